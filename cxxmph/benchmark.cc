@@ -6,6 +6,12 @@
 #include <memory>
 #include <sys/time.h>
 #include <sys/resource.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include <iomanip>
 #include <iostream>
@@ -91,6 +97,106 @@ string demangle(const string& name) { return name; }
 #endif
  
 
+// Hardware counters of the process, read with perf_event_open(2) on Linux
+// while a benchmark runs. Counters the kernel, the CPU or the permissions
+// do not provide are left out, and the benchmarks run without them.
+struct PerfEvent {
+  const char* name;
+  uint32_t type;
+  uint64_t config;
+};
+
+#ifdef __linux__
+#define PERF_CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+const PerfEvent kPerfEvents[] = {
+  { "Cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { "Instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { "LLC misses", PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+  { "dTLB misses", PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+  { "Branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+const int kNumPerfEvents = sizeof(kPerfEvents) / sizeof(kPerfEvents[0]);
+#else
+const PerfEvent* kPerfEvents = NULL;
+const int kNumPerfEvents = 0;
+#endif
+
+class PerfCounters {
+ public:
+  PerfCounters() {
+    for (int i = 0; i < kNumPerfEvents; ++i) fds_.push_back(Open(kPerfEvents[i]));
+  }
+  ~PerfCounters() {
+#ifdef __linux__
+    for (uint32_t i = 0; i < fds_.size(); ++i) if (fds_[i] >= 0) close(fds_[i]);
+#endif
+  }
+  void Start() {
+#ifdef __linux__
+    for (uint32_t i = 0; i < fds_.size(); ++i) {
+      if (fds_[i] < 0) continue;
+      ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+  void Stop() {
+#ifdef __linux__
+    for (uint32_t i = 0; i < fds_.size(); ++i) {
+      if (fds_[i] >= 0) ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+#endif
+  }
+  // Count of the i-th event, scaled up when the kernel multiplexed the
+  // counters. Returns false if the event is not counted.
+  bool Read(int i, double* count) const {
+#ifdef __linux__
+    uint64_t values[3];  // value, time enabled, time running
+    if (fds_[i] < 0 || read(fds_[i], values, sizeof(values)) != sizeof(values)) {
+      return false;
+    }
+    if (values[2] == 0) return false;  // never scheduled on the PMU
+    *count = static_cast<double>(values[0]);
+    if (values[2] < values[1]) *count *= static_cast<double>(values[1]) / values[2];
+    return true;
+#else
+    return false;
+#endif
+  }
+
+ private:
+  static int Open(const PerfEvent& event) {
+#ifdef __linux__
+    static bool warned = false;
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;  // allowed with perf_event_paranoid up to 2
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0 && !warned) {
+      cerr << "Hardware counter " << event.name << " is not available ("
+           << strerror(errno) << "), benchmarks run without it" << endl;
+      if (errno == EACCES || errno == EPERM) {
+        cerr << "See /proc/sys/kernel/perf_event_paranoid" << endl;
+      }
+      warned = true;
+    }
+    return fd;
+#else
+    return -1;
+#endif
+  }
+  vector<int> fds_;
+};
+
 static vector<cxxmph::Benchmark*> g_benchmarks;
 
 }  // anonymous namespace
@@ -119,9 +225,12 @@ namespace cxxmph {
 }
 
 void Benchmark::MeasureRun() {
+  PerfCounters counters;
   struct timeval walltime_begin = gettimeofday_or_die();
   struct rusage begin = getrusage_or_die();
+  counters.Start();
   Run();
+  counters.Stop();
   struct rusage end = getrusage_or_die();
   struct timeval walltime_end = gettimeofday_or_die();
 
@@ -136,6 +245,17 @@ void Benchmark::MeasureRun() {
   cout << "CPU User time  : " << timeval_to_string(utime) << endl;
   cout << "CPU System time: " << timeval_to_string(stime) << endl;
   cout << "Wall clock time: " << timeval_to_string(wtime) << endl;
+  double ops = static_cast<double>(operations_);
+  cout << "Operations     : " << operations_ << endl;
+  cout << "Wall ns/op     : " << std::fixed << std::setprecision(2)
+       << (wtime.tv_sec * 1e9 + wtime.tv_usec * 1e3) / ops << endl;
+  for (int i = 0; i < kNumPerfEvents; ++i) {
+    double count;
+    if (!counters.Read(i, &count)) continue;
+    cout << std::left << setw(15) << (string(kPerfEvents[i].name) + "/op")
+         << std::right << ": " << count / ops << endl;
+  }
+  cout.unsetf(std::ios::floatfield);
   cout << endl;
 }
 
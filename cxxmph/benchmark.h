@@ -1,6 +1,7 @@
 #ifndef __CXXMPH_BENCHMARK_H__
 #define __CXXMPH_BENCHMARK_H__
 
+#include <stdint.h>
 #include <string>
 #include <typeinfo>
 
@@ -8,11 +9,14 @@ namespace cxxmph {
 
 class Benchmark {
  public:
-  Benchmark() {}
+  Benchmark() : operations_(1) {}
   virtual ~Benchmark() {}
 
   const std::string& name() { return name_; }
   void set_name(const std::string& name) { name_ = name; }
+  // Operations done by Run(), such as lookups, by which the time and the
+  // hardware counters are divided.
+  uint64_t operations() const { return operations_; }
 
   static void Register(Benchmark* bm);
   static void RunAll();
@@ -21,9 +25,11 @@ class Benchmark {
   virtual bool SetUp() { return true; }; 
   virtual void Run() = 0;
   virtual bool TearDown() { return true; };
+  void set_operations(uint64_t operations) { operations_ = operations; }
 
  private:
   std::string name_;
+  uint64_t operations_;
   void MeasureRun();
 };
 
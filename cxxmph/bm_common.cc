@@ -19,7 +19,9 @@ bool UrlsBenchmark::SetUp() {
   vector<string> urls;
   std::ifstream f(urls_file_.c_str());
   if (!f.is_open()) {
-    cerr << "Failed to open urls file " << urls_file_ << endl;
+    cerr << "Failed to open urls file " << urls_file_
+         << ", generate it with: cmph keygen -t url -n 100k -s 1 -o "
+         << urls_file_ << endl;
     return false;
   }
   string buffer;
@@ -30,6 +32,7 @@ bool UrlsBenchmark::SetUp() {
     return false;
   }
   urls.swap(urls_);
+  set_operations(urls_.size());
   return true;
 }
 
@@ -46,6 +49,7 @@ bool SearchUrlsBenchmark::SetUp() {
       random_[i] = forced_miss_urls_[i];
     }
   }
+  set_operations(nsearches_);
   return true;
 }
 
@@ -58,6 +62,7 @@ bool Uint64Benchmark::SetUp() {
     values_.push_back(v);
     unique.insert(v);
   }
+  set_operations(count_);
   return true;
 }
 
@@ -69,6 +74,7 @@ bool SearchUint64Benchmark::SetUp() {
     uint32_t pos = random() % values_.size();
     random_[i] = values_[pos];
   }
+  set_operations(nsearches_);
   return true;
 }
 
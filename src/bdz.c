@@ -275,6 +275,7 @@ cmph_t *bdz_new(cmph_config_t *mph, double c)
 	cmph_uint32 iterations;
 	bdz_queue_t edges;
 	bdz_graph3_t graph3;
+	cmph_stats_mark_t mark;
 	bdz_config_data_t *bdz = (bdz_config_data_t *)mph->data;
 	#ifdef CMPH_TIMING
 	double construction_time_begin = 0.0;
@@ -318,10 +319,11 @@ cmph_t *bdz_new(cmph_config_t *mph, double c)
 	{
 		int ok;
 		DEBUGP("linear hash function \n");
-		bdz->hl = hash_state_new(bdz->hashfunc, 15);
+		bdz->hl = hash_state_new(bdz->hashfunc, bdz->n);
 
 		ok = bdz_mapping(mph, &graph3, edges);
                 //ok = 0;
+		cmph_stats_iteration(mph->stats, ok);
 		if (!ok)
 		{
 			--iterations;
@@ -349,7 +351,9 @@ cmph_t *bdz_new(cmph_config_t *mph, double c)
 	{
 		fprintf(stderr, "Entering assigning step for mph creation of %u keys with graph sized %u\n", bdz->m, bdz->n);
 	}
+	cmph_stats_begin(mph->stats, &mark);
 	assigning(bdz, &graph3, edges);
+	cmph_stats_end(mph->stats, CMPH_PHASE_ASSIGNING, &mark);
 
 	bdz_free_queue(&edges);
 	bdz_free_graph3(&graph3);
@@ -357,7 +361,9 @@ cmph_t *bdz_new(cmph_config_t *mph, double c)
 	{
 		fprintf(stderr, "Entering ranking step for mph creation of %u keys with graph sized %u\n", bdz->m, bdz->n);
 	}
+	cmph_stats_begin(mph->stats, &mark);
 	ranking(bdz);
+	cmph_stats_end(mph->stats, CMPH_PHASE_RANKING, &mark);
 	#ifdef CMPH_TIMING
 	ELAPSED_TIME_IN_SECONDS(&construction_time);
 	#endif
@@ -378,6 +384,12 @@ cmph_t *bdz_new(cmph_config_t *mph, double c)
 	bdzf->r = bdz->r;
 	mphf->data = bdzf;
 	mphf->size = bdz->m;
+	cmph_stats_component(mph->stats, "g", ceil(bdz->n/4.0)*8);
+	cmph_stats_component(mph->stats, "ranktable", bdz->ranktablesize*32.0);
+	cmph_stats_component(mph->stats, "hash", hash_state_packed_size(bdz->hashfunc)*8.0);
+	cmph_stats_parameter(mph->stats, "c", c);
+	cmph_stats_parameter(mph->stats, "b", bdz->b);
+	cmph_stats_parameter(mph->stats, "n", bdz->n);
 
 	DEBUGP("Successfully generated minimal perfect hash\n");
 	if (mph->verbosity)
@@ -402,7 +414,9 @@ static int bdz_mapping(cmph_config_t *mph, bdz_graph3_t* graph3, bdz_queue_t que
 	cmph_uint32 e;
 	int cycles = 0;
 	cmph_uint32 hl[3];
+	cmph_stats_mark_t mark;
 	bdz_config_data_t *bdz = (bdz_config_data_t *)mph->data;
+	cmph_stats_begin(mph->stats, &mark);
 	bdz_init_graph3(graph3, bdz->m, bdz->n);
 	mph->key_source->rewind(mph->key_source->data);
 	for (e = 0; e < mph->key_source->nkeys; ++e)
@@ -419,7 +433,10 @@ static int bdz_mapping(cmph_config_t *mph, bdz_graph3_t* graph3, bdz_queue_t que
 		mph->key_source->dispose(mph->key_source->data, key, keylen);
 		bdz_add_edge(graph3,h0,h1,h2);
 	}
+	cmph_stats_end(mph->stats, CMPH_PHASE_MAPPING, &mark);
+	cmph_stats_begin(mph->stats, &mark);
 	cycles = bdz_generate_queue(bdz->m, bdz->n, queue, graph3);
+	cmph_stats_end(mph->stats, CMPH_PHASE_SEARCHING, &mark);
 	return (cycles == 0);
 }
 
@@ -241,6 +241,7 @@ cmph_t *bdz_ph_new(cmph_config_t *mph, double c)
 	cmph_uint32 iterations;
 	bdz_ph_queue_t edges;
 	bdz_ph_graph3_t graph3;
+	cmph_stats_mark_t mark;
 	bdz_ph_config_data_t *bdz_ph = (bdz_ph_config_data_t *)mph->data;
 	#ifdef CMPH_TIMING
 	double construction_time_begin = 0.0;
@@ -281,6 +282,7 @@ cmph_t *bdz_ph_new(cmph_config_t *mph, double c)
 		bdz_ph->hl = hash_state_new(bdz_ph->hashfunc, 15);
 
 		ok = bdz_ph_mapping(mph, &graph3, edges);
+		cmph_stats_iteration(mph->stats, ok);
 		if (!ok)
 		{
 			--iterations;
@@ -309,7 +311,9 @@ cmph_t *bdz_ph_new(cmph_config_t *mph, double c)
 	{
 		fprintf(stderr, "Entering assigning step for mph creation of %u keys with graph sized %u\n", bdz_ph->m, bdz_ph->n);
 	}
+	cmph_stats_begin(mph->stats, &mark);
 	assigning(bdz_ph, &graph3, edges);
+	cmph_stats_end(mph->stats, CMPH_PHASE_ASSIGNING, &mark);
 
 	bdz_ph_free_queue(&edges);
 	bdz_ph_free_graph3(&graph3);
@@ -319,7 +323,9 @@ cmph_t *bdz_ph_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "Starting optimization step\n");
 	}
 
+	cmph_stats_begin(mph->stats, &mark);
 	bdz_ph_optimization(bdz_ph);
+	cmph_stats_end(mph->stats, CMPH_PHASE_RANKING, &mark);
 
 	#ifdef CMPH_TIMING
 	ELAPSED_TIME_IN_SECONDS(&construction_time);
@@ -336,6 +342,10 @@ cmph_t *bdz_ph_new(cmph_config_t *mph, double c)
 	bdz_phf->r = bdz_ph->r;
 	mphf->data = bdz_phf;
 	mphf->size = bdz_ph->n;
+	cmph_stats_component(mph->stats, "g", ceil(bdz_ph->n/5.0)*8);
+	cmph_stats_component(mph->stats, "hash", hash_state_packed_size(bdz_ph->hashfunc)*8.0);
+	cmph_stats_parameter(mph->stats, "c", c);
+	cmph_stats_parameter(mph->stats, "n", bdz_ph->n);
 
 	DEBUGP("Successfully generated minimal perfect hash\n");
 	if (mph->verbosity)
@@ -359,8 +369,10 @@ static int bdz_ph_mapping(cmph_config_t *mph, bdz_ph_graph3_t* graph3, bdz_ph_qu
 	cmph_uint32 e;
 	int cycles = 0;
 	cmph_uint32 hl[3];
+	cmph_stats_mark_t mark;
 
 	bdz_ph_config_data_t *bdz_ph = (bdz_ph_config_data_t *)mph->data;
+	cmph_stats_begin(mph->stats, &mark);
 	bdz_ph_init_graph3(graph3, bdz_ph->m, bdz_ph->n);
 	mph->key_source->rewind(mph->key_source->data);
 	for (e = 0; e < mph->key_source->nkeys; ++e)
@@ -376,7 +388,10 @@ static int bdz_ph_mapping(cmph_config_t *mph, bdz_ph_graph3_t* graph3, bdz_ph_qu
 		mph->key_source->dispose(mph->key_source->data, key, keylen);
 		bdz_ph_add_edge(graph3,h0,h1,h2);
 	}
+	cmph_stats_end(mph->stats, CMPH_PHASE_MAPPING, &mark);
+	cmph_stats_begin(mph->stats, &mark);
 	cycles = bdz_ph_generate_queue(bdz_ph->m, bdz_ph->n, queue, graph3);
+	cmph_stats_end(mph->stats, CMPH_PHASE_SEARCHING, &mark);
 	return (cycles == 0);
 }
 
@@ -0,0 +1,587 @@
+#ifdef WIN32
+#include "wingetopt.h"
+#else
+#include <getopt.h>
+#endif
+#include "bench.h"
+#include "cmph.h"
+#include "cmph_blob.h"
+#include "cmph_searcher.h"
+#include "cmph_stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+//#define DEBUG
+#include "debug.h"
+
+#define BENCH_BATCH 64                    // keys of a call to cmph_searcher_search_batch()
+#define BENCH_DEFAULT_NLOOKUPS (1U << 20)
+#define BENCH_DEFAULT_ROUNDS 3
+
+/* Algorithms and parameters built by the benchmark. A b of 0 leaves the
+ * default of the algorithm.
+ */
+typedef struct
+{
+	CMPH_ALGO algo;
+	CMPH_ALGO bucket_algo;   // of BRZ
+	double c;
+	cmph_uint32 b;
+} bench_config_t;
+
+static const bench_config_t bench_configs[] =
+{
+	{ CMPH_BMZ, CMPH_COUNT, 1.15, 0 },
+	{ CMPH_BMZ, CMPH_COUNT, 1.5, 0 },
+	{ CMPH_BMZ8, CMPH_COUNT, 1.0, 0 },
+	{ CMPH_CHM, CMPH_COUNT, 2.09, 0 },
+	{ CMPH_CHM, CMPH_COUNT, 3.0, 0 },
+	{ CMPH_BRZ, CMPH_BMZ8, 1.0, 128 },
+	{ CMPH_BRZ, CMPH_FCH, 2.6, 128 },
+	{ CMPH_BRZ, CMPH_BDZ, 1.23, 2048 },
+	{ CMPH_BRZ, CMPH_CHD, 0.99, 2048 },
+	{ CMPH_FCH, CMPH_COUNT, 2.6, 0 },
+	{ CMPH_FCH, CMPH_COUNT, 3.0, 0 },
+	{ CMPH_BDZ, CMPH_COUNT, 1.23, 7 },
+	{ CMPH_BDZ, CMPH_COUNT, 1.23, 4 },
+	{ CMPH_BDZ_PH, CMPH_COUNT, 1.23, 0 },
+	{ CMPH_CHD_PH, CMPH_COUNT, 0.99, 4 },
+	{ CMPH_CHD_PH, CMPH_COUNT, 0.81, 5 },
+	{ CMPH_CHD, CMPH_COUNT, 0.5, 4 },
+	{ CMPH_CHD, CMPH_COUNT, 0.99, 4 },
+	{ CMPH_CHD, CMPH_COUNT, 0.99, 6 },
+};
+#define BENCH_NCONFIGS (sizeof(bench_configs)/sizeof(bench_configs[0]))
+
+/* Ways the functions are searched and keys searched. */
+typedef enum { BENCH_UNPACKED, BENCH_PACKED, BENCH_MMAP, BENCH_NVARIANTS } BENCH_VARIANT;
+typedef enum { BENCH_HIT, BENCH_MISS, BENCH_BATCH_HIT, BENCH_NPATTERNS } BENCH_PATTERN;
+static const char *bench_variant_names[] = { "unpacked", "packed", "mmap" };
+static const char *bench_pattern_names[] = { "hit_ns", "miss_ns", "batch_ns" };
+
+typedef struct
+{
+	char *buffer;
+	char **keys;             // NUL terminated lines of buffer
+	cmph_uint32 nkeys;
+	// lookups in random order, with their keys copied in order so that reading
+	// the keys does not miss the cache more than searching them
+	char *hit_buffer;
+	const char **hits;
+	cmph_uint32 *hit_lens;
+	char *miss_buffer;
+	const char **misses;     // keys of the set followed by a newline, so out of it
+	cmph_uint32 *miss_lens;
+	cmph_uint32 nlookups;
+} bench_keys_t;
+
+typedef struct
+{
+	int ok;
+	double build_seconds;
+	double build_cpu_seconds;
+	cmph_uint32 iterations;
+	cmph_uint64 build_memory;   // growth of the resident memory during the build, 0 if unknown
+	double bits_per_key;
+	double ns[BENCH_NVARIANTS][BENCH_NPATTERNS];   // per key, negative when not measured
+} bench_result_t;
+
+static volatile cmph_uint32 bench_sink;
+
+static void bench_usage(const char *prg)
+{
+	fprintf(stderr, "usage: %s bench [-a algorithm] [-k nkeys] [-l nlookups] [-r rounds] [-s seed] [-d tmp_dir] [-o file.json] keysfile\n", prg);
+	fprintf(stderr, "  -a\t algorithm to build (may be used multiple times), all of them by default\n");
+	fprintf(stderr, "  -k\t number of keys read from keysfile\n");
+	fprintf(stderr, "  -l\t number of lookups of each pattern (default %u)\n", BENCH_DEFAULT_NLOOKUPS);
+	fprintf(stderr, "  -r\t rounds of the lookups, of which the fastest is reported (default %u)\n", BENCH_DEFAULT_ROUNDS);
+	fprintf(stderr, "  -s\t random seed of the order of the lookups\n");
+	fprintf(stderr, "  -d\t temporary directory of BRZ and of the blobs mapped (default /var/tmp/)\n");
+	fprintf(stderr, "  -o\t write the results to the file as JSON lines\n");
+}
+
+static double bench_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Resident memory of the process from /proc, VmRSS or its peak VmHWM, in
+ * bytes, or 0 where it is not available.
+ */
+static cmph_uint64 bench_memory(const char *field)
+{
+	char line[128];
+	size_t len = strlen(field);
+	unsigned long long kb = 0;
+	FILE *f = fopen("/proc/self/status", "r");
+	if (f == NULL) return 0;
+	while (fgets(line, sizeof(line), f))
+	{
+		if (strncmp(line, field, len) == 0 && line[len] == ':')
+		{
+			kb = strtoull(line + len + 1, NULL, 10);
+			break;
+		}
+	}
+	fclose(f);
+	return (cmph_uint64)kb * 1024;
+}
+
+// Starts a new peak of the resident memory, on Linux only
+static int bench_reset_peak(void)
+{
+	FILE *f = fopen("/proc/self/clear_refs", "w");
+	if (f == NULL) return 0;
+	if (fputs("5", f) == EOF)
+	{
+		fclose(f);
+		return 0;
+	}
+	return fclose(f) == 0;
+}
+
+static int bench_read_keys(bench_keys_t *keys, const char *keys_file, cmph_uint32 nkeys)
+{
+	FILE *f = fopen(keys_file, "rb");
+	size_t len = 0, capacity = 1 << 20, nread;
+	cmph_uint32 capacity_keys = 0;
+	char *p, *end;
+	if (f == NULL)
+	{
+		fprintf(stderr, "Unable to open file %s: %s\n", keys_file, strerror(errno));
+		return 0;
+	}
+	keys->buffer = (char *)malloc(capacity + 1);
+	while ((nread = fread(keys->buffer + len, 1, capacity - len, f)) > 0)
+	{
+		len += nread;
+		if (len == capacity)
+		{
+			capacity *= 2;
+			keys->buffer = (char *)realloc(keys->buffer, capacity + 1);
+		}
+	}
+	fclose(f);
+	keys->buffer[len] = '\n';
+	keys->keys = NULL;
+	keys->nkeys = 0;
+	end = keys->buffer + len;
+	for (p = keys->buffer; p < end && keys->nkeys < nkeys; )
+	{
+		char *newline = (char *)memchr(p, '\n', (size_t)(end - p) + 1);
+		if (keys->nkeys == capacity_keys)
+		{
+			capacity_keys = capacity_keys ? capacity_keys * 2 : 65536;
+			keys->keys = (char **)realloc(keys->keys, sizeof(char *)*capacity_keys);
+		}
+		*newline = 0;
+		keys->keys[keys->nkeys++] = p;
+		p = newline + 1;
+	}
+	if (keys->nkeys == 0)
+	{
+		fprintf(stderr, "No keys in %s\n", keys_file);
+		return 0;
+	}
+	return 1;
+}
+
+/* Draws the keys of the lookups. The keys out of the set are the keys of the
+ * set followed by a newline, which no line holds.
+ */
+static void bench_draw_lookups(bench_keys_t *keys, cmph_uint32 nlookups, cmph_uint32 seed)
+{
+	cmph_uint64 state = seed ? seed : 1;
+	size_t nbytes = 0, pos = 0, miss_pos = 0;
+	cmph_uint32 i;
+	keys->nlookups = nlookups;
+	keys->hits = (const char **)malloc(sizeof(char *)*nlookups);
+	keys->hit_lens = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*nlookups);
+	keys->misses = (const char **)malloc(sizeof(char *)*nlookups);
+	keys->miss_lens = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*nlookups);
+	for (i = 0; i < nlookups; ++i)
+	{
+		cmph_uint32 k;
+		// xorshift64*, the same sequence on every platform
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		k = (cmph_uint32)(((state * 2685821657736338717ULL) >> 32) % keys->nkeys);
+		keys->hits[i] = keys->keys[k];
+		keys->hit_lens[i] = (cmph_uint32)strlen(keys->keys[k]);
+		nbytes += keys->hit_lens[i] + 1;
+	}
+	keys->hit_buffer = (char *)malloc(nbytes);
+	keys->miss_buffer = (char *)malloc(nbytes);
+	for (i = 0; i < nlookups; ++i)
+	{
+		cmph_uint32 len = keys->hit_lens[i];
+		memcpy(keys->hit_buffer + pos, keys->hits[i], len);
+		keys->hits[i] = keys->hit_buffer + pos;
+		pos += len;
+	}
+	for (i = 0; i < nlookups; ++i)
+	{
+		// the misses are the hits of the lookups in reverse order
+		cmph_uint32 len = keys->hit_lens[nlookups - 1 - i];
+		memcpy(keys->miss_buffer + miss_pos, keys->hits[nlookups - 1 - i], len);
+		keys->miss_buffer[miss_pos + len] = '\n';
+		keys->misses[i] = keys->miss_buffer + miss_pos;
+		keys->miss_lens[i] = len + 1;
+		miss_pos += len + 1;
+	}
+}
+
+static void bench_keys_destroy(bench_keys_t *keys)
+{
+	free(keys->buffer);
+	free(keys->keys);
+	free(keys->hit_buffer);
+	free((void *)keys->hits);
+	free(keys->hit_lens);
+	free(keys->miss_buffer);
+	free((void *)keys->misses);
+	free(keys->miss_lens);
+}
+
+/* Time of the fastest of rounds lookups of all keys, in ns per key. */
+static double bench_lookups(cmph_t *mphf, void *packed, const cmph_searcher_t *searcher, const char **keys, const cmph_uint32 *keylens, cmph_uint32 nkeys, cmph_uint32 rounds)
+{
+	cmph_uint32 values[BENCH_BATCH];
+	double best = 0;
+	cmph_uint32 round, i, sum = 0;
+	for (round = 0; round < rounds; ++round)
+	{
+		double begin = bench_now(), elapsed;
+		if (searcher)
+		{
+			for (i = 0; i < nkeys; i += BENCH_BATCH)
+			{
+				cmph_uint32 n = nkeys - i < BENCH_BATCH ? nkeys - i : BENCH_BATCH;
+				cmph_searcher_search_batch(searcher, n, keys + i, keylens + i, values);
+				sum += values[0];
+			}
+		}
+		else if (packed)
+		{
+			for (i = 0; i < nkeys; ++i) sum += cmph_search_packed(packed, keys[i], keylens[i]);
+		}
+		else
+		{
+			for (i = 0; i < nkeys; ++i) sum += cmph_search(mphf, keys[i], keylens[i]);
+		}
+		elapsed = bench_now() - begin;
+		if (round == 0 || elapsed < best) best = elapsed;
+	}
+	bench_sink = sum;
+	return best * 1e9 / nkeys;
+}
+
+// Measures the patterns of a variant, searched on the function or on its packed form
+static void bench_patterns(bench_result_t *result, BENCH_VARIANT variant, cmph_t *mphf, void *packed, const bench_keys_t *keys, cmph_uint32 rounds)
+{
+	result->ns[variant][BENCH_HIT] = bench_lookups(mphf, packed, NULL, keys->hits, keys->hit_lens, keys->nlookups, rounds);
+	result->ns[variant][BENCH_MISS] = bench_lookups(mphf, packed, NULL, keys->misses, keys->miss_lens, keys->nlookups, rounds);
+	if (packed)
+	{
+		cmph_searcher_t *searcher = cmph_searcher_new_packed(packed);
+		if (searcher)
+		{
+			result->ns[variant][BENCH_BATCH_HIT] = bench_lookups(NULL, NULL, searcher, keys->hits, keys->hit_lens, keys->nlookups, rounds);
+			cmph_searcher_destroy(searcher);
+		}
+	}
+}
+
+static void bench_run(const bench_config_t *config, const bench_keys_t *keys, const char *tmp_dir, const char *blob_file, cmph_uint32 rounds, bench_result_t *result)
+{
+	cmph_io_adapter_t *source = cmph_io_vector_adapter(keys->keys, keys->nkeys);
+	cmph_config_t *mph = cmph_config_new(source);
+	FILE *mphf_fd = config->algo == CMPH_BRZ ? tmpfile() : NULL;
+	cmph_stats_t stats;
+	cmph_uint64 rss;
+	cmph_t *mphf;
+	cmph_blob_t *blob;
+	FILE *blob_fd;
+	void *packed;
+	cmph_uint32 i, j;
+	int peak = 0;
+
+	memset(result, 0, sizeof(bench_result_t));
+	for (i = 0; i < BENCH_NVARIANTS; ++i)
+	{
+		for (j = 0; j < BENCH_NPATTERNS; ++j) result->ns[i][j] = -1;
+	}
+	cmph_config_set_algo(mph, config->algo);
+	if (config->bucket_algo != CMPH_COUNT) cmph_config_set_brz_algo(mph, config->bucket_algo);
+	cmph_config_set_tmp_dir(mph, (cmph_uint8 *)tmp_dir);
+	if (mphf_fd) cmph_config_set_mphf_fd(mph, mphf_fd);
+	if (config->b) cmph_config_set_b(mph, config->b);
+	cmph_config_set_graphsize(mph, config->c);
+	cmph_config_set_stats(mph, &stats);
+
+#ifdef __GLIBC__
+	// memory freed by the previous builds would be reused without being counted
+	malloc_trim(0);
+#endif
+	rss = bench_memory("VmRSS");
+	if (rss) peak = bench_reset_peak();
+	mphf = cmph_new(mph);
+	if (peak)
+	{
+		cmph_uint64 hwm = bench_memory("VmHWM");
+		result->build_memory = hwm > rss ? hwm - rss : 0;
+	}
+	cmph_config_destroy(mph);
+	cmph_io_vector_adapter_destroy(source);
+	if (mphf && mphf_fd)
+	{
+		// a function of BRZ is complete once it is written
+		cmph_dump(mphf, mphf_fd);
+		cmph_destroy(mphf);
+		rewind(mphf_fd);
+		mphf = cmph_load(mphf_fd);
+	}
+	if (mphf_fd) fclose(mphf_fd);
+	if (mphf == NULL) return;
+	result->ok = 1;
+	result->build_seconds = stats.total_wall;
+	result->build_cpu_seconds = stats.total_cpu;
+	result->iterations = stats.iterations;
+	result->bits_per_key = cmph_packed_size(mphf) * 8.0 / keys->nkeys;
+
+	bench_patterns(result, BENCH_UNPACKED, mphf, NULL, keys, rounds);
+	packed = malloc((size_t)cmph_packed_size(mphf));
+	cmph_pack(mphf, packed);
+	bench_patterns(result, BENCH_PACKED, NULL, packed, keys, rounds);
+	free(packed);
+
+	blob_fd = fopen(blob_file, "wb");
+	if (blob_fd && cmph_blob_dump(mphf, blob_fd, CMPH_CHECKSUM_CRC32C) && fclose(blob_fd) == 0)
+	{
+		blob = cmph_blob_open(blob_file, CMPH_BLOB_VERIFY);
+		packed = blob ? cmph_blob_packed(blob) : NULL;
+		if (packed) bench_patterns(result, BENCH_MMAP, NULL, packed, keys, rounds);
+		if (blob) cmph_blob_close(blob);
+	}
+	else
+	{
+		fprintf(stderr, "Unable to write the blob %s\n", blob_file);
+		if (blob_fd) fclose(blob_fd);
+	}
+	remove(blob_file);
+	cmph_destroy(mphf);
+}
+
+static void bench_print_header(void)
+{
+	printf("%54s |%-14s |%-21s |%s\n", "", " unpacked ns", " packed ns", " mmap ns");
+	printf("%-7s %-6s %5s %5s %9s %8s %8s | %6s %6s | %6s %6s %6s | %6s %6s %6s\n",
+	       "algo", "bucket", "c", "b", "build_s", "mem_MB", "bits/key", "hit", "miss", "hit", "miss", "batch", "hit", "miss", "batch");
+}
+
+static void bench_print(const bench_config_t *config, const bench_result_t *result)
+{
+	cmph_uint32 i, j;
+	printf("%-7s %-6s %5.2f %5u ", cmph_names[config->algo], config->bucket_algo != CMPH_COUNT ? cmph_names[config->bucket_algo] : "-", config->c, config->b);
+	if (!result->ok)
+	{
+		printf("failed\n");
+		return;
+	}
+	printf("%9.3f ", result->build_seconds);
+	if (result->build_memory) printf("%8.1f ", (double)result->build_memory / (1 << 20));
+	else printf("%8s ", "-");
+	printf("%8.3f", result->bits_per_key);
+	for (i = 0; i < BENCH_NVARIANTS; ++i)
+	{
+		printf(" |");
+		for (j = 0; j < BENCH_NPATTERNS; ++j)
+		{
+			if (result->ns[i][j] >= 0) printf(" %6.1f", result->ns[i][j]);
+			else if (i != BENCH_UNPACKED) printf(" %6s", "-");
+		}
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+static void bench_json(FILE *f, const char *keys_file, const bench_keys_t *keys, const bench_config_t *config, const bench_result_t *result)
+{
+	cmph_uint32 i, j;
+	const char *p;
+	fprintf(f, "{\"keys\":\"");
+	for (p = keys_file; *p; ++p)
+	{
+		if (*p == '"' || *p == '\\') fputc('\\', f);
+		fputc(*p, f);
+	}
+	fprintf(f, "\",\"nkeys\":%u,\"nlookups\":%u,\"algo\":\"%s\",", keys->nkeys, keys->nlookups, cmph_names[config->algo]);
+	if (config->bucket_algo != CMPH_COUNT) fprintf(f, "\"bucket_algo\":\"%s\",", cmph_names[config->bucket_algo]);
+	fprintf(f, "\"c\":%.10g,\"b\":%u,\"ok\":%s", config->c, config->b, result->ok ? "true" : "false");
+	if (result->ok)
+	{
+		fprintf(f, ",\"build_seconds\":%.6f,\"build_cpu_seconds\":%.6f,\"iterations\":%u,\"build_memory_bytes\":",
+		        result->build_seconds, result->build_cpu_seconds, result->iterations);
+		if (result->build_memory) fprintf(f, "%llu", (unsigned long long)result->build_memory);
+		else fprintf(f, "null");
+		fprintf(f, ",\"bits_per_key\":%.4f,\"lookups\":{", result->bits_per_key);
+		for (i = 0; i < BENCH_NVARIANTS; ++i)
+		{
+			cmph_uint32 n = 0;
+			fprintf(f, "%s\"%s\":{", i ? "," : "", bench_variant_names[i]);
+			for (j = 0; j < BENCH_NPATTERNS; ++j)
+			{
+				if (result->ns[i][j] < 0) continue;
+				fprintf(f, "%s\"%s\":%.2f", n++ ? "," : "", bench_pattern_names[j], result->ns[i][j]);
+			}
+			fputc('}', f);
+		}
+		fputc('}', f);
+	}
+	fprintf(f, "}\n");
+}
+
+int bench_main(int argc, char **argv)
+{
+	cmph_uint32 nkeys = UINT_MAX;
+	cmph_uint32 nlookups = BENCH_DEFAULT_NLOOKUPS;
+	cmph_uint32 rounds = BENCH_DEFAULT_ROUNDS;
+	cmph_uint32 seed = 1;
+	const char *tmp_dir = "/var/tmp/";
+	const char *json_file = NULL;
+	cmph_uint8 selected[CMPH_COUNT];
+	cmph_uint32 nselected = 0;
+	bench_keys_t keys;
+	bench_result_t result;
+	char *blob_file;
+	unsigned long id;
+	FILE *json_fd = NULL;
+	cmph_uint32 i;
+	int ret = 0;
+
+	memset(selected, 0, sizeof(selected));
+	memset(&keys, 0, sizeof(keys));
+	while (1)
+	{
+		int ch = getopt(argc, argv, "ha:k:l:r:s:d:o:");
+		char *endptr;
+		if (ch == -1) break;
+		switch (ch)
+		{
+			case 'a':
+				for (i = 0; i < CMPH_COUNT; ++i)
+				{
+					if (strcmp(cmph_names[i], optarg) == 0) break;
+				}
+				if (i == CMPH_COUNT)
+				{
+					fprintf(stderr, "Invalid mph algorithm: %s\n", optarg);
+					return 1;
+				}
+				if (!selected[i]) ++nselected;
+				selected[i] = 1;
+				break;
+			case 'k':
+			case 'l':
+			case 'r':
+			case 's':
+				{
+					unsigned long value = strtoul(optarg, &endptr, 10);
+					if (*endptr != 0 || (ch != 's' && value == 0))
+					{
+						fprintf(stderr, "Invalid value %s of -%c\n", optarg, ch);
+						return 1;
+					}
+					if (ch == 'k') nkeys = (cmph_uint32)value;
+					else if (ch == 'l') nlookups = (cmph_uint32)value;
+					else if (ch == 'r') rounds = (cmph_uint32)value;
+					else seed = (cmph_uint32)value;
+				}
+				break;
+			case 'd':
+				tmp_dir = optarg;
+				break;
+			case 'o':
+				json_file = optarg;
+				break;
+			case 'h':
+			default:
+				bench_usage("cmph");
+				return ch == 'h' ? 0 : 1;
+		}
+	}
+	if (optind != argc - 1)
+	{
+		bench_usage("cmph");
+		return 1;
+	}
+	if (!bench_read_keys(&keys, argv[optind], nkeys))
+	{
+		bench_keys_destroy(&keys);
+		return 1;
+	}
+	if (json_file)
+	{
+		json_fd = fopen(json_file, "w");
+		if (json_fd == NULL)
+		{
+			fprintf(stderr, "Unable to open output file %s: %s\n", json_file, strerror(errno));
+			bench_keys_destroy(&keys);
+			return 1;
+		}
+	}
+	bench_draw_lookups(&keys, nlookups, seed);
+	// the blob is named after the process, so that benchmarks sharing the directory do not overwrite each other
+#ifdef HAVE_UNISTD_H
+	id = (unsigned long)getpid();
+#else
+	id = (unsigned long)time(NULL);
+#endif
+	blob_file = (char *)malloc(strlen(tmp_dir) + 48);
+	sprintf(blob_file, "%s%scmph_bench.%lu.mph", tmp_dir, tmp_dir[0] && tmp_dir[strlen(tmp_dir) - 1] != '/' ? "/" : "", id);
+	DEBUGP("Benchmark of %u keys with %u lookups\n", keys.nkeys, nlookups);
+
+	bench_print_header();
+	for (i = 0; i < BENCH_NCONFIGS; ++i)
+	{
+		const bench_config_t *config = bench_configs + i;
+		if (nselected && !selected[config->algo]) continue;
+		if (config->algo == CMPH_BMZ8 && keys.nkeys > 255)
+		{
+			fprintf(stderr, "Skipping bmz8: its functions hold at most 255 keys, not %u\n", keys.nkeys);
+			continue;
+		}
+		bench_run(config, &keys, tmp_dir, blob_file, rounds, &result);
+		bench_print(config, &result);
+		if (json_fd) bench_json(json_fd, argv[optind], &keys, config, &result);
+	}
+	if (json_fd && fclose(json_fd) != 0)
+	{
+		fprintf(stderr, "Unable to write %s\n", json_file);
+		ret = 1;
+	}
+	free(blob_file);
+	bench_keys_destroy(&keys);
+	return ret;
+}
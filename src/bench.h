@@ -0,0 +1,17 @@
+#ifndef __CMPH_BENCH_H__
+#define __CMPH_BENCH_H__
+
+/** \fn int bench_main(int argc, char **argv);
+ *  \brief The bench subcommand of the cmph tool. Builds the functions of a
+ *  keys file with each algorithm and a few values of its parameters, and
+ *  measures the time and the memory of the build, the size of the function
+ *  and the time of the lookups of keys of the set and of keys out of it,
+ *  searched one at a time and in batches, on the function as built, packed
+ *  and mapped from a blob. Prints a table to stdout and writes the results
+ *  as JSON lines to the file given by -o.
+ *  \param argv the arguments after the program name, "bench" first
+ *  \return the exit status of the tool
+ */
+int bench_main(int argc, char **argv);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef _CMPH_BITBOOL_H__
 #define _CMPH_BITBOOL_H__
-#include "cmph_types.h" 
+#include "cmph_types.h"
+#include <stdlib.h>
 
 static const cmph_uint8 bitmask[] = { 1, 1 << 1,  1 << 2,  1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7 };
 
@@ -167,4 +168,53 @@ static inline cmph_uint32 get_bits_at_pos(cmph_uint32 * bits_table,cmph_uint32 p
 }
 
 
+/** \fn cmph_uint32 packed_table_width(cmph_uint32 max_value);
+ *  \brief Return the number of bits needed to store the values up to max_value, at least 1.
+ */
+static inline cmph_uint32 packed_table_width(cmph_uint32 max_value)
+{
+	register cmph_uint32 width = 1;
+	while (width < 32 && (max_value >> width)) width++;
+	return width;
+}
+
+/** \def PACKED_TABLE_SIZE(n, width)
+ *  \brief number of 32-bit words of a table holding n values of width bits.
+ *
+ * Positions in these tables are 64-bit, so they may hold more than 2^32 bits.
+ * A word of padding is kept at the end so that a value is always read with
+ * a single load of the 64-bit window starting at its word.
+ */
+#define PACKED_TABLE_SIZE(n, width) ((size_t)((((cmph_uint64)(n) * (width) + 31) >> 5) + 1))
+
+static inline void set_packed_value(cmph_uint32 * table, cmph_uint32 index, cmph_uint32 value, cmph_uint32 width)
+{
+	register cmph_uint64 pos = (cmph_uint64)index * width;
+	register cmph_uint64 mask = ((((cmph_uint64)1) << width) - 1) << (pos & 0x1f);
+	register cmph_uint64 window = ((cmph_uint64)table[(pos >> 5) + 1] << 32) | table[pos >> 5];
+	window = (window & ~mask) | (((cmph_uint64)value << (pos & 0x1f)) & mask);
+	table[pos >> 5] = (cmph_uint32)window;
+	table[(pos >> 5) + 1] = (cmph_uint32)(window >> 32);
+}
+
+static inline cmph_uint32 get_packed_value(const cmph_uint32 * table, cmph_uint32 index, cmph_uint32 width)
+{
+	register cmph_uint64 pos = (cmph_uint64)index * width;
+	register const cmph_uint32 *word = table + (pos >> 5);
+	register cmph_uint64 window = ((cmph_uint64)word[1] << 32) | word[0];
+	return (cmph_uint32)((window >> (pos & 0x1f)) & ((((cmph_uint64)1) << width) - 1));
+}
+
+/** \fn cmph_uint32 * packed_table_new(const cmph_uint32 *values, cmph_uint32 n, cmph_uint32 width);
+ *  \brief Store the low width bits of the n values in a new table of PACKED_TABLE_SIZE(n, width) words.
+ */
+static inline cmph_uint32 * packed_table_new(const cmph_uint32 *values, cmph_uint32 n, cmph_uint32 width)
+{
+	register cmph_uint32 i;
+	cmph_uint32 *table = (cmph_uint32 *)calloc(PACKED_TABLE_SIZE(n, width), sizeof(cmph_uint32));
+	if (!table) return NULL;
+	for (i = 0; i < n; ++i) set_packed_value(table, i, values[i], width);
+	return table;
+}
+
 #endif
@@ -1,25 +1,21 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "bitbool.h"
 #include "cmph.h"
 #include "cmph_benchmark.h"
+#include "key_generator.h"
 #include "linear_string_map.h"
 
-// Generates a vector with random unique 32 bits integers
+// Generates a vector of unique 32 bits integers, the same on every machine
 cmph_uint32* random_numbers_vector_new(cmph_uint32 size) {
   cmph_uint32 i = 0;
-  cmph_uint32 dup_bits = sizeof(cmph_uint32)*size*8;
-  char* dup = (char*)malloc(dup_bits/8);
   cmph_uint32* vec = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*size);
-  memset(dup, 0, dup_bits/8);
+  key_generator_t* gen = key_generator_new(KEY_SPARSE, size, 1);
+  key_generator_set_bits(gen, 32);
   for (i = 0; i < size; ++i) {
-    cmph_uint32 v = random();
-    while (GETBIT(dup, v % dup_bits)) { v = random(); }
-    SETBIT(dup, v % dup_bits);
-    vec[i] = v;
+    vec[i] = (cmph_uint32)key_generator_value(gen, i);
   }
-  free(dup);
+  key_generator_destroy(gen);
   return vec;
 }
 
@@ -43,6 +39,7 @@ void bm_create(CMPH_ALGO algo, int iters) {
   cmph_io_adapter_t* source = NULL;
   cmph_config_t* config = NULL;
   cmph_t* mphf = NULL;
+  char *mphf_name;
 
   if (iters > (int)g_numbers_len) {
     fprintf(stderr, "No input with proper size.");
@@ -62,7 +59,14 @@ void bm_create(CMPH_ALGO algo, int iters) {
   }
   cmph_config_destroy(config);
   cmph_io_struct_vector_adapter_destroy(source);
-  lsmap_append(g_created_mphf, create_lsmap_key(algo, iters), mphf);
+  // The benchmarks run several times, and the first function is kept.
+  mphf_name = create_lsmap_key(algo, iters);
+  if (lsmap_search(g_created_mphf, mphf_name)) {
+    cmph_destroy(mphf);
+    free(mphf_name);
+  } else {
+    lsmap_append(g_created_mphf, mphf_name, mphf);
+  }
 }
 
 void bm_search(CMPH_ALGO algo, int iters) {
@@ -72,10 +76,22 @@ void bm_search(CMPH_ALGO algo, int iters) {
 
   mphf_name = create_lsmap_key(algo, iters);
   mphf = (cmph_t*)lsmap_search(g_created_mphf, mphf_name);
-  free(mphf_name);
+  if (!mphf) {
+    fprintf(stderr, "No mphf for algorithm %s with %u keys, run its create benchmark.\n",
+            cmph_names[algo], iters);
+    exit(-1);
+  }
 
-  cmph_uint32* count = (cmph_uint32*)malloc(sizeof(cmph_uint32)*iters);  
-  cmph_uint32* hash_count = (cmph_uint32*)malloc(sizeof(cmph_uint32)*iters);  
+  // The probes of all runs are counted together.
+  cmph_uint32* count = (cmph_uint32*)lsmap_search(g_expected_probes, mphf_name);
+  cmph_uint32* hash_count = (cmph_uint32*)lsmap_search(g_mphf_probes, mphf_name);
+  if (!count) {
+    count = (cmph_uint32*)calloc(iters, sizeof(cmph_uint32));
+    hash_count = (cmph_uint32*)calloc(iters, sizeof(cmph_uint32));
+    lsmap_append(g_expected_probes, create_lsmap_key(algo, iters), count);
+    lsmap_append(g_mphf_probes, create_lsmap_key(algo, iters), hash_count);
+  }
+  free(mphf_name);
 
   for (i = 0; i < iters * 100; ++i) {
     cmph_uint32 pos = random() % iters;
@@ -84,13 +100,46 @@ void bm_search(CMPH_ALGO algo, int iters) {
     ++count[pos];
     ++hash_count[h];
   }
+}
 
-  // Verify correctness later.
-  lsmap_append(g_expected_probes, create_lsmap_key(algo, iters), count);
-  lsmap_append(g_mphf_probes, create_lsmap_key(algo, iters), hash_count);
+// Checks that the functions are minimal and perfect, and that each key was
+// found at its own position as many times as it was searched.
+int verify_algo(CMPH_ALGO algo, int iters) {
+  char *mphf_name = create_lsmap_key(algo, iters);
+  cmph_t* mphf = (cmph_t*)lsmap_search(g_created_mphf, mphf_name);
+  cmph_uint32* count = (cmph_uint32*)lsmap_search(g_expected_probes, mphf_name);
+  cmph_uint32* hash_count = (cmph_uint32*)lsmap_search(g_mphf_probes, mphf_name);
+  char* seen;
+  int i, ok = 1;
+  free(mphf_name);
+  if (!mphf) return 1;  // not benchmarked
+  seen = (char*)calloc(iters, 1);
+  for (i = 0; i < iters && ok; ++i) {
+    const char* buf = (const char*)(g_numbers + i);
+    cmph_uint32 h = cmph_search(mphf, buf, sizeof(cmph_uint32));
+    if (h >= (cmph_uint32)iters || seen[h]) {
+      fprintf(stderr, "Key %u of %s collides at %u\n", i, cmph_names[algo], h);
+      ok = 0;
+    } else if (count && count[i] != hash_count[h]) {
+      fprintf(stderr, "Key %u of %s was searched %u times but found %u times\n",
+              i, cmph_names[algo], count[i], hash_count[h]);
+      ok = 0;
+    } else {
+      seen[h] = 1;
+    }
+  }
+  free(seen);
+  return ok;
 }
 
-void verify() { }
+int verify() {
+  int ok = verify_algo(CMPH_BMZ, 1000 * 1000);
+  ok &= verify_algo(CMPH_CHM, 1000 * 1000);
+  ok &= verify_algo(CMPH_BRZ, 1000 * 1000);
+  ok &= verify_algo(CMPH_FCH, 1000 * 1000);
+  ok &= verify_algo(CMPH_BDZ, 1000 * 1000);
+  return ok;
+}
 
 #define DECLARE_ALGO(algo) \
   void bm_create_ ## algo(int iters) { bm_create(algo, iters); } \
@@ -119,12 +168,19 @@ int main(int argc, char** argv) {
 //  BM_REGISTER(bm_search_CMPH_FCH, 1000 * 1000);
   BM_REGISTER(bm_create_CMPH_BDZ, 1000 * 1000);
   BM_REGISTER(bm_search_CMPH_BDZ, 1000 * 1000);
-  run_benchmarks(argc, argv);
+  int regressions = run_benchmarks(argc, argv);
 
-  verify();
+  int ok = verify();
   free(g_numbers);
   lsmap_foreach_key(g_created_mphf, (void(*)(const char*))free);
   lsmap_foreach_value(g_created_mphf, (void(*)(void*))cmph_destroy);
   lsmap_destroy(g_created_mphf);
-  return 0;
+  lsmap_foreach_key(g_expected_probes, (void(*)(const char*))free);
+  lsmap_foreach_value(g_expected_probes, free);
+  lsmap_destroy(g_expected_probes);
+  lsmap_foreach_key(g_mphf_probes, (void(*)(const char*))free);
+  lsmap_foreach_value(g_mphf_probes, free);
+  lsmap_destroy(g_mphf_probes);
+  if (!ok) fprintf(stderr, "Verification failed\n");
+  return regressions == 0 && ok ? 0 : 1;
 }
@@ -64,6 +64,7 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 	cmph_uint8 *used_edges = NULL;
 	cmph_uint8 restart_mapping = 0;
 	cmph_uint8 * visited = NULL;
+	cmph_stats_mark_t mark;
 
 	bmz_config_data_t *bmz = (bmz_config_data_t *)mph->data;
 	if (c == 0) c = 1.15; // validating restrictions over parameter c.
@@ -101,9 +102,13 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 		DEBUGP("hash function 2\n");
 		bmz->hashes[1] = hash_state_new(bmz->hashfuncs[1], bmz->n);
 		DEBUGP("Generating edges\n");
+		cmph_stats_begin(mph->stats, &mark);
 		ok = bmz_gen_edges(mph);
+		cmph_stats_end(mph->stats, CMPH_PHASE_MAPPING, &mark);
 		if (!ok)
 		{
+			// the successful attempts are counted once searched
+			cmph_stats_iteration(mph->stats, 0);
 			--iterations;
 			hash_state_destroy(bmz->hashes[0]);
 			bmz->hashes[0] = NULL;
@@ -128,7 +133,9 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 	  {
 		fprintf(stderr, "Starting ordering step\n");
 	  }
+	  cmph_stats_begin(mph->stats, &mark);
 	  graph_obtain_critical_nodes(bmz->graph);
+	  cmph_stats_end(mph->stats, CMPH_PHASE_ORDERING, &mark);
 
 	  // Searching step
 	  if (mph->verbosity)
@@ -137,6 +144,7 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "\tTraversing critical vertices.\n");
 	  }
 	  DEBUGP("Searching step\n");
+	  cmph_stats_begin(mph->stats, &mark);
 	  visited = (cmph_uint8 *)malloc((size_t)bmz->n/8 + 1);
 	  memset(visited, 0, (size_t)bmz->n/8 + 1);
 	  used_edges = (cmph_uint8 *)malloc((size_t)bmz->m/8 + 1);
@@ -159,13 +167,18 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 	        {
 		  fprintf(stderr, "\tTraversing non critical vertices.\n");
 		}
+		cmph_stats_end(mph->stats, CMPH_PHASE_SEARCHING, &mark);
+		cmph_stats_begin(mph->stats, &mark);
 		bmz_traverse_non_critical_nodes(bmz, used_edges, visited); // non_critical_nodes
+		cmph_stats_end(mph->stats, CMPH_PHASE_ASSIGNING, &mark);
 	  }
 	  else
 	  {
+		cmph_stats_end(mph->stats, CMPH_PHASE_SEARCHING, &mark);
  	        iterations_map--;
 		if (mph->verbosity) fprintf(stderr, "Restarting mapping step. %u iterations remaining.\n", iterations_map);
 	  }
+	  cmph_stats_iteration(mph->stats, !restart_mapping);
 	  free(used_edges);
 	  free(visited);
         } while(restart_mapping && iterations_map > 0);
@@ -184,14 +197,20 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
 	bmzf = (bmz_data_t *)malloc(sizeof(bmz_data_t));
-	bmzf->g = bmz->g;
-	bmz->g = NULL; //transfer memory ownership
+	bmzf->g_bits = packed_table_width(bmz->m - 1);
+	bmzf->g = packed_table_new(bmz->g, bmz->n, bmzf->g_bits);
+	free(bmz->g);
+	bmz->g = NULL;
 	bmzf->hashes = bmz->hashes;
 	bmz->hashes = NULL; //transfer memory ownership
 	bmzf->n = bmz->n;
 	bmzf->m = bmz->m;
 	mphf->data = bmzf;
 	mphf->size = bmz->m;
+	cmph_stats_component(mph->stats, "g", (double)bmzf->n * bmzf->g_bits);
+	cmph_stats_component(mph->stats, "hash", (hash_state_packed_size(bmz->hashfuncs[0]) + hash_state_packed_size(bmz->hashfuncs[1]))*8.0);
+	cmph_stats_parameter(mph->stats, "c", c);
+	cmph_stats_parameter(mph->stats, "n", bmz->n);
 
 	DEBUGP("Successfully generated minimal perfect hash\n");
 	if (mph->verbosity)
@@ -208,7 +227,8 @@ static cmph_uint8 bmz_traverse_critical_nodes(bmz_config_data_t *bmz, cmph_uint3
 	cmph_uint32 lav; /* lookahead vertex */
 	cmph_uint8 collision;
 	vqueue_t * q = vqueue_new((cmph_uint32)(graph_ncritical_nodes(bmz->graph)) + 1);
-	graph_iterator_t it, it1;
+	const cmph_uint32 *adj, *adj1;
+	cmph_uint32 degree, degree1, i, j;
 
 	DEBUGP("Labelling critical vertices\n");
 	bmz->g[v] = (cmph_uint32)ceil ((double)(*biggest_edge_value)/2) - 1;
@@ -218,19 +238,21 @@ static cmph_uint8 bmz_traverse_critical_nodes(bmz_config_data_t *bmz, cmph_uint3
 	while(!vqueue_is_empty(q))
 	{
 		v = vqueue_remove(q);
-		it = graph_neighbors_it(bmz->graph, v);
-		while ((u = graph_next_neighbor(bmz->graph, &it)) != GRAPH_NO_NEIGHBOR)
+		degree = graph_adjacency(bmz->graph, v, &adj, NULL);
+		for (i = 0; i < degree; i++)
 		{
+			u = adj[i];
                	        if (graph_node_is_critical(bmz->graph, u) && (!GETBIT(visited,u)))
 			{
 			        collision = 1;
 			        while(collision) // lookahead to resolve collisions
 				{
  				        next_g = *biggest_g_value + 1;
-					it1 = graph_neighbors_it(bmz->graph, u);
+					degree1 = graph_adjacency(bmz->graph, u, &adj1, NULL);
 					collision = 0;
-					while((lav = graph_next_neighbor(bmz->graph, &it1)) != GRAPH_NO_NEIGHBOR)
+					for (j = 0; j < degree1; j++)
 					{
+						lav = adj1[j];
   					        if (graph_node_is_critical(bmz->graph, lav) && GETBIT(visited,lav))
 						{
    						        if(next_g + bmz->g[lav] >= bmz->m)
@@ -248,9 +270,9 @@ static cmph_uint8 bmz_traverse_critical_nodes(bmz_config_data_t *bmz, cmph_uint3
  					if (next_g > *biggest_g_value) *biggest_g_value = next_g;
 				}
 				// Marking used edges...
-				it1 = graph_neighbors_it(bmz->graph, u);
-				while((lav = graph_next_neighbor(bmz->graph, &it1)) != GRAPH_NO_NEIGHBOR)
+				for (j = 0; j < degree1; j++)
 				{
+					lav = adj1[j];
                  		        if (graph_node_is_critical(bmz->graph, lav) && GETBIT(visited, lav))
 					{
                    			        SETBIT(used_edges,(next_g + bmz->g[lav]));
@@ -278,7 +300,8 @@ static cmph_uint8 bmz_traverse_critical_nodes_heuristic(bmz_config_data_t *bmz,
 	cmph_uint32 unused_g_values_capacity = 0;
 	cmph_uint32 nunused_g_values = 0;
 	vqueue_t * q = vqueue_new((cmph_uint32)(0.5*graph_ncritical_nodes(bmz->graph))+1);
-	graph_iterator_t it, it1;
+	const cmph_uint32 *adj, *adj1;
+	cmph_uint32 degree, degree1, i, j;
 
 	DEBUGP("Labelling critical vertices\n");
 	bmz->g[v] = (cmph_uint32)ceil ((double)(*biggest_edge_value)/2) - 1;
@@ -288,9 +311,10 @@ static cmph_uint8 bmz_traverse_critical_nodes_heuristic(bmz_config_data_t *bmz,
 	while(!vqueue_is_empty(q))
 	{
 		v = vqueue_remove(q);
-		it = graph_neighbors_it(bmz->graph, v);
-		while ((u = graph_next_neighbor(bmz->graph, &it)) != GRAPH_NO_NEIGHBOR)
+		degree = graph_adjacency(bmz->graph, v, &adj, NULL);
+		for (i = 0; i < degree; i++)
 		{
+			u = adj[i];
                	        if (graph_node_is_critical(bmz->graph, u) && (!GETBIT(visited,u)))
 			{
 			        cmph_uint32 next_g_index = 0;
@@ -306,10 +330,11 @@ static cmph_uint8 bmz_traverse_critical_nodes_heuristic(bmz_config_data_t *bmz,
 					        next_g = *biggest_g_value + 1;
 						next_g_index = UINT_MAX;
 					}
-					it1 = graph_neighbors_it(bmz->graph, u);
+					degree1 = graph_adjacency(bmz->graph, u, &adj1, NULL);
 					collision = 0;
-					while((lav = graph_next_neighbor(bmz->graph, &it1)) != GRAPH_NO_NEIGHBOR)
+					for (j = 0; j < degree1; j++)
 					{
+						lav = adj1[j];
   					        if (graph_node_is_critical(bmz->graph, lav) && GETBIT(visited,lav))
 						{
    						        if(next_g + bmz->g[lav] >= bmz->m)
@@ -341,9 +366,9 @@ static cmph_uint8 bmz_traverse_critical_nodes_heuristic(bmz_config_data_t *bmz,
 				if (next_g_index < nunused_g_values) unused_g_values[next_g_index] = unused_g_values[--nunused_g_values];
 
 				// Marking used edges...
-				it1 = graph_neighbors_it(bmz->graph, u);
-				while((lav = graph_next_neighbor(bmz->graph, &it1)) != GRAPH_NO_NEIGHBOR)
+				for (j = 0; j < degree1; j++)
 				{
+					lav = adj1[j];
                  		        if (graph_node_is_critical(bmz->graph, lav) && GETBIT(visited, lav))
 					{
                    			        SETBIT(used_edges,(next_g + bmz->g[lav]));
@@ -479,11 +504,12 @@ int bmz_dump(cmph_t *mphf, FILE *fd)
 	nbytes = fwrite(&(data->n), sizeof(cmph_uint32), (size_t)1, fd);
 	nbytes = fwrite(&(data->m), sizeof(cmph_uint32), (size_t)1, fd);
 
-	nbytes = fwrite(data->g, sizeof(cmph_uint32)*(data->n), (size_t)1, fd);
+	nbytes = fwrite(&(data->g_bits), sizeof(cmph_uint32), (size_t)1, fd);
+	nbytes = fwrite(data->g, sizeof(cmph_uint32)*PACKED_TABLE_SIZE(data->n, data->g_bits), (size_t)1, fd);
 	#ifdef DEBUG
 	cmph_uint32 i;
 	fprintf(stderr, "G: ");
-	for (i = 0; i < data->n; ++i) fprintf(stderr, "%u ", data->g[i]);
+	for (i = 0; i < data->n; ++i) fprintf(stderr, "%u ", get_packed_value(data->g, i, data->g_bits));
 	fprintf(stderr, "\n");
 	#endif
 	return 1;
@@ -519,11 +545,12 @@ void bmz_load(FILE *f, cmph_t *mphf)
 	nbytes = fread(&(bmz->n), sizeof(cmph_uint32), (size_t)1, f);
 	nbytes = fread(&(bmz->m), sizeof(cmph_uint32), (size_t)1, f);
 
-	bmz->g = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*bmz->n);
-	nbytes = fread(bmz->g, bmz->n*sizeof(cmph_uint32), (size_t)1, f);
+	nbytes = fread(&(bmz->g_bits), sizeof(cmph_uint32), (size_t)1, f);
+	bmz->g = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*PACKED_TABLE_SIZE(bmz->n, bmz->g_bits));
+	nbytes = fread(bmz->g, sizeof(cmph_uint32)*PACKED_TABLE_SIZE(bmz->n, bmz->g_bits), (size_t)1, f);
 	#ifdef DEBUG
 	fprintf(stderr, "G: ");
-	for (i = 0; i < bmz->n; ++i) fprintf(stderr, "%u ", bmz->g[i]);
+	for (i = 0; i < bmz->n; ++i) fprintf(stderr, "%u ", get_packed_value(bmz->g, i, bmz->g_bits));
 	fprintf(stderr, "\n");
 	#endif
 	return;
@@ -535,10 +562,15 @@ cmph_uint32 bmz_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	bmz_data_t *bmz = (bmz_data_t *)mphf->data;
 	cmph_uint32 h1 = hash(bmz->hashes[0], key, keylen) % bmz->n;
 	cmph_uint32 h2 = hash(bmz->hashes[1], key, keylen) % bmz->n;
+	cmph_uint32 g1, g2;
 	DEBUGP("key: %.*s h1: %u h2: %u\n", keylen, key, h1, h2);
 	if (h1 == h2 && ++h2 >= bmz->n) h2 = 0;
-	DEBUGP("key: %.*s g[h1]: %u g[h2]: %u edges: %u\n", keylen, key, bmz->g[h1], bmz->g[h2], bmz->m);
-	return bmz->g[h1] + bmz->g[h2];
+	g1 = get_packed_value(bmz->g, h1, bmz->g_bits);
+	g2 = get_packed_value(bmz->g, h2, bmz->g_bits);
+	DEBUGP("key: %.*s g[h1]: %u g[h2]: %u edges: %u\n", keylen, key, g1, g2, bmz->m);
+	// g[h1] + g[h2] wraps around to the id of the edge, which is below m, so
+	// the low g_bits bits of the values are enough to recover it.
+	return (g1 + g2) & (cmph_uint32)((((cmph_uint64)1) << bmz->g_bits) - 1);
 }
 void bmz_destroy(cmph_t *mphf)
 {
@@ -584,8 +616,12 @@ void bmz_pack(cmph_t *mphf, void *packed_mphf)
 	*((cmph_uint32 *) ptr) = data->n;
 	ptr += sizeof(data->n);
 
+	// packing g width
+	*((cmph_uint32 *) ptr) = data->g_bits;
+	ptr += sizeof(data->g_bits);
+
 	// packing g
-	memcpy(ptr, data->g, sizeof(cmph_uint32)*data->n);
+	memcpy(ptr, data->g, sizeof(cmph_uint32)*PACKED_TABLE_SIZE(data->n, data->g_bits));
 }
 
 /** \fn cmph_uint32 bmz_packed_size(cmph_t *mphf);
@@ -600,7 +636,7 @@ cmph_uint32 bmz_packed_size(cmph_t *mphf)
 	CMPH_HASH h2_type = hash_get_type(data->hashes[1]);
 
 	return (cmph_uint32)(sizeof(CMPH_ALGO) + hash_state_packed_size(h1_type) + hash_state_packed_size(h2_type) +
-			3*sizeof(cmph_uint32) + sizeof(cmph_uint32)*data->n);
+			4*sizeof(cmph_uint32) + sizeof(cmph_uint32)*PACKED_TABLE_SIZE(data->n, data->g_bits));
 }
 
 /** cmph_uint32 bmz_search(void *packed_mphf, const char *key, cmph_uint32 keylen);
@@ -623,9 +659,10 @@ cmph_uint32 bmz_search_packed(void *packed_mphf, const char *key, cmph_uint32 ke
 	register cmph_uint32 *g_ptr = (cmph_uint32 *)(h2_ptr + hash_state_packed_size(h2_type));
 
 	register cmph_uint32 n = *g_ptr++;
+	register cmph_uint32 g_bits = *g_ptr++;
 
 	register cmph_uint32 h1 = hash_packed(h1_ptr, h1_type, key, keylen) % n;
 	register cmph_uint32 h2 = hash_packed(h2_ptr, h2_type, key, keylen) % n;
 	if (h1 == h2 && ++h2 >= n) h2 = 0;
-	return (g_ptr[h1] + g_ptr[h2]);
+	return (get_packed_value(g_ptr, h1, g_bits) + get_packed_value(g_ptr, h2, g_bits)) & (cmph_uint32)((((cmph_uint64)1) << g_bits) - 1);
 }
@@ -63,6 +63,7 @@ cmph_t *bmz8_new(cmph_config_t *mph, double c)
 	cmph_uint8 *used_edges = NULL;
 	cmph_uint8 restart_mapping = 0;
 	cmph_uint8 * visited = NULL;
+	cmph_stats_mark_t mark;
 	bmz8_config_data_t *bmz8 = (bmz8_config_data_t *)mph->data;
 
 	if (mph->key_source->nkeys >= 256)
@@ -105,9 +106,13 @@ cmph_t *bmz8_new(cmph_config_t *mph, double c)
 		DEBUGP("hash function 2\n");
 		bmz8->hashes[1] = hash_state_new(bmz8->hashfuncs[1], bmz8->n);
 		DEBUGP("Generating edges\n");
+		cmph_stats_begin(mph->stats, &mark);
 		ok = bmz8_gen_edges(mph);
+		cmph_stats_end(mph->stats, CMPH_PHASE_MAPPING, &mark);
 		if (!ok)
 		{
+			// the successful attempts are counted once searched
+			cmph_stats_iteration(mph->stats, 0);
 			--iterations;
 			hash_state_destroy(bmz8->hashes[0]);
 			bmz8->hashes[0] = NULL;
@@ -134,7 +139,9 @@ cmph_t *bmz8_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "Starting ordering step\n");
 	  }
 
+	  cmph_stats_begin(mph->stats, &mark);
 	  graph_obtain_critical_nodes(bmz8->graph);
+	  cmph_stats_end(mph->stats, CMPH_PHASE_ORDERING, &mark);
 
 	  // Searching step
 	  if (mph->verbosity)
@@ -143,6 +150,7 @@ cmph_t *bmz8_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "\tTraversing critical vertices.\n");
 	  }
 	  DEBUGP("Searching step\n");
+	  cmph_stats_begin(mph->stats, &mark);
 	  visited = (cmph_uint8 *)malloc((size_t)bmz8->n/8 + 1);
 	  memset(visited, 0, (size_t)bmz8->n/8 + 1);
 	  used_edges = (cmph_uint8 *)malloc((size_t)bmz8->m/8 + 1);
@@ -165,13 +173,18 @@ cmph_t *bmz8_new(cmph_config_t *mph, double c)
 	        {
 		  fprintf(stderr, "\tTraversing non critical vertices.\n");
 		}
+		cmph_stats_end(mph->stats, CMPH_PHASE_SEARCHING, &mark);
+		cmph_stats_begin(mph->stats, &mark);
 		bmz8_traverse_non_critical_nodes(bmz8, used_edges, visited); // non_critical_nodes
+		cmph_stats_end(mph->stats, CMPH_PHASE_ASSIGNING, &mark);
 	  }
 	  else
 	  {
+		cmph_stats_end(mph->stats, CMPH_PHASE_SEARCHING, &mark);
  	        iterations_map--;
 		if (mph->verbosity) fprintf(stderr, "Restarting mapping step. %u iterations remaining.\n", iterations_map);
 	  }
+	  cmph_stats_iteration(mph->stats, !restart_mapping);
 
 	  free(used_edges);
 	  free(visited);
@@ -194,6 +207,10 @@ cmph_t *bmz8_new(cmph_config_t *mph, double c)
 	bmz8f->m = bmz8->m;
 	mphf->data = bmz8f;
 	mphf->size = bmz8->m;
+	cmph_stats_component(mph->stats, "g", bmz8->n*8.0);
+	cmph_stats_component(mph->stats, "hash", (hash_state_packed_size(bmz8->hashfuncs[0]) + hash_state_packed_size(bmz8->hashfuncs[1]))*8.0);
+	cmph_stats_parameter(mph->stats, "c", c);
+	cmph_stats_parameter(mph->stats, "n", bmz8->n);
 	DEBUGP("Successfully generated minimal perfect hash\n");
 	if (mph->verbosity)
 	{
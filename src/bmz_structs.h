@@ -7,7 +7,8 @@ struct __bmz_data_t
 {
 	cmph_uint32 m; //edges (words) count
 	cmph_uint32 n; //vertex count
-	cmph_uint32 *g;
+	cmph_uint32 g_bits; //width of the values of g, enough for m - 1
+	cmph_uint32 *g; //packed in g_bits bits per vertex, see bitbool.h
 	hash_state_t **hashes;
 };
 
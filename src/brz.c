@@ -3,10 +3,13 @@
 #include "fch_structs.h"
 #include "bmz8.h"
 #include "bmz8_structs.h"
+#include "bdz.h"
+#include "chd.h"
 #include "brz.h"
 #include "cmph_structs.h"
 #include "brz_structs.h"
 #include "buffer_manager.h"
+#include "run_codec.h"
 #include "cmph.h"
 #include "hash.h"
 #include "bitbool.h"
@@ -15,22 +18,153 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
-#define MAX_BUCKET_SIZE 255
+#include <errno.h>
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+#define MAX_BUCKET_SIZE 255   // for CMPH_BMZ8 and CMPH_FCH, whose functions index buckets with a byte
+#define BRZ_DEFAULT_B 128
+#define BRZ_LARGE_DEFAULT_B 2048 // for CMPH_BDZ and CMPH_CHD
+#define BRZ_LARGE_MIN_B 128
+#define BRZ_LARGE_MAX_B 16384
+/* Maximum number of runs merged at once. When there are more runs, they are
+ * merged in several passes, each one combining up to this many runs into a
+ * new run.
+ */
+#ifndef BRZ_MAX_FANIN
+#define BRZ_MAX_FANIN 1024
+#endif
 //#define DEBUG
 #include "debug.h"
 
+/* The progress of a build is journaled in tmp_dir, so that an interrupted
+ * build can be resumed (see brz_config_set_resume()):
+ *   brz.sizes   is written while partitioning: the parameters, h0, the number
+ *               of keys already in the runs, the number of runs and the sizes
+ *               of the buckets so far;
+ *   brz.journal is written once the keys are partitioned: the runs still to be
+ *               merged and, while the MPHF is dumped, the next bucket and the
+ *               offset of mphf_fd after the previous one.
+ * Both are replaced by renaming a complete temporary file.
+ */
+#define BRZ_JOURNAL_MAGIC     0x4a5a5242U
+#define BRZ_JOURNAL_MERGE     1
+#define BRZ_JOURNAL_MPHF      2
+#define BRZ_JOURNAL_BUCKETS   4096 // buckets written to mphf_fd between two journal updates
+
+typedef struct
+{
+	cmph_uint32 magic;
+	cmph_uint32 stage;       // BRZ_JOURNAL_MERGE or BRZ_JOURNAL_MPHF
+	cmph_uint32 m;
+	cmph_uint32 k;
+	cmph_uint32 first_run;   // runs first_run, ..., nflushes - 1 are still to be merged
+	cmph_uint32 nflushes;
+	cmph_uint32 next_bucket; // first bucket not written to mphf_fd
+	cmph_uint32 reserved;
+	cmph_uint64 mphf_offset; // offset of mphf_fd after the bucket next_bucket - 1
+} brz_journal_t;
+
+/* The MPHFs of the buckets are generated by a pool of worker threads. The
+ * merging thread submits the buckets in increasing order to a ring of job
+ * slots and, whenever it needs a free slot, it writes the oldest job to
+ * mphf_fd, so the pieces of the MPHF are still dumped in bucket order.
+ */
+#define BRZ_JOB_FREE    0
+#define BRZ_JOB_PENDING 1
+#define BRZ_JOB_DONE    2
+#define BRZ_JOB_FAILED  3
+
+/* The records of a bucket (key length followed by the key) are copied back to
+ * back into an arena, which is reset rather than freed between buckets.
+ */
+typedef struct
+{
+	cmph_uint8 *data;
+	cmph_uint32 size;        // used bytes
+	cmph_uint32 capacity;    // allocated bytes
+} brz_arena_t;
+
+typedef struct
+{
+	cmph_uint32 bucket;      // bucket id
+	cmph_uint32 nkeys;       // number of keys in keys
+	cmph_uint8 **keys;       // keys of the bucket, pointing into arena
+	brz_arena_t arena;
+	char *bufmphf;           // resulting partial mphf
+	cmph_uint32 buflenmphf;
+	cmph_uint8 state;
+} brz_job_t;
+
+typedef struct
+{
+	cmph_config_t *mph;
+	brz_job_t *jobs;         // ring of job slots
+	cmph_uint32 njobs;       // number of job slots
+	cmph_uint32 nsubmitted;  // number of jobs submitted
+	cmph_uint32 ntaken;      // number of jobs taken by the workers
+	cmph_uint32 nwritten;    // number of jobs written to mphf_fd
+	cmph_uint32 nworkers;    // number of worker threads (0 means building in the caller)
+	brz_arena_t arena;       // records of the bucket being merged
+	cmph_uint32 *offsets;    // offsets of these records in arena
+	cmph_uint32 nkeys;       // number of records in arena
+	cmph_uint8 error;
+	brz_journal_t *journal;  // updated every BRZ_JOURNAL_BUCKETS buckets written
+#ifdef HAVE_PTHREAD_H
+	cmph_uint8 shutdown;
+	double cpu;              // CPU seconds of the workers that have exited
+	pthread_t *workers;
+	pthread_mutex_t mutex;
+	pthread_cond_t job_ready;
+	pthread_cond_t job_done;
+#endif
+} brz_pool_t;
+
 static int brz_gen_mphf(cmph_config_t *mph);
-static cmph_uint32 brz_min_index(cmph_uint32 * vector, cmph_uint32 n);
-static void brz_destroy_keys_vd(cmph_uint8 ** keys_vd, cmph_uint32 nkeys);
+static int brz_record_cmp(cmph_uint8 *a, cmph_uint8 *b);
+static void brz_sort_records(cmph_uint8 *buffer, cmph_uint32 *keys_index, cmph_uint32 n, cmph_uint32 *tmp);
+static void brz_heap_sift_down(cmph_uint32 *heap, cmph_uint32 nheap, cmph_uint32 *buffer_h0, cmph_uint8 **buffer_merge, cmph_uint32 pos);
+static char * brz_run_filename(brz_config_data_t *brz, cmph_uint32 run);
+static cmph_uint32 brz_open_runs(brz_config_data_t *brz, buffer_manager_t *buff_manager, cmph_uint32 first_run, cmph_uint32 nruns,
+				 cmph_uint8 **buffer_merge, cmph_uint32 *buffer_h0, cmph_uint32 *heap);
+static cmph_uint32 brz_max_fanin(void);
+static void brz_remove_runs(brz_config_data_t *brz, cmph_uint32 first_run, cmph_uint32 nruns);
+static int brz_save_sizes(brz_config_data_t *brz, cmph_uint32 nkeys, cmph_uint32 nflushes);
+static int brz_load_sizes(brz_config_data_t *brz, cmph_uint32 *nkeys, cmph_uint32 *nflushes);
+static int brz_save_journal(brz_config_data_t *brz, brz_journal_t *journal);
+static int brz_load_journal(brz_config_data_t *brz, brz_journal_t *journal);
+static void brz_remove_journal(brz_config_data_t *brz);
+static int brz_merge_runs(brz_config_data_t *brz, cmph_uint32 first_run, cmph_uint32 nruns, cmph_uint32 new_run);
+static char * brz_build_bucket_mphf(cmph_config_t *mph, cmph_uint8 **keys_vd, cmph_uint32 nkeys_vd, cmph_uint32 cur_bucket, cmph_uint32 *buflen);
 static char * brz_copy_partial_fch_mphf(brz_config_data_t *brz, fch_data_t * fchf, cmph_uint32 index,  cmph_uint32 *buflen);
 static char * brz_copy_partial_bmz8_mphf(brz_config_data_t *brz, bmz8_data_t * bmzf, cmph_uint32 index,  cmph_uint32 *buflen);
+static char * brz_copy_partial_packed_mphf(cmph_t * mphf, cmph_uint32 *buflen);
+static cmph_uint32 brz_size_width(CMPH_ALGO algo);
+static brz_pool_t * brz_pool_new(cmph_config_t *mph, cmph_uint32 nworkers, brz_journal_t *journal);
+static void brz_append_tmp_dir(brz_config_data_t *brz, cmph_uint8 *tmp_dir);
+static int brz_make_run_dirs(brz_config_data_t *brz);
+static void brz_remove_run_dirs(brz_config_data_t *brz);
+static void brz_pool_add_key(brz_pool_t *pool, cmph_uint8 *record);
+static int brz_pool_submit(brz_pool_t *pool, cmph_uint32 bucket);
+static int brz_pool_finish(brz_pool_t *pool);
 brz_config_data_t *brz_config_new(void)
 {
 	brz_config_data_t *brz = NULL;
     brz = (brz_config_data_t *)malloc(sizeof(brz_config_data_t));
     if (!brz) return NULL;
-    brz->algo = CMPH_FCH;
-	brz->b = 128;
+    brz->algo = CMPH_COUNT;
+	brz->b = 0;
+	brz->max_bucket_size = MAX_BUCKET_SIZE;
 	brz->hashfuncs[0] = CMPH_HASH_JENKINS;
 	brz->hashfuncs[1] = CMPH_HASH_JENKINS;
 	brz->hashfuncs[2] = CMPH_HASH_JENKINS;
@@ -41,9 +175,14 @@ brz_config_data_t *brz_config_new(void)
 	brz->h2 = NULL;
 	brz->h0 = NULL;
 	brz->memory_availability = 1024*1024;
-	brz->tmp_dir = (cmph_uint8 *)calloc((size_t)10, sizeof(cmph_uint8));
+	brz->tmp_dirs = NULL;
+	brz->ntmp_dirs = 0;
+	brz->run_dirs = NULL;
+	brz->nruns = 0;
 	brz->mphf_fd = NULL;
-	strcpy((char *)(brz->tmp_dir), "/var/tmp/");
+	brz->compress_runs = 0;
+	brz->resume = 0;
+	brz_append_tmp_dir(brz, (cmph_uint8 *)"/var/tmp/");
 	assert(brz);
 	return brz;
 }
@@ -51,7 +190,9 @@ brz_config_data_t *brz_config_new(void)
 void brz_config_destroy(cmph_config_t *mph)
 {
 	brz_config_data_t *data = (brz_config_data_t *)mph->data;
-	free(data->tmp_dir);
+	cmph_uint32 i;
+	for(i = 0; i < data->ntmp_dirs; i++) free(data->tmp_dirs[i]);
+	free(data->tmp_dirs);
 	DEBUGP("Destroying algorithm dependent data\n");
 	free(data);
 }
@@ -75,27 +216,47 @@ void brz_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_a
 	if(memory_availability > 0) brz->memory_availability = memory_availability*1024*1024;
 }
 
+// Appends tmp_dir, ended by a slash, to the temporary directories.
+static void brz_append_tmp_dir(brz_config_data_t *brz, cmph_uint8 *tmp_dir)
+{
+	size_t len = strlen((char *)tmp_dir);
+	cmph_uint8 *dir = (cmph_uint8 *)calloc(len + 2, sizeof(cmph_uint8));
+	if(len > 0 && tmp_dir[len-1] != '/') sprintf((char *)dir, "%s/", (char *)tmp_dir);
+	else sprintf((char *)dir, "%s", (char *)tmp_dir);
+	brz->tmp_dirs = (cmph_uint8 **)realloc(brz->tmp_dirs, sizeof(cmph_uint8 *)*(brz->ntmp_dirs + 1));
+	brz->tmp_dirs[brz->ntmp_dirs++] = dir;
+}
+
 void brz_config_set_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir)
 {
 	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
+	cmph_uint32 i;
 	if(tmp_dir)
 	{
-		size_t len = strlen((char *)tmp_dir);
-		free(brz->tmp_dir);
-		if(tmp_dir[len-1] != '/')
-		{
-			brz->tmp_dir = (cmph_uint8 *)calloc((size_t)len+2, sizeof(cmph_uint8));
-			sprintf((char *)(brz->tmp_dir), "%s/", (char *)tmp_dir);
-		}
-		else
-		{
-			brz->tmp_dir = (cmph_uint8 *)calloc((size_t)len+1, sizeof(cmph_uint8));
-			sprintf((char *)(brz->tmp_dir), "%s", (char *)tmp_dir);
-		}
-
+		for(i = 0; i < brz->ntmp_dirs; i++) free(brz->tmp_dirs[i]);
+		brz->ntmp_dirs = 0;
+		brz_append_tmp_dir(brz, tmp_dir);
 	}
 }
 
+void brz_config_add_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir)
+{
+	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
+	if(tmp_dir) brz_append_tmp_dir(brz, tmp_dir);
+}
+
+void brz_config_set_compress_runs(cmph_config_t *mph, cmph_uint8 compress_runs)
+{
+	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
+	brz->compress_runs = compress_runs;
+}
+
+void brz_config_set_resume(cmph_config_t *mph, cmph_uint8 resume)
+{
+	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
+	brz->resume = resume;
+}
+
 void brz_config_set_mphf_fd(cmph_config_t *mph, FILE *mphf_fd)
 {
 	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
@@ -106,18 +267,15 @@ void brz_config_set_mphf_fd(cmph_config_t *mph, FILE *mphf_fd)
 void brz_config_set_b(cmph_config_t *mph, cmph_uint32 b)
 {
 	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
-	if(b <= 64 || b >= 175)
-	{
-		b =  128;
-	}
-	brz->b = (cmph_uint8)b;
+	brz->b = b; // validated by brz_new, once the algorithm of the buckets is known
 }
 
 void brz_config_set_algo(cmph_config_t *mph, CMPH_ALGO algo)
 {
-	if (algo == CMPH_BMZ8 || algo == CMPH_FCH) // supported algorithms
+	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
+	if (algo == CMPH_CHD_PH) algo = CMPH_CHD; // the functions of the buckets must be minimal
+	if (algo == CMPH_BMZ8 || algo == CMPH_FCH || algo == CMPH_BDZ || algo == CMPH_CHD) // supported algorithms
 	{
-		brz_config_data_t *brz = (brz_config_data_t *)mph->data;
 		brz->algo = algo;
 	}
 }
@@ -128,6 +286,7 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 	brz_data_t *brzf = NULL;
 	cmph_uint32 i;
 	cmph_uint32 iterations = 20;
+	long mphf_start;
 
 	DEBUGP("c: %f\n", c);
 	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
@@ -140,13 +299,28 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
         return NULL;
     }
 
-	switch(brz->algo) // validating restrictions over parameter c.
+	if (brz->algo == CMPH_COUNT) brz->algo = c >= 2.0 ? CMPH_FCH : CMPH_BMZ8;
+	switch(brz->algo) // validating restrictions over parameters c and b.
 	{
 		case CMPH_BMZ8:
 			if (c == 0 || c >= 2.0) c = 1;
+			if (brz->b <= 64 || brz->b >= 175) brz->b = BRZ_DEFAULT_B;
+			brz->max_bucket_size = MAX_BUCKET_SIZE;
 			break;
 		case CMPH_FCH:
 			if (c <= 2.0) c = 2.6;
+			if (brz->b <= 64 || brz->b >= 175) brz->b = BRZ_DEFAULT_B;
+			brz->max_bucket_size = MAX_BUCKET_SIZE;
+			break;
+		case CMPH_BDZ:
+			if (c < 1.23) c = 1.23;
+			if (brz->b < BRZ_LARGE_MIN_B || brz->b > BRZ_LARGE_MAX_B) brz->b = BRZ_LARGE_DEFAULT_B;
+			brz->max_bucket_size = 4*brz->b;
+			break;
+		case CMPH_CHD: // c is the load factor
+			if (c < 0.5 || c >= 1.0) c = 0.99;
+			if (brz->b < BRZ_LARGE_MIN_B || brz->b > BRZ_LARGE_MAX_B) brz->b = BRZ_LARGE_DEFAULT_B;
+			brz->max_bucket_size = 4*brz->b;
 			break;
 		default:
 			assert(0);
@@ -161,7 +335,13 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 	DEBUGP("m: %u\n", brz->m);
         brz->k = (cmph_uint32)ceil(brz->m/((double)brz->b));
 	DEBUGP("k: %u\n", brz->k);
-	brz->size   = (cmph_uint8 *) calloc((size_t)brz->k, sizeof(cmph_uint8));
+	brz->size   = (cmph_uint32 *) calloc((size_t)brz->k, sizeof(cmph_uint32));
+	if (!brz_make_run_dirs(brz))
+	{
+		free(brz->size);
+		brz->size = NULL;
+		return NULL;
+	}
 
 	// Clustering the keys by graph id.
 	if (mph->verbosity)
@@ -169,6 +349,7 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "Partitioning the set of keys.\n");
 	}
 
+	mphf_start = ftell(brz->mphf_fd);
 	while(1)
 	{
 		int ok;
@@ -176,15 +357,18 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 		brz->h0 = hash_state_new(brz->hashfuncs[2], brz->k);
 		DEBUGP("Generating graphs\n");
 		ok = brz_gen_mphf(mph);
+		cmph_stats_iteration(mph->stats, ok);
 		if (!ok)
 		{
+			brz_remove_journal(brz); // it refers to this h0
+			if (mphf_start >= 0) fseek(brz->mphf_fd, mphf_start, SEEK_SET);
 			--iterations;
 			hash_state_destroy(brz->h0);
 			brz->h0 = NULL;
 			DEBUGP("%u iterations remaining to create the graphs in a external file\n", iterations);
 			if (mph->verbosity)
 			{
-				fprintf(stderr, "Failure: A graph with more than 255 keys was created - %u iterations remaining\n", iterations);
+				fprintf(stderr, "Failure: A graph with more than %u keys was created - %u iterations remaining\n", brz->max_bucket_size, iterations);
 			}
 			if (iterations == 0) break;
 		}
@@ -192,11 +376,13 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 	}
 	if (iterations == 0)
 	{
-		DEBUGP("Graphs with more than 255 keys were created in all 20 iterations\n");
+		DEBUGP("Graphs with more than %u keys were created in all 20 iterations\n", brz->max_bucket_size);
+		brz_remove_run_dirs(brz);
 		free(brz->size);
 		return NULL;
 	}
 	DEBUGP("Graphs generated\n");
+	brz_remove_run_dirs(brz);
 
 	brz->offset = (cmph_uint32 *)calloc((size_t)brz->k, sizeof(cmph_uint32));
 	for (i = 1; i < brz->k; ++i)
@@ -225,6 +411,12 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 	brzf->algo = brz->algo;
 	mphf->data = brzf;
 	mphf->size = brz->m;
+	// the functions of the buckets are only in mphf_fd
+	if (mphf_start >= 0) cmph_stats_component(mph->stats, "functions", (ftell(brz->mphf_fd) - mphf_start)*8.0);
+	cmph_stats_component(mph->stats, "offsets", brz->k*32.0);
+	cmph_stats_parameter(mph->stats, "c", brz->c);
+	cmph_stats_parameter(mph->stats, "b", brz->b);
+	cmph_stats_parameter(mph->stats, "k", brz->k);
 	DEBUGP("Successfully generated minimal perfect hash\n");
 	if (mph->verbosity)
 	{
@@ -233,6 +425,82 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 	return mphf;
 }
 
+/* Writes the records of buffer to a new run file sorted by bucket, then by
+ * key. Each record is h0 followed by the key length and the key, so the bucket
+ * of a key is computed only once.
+ */
+static int brz_flush_buffer(brz_config_data_t *brz, cmph_uint8 *buffer, cmph_uint32 memory_usage,
+			    cmph_uint32 nkeys_in_buffer, cmph_uint32 *buckets_size, cmph_uint32 nflushes)
+{
+	cmph_uint32 value = buckets_size[0];
+	cmph_uint32 sum = 0;
+	cmph_uint32 keylen = 0;
+	cmph_uint32 h0;
+	cmph_uint32 i, pos;
+	cmph_uint32 *keys_index = NULL;
+	cmph_uint32 *tmp = NULL;
+	cmph_uint32 tmp_size = 0;
+	char *filename = NULL;
+	FILE *tmp_fd = NULL;
+	run_writer_t *run_writer = NULL;
+	int error = 0;
+	buckets_size[0]   = 0;
+	for(i = 1; i < brz->k; i++)
+	{
+		if(buckets_size[i] == 0) continue;
+		sum += value;
+		value = buckets_size[i];
+		buckets_size[i] = sum;
+	}
+	keys_index = (cmph_uint32 *)calloc((size_t)nkeys_in_buffer, sizeof(cmph_uint32));
+	for(pos = 0; pos < memory_usage; pos += keylen + 2U*(cmph_uint32)sizeof(cmph_uint32))
+	{
+		memcpy(&h0, buffer + pos, sizeof(h0));
+		memcpy(&keylen, buffer + pos + sizeof(h0), sizeof(keylen));
+		keys_index[buckets_size[h0]] = pos;
+		buckets_size[h0]++;
+	}
+	memset((void *)buckets_size, 0, brz->k*sizeof(cmph_uint32));
+	// sorting the keys of each bucket
+	for(i = 0; i < nkeys_in_buffer; i = pos)
+	{
+		cmph_uint32 bucket;
+		memcpy(&bucket, buffer + keys_index[i], sizeof(bucket));
+		for(pos = i + 1; pos < nkeys_in_buffer; pos++)
+		{
+			memcpy(&h0, buffer + keys_index[pos], sizeof(h0));
+			if(h0 != bucket) break;
+		}
+		if(pos - i > 2*tmp_size)
+		{
+			tmp_size = (pos - i)/2;
+			tmp = (cmph_uint32 *)realloc(tmp, tmp_size*sizeof(cmph_uint32));
+		}
+		if(pos - i > 1) brz_sort_records(buffer, keys_index + i, pos - i, tmp);
+	}
+	free(tmp);
+	filename = brz_run_filename(brz, nflushes);
+	tmp_fd = fopen(filename, "wb");
+	if(tmp_fd == NULL)
+	{
+		fprintf(stderr, "Unable to create file %s: %s\n", filename, strerror(errno));
+		free(filename);
+		free(keys_index);
+		return 0;
+	}
+	free(filename);
+	run_writer = run_writer_new(tmp_fd, brz->compress_runs);
+	for(i = 0; i < nkeys_in_buffer; i++)
+	{
+		memcpy(&h0, buffer + keys_index[i], sizeof(h0));
+		run_writer_write(run_writer, h0, buffer + keys_index[i] + sizeof(h0));
+	}
+	if(!run_writer_destroy(run_writer)) error = 1;
+	free(keys_index);
+	if(fclose(tmp_fd) != 0) error = 1;
+	return !error;
+}
+
 static int brz_gen_mphf(cmph_config_t *mph)
 {
 	cmph_uint32 i, e, error;
@@ -241,86 +509,103 @@ static int brz_gen_mphf(cmph_config_t *mph)
 	cmph_uint32 nkeys_in_buffer = 0;
 	cmph_uint8 *buffer = (cmph_uint8 *)malloc((size_t)brz->memory_availability);
 	cmph_uint32 *buckets_size = (cmph_uint32 *)calloc((size_t)brz->k, sizeof(cmph_uint32));
-	cmph_uint32 *keys_index = NULL;
 	cmph_uint8 **buffer_merge = NULL;
 	cmph_uint32 *buffer_h0 = NULL;
+	cmph_uint32 *heap = NULL;
+	cmph_uint32 nheap = 0;
 	cmph_uint32 nflushes = 0;
+	cmph_uint32 first_run = 0, last_run, fanin, nruns;
+	cmph_uint32 first_key = 0;
+	cmph_uint64 flushed_bytes = 0; // written to the runs since brz.sizes was saved
+	cmph_uint8 resume = brz->resume; // mphf_fd may hold a partial MPHF
+	cmph_uint8 resumed = resume;     // whether the journal could be used
+	brz_journal_t journal;
 	cmph_uint32 h0;
 	register size_t nbytes;
-	FILE *  tmp_fd = NULL;
 	buffer_manager_t * buff_manager = NULL;
-	char *filename = NULL;
 	char *key = NULL;
 	cmph_uint32 keylen;
 	cmph_uint32 cur_bucket = 0;
-	cmph_uint8 nkeys_vd = 0;
-	cmph_uint8 ** keys_vd = NULL;
-
+	cmph_uint32 nkeys_vd = 0;
+	brz_pool_t * pool = NULL;
+	cmph_stats_mark_t mark;
+
+	cmph_stats_begin(mph->stats, &mark);
+	memset(&journal, 0, sizeof(journal));
+	journal.magic = BRZ_JOURNAL_MAGIC;
+	journal.m = brz->m;
+	journal.k = brz->k;
+	if(!resumed || !brz_load_sizes(brz, &first_key, &nflushes))
+	{
+		memset(brz->size, 0, sizeof(cmph_uint32)*brz->k); // a previous attempt may have failed
+		first_key = 0;
+		nflushes = 0;
+		resumed = 0;
+	}
+	else if(first_key != brz->m || !brz_load_journal(brz, &journal) || journal.nflushes < nflushes)
+	{
+		journal.stage = 0; // still partitioning
+	}
+	if(resumed && mph->verbosity)
+	{
+		if(journal.stage == BRZ_JOURNAL_MPHF) fprintf(stderr, "Resuming from bucket %u out of %u\n", journal.next_bucket, brz->k);
+		else if(journal.stage == BRZ_JOURNAL_MERGE) fprintf(stderr, "Resuming the merge of %u runs\n", journal.nflushes - journal.first_run);
+		else fprintf(stderr, "Resuming the partitioning after %u keys\n", first_key);
+	}
+	brz->resume = 0; // a new h0 starts over
+	if(nflushes > brz->nruns) brz->nruns = nflushes; // for the cleanup
+	if(journal.nflushes > brz->nruns) brz->nruns = journal.nflushes;
 	mph->key_source->rewind(mph->key_source->data);
 	DEBUGP("Generating graphs from %u keys\n", brz->m);
+	// Skipping the keys already partitioned by an interrupted build
+	for (e = 0; e < first_key && e < brz->m; ++e)
+	{
+		mph->key_source->read(mph->key_source->data, &key, &keylen);
+		mph->key_source->dispose(mph->key_source->data, key, keylen);
+	}
 	// Partitioning
-	for (e = 0; e < brz->m; ++e)
+	for (e = first_key; e < brz->m; ++e)
 	{
 		mph->key_source->read(mph->key_source->data, &key, &keylen);
 
 		/* Buffers management */
-		if (memory_usage + keylen + sizeof(keylen) > brz->memory_availability) // flush buffers
+		if (memory_usage + keylen + sizeof(h0) + sizeof(keylen) > brz->memory_availability) // flush buffers
 		{
 			if(mph->verbosity)
 			{
 				fprintf(stderr, "Flushing  %u\n", nkeys_in_buffer);
 			}
-			cmph_uint32 value = buckets_size[0];
-			cmph_uint32 sum = 0;
-			cmph_uint32 keylen1 = 0;
-			buckets_size[0]   = 0;
-			for(i = 1; i < brz->k; i++)
-			{
-				if(buckets_size[i] == 0) continue;
-				sum += value;
-				value = buckets_size[i];
-				buckets_size[i] = sum;
-
-			}
-			memory_usage = 0;
-			keys_index = (cmph_uint32 *)calloc((size_t)nkeys_in_buffer, sizeof(cmph_uint32));
-			for(i = 0; i < nkeys_in_buffer; i++)
-			{
-				memcpy(&keylen1, buffer + memory_usage, sizeof(keylen1));
-				h0 = hash(brz->h0, (char *)(buffer + memory_usage + sizeof(keylen1)), keylen1) % brz->k;
-				keys_index[buckets_size[h0]] = memory_usage;
-				buckets_size[h0]++;
-				memory_usage +=  keylen1 + (cmph_uint32)sizeof(keylen1);
-			}
-			filename = (char *)calloc(strlen((char *)(brz->tmp_dir)) + 11, sizeof(char));
-			sprintf(filename, "%s%u.cmph",brz->tmp_dir, nflushes);
-			tmp_fd = fopen(filename, "wb");
-			free(filename);
-			filename = NULL;
-			for(i = 0; i < nkeys_in_buffer; i++)
+			if(!brz_flush_buffer(brz, buffer, memory_usage, nkeys_in_buffer, buckets_size, nflushes))
 			{
-				memcpy(&keylen1, buffer + keys_index[i], sizeof(keylen1));
-				nbytes = fwrite(buffer + keys_index[i], (size_t)1, keylen1 + sizeof(keylen1), tmp_fd);
+				mph->key_source->dispose(mph->key_source->data, key, keylen);
+				free(buffer);
+				free(buckets_size);
+				return 0;
 			}
+			flushed_bytes += memory_usage;
 			nkeys_in_buffer = 0;
 			memory_usage = 0;
-			memset((void *)buckets_size, 0, brz->k*sizeof(cmph_uint32));
 			nflushes++;
-			free(keys_index);
-			fclose(tmp_fd);
+			// the sizes of the buckets are saved only once the runs have grown more than them
+			if(flushed_bytes >= 4*sizeof(cmph_uint32)*(cmph_uint64)brz->k)
+			{
+				brz_save_sizes(brz, e, nflushes);
+				flushed_bytes = 0;
+			}
 		}
-		memcpy(buffer + memory_usage, &keylen, sizeof(keylen));
-		memcpy(buffer + memory_usage + sizeof(keylen), key, (size_t)keylen);
-		memory_usage += keylen + (cmph_uint32)sizeof(keylen);
 		h0 = hash(brz->h0, key, keylen) % brz->k;
+		memcpy(buffer + memory_usage, &h0, sizeof(h0));
+		memcpy(buffer + memory_usage + sizeof(h0), &keylen, sizeof(keylen));
+		memcpy(buffer + memory_usage + sizeof(h0) + sizeof(keylen), key, (size_t)keylen);
+		memory_usage += keylen + 2U*(cmph_uint32)sizeof(cmph_uint32);
 
-		if ((brz->size[h0] == MAX_BUCKET_SIZE) || (brz->algo == CMPH_BMZ8 && ((brz->c >= 1.0) && (cmph_uint8)(brz->c * brz->size[h0]) < brz->size[h0])))
+		if ((brz->size[h0] == brz->max_bucket_size) || (brz->algo == CMPH_BMZ8 && ((brz->c >= 1.0) && (cmph_uint8)(brz->c * brz->size[h0]) < brz->size[h0])))
 		{
 			free(buffer);
 			free(buckets_size);
 			return 0;
 		}
-		brz->size[h0] = (cmph_uint8)(brz->size[h0] + 1U);
+		brz->size[h0]++;
 		buckets_size[h0] ++;
 		nkeys_in_buffer++;
 		mph->key_source->dispose(mph->key_source->data, key, keylen);
@@ -331,200 +616,790 @@ static int brz_gen_mphf(cmph_config_t *mph)
 		{
 			fprintf(stderr, "Flushing  %u\n", nkeys_in_buffer);
 		}
-		cmph_uint32 value = buckets_size[0];
-		cmph_uint32 sum = 0;
-		cmph_uint32 keylen1 = 0;
-		buckets_size[0]   = 0;
-		for(i = 1; i < brz->k; i++)
-		{
-			if(buckets_size[i] == 0) continue;
-			sum += value;
-			value = buckets_size[i];
-			buckets_size[i] = sum;
-		}
-		memory_usage = 0;
-		keys_index = (cmph_uint32 *)calloc((size_t)nkeys_in_buffer, sizeof(cmph_uint32));
-		for(i = 0; i < nkeys_in_buffer; i++)
-		{
-			memcpy(&keylen1, buffer + memory_usage, sizeof(keylen1));
-			h0 = hash(brz->h0, (char *)(buffer + memory_usage + sizeof(keylen1)), keylen1) % brz->k;
-			keys_index[buckets_size[h0]] = memory_usage;
-			buckets_size[h0]++;
-			memory_usage +=  keylen1 + (cmph_uint32)sizeof(keylen1);
-		}
-		filename = (char *)calloc(strlen((char *)(brz->tmp_dir)) + 11, sizeof(char));
-		sprintf(filename, "%s%u.cmph",brz->tmp_dir, nflushes);
-		tmp_fd = fopen(filename, "wb");
-		free(filename);
-		filename = NULL;
-		for(i = 0; i < nkeys_in_buffer; i++)
+		if(!brz_flush_buffer(brz, buffer, memory_usage, nkeys_in_buffer, buckets_size, nflushes))
 		{
-			memcpy(&keylen1, buffer + keys_index[i], sizeof(keylen1));
-			nbytes = fwrite(buffer + keys_index[i], (size_t)1, keylen1 + sizeof(keylen1), tmp_fd);
+			free(buffer);
+			free(buckets_size);
+			return 0;
 		}
 		nkeys_in_buffer = 0;
 		memory_usage = 0;
-		memset((void *)buckets_size, 0, brz->k*sizeof(cmph_uint32));
 		nflushes++;
-		free(keys_index);
-		fclose(tmp_fd);
 	}
 
 	free(buffer);
 	free(buckets_size);
-	if(nflushes > 1024) return 0; // Too many files generated.
+	if(journal.stage == 0)
+	{
+		brz_save_sizes(brz, brz->m, nflushes);
+		journal.stage = BRZ_JOURNAL_MERGE;
+		journal.first_run = 0;
+		journal.nflushes = nflushes;
+		brz_save_journal(brz, &journal);
+	}
+	first_run = journal.first_run;
+	nflushes = journal.nflushes;
+	// Merging groups of runs until all of them can be merged at once
+	fanin = brz_max_fanin();
+	while(journal.stage == BRZ_JOURNAL_MERGE && nflushes - first_run > fanin)
+	{
+		last_run = nflushes;
+		if(mph->verbosity)
+		{
+			fprintf(stderr, "Merging %u runs into %u\n", last_run - first_run, (last_run - first_run + fanin - 1)/fanin);
+		}
+		for(i = first_run; i < last_run; i += fanin)
+		{
+			nruns = last_run - i < fanin ? last_run - i : fanin;
+			if(!brz_merge_runs(brz, i, nruns, nflushes)) return 0;
+			nflushes++;
+			journal.first_run = i + nruns;
+			journal.nflushes = nflushes;
+			brz_save_journal(brz, &journal);
+			brz_remove_runs(brz, i, nruns);
+		}
+		first_run = last_run;
+	}
+	cmph_stats_end(mph->stats, CMPH_PHASE_IO, &mark);
 	// mphf generation
+	cmph_stats_begin(mph->stats, &mark);
 	if(mph->verbosity)
 	{
 		fprintf(stderr, "\nMPHF generation \n");
 	}
-	/* Starting to dump to disk the resulting MPHF: __cmph_dump function */
-	nbytes = fwrite(cmph_names[CMPH_BRZ], (size_t)(strlen(cmph_names[CMPH_BRZ]) + 1), (size_t)1, brz->mphf_fd);
-	nbytes = fwrite(&(brz->m), sizeof(brz->m), (size_t)1, brz->mphf_fd);
-	nbytes = fwrite(&(brz->c), sizeof(double), (size_t)1, brz->mphf_fd);
-	nbytes = fwrite(&(brz->algo), sizeof(brz->algo), (size_t)1, brz->mphf_fd);
-	nbytes = fwrite(&(brz->k), sizeof(cmph_uint32), (size_t)1, brz->mphf_fd); // number of MPHFs
-	nbytes = fwrite(brz->size, sizeof(cmph_uint8)*(brz->k), (size_t)1, brz->mphf_fd);
+	if(journal.stage == BRZ_JOURNAL_MPHF)
+	{
+		// the buckets before journal.next_bucket are already in mphf_fd
+		fseek(brz->mphf_fd, (long)journal.mphf_offset, SEEK_SET);
+	}
+	else
+	{
+		/* Starting to dump to disk the resulting MPHF: __cmph_dump function */
+		nbytes = fwrite(cmph_names[CMPH_BRZ], (size_t)(strlen(cmph_names[CMPH_BRZ]) + 1), (size_t)1, brz->mphf_fd);
+		nbytes = fwrite(&(brz->m), sizeof(brz->m), (size_t)1, brz->mphf_fd);
+		nbytes = fwrite(&(brz->c), sizeof(double), (size_t)1, brz->mphf_fd);
+		nbytes = fwrite(&(brz->algo), sizeof(brz->algo), (size_t)1, brz->mphf_fd);
+		nbytes = fwrite(&(brz->k), sizeof(cmph_uint32), (size_t)1, brz->mphf_fd); // number of MPHFs
+		if(brz_size_width(brz->algo) == sizeof(cmph_uint32))
+		{
+			nbytes = fwrite(brz->size, sizeof(cmph_uint32)*(brz->k), (size_t)1, brz->mphf_fd);
+		}
+		else for(i = 0; i < brz->k; i++)
+		{
+			cmph_uint8 size = (cmph_uint8)brz->size[i];
+			nbytes = fwrite(&size, sizeof(cmph_uint8), (size_t)1, brz->mphf_fd);
+		}
+		journal.stage = BRZ_JOURNAL_MPHF;
+		journal.next_bucket = 0;
+	}
+#ifdef HAVE_UNISTD_H
+	// dropping what an interrupted build wrote after the last journaled bucket
+	if(resume && (fflush(brz->mphf_fd) != 0 || ftruncate(fileno(brz->mphf_fd), ftell(brz->mphf_fd)) != 0))
+	{
+		if(mph->verbosity) fprintf(stderr, "Unable to truncate the partial MPHF\n");
+	}
+#endif
 
-	//tmp_fds = (FILE **)calloc(nflushes, sizeof(FILE *));
-	buff_manager = buffer_manager_new(brz->memory_availability, nflushes);
+	nflushes -= first_run;
+	buff_manager = buffer_manager_new(brz->memory_availability, nflushes, brz->compress_runs);
 	buffer_merge = (cmph_uint8 **)calloc((size_t)nflushes, sizeof(cmph_uint8 *));
 	buffer_h0    = (cmph_uint32 *)calloc((size_t)nflushes, sizeof(cmph_uint32));
-
-	memory_usage = 0;
-	for(i = 0; i < nflushes; i++)
+	heap         = (cmph_uint32 *)calloc((size_t)nflushes, sizeof(cmph_uint32));
+	nheap = brz_open_runs(brz, buff_manager, first_run, nflushes, buffer_merge, buffer_h0, heap);
+	e = 0;
+	// Skipping the buckets already in mphf_fd
+	while(nheap > 0 && buffer_h0[heap[0]] < journal.next_bucket)
 	{
-		filename = (char *)calloc(strlen((char *)(brz->tmp_dir)) + 11, sizeof(char));
-		sprintf(filename, "%s%u.cmph",brz->tmp_dir, i);
-		buffer_manager_open(buff_manager, i, filename);
-		free(filename);
-		filename = NULL;
-		key = (char *)buffer_manager_read_key(buff_manager, i, &keylen);
-		h0 = hash(brz->h0, key+sizeof(keylen), keylen) % brz->k;
-		buffer_h0[i] = h0;
-                buffer_merge[i] = (cmph_uint8 *)key;
-                key = NULL; //transfer memory ownership
+		i = heap[0];
+		e++;
+		key = (char *)buffer_manager_read_key(buff_manager, i, &keylen, buffer_h0 + i);
+		if(key) buffer_merge[i] = (cmph_uint8 *)key;
+		else heap[0] = heap[--nheap]; // run i is exhausted
+		if(nheap > 1) brz_heap_sift_down(heap, nheap, buffer_h0, buffer_merge, 0);
 	}
-	e = 0;
-	keys_vd = (cmph_uint8 **)calloc((size_t)MAX_BUCKET_SIZE, sizeof(cmph_uint8 *));
+	pool = brz_pool_new(mph, mph->nthreads > 1 ? mph->nthreads : 0, &journal);
 	nkeys_vd = 0;
 	error = 0;
-	while(e < brz->m)
+	while(nheap > 0)
 	{
-		i = brz_min_index(buffer_h0, nflushes);
+		i = heap[0];
 		cur_bucket = buffer_h0[i];
-		key = (char *)buffer_manager_read_key(buff_manager, i, &keylen);
-		if(key)
+		// Moving the keys of cur_bucket from run i to the bucket
+		do
 		{
-			while(key)
+			if(nkeys_vd >= brz->size[cur_bucket]) // the runs do not match the bucket sizes
 			{
-				//keylen = strlen(key);
-				h0 = hash(brz->h0, key+sizeof(keylen), keylen) % brz->k;
-				if (h0 != buffer_h0[i]) break;
-				keys_vd[nkeys_vd++] = (cmph_uint8 *)key;
-				key = NULL; //transfer memory ownership
-				e++;
-				key = (char *)buffer_manager_read_key(buff_manager, i, &keylen);
-			}
-			if (key)
-			{
-				assert(nkeys_vd < brz->size[cur_bucket]);
-				keys_vd[nkeys_vd++] = buffer_merge[i];
-				buffer_merge[i] = NULL; //transfer memory ownership
-				e++;
-				buffer_h0[i] = h0;
-				buffer_merge[i] = (cmph_uint8 *)key;
+				error = 1;
+				break;
 			}
-		}
-		if(!key)
-		{
-			assert(nkeys_vd < brz->size[cur_bucket]);
-			keys_vd[nkeys_vd++] = buffer_merge[i];
-			buffer_merge[i] = NULL; //transfer memory ownership
+			brz_pool_add_key(pool, buffer_merge[i]);
+			nkeys_vd++;
 			e++;
-			buffer_h0[i] = UINT_MAX;
-		}
+			key = (char *)buffer_manager_read_key(buff_manager, i, &keylen, &h0);
+			if(!key) break;
+			buffer_h0[i] = h0;
+			buffer_merge[i] = (cmph_uint8 *)key;
+		} while(h0 == cur_bucket);
+		if(error) break;
+		if(!key) heap[0] = heap[--nheap]; // run i is exhausted
+		if(nheap > 1) brz_heap_sift_down(heap, nheap, buffer_h0, buffer_merge, 0);
 
 		if(nkeys_vd == brz->size[cur_bucket]) // Generating mphf for each bucket.
 		{
-			cmph_io_adapter_t *source = NULL;
-			cmph_config_t *config = NULL;
-			cmph_t *mphf_tmp = NULL;
-			char *bufmphf = NULL;
-			cmph_uint32 buflenmphf = 0;
-			// Source of keys
-			source = cmph_io_byte_vector_adapter(keys_vd, (cmph_uint32)nkeys_vd);
-			config = cmph_config_new(source);
-			cmph_config_set_algo(config, brz->algo);
-			cmph_config_set_hashfuncs(config, brz->hashfuncs);
-			cmph_config_set_graphsize(config, brz->c);
-			mphf_tmp = cmph_new(config);
-			if (mphf_tmp == NULL)
+			if(!brz_pool_submit(pool, cur_bucket))
 			{
-				if(mph->verbosity) fprintf(stderr, "ERROR: Can't generate MPHF for bucket %u out of %u\n", cur_bucket + 1, brz->k);
 				error = 1;
-				cmph_config_destroy(config);
- 				brz_destroy_keys_vd(keys_vd, nkeys_vd);
-				cmph_io_byte_vector_adapter_destroy(source);
 				break;
 			}
-			if(mph->verbosity)
-			{
-			  if (cur_bucket % 1000 == 0)
-  			  {
-			  	fprintf(stderr, "MPHF for bucket %u out of %u was generated.\n", cur_bucket + 1, brz->k);
-			  }
-			}
-			switch(brz->algo)
-			{
-				case CMPH_FCH:
-				{
-					fch_data_t * fchf = NULL;
-					fchf = (fch_data_t *)mphf_tmp->data;
-					bufmphf = brz_copy_partial_fch_mphf(brz, fchf, cur_bucket, &buflenmphf);
-				}
-					break;
-				case CMPH_BMZ8:
-				{
-					bmz8_data_t * bmzf = NULL;
-					bmzf = (bmz8_data_t *)mphf_tmp->data;
-					bufmphf = brz_copy_partial_bmz8_mphf(brz, bmzf, cur_bucket,  &buflenmphf);
-				}
-					break;
-				default: assert(0);
-			}
-		        nbytes = fwrite(bufmphf, (size_t)buflenmphf, (size_t)1, brz->mphf_fd);
-			free(bufmphf);
-			bufmphf = NULL;
-			cmph_config_destroy(config);
- 			brz_destroy_keys_vd(keys_vd, nkeys_vd);
-			cmph_destroy(mphf_tmp);
-			cmph_io_byte_vector_adapter_destroy(source);
 			nkeys_vd = 0;
 		}
 	}
+	// a truncated run leaves buckets short of their keys, never built
+	if(e != brz->m) error = 1;
+	if(!brz_pool_finish(pool)) error = 1;
 	buffer_manager_destroy(buff_manager);
-	free(keys_vd);
 	free(buffer_merge);
 	free(buffer_h0);
+	free(heap);
+	cmph_stats_end(mph->stats, CMPH_PHASE_SEARCHING, &mark);
 	if (error) return 0;
 	return 1;
 }
 
-static cmph_uint32 brz_min_index(cmph_uint32 * vector, cmph_uint32 n)
+/* Compares two records, each one the key length followed by the key, by their
+ * keys. Keeping the keys of a bucket sorted in the runs lets the compressed
+ * runs share the prefixes of neighbouring keys.
+ */
+static int brz_record_cmp(cmph_uint8 *a, cmph_uint8 *b)
+{
+	cmph_uint32 alen, blen;
+	int cmp;
+	memcpy(&alen, a, sizeof(alen));
+	memcpy(&blen, b, sizeof(blen));
+	cmp = memcmp(a + sizeof(alen), b + sizeof(blen), (size_t)(alen < blen ? alen : blen));
+	if(cmp) return cmp;
+	return alen < blen ? -1 : alen > blen;
+}
+
+// Merge sort by key of the records of a bucket, at keys_index in buffer.
+static void brz_sort_records(cmph_uint8 *buffer, cmph_uint32 *keys_index, cmph_uint32 n, cmph_uint32 *tmp)
+{
+	cmph_uint32 i, j, k, half = n/2;
+	if(n < 8)
+	{
+		for(i = 1; i < n; i++)
+		{
+			cmph_uint32 pos = keys_index[i];
+			for(j = i; j > 0 && brz_record_cmp(buffer + keys_index[j - 1] + sizeof(cmph_uint32), buffer + pos + sizeof(cmph_uint32)) > 0; j--)
+				keys_index[j] = keys_index[j - 1];
+			keys_index[j] = pos;
+		}
+		return;
+	}
+	brz_sort_records(buffer, keys_index, half, tmp);
+	brz_sort_records(buffer, keys_index + half, n - half, tmp);
+	memcpy(tmp, keys_index, half*sizeof(cmph_uint32));
+	for(i = 0, j = half, k = 0; i < half; k++)
+	{
+		if(j < n && brz_record_cmp(buffer + keys_index[j] + sizeof(cmph_uint32), buffer + tmp[i] + sizeof(cmph_uint32)) < 0)
+			keys_index[k] = keys_index[j++];
+		else keys_index[k] = tmp[i++];
+	}
+}
+
+/* The runs being merged form a binary min-heap ordered by the bucket of their
+ * current record, then by its key, so the next bucket is found in
+ * O(log nflushes) and the merged runs keep the keys of a bucket sorted.
+ */
+#define BRZ_RUN_LESS(a, b) (buffer_h0[a] < buffer_h0[b] || (buffer_h0[a] == buffer_h0[b] && brz_record_cmp(buffer_merge[a], buffer_merge[b]) < 0))
+static void brz_heap_sift_down(cmph_uint32 *heap, cmph_uint32 nheap, cmph_uint32 *buffer_h0, cmph_uint8 **buffer_merge, cmph_uint32 pos)
+{
+	cmph_uint32 run = heap[pos];
+	cmph_uint32 child;
+	while((child = 2*pos + 1) < nheap)
+	{
+		if(child + 1 < nheap && BRZ_RUN_LESS(heap[child + 1], heap[child])) child++;
+		if(!BRZ_RUN_LESS(heap[child], run)) break;
+		heap[pos] = heap[child];
+		pos = child;
+	}
+	heap[pos] = run;
+}
+
+// The runs are striped across the temporary directories.
+static char * brz_run_filename(brz_config_data_t *brz, cmph_uint32 run)
+{
+	char *dir = (char *)brz->run_dirs[run % brz->ntmp_dirs];
+	char *filename = (char *)calloc(strlen(dir) + 16, sizeof(char)); // room for a 32-bit run and ".cmph"
+	sprintf(filename, "%s%u.cmph", dir, run);
+	if(run >= brz->nruns) brz->nruns = run + 1;
+	return filename;
+}
+
+/* Creates the directory of the build in each temporary directory, so that
+ * concurrent builds sharing them do not clash. It is named after the file
+ * mphf_fd refers to, which is unique among the running builds and the same
+ * when an interrupted build is resumed. Without <sys/stat.h> the runs are
+ * written directly to the temporary directories.
+ */
+static int brz_make_run_dirs(brz_config_data_t *brz)
+{
+	char id[64];
+	cmph_uint32 i;
+	size_t len;
+	id[0] = 0;
+#if defined(HAVE_SYS_STAT_H) && defined(HAVE_UNISTD_H)
+	{
+		struct stat st;
+		if(fstat(fileno(brz->mphf_fd), &st) == 0) sprintf(id, "cmph-brz-%lx-%lx/", (unsigned long)st.st_dev, (unsigned long)st.st_ino);
+		else sprintf(id, "cmph-brz-p%lu/", (unsigned long)getpid());
+	}
+#endif
+	brz->run_dirs = (cmph_uint8 **)calloc((size_t)brz->ntmp_dirs, sizeof(cmph_uint8 *));
+	for(i = 0; i < brz->ntmp_dirs; i++)
+	{
+		len = strlen((char *)brz->tmp_dirs[i]) + strlen(id) + 1;
+		brz->run_dirs[i] = (cmph_uint8 *)calloc(len, sizeof(cmph_uint8));
+		sprintf((char *)brz->run_dirs[i], "%s%s", (char *)brz->tmp_dirs[i], id);
+#if defined(HAVE_SYS_STAT_H) && defined(HAVE_UNISTD_H)
+		if(mkdir((char *)brz->run_dirs[i], 0700) != 0 && errno != EEXIST)
+		{
+			brz->run_dirs[i][strlen((char *)brz->run_dirs[i]) - 1] = 0; // without the slash
+			fprintf(stderr, "Unable to create directory %s: %s\n", (char *)brz->run_dirs[i], strerror(errno));
+			brz_remove_run_dirs(brz);
+			return 0;
+		}
+#endif
+	}
+	brz->nruns = 0;
+	return 1;
+}
+
+// Removes the runs, the journal and the directories of the build.
+static void brz_remove_run_dirs(brz_config_data_t *brz)
+{
+	cmph_uint32 i;
+	if(brz->run_dirs == NULL) return;
+	brz_remove_runs(brz, 0, brz->nruns);
+	brz_remove_journal(brz);
+	for(i = 0; i < brz->ntmp_dirs; i++)
+	{
+#if defined(HAVE_SYS_STAT_H) && defined(HAVE_UNISTD_H)
+		if(brz->run_dirs[i] && strcmp((char *)brz->run_dirs[i], (char *)brz->tmp_dirs[i]) != 0) rmdir((char *)brz->run_dirs[i]);
+#endif
+		free(brz->run_dirs[i]);
+	}
+	free(brz->run_dirs);
+	brz->run_dirs = NULL;
+	brz->nruns = 0;
+}
+
+/* Opens the runs first_run, ..., first_run + nruns - 1, reads their first
+ * records into buffer_merge and buffer_h0 and builds the heap of the runs.
+ * Returns the number of runs in the heap.
+ */
+static cmph_uint32 brz_open_runs(brz_config_data_t *brz, buffer_manager_t *buff_manager, cmph_uint32 first_run, cmph_uint32 nruns,
+				 cmph_uint8 **buffer_merge, cmph_uint32 *buffer_h0, cmph_uint32 *heap)
+{
+	cmph_uint32 i, keylen, nheap = 0;
+	char *filename = NULL;
+	cmph_uint8 *key = NULL;
+	for(i = 0; i < nruns; i++)
+	{
+		filename = brz_run_filename(brz, first_run + i);
+		buffer_manager_open(buff_manager, i, filename);
+		free(filename);
+		key = buffer_manager_read_key(buff_manager, i, &keylen, buffer_h0 + i);
+		if(!key) continue;
+		buffer_merge[i] = key; // borrowed from buff_manager
+		heap[nheap++] = i;
+	}
+	for(i = nheap/2; i > 0; i--) brz_heap_sift_down(heap, nheap, buffer_h0, buffer_merge, i - 1);
+	return nheap;
+}
+
+// Number of runs that can be merged at once without running out of file descriptors.
+static cmph_uint32 brz_max_fanin(void)
+{
+	cmph_uint32 fanin = BRZ_MAX_FANIN;
+#if defined(HAVE_UNISTD_H) && defined(_SC_OPEN_MAX)
+	long open_max = sysconf(_SC_OPEN_MAX);
+	// leaving some descriptors to the caller, the output run and mphf_fd
+	if(open_max > 0 && (cmph_uint64)open_max < (cmph_uint64)fanin + 32) fanin = open_max > 48 ? (cmph_uint32)open_max - 32 : 16;
+#endif
+	return fanin;
+}
+
+static char * brz_state_filename(brz_config_data_t *brz, const char *name)
+{
+	char *filename = (char *)calloc(strlen((char *)(brz->run_dirs[0])) + strlen(name) + 1, sizeof(char));
+	sprintf(filename, "%s%s", brz->run_dirs[0], name);
+	return filename;
+}
+
+// Makes what was written to fd durable before the journal refers to it.
+static int brz_sync(FILE *fd)
+{
+	if(fflush(fd) != 0) return 0;
+#ifdef HAVE_UNISTD_H
+	if(fsync(fileno(fd)) != 0) return 0;
+#endif
+	return 1;
+}
+
+/* Writes the buffers to tmp_dir/name.tmp and renames it to tmp_dir/name, so
+ * the previous state is kept if the build stops meanwhile.
+ */
+static int brz_save_state(brz_config_data_t *brz, const char *name, cmph_uint32 nbufs, const void **bufs, const cmph_uint32 *lens)
+{
+	char *filename = brz_state_filename(brz, name);
+	char *tmp_filename = (char *)calloc(strlen(filename) + 5, sizeof(char));
+	FILE *fd = NULL;
+	cmph_uint32 i;
+	int error = 0;
+	sprintf(tmp_filename, "%s.tmp", filename);
+	fd = fopen(tmp_filename, "wb");
+	if(fd == NULL) error = 1;
+	for(i = 0; !error && i < nbufs; i++)
+	{
+		if(lens[i] && fwrite(bufs[i], (size_t)lens[i], (size_t)1, fd) != 1) error = 1;
+	}
+	if(fd && !brz_sync(fd)) error = 1;
+	if(fd && fclose(fd) != 0) error = 1;
+	if(!error && rename(tmp_filename, filename) != 0) error = 1;
+	free(tmp_filename);
+	free(filename);
+	return !error;
+}
+
+static int brz_save_sizes(brz_config_data_t *brz, cmph_uint32 nkeys, cmph_uint32 nflushes)
+{
+	cmph_uint32 header[7];
+	char *buf = NULL;
+	cmph_uint32 buflen;
+	const void *bufs[5];
+	cmph_uint32 lens[5];
+	int ok;
+	header[0] = BRZ_JOURNAL_MAGIC;
+	header[1] = brz->m;
+	header[2] = brz->k;
+	header[3] = brz->algo;
+	header[4] = brz->compress_runs;
+	header[5] = nkeys;
+	header[6] = nflushes;
+	hash_state_dump(brz->h0, &buf, &buflen);
+	bufs[0] = header; lens[0] = (cmph_uint32)sizeof(header);
+	bufs[1] = &(brz->c); lens[1] = (cmph_uint32)sizeof(brz->c);
+	bufs[2] = &buflen; lens[2] = (cmph_uint32)sizeof(buflen);
+	bufs[3] = buf; lens[3] = buflen;
+	bufs[4] = brz->size; lens[4] = (cmph_uint32)sizeof(cmph_uint32)*brz->k;
+	ok = brz_save_state(brz, "brz.sizes", 5, bufs, lens);
+	free(buf);
+	return ok;
+}
+
+/* Restores h0 and the sizes of the buckets from brz.sizes if it was written
+ * by a build with the same parameters. Returns 0 otherwise.
+ */
+static int brz_load_sizes(brz_config_data_t *brz, cmph_uint32 *nkeys, cmph_uint32 *nflushes)
+{
+	char *filename = brz_state_filename(brz, "brz.sizes");
+	FILE *fd = fopen(filename, "rb");
+	cmph_uint32 header[7];
+	double c;
+	char *buf = NULL;
+	cmph_uint32 buflen = 0;
+	hash_state_t *h0 = NULL;
+	int ok = 0;
+	free(filename);
+	if(fd == NULL) return 0;
+	if(fread(header, sizeof(header), (size_t)1, fd) == 1 && fread(&c, sizeof(c), (size_t)1, fd) == 1 &&
+	   header[0] == BRZ_JOURNAL_MAGIC && header[1] == brz->m && header[2] == brz->k && header[3] == (cmph_uint32)brz->algo &&
+	   header[4] == brz->compress_runs && c == brz->c && fread(&buflen, sizeof(buflen), (size_t)1, fd) == 1 && buflen < 1024)
+	{
+		buf = (char *)malloc((size_t)buflen);
+		if(fread(buf, (size_t)buflen, (size_t)1, fd) == 1 &&
+		   fread(brz->size, sizeof(cmph_uint32)*brz->k, (size_t)1, fd) == 1 &&
+		   (h0 = hash_state_load(buf, buflen)) != NULL)
+		{
+			hash_state_destroy(brz->h0);
+			brz->h0 = h0;
+			*nkeys = header[5];
+			*nflushes = header[6];
+			ok = 1;
+		}
+		free(buf);
+	}
+	fclose(fd);
+	return ok;
+}
+
+static int brz_save_journal(brz_config_data_t *brz, brz_journal_t *journal)
+{
+	const void *bufs[1];
+	cmph_uint32 lens[1];
+	if(journal->stage == BRZ_JOURNAL_MPHF && !brz_sync(brz->mphf_fd)) return 0;
+	bufs[0] = journal;
+	lens[0] = (cmph_uint32)sizeof(brz_journal_t);
+	return brz_save_state(brz, "brz.journal", 1, bufs, lens);
+}
+
+static int brz_load_journal(brz_config_data_t *brz, brz_journal_t *journal)
 {
-	cmph_uint32 i, min_index = 0;
-	for(i = 1; i < n; i++)
+	char *filename = brz_state_filename(brz, "brz.journal");
+	FILE *fd = fopen(filename, "rb");
+	int ok = 0;
+	free(filename);
+	if(fd == NULL) return 0;
+	if(fread(journal, sizeof(brz_journal_t), (size_t)1, fd) == 1)
 	{
-		if(vector[i] < vector[min_index]) min_index = i;
+		ok = journal->magic == BRZ_JOURNAL_MAGIC && journal->m == brz->m && journal->k == brz->k &&
+		     journal->first_run <= journal->nflushes;
 	}
-	return min_index;
+	fclose(fd);
+	return ok;
 }
 
-static void brz_destroy_keys_vd(cmph_uint8 ** keys_vd, cmph_uint32 nkeys)
+static void brz_remove_journal(brz_config_data_t *brz)
 {
-	cmph_uint8 i;
-	for(i = 0; i < nkeys; i++) { free(keys_vd[i]); keys_vd[i] = NULL;}
+	char *filename = brz_state_filename(brz, "brz.journal");
+	remove(filename);
+	free(filename);
+	filename = brz_state_filename(brz, "brz.sizes");
+	remove(filename);
+	free(filename);
+	filename = brz_state_filename(brz, "brz.journal.tmp");
+	remove(filename);
+	free(filename);
+	filename = brz_state_filename(brz, "brz.sizes.tmp");
+	remove(filename);
+	free(filename);
+}
+
+/* Merges the runs first_run, ..., first_run + nruns - 1 into the run new_run,
+ * which is sorted by h0 and key as well. The caller removes them with brz_remove_runs()
+ * once the journal no longer refers to them.
+ */
+static int brz_merge_runs(brz_config_data_t *brz, cmph_uint32 first_run, cmph_uint32 nruns, cmph_uint32 new_run)
+{
+	buffer_manager_t * buff_manager = NULL;
+	cmph_uint8 **buffer_merge = NULL;
+	cmph_uint32 *buffer_h0 = NULL;
+	cmph_uint32 *heap = NULL;
+	cmph_uint32 nheap, i, keylen;
+	cmph_uint8 *key = NULL;
+	char *filename = NULL;
+	char *new_filename = brz_run_filename(brz, new_run);
+	FILE *tmp_fd = NULL;
+	run_writer_t *run_writer = NULL;
+	int error = 0;
+	if(nruns == 1) // nothing to merge
+	{
+		filename = brz_run_filename(brz, first_run);
+		error = rename(filename, new_filename);
+		if(error && (tmp_fd = fopen(new_filename, "rb")) != NULL) // renamed before an interruption
+		{
+			fclose(tmp_fd);
+			error = 0;
+		}
+		free(filename);
+		free(new_filename);
+		return !error;
+	}
+	tmp_fd = fopen(new_filename, "wb");
+	free(new_filename);
+	if(tmp_fd == NULL) return 0;
+	buff_manager = buffer_manager_new(brz->memory_availability, nruns, brz->compress_runs);
+	buffer_merge = (cmph_uint8 **)calloc((size_t)nruns, sizeof(cmph_uint8 *));
+	buffer_h0    = (cmph_uint32 *)calloc((size_t)nruns, sizeof(cmph_uint32));
+	heap         = (cmph_uint32 *)calloc((size_t)nruns, sizeof(cmph_uint32));
+	nheap = brz_open_runs(brz, buff_manager, first_run, nruns, buffer_merge, buffer_h0, heap);
+	run_writer = run_writer_new(tmp_fd, brz->compress_runs);
+	while(nheap > 0)
+	{
+		i = heap[0];
+		run_writer_write(run_writer, buffer_h0[i], buffer_merge[i]);
+		key = buffer_manager_read_key(buff_manager, i, &keylen, buffer_h0 + i);
+		if(key) buffer_merge[i] = key;
+		else heap[0] = heap[--nheap]; // run i is exhausted
+		if(nheap > 1) brz_heap_sift_down(heap, nheap, buffer_h0, buffer_merge, 0);
+	}
+	if(!run_writer_destroy(run_writer)) error = 1;
+	buffer_manager_destroy(buff_manager);
+	free(buffer_merge);
+	free(buffer_h0);
+	free(heap);
+	if(fclose(tmp_fd) != 0) error = 1;
+	return !error;
+}
+
+static void brz_remove_runs(brz_config_data_t *brz, cmph_uint32 first_run, cmph_uint32 nruns)
+{
+	cmph_uint32 i;
+	char *filename = NULL;
+	for(i = 0; i < nruns; i++)
+	{
+		filename = brz_run_filename(brz, first_run + i);
+		remove(filename);
+		free(filename);
+	}
+}
+
+static char * brz_build_bucket_mphf(cmph_config_t *mph, cmph_uint8 **keys_vd, cmph_uint32 nkeys_vd, cmph_uint32 cur_bucket, cmph_uint32 *buflen)
+{
+	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
+	cmph_io_adapter_t *source = NULL;
+	cmph_config_t *config = NULL;
+	cmph_t *mphf_tmp = NULL;
+	char *bufmphf = NULL;
+	// Source of keys
+	source = cmph_io_byte_vector_adapter(keys_vd, nkeys_vd);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, brz->algo);
+	cmph_config_set_hashfuncs(config, brz->hashfuncs);
+	cmph_config_set_graphsize(config, brz->c);
+	mphf_tmp = cmph_new(config);
+	if (mphf_tmp == NULL)
+	{
+		if(mph->verbosity) fprintf(stderr, "ERROR: Can't generate MPHF for bucket %u out of %u\n", cur_bucket + 1, brz->k);
+		cmph_config_destroy(config);
+		cmph_io_byte_vector_adapter_destroy(source);
+		return NULL;
+	}
+	if(mph->verbosity)
+	{
+	  if (cur_bucket % 1000 == 0)
+	  {
+	  	fprintf(stderr, "MPHF for bucket %u out of %u was generated.\n", cur_bucket + 1, brz->k);
+	  }
+	}
+	switch(brz->algo)
+	{
+		case CMPH_FCH:
+		{
+			fch_data_t * fchf = NULL;
+			fchf = (fch_data_t *)mphf_tmp->data;
+			bufmphf = brz_copy_partial_fch_mphf(brz, fchf, cur_bucket, buflen);
+		}
+			break;
+		case CMPH_BMZ8:
+		{
+			bmz8_data_t * bmzf = NULL;
+			bmzf = (bmz8_data_t *)mphf_tmp->data;
+			bufmphf = brz_copy_partial_bmz8_mphf(brz, bmzf, cur_bucket, buflen);
+		}
+			break;
+		case CMPH_BDZ:
+		case CMPH_CHD:
+			bufmphf = brz_copy_partial_packed_mphf(mphf_tmp, buflen);
+			break;
+		default: assert(0);
+	}
+	cmph_config_destroy(config);
+	cmph_destroy(mphf_tmp);
+	cmph_io_byte_vector_adapter_destroy(source);
+	return bufmphf;
+}
+
+static void brz_pool_build(brz_pool_t *pool, brz_job_t *job)
+{
+	job->bufmphf = brz_build_bucket_mphf(pool->mph, job->keys, job->nkeys, job->bucket, &job->buflenmphf);
+	job->nkeys = 0;
+}
+
+#ifdef HAVE_PTHREAD_H
+static void * brz_pool_worker(void *arg)
+{
+	brz_pool_t *pool = (brz_pool_t *)arg;
+	brz_job_t *job = NULL;
+	double cpu = cmph_stats_thread_cpu();
+	pthread_mutex_lock(&pool->mutex);
+	while(1)
+	{
+		while(!pool->shutdown && pool->ntaken == pool->nsubmitted)
+		{
+			pthread_cond_wait(&pool->job_ready, &pool->mutex);
+		}
+		if(pool->ntaken == pool->nsubmitted) break;
+		job = pool->jobs + (pool->ntaken % pool->njobs);
+		pool->ntaken++;
+		pthread_mutex_unlock(&pool->mutex);
+
+		brz_pool_build(pool, job);
+
+		pthread_mutex_lock(&pool->mutex);
+		job->state = job->bufmphf ? BRZ_JOB_DONE : BRZ_JOB_FAILED;
+		pthread_cond_broadcast(&pool->job_done);
+	}
+	pool->cpu += cmph_stats_thread_cpu() - cpu;
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+#endif
+
+static brz_pool_t * brz_pool_new(cmph_config_t *mph, cmph_uint32 nworkers, brz_journal_t *journal)
+{
+	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
+	cmph_uint32 i;
+	brz_pool_t *pool = (brz_pool_t *)calloc((size_t)1, sizeof(brz_pool_t));
+	assert(pool);
+	pool->mph = mph;
+	pool->journal = journal;
+#ifndef HAVE_PTHREAD_H
+	nworkers = 0;
+#endif
+	pool->nworkers = nworkers;
+	// Enough slots to keep the workers busy while the oldest job is being written.
+	pool->njobs = nworkers ? 4*nworkers : 1;
+	pool->jobs = (brz_job_t *)calloc((size_t)pool->njobs, sizeof(brz_job_t));
+	for(i = 0; i < pool->njobs; i++)
+	{
+		pool->jobs[i].keys = (cmph_uint8 **)calloc((size_t)brz->max_bucket_size, sizeof(cmph_uint8 *));
+	}
+	pool->offsets = (cmph_uint32 *)calloc((size_t)brz->max_bucket_size, sizeof(cmph_uint32));
+#ifdef HAVE_PTHREAD_H
+	if(nworkers)
+	{
+		pthread_mutex_init(&pool->mutex, NULL);
+		pthread_cond_init(&pool->job_ready, NULL);
+		pthread_cond_init(&pool->job_done, NULL);
+		pool->workers = (pthread_t *)calloc((size_t)nworkers, sizeof(pthread_t));
+		for(i = 0; i < nworkers; i++)
+		{
+			if(pthread_create(pool->workers + i, NULL, brz_pool_worker, pool) != 0) break;
+		}
+		pool->nworkers = i;
+		if(i == 0) // no thread could be started, so build the buckets in the caller
+		{
+			free(pool->workers);
+			pool->workers = NULL;
+			pthread_mutex_destroy(&pool->mutex);
+			pthread_cond_destroy(&pool->job_ready);
+			pthread_cond_destroy(&pool->job_done);
+		}
+	}
+#endif
+	return pool;
+}
+
+// Writes the oldest submitted job to mphf_fd and releases its slot.
+static void brz_pool_write_next(brz_pool_t *pool)
+{
+	brz_config_data_t *brz = (brz_config_data_t *)pool->mph->data;
+	brz_job_t *job = pool->jobs + (pool->nwritten % pool->njobs);
+	register size_t nbytes;
+#ifdef HAVE_PTHREAD_H
+	if(pool->nworkers)
+	{
+		pthread_mutex_lock(&pool->mutex);
+		while(job->state == BRZ_JOB_PENDING) pthread_cond_wait(&pool->job_done, &pool->mutex);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+#endif
+	if(job->state == BRZ_JOB_FAILED) pool->error = 1;
+	if(job->state == BRZ_JOB_DONE && !pool->error)
+	{
+		nbytes = fwrite(job->bufmphf, (size_t)job->buflenmphf, (size_t)1, brz->mphf_fd);
+		if(pool->journal && (pool->nwritten + 1) % BRZ_JOURNAL_BUCKETS == 0)
+		{
+			pool->journal->next_bucket = job->bucket + 1;
+			pool->journal->mphf_offset = (cmph_uint64)ftell(brz->mphf_fd);
+			if(!brz_save_journal(brz, pool->journal)) pool->error = 1;
+		}
+	}
+	free(job->bufmphf);
+	job->bufmphf = NULL;
+	job->state = BRZ_JOB_FREE;
+	pool->nwritten++;
+}
+
+// Appends a record to the bucket being merged.
+static void brz_pool_add_key(brz_pool_t *pool, cmph_uint8 *record)
+{
+	brz_arena_t *arena = &pool->arena;
+	cmph_uint32 reclen;
+	memcpy(&reclen, record, sizeof(cmph_uint32));
+	reclen += (cmph_uint32)sizeof(cmph_uint32);
+	if(arena->size + reclen > arena->capacity)
+	{
+		arena->capacity = arena->capacity*2 > arena->size + reclen ? arena->capacity*2 : arena->size + reclen;
+		arena->data = (cmph_uint8 *)realloc(arena->data, (size_t)arena->capacity);
+		assert(arena->data);
+	}
+	memcpy(arena->data + arena->size, record, (size_t)reclen);
+	pool->offsets[pool->nkeys++] = arena->size;
+	arena->size += reclen;
+}
+
+/* Hands the bucket being merged over to the pool. Its arena is exchanged
+ * with the one of a free job slot, so no record is copied again.
+ * Returns 0 if the MPHF of some bucket could not be generated.
+ */
+static int brz_pool_submit(brz_pool_t *pool, cmph_uint32 bucket)
+{
+	brz_job_t *job = NULL;
+	brz_arena_t arena;
+	cmph_uint32 i;
+	if(pool->nsubmitted - pool->nwritten == pool->njobs) brz_pool_write_next(pool);
+	job = pool->jobs + (pool->nsubmitted % pool->njobs);
+	job->bucket = bucket;
+	arena = job->arena;
+	job->arena = pool->arena;
+	pool->arena = arena;
+	pool->arena.size = 0;
+	for(i = 0; i < pool->nkeys; i++) job->keys[i] = job->arena.data + pool->offsets[i];
+	job->nkeys = pool->nkeys;
+	pool->nkeys = 0;
+	job->state = BRZ_JOB_PENDING;
+#ifdef HAVE_PTHREAD_H
+	if(pool->nworkers)
+	{
+		pthread_mutex_lock(&pool->mutex);
+		pool->nsubmitted++;
+		pthread_cond_signal(&pool->job_ready);
+		pthread_mutex_unlock(&pool->mutex);
+		return !pool->error;
+	}
+#endif
+	pool->nsubmitted++;
+	brz_pool_build(pool, job);
+	job->state = job->bufmphf ? BRZ_JOB_DONE : BRZ_JOB_FAILED;
+	brz_pool_write_next(pool);
+	return !pool->error;
+}
+
+// Writes the pending jobs, stops the workers and destroys the pool.
+static int brz_pool_finish(brz_pool_t *pool)
+{
+	cmph_uint32 i;
+	int ok;
+	while(pool->nwritten < pool->nsubmitted) brz_pool_write_next(pool);
+#ifdef HAVE_PTHREAD_H
+	if(pool->nworkers)
+	{
+		pthread_mutex_lock(&pool->mutex);
+		pool->shutdown = 1;
+		pthread_cond_broadcast(&pool->job_ready);
+		pthread_mutex_unlock(&pool->mutex);
+		for(i = 0; i < pool->nworkers; i++) pthread_join(pool->workers[i], NULL);
+		cmph_stats_add_cpu(pool->mph->stats, CMPH_PHASE_SEARCHING, pool->cpu);
+		free(pool->workers);
+		pthread_mutex_destroy(&pool->mutex);
+		pthread_cond_destroy(&pool->job_ready);
+		pthread_cond_destroy(&pool->job_done);
+	}
+#endif
+	for(i = 0; i < pool->njobs; i++)
+	{
+		free(pool->jobs[i].keys);
+		free(pool->jobs[i].arena.data);
+	}
+	free(pool->jobs);
+	free(pool->arena.data);
+	free(pool->offsets);
+	ok = !pool->error;
+	free(pool);
+	return ok;
 }
 
 static char * brz_copy_partial_fch_mphf(brz_config_data_t *brz, fch_data_t * fchf, cmph_uint32 index,  cmph_uint32 *buflen)
@@ -544,7 +1419,7 @@ static char * brz_copy_partial_fch_mphf(brz_config_data_t *brz, fch_data_t * fch
 	memcpy(buf+sizeof(cmph_uint32), bufh1, (size_t)buflenh1);
 	memcpy(buf+sizeof(cmph_uint32)+buflenh1, &buflenh2, sizeof(cmph_uint32));
 	memcpy(buf+2*sizeof(cmph_uint32)+buflenh1, bufh2, (size_t)buflenh2);
-	for (i = 0; i < n; i++) memcpy(buf+2*sizeof(cmph_uint32)+buflenh1+buflenh2+i,(fchf->g + i), (size_t)1);
+	for (i = 0; i < n; i++) buf[2*sizeof(cmph_uint32)+buflenh1+buflenh2+i] = (char)get_packed_value(fchf->g, i, fchf->g_bits);
 	free(bufh1);
 	free(bufh2);
 	return buf;
@@ -571,6 +1446,26 @@ static char * brz_copy_partial_bmz8_mphf(brz_config_data_t *brz, bmz8_data_t * b
 	return buf;
 }
 
+/* The MPHF of a bucket built by CMPH_BDZ or CMPH_CHD is stored packed, without
+ * the algorithm, preceded by its length.
+ */
+static char * brz_copy_partial_packed_mphf(cmph_t * mphf, cmph_uint32 *buflen)
+{
+	cmph_uint32 n = 0;
+	char * buf = NULL;
+	*buflen = cmph_packed_size(mphf);
+	n = *buflen - (cmph_uint32)sizeof(cmph_uint32);
+	buf = (char *)malloc((size_t)(*buflen));
+	cmph_pack(mphf, buf);
+	memcpy(buf, &n, sizeof(cmph_uint32)); // replacing the algorithm by the length
+	return buf;
+}
+
+// Number of bytes of each entry of size[] in the dumped function.
+static cmph_uint32 brz_size_width(CMPH_ALGO algo)
+{
+	return algo == CMPH_BDZ || algo == CMPH_CHD ? (cmph_uint32)sizeof(cmph_uint32) : (cmph_uint32)sizeof(cmph_uint8);
+}
 
 int brz_dump(cmph_t *mphf, FILE *fd)
 {
@@ -605,14 +1500,36 @@ void brz_load(FILE *f, cmph_t *mphf)
 	nbytes = fread(&(brz->c), sizeof(double), (size_t)1, f);
 	nbytes = fread(&(brz->algo), sizeof(brz->algo), (size_t)1, f); // Reading algo.
 	nbytes = fread(&(brz->k), sizeof(cmph_uint32), (size_t)1, f);
-	brz->size   = (cmph_uint8 *) malloc(sizeof(cmph_uint8)*brz->k);
-	nbytes = fread(brz->size, sizeof(cmph_uint8)*(brz->k), (size_t)1, f);
-	brz->h1 = (hash_state_t **)malloc(sizeof(hash_state_t *)*brz->k);
-	brz->h2 = (hash_state_t **)malloc(sizeof(hash_state_t *)*brz->k);
+	brz->size   = (cmph_uint32 *) malloc(sizeof(cmph_uint32)*brz->k);
+	if(brz_size_width(brz->algo) == sizeof(cmph_uint32))
+	{
+		nbytes = fread(brz->size, sizeof(cmph_uint32)*(brz->k), (size_t)1, f);
+	}
+	else for(i = 0; i < brz->k; i++)
+	{
+		cmph_uint8 size = 0;
+		nbytes = fread(&size, sizeof(cmph_uint8), (size_t)1, f);
+		brz->size[i] = size;
+	}
+	brz->h1 = NULL;
+	brz->h2 = NULL;
 	brz->g  = (cmph_uint8 **)  calloc((size_t)brz->k, sizeof(cmph_uint8 *));
 	DEBUGP("Reading c = %f   k = %u   algo = %u \n", brz->c, brz->k, brz->algo);
+	if(brz->algo == CMPH_BDZ || brz->algo == CMPH_CHD) for(i = 0; i < brz->k; i++)
+	{
+		// length of the packed function followed by it
+		nbytes = fread(&n, sizeof(cmph_uint32), (size_t)1, f);
+		brz->g[i] = (cmph_uint8 *)malloc(sizeof(cmph_uint32) + n);
+		memcpy(brz->g[i], &n, sizeof(cmph_uint32));
+		nbytes = fread(brz->g[i] + sizeof(cmph_uint32), (size_t)n, (size_t)1, f);
+	}
+	else
+	{
+		brz->h1 = (hash_state_t **)malloc(sizeof(hash_state_t *)*brz->k);
+		brz->h2 = (hash_state_t **)malloc(sizeof(hash_state_t *)*brz->k);
+	}
 	//loading h_i1, h_i2 and g_i.
-	for(i = 0; i < brz->k; i++)
+	for(i = 0; brz->h1 && i < brz->k; i++)
 	{
 		// h1
 		nbytes = fread(&buflen, sizeof(cmph_uint32), (size_t)1, f);
@@ -701,12 +1618,21 @@ cmph_uint32 brz_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 {
 	brz_data_t *brz = (brz_data_t *)mphf->data;
 	cmph_uint32 fingerprint[3];
+	register cmph_uint32 h0;
 	switch(brz->algo)
 	{
 		case CMPH_FCH:
 			return brz_fch_search(brz, key, keylen, fingerprint);
 		case CMPH_BMZ8:
 			return brz_bmz8_search(brz, key, keylen, fingerprint);
+		case CMPH_BDZ:
+			hash_vector(brz->h0, key, keylen, fingerprint);
+			h0 = fingerprint[2] % brz->k;
+			return bdz_search_packed(brz->g[h0] + sizeof(cmph_uint32), key, keylen) + brz->offset[h0];
+		case CMPH_CHD:
+			hash_vector(brz->h0, key, keylen, fingerprint);
+			h0 = fingerprint[2] % brz->k;
+			return chd_search_packed(brz->g[h0] + sizeof(cmph_uint32), key, keylen) + brz->offset[h0];
 		default: assert(0);
 	}
 	return 0;
@@ -720,8 +1646,8 @@ void brz_destroy(cmph_t *mphf)
 		for(i = 0; i < data->k; i++)
 		{
 			free(data->g[i]);
-			hash_state_destroy(data->h1[i]);
-			hash_state_destroy(data->h2[i]);
+			if(data->h1) hash_state_destroy(data->h1[i]);
+			if(data->h2) hash_state_destroy(data->h2[i]);
 		}
 		free(data->g);
 		free(data->h1);
@@ -734,6 +1660,52 @@ void brz_destroy(cmph_t *mphf)
 	free(mphf);
 }
 
+/* Packed layout:
+ * algo | h0 type | h0 | k | h1 type | h2 type | record[k] | functions of the buckets
+ * record[i] holds the precomputed parameters of bucket i, so a search does no floating point work:
+ *   CMPH_BMZ8: offset, goffset, m, n
+ *   CMPH_FCH: offset, goffset, m, b, p1, p2
+ *   CMPH_BDZ and CMPH_CHD: offset, goffset
+ * goffset is the position of the function of the bucket counted from the end of the records
+ * (h1 | h2 | g for BMZ8 and FCH, the packed function otherwise), so the packed function does
+ * not depend on the address it is loaded at. The functions of the buckets are 32-bit aligned.
+ */
+#define BRZ_PACKED_ALIGN(n) (((n) + 3U) & ~3U)
+
+static cmph_uint32 brz_packed_record_size(CMPH_ALGO algo)
+{
+	switch(algo)
+	{
+		case CMPH_BMZ8:
+			return 4;
+		case CMPH_FCH:
+			return 6;
+		default:
+			return 2;
+	}
+}
+
+// Number of bytes of the function of bucket i in the packed function.
+static cmph_uint32 brz_bucket_packed_size(brz_data_t *data, cmph_uint32 i, CMPH_HASH h1_type, CMPH_HASH h2_type)
+{
+	cmph_uint32 n = 0;
+	switch(data->algo)
+	{
+		case CMPH_FCH:
+			n = fch_calc_b(data->c, data->size[i]);
+			break;
+		case CMPH_BMZ8:
+			n = (cmph_uint32)ceil(data->c * data->size[i]);
+			break;
+		case CMPH_BDZ:
+		case CMPH_CHD:
+			memcpy(&n, data->g[i], sizeof(cmph_uint32));
+			return n;
+		default: assert(0);
+	}
+	return hash_state_packed_size(h1_type) + hash_state_packed_size(h2_type) + n;
+}
+
 /** \fn void brz_pack(cmph_t *mphf, void *packed_mphf);
  *  \brief Support the ability to pack a perfect hash function into a preallocated contiguous memory space pointed by packed_mphf.
  *  \param mphf pointer to the resulting mphf
@@ -743,20 +1715,22 @@ void brz_pack(cmph_t *mphf, void *packed_mphf)
 {
 	brz_data_t *data = (brz_data_t *)mphf->data;
 	cmph_uint8 * ptr = (cmph_uint8 *)packed_mphf;
-	cmph_uint32 i,n;
- 
-    // This assumes that if one function pointer is NULL, 
-    // all the others will be as well.
-    if (data->h1 == NULL) 
-    {
-        return;
-    }
+	cmph_uint32 i, n, goffset = 0;
+	cmph_uint32 record_size = brz_packed_record_size(data->algo);
+	cmph_uint32 * record;
+	cmph_uint8 * g_i;
+	CMPH_HASH h0_type, h1_type = CMPH_HASH_COUNT, h2_type = CMPH_HASH_COUNT;
+
+	if (data->g == NULL)
+	{
+		return;
+	}
 	// packing internal algo type
 	memcpy(ptr, &(data->algo), sizeof(data->algo));
 	ptr += sizeof(data->algo);
 
 	// packing h0 type
-	CMPH_HASH h0_type = hash_get_type(data->h0);
+	h0_type = hash_get_type(data->h0);
 	memcpy(ptr, &h0_type, sizeof(h0_type));
 	ptr += sizeof(h0_type);
 
@@ -768,67 +1742,52 @@ void brz_pack(cmph_t *mphf, void *packed_mphf)
 	memcpy(ptr, &(data->k), sizeof(data->k));
 	ptr += sizeof(data->k);
 
-	// packing c
-	*((cmph_uint64 *)ptr) = (cmph_uint64)data->c;
-	ptr += sizeof(data->c);
-
-	// packing h1 type
-	CMPH_HASH h1_type = hash_get_type(data->h1[0]);
+	// packing h1 and h2 types
+	if (data->h1)
+	{
+		h1_type = hash_get_type(data->h1[0]);
+		h2_type = hash_get_type(data->h2[0]);
+	}
 	memcpy(ptr, &h1_type, sizeof(h1_type));
 	ptr += sizeof(h1_type);
-
-	// packing h2 type
-	CMPH_HASH h2_type = hash_get_type(data->h2[0]);
 	memcpy(ptr, &h2_type, sizeof(h2_type));
 	ptr += sizeof(h2_type);
 
-	// packing size
-	memcpy(ptr, data->size, sizeof(cmph_uint8)*data->k);
-	ptr += data->k;
-
-	// packing offset
-	memcpy(ptr, data->offset, sizeof(cmph_uint32)*data->k);
-	ptr += sizeof(cmph_uint32)*data->k;
-
-	#if defined (__ia64) || defined (__x86_64__)
-		cmph_uint64 * g_is_ptr = (cmph_uint64 *)ptr;
-	#else
-		cmph_uint32 * g_is_ptr = (cmph_uint32 *)ptr;
-	#endif
-
-	cmph_uint8 * g_i = (cmph_uint8 *) (g_is_ptr + data->k);
-
-	for(i = 0; i < data->k; i++)
+	record = (cmph_uint32 *)ptr;
+	g_i = ptr + sizeof(cmph_uint32)*record_size*data->k;
+	for(i = 0; i < data->k; i++, record += record_size)
 	{
-		#if defined (__ia64) || defined (__x86_64__)
-			*g_is_ptr++ = (cmph_uint64)g_i;
-		#else
-			*g_is_ptr++ = (cmph_uint32)g_i;
-		#endif
-		// packing h1[i]
-		hash_state_pack(data->h1[i], g_i);
-		g_i += hash_state_packed_size(h1_type);
-
-		// packing h2[i]
-		hash_state_pack(data->h2[i], g_i);
-		g_i += hash_state_packed_size(h2_type);
-
-		// packing g_i
+		cmph_uint32 m = data->size[i];
+		n = brz_bucket_packed_size(data, i, h1_type, h2_type);
+		record[0] = data->offset[i];
+		record[1] = goffset;
 		switch(data->algo)
 		{
 			case CMPH_FCH:
-				n = fch_calc_b(data->c, data->size[i]);
+				record[2] = m;
+				record[3] = fch_calc_b(data->c, m);
+				record[4] = (cmph_uint32)fch_calc_p1(m);
+				record[5] = (cmph_uint32)fch_calc_p2(record[3]);
 				break;
 			case CMPH_BMZ8:
-				n = (cmph_uint32)ceil(data->c * data->size[i]);
+				record[2] = m;
+				record[3] = (cmph_uint32)ceil(data->c * m);
+				break;
+			default:
 				break;
-			default: assert(0);
 		}
-		memcpy(g_i, data->g[i], sizeof(cmph_uint8)*n);
-		g_i += n;
-
+		if (data->h1)
+		{
+			// packing h1[i], h2[i] and g_i
+			hash_state_pack(data->h1[i], g_i + goffset);
+			hash_state_pack(data->h2[i], g_i + goffset + hash_state_packed_size(h1_type));
+			memcpy(g_i + goffset + hash_state_packed_size(h1_type) + hash_state_packed_size(h2_type), data->g[i],
+			       (size_t)(n - hash_state_packed_size(h1_type) - hash_state_packed_size(h2_type)));
+		}
+		else memcpy(g_i + goffset, data->g[i] + sizeof(cmph_uint32), (size_t)n);
+		memset(g_i + goffset + n, 0, (size_t)(BRZ_PACKED_ALIGN(n) - n));
+		goffset += BRZ_PACKED_ALIGN(n);
 	}
-
 }
 
 /** \fn cmph_uint32 brz_packed_size(cmph_t *mphf);
@@ -842,91 +1801,34 @@ cmph_uint32 brz_packed_size(cmph_t *mphf)
 	cmph_uint32 size = 0;
 	brz_data_t *data = (brz_data_t *)mphf->data;
 	CMPH_HASH h0_type;
-	CMPH_HASH h1_type;
-	CMPH_HASH h2_type;
+	CMPH_HASH h1_type = CMPH_HASH_COUNT;
+	CMPH_HASH h2_type = CMPH_HASH_COUNT;
 
-    // This assumes that if one function pointer is NULL, 
-    // all the others will be as well.
-    if (data->h1 == NULL) 
-    {
-        return 0U;
-    }
+	if (data->g == NULL)
+	{
+		return 0U;
+	}
 
 	h0_type = hash_get_type(data->h0);
-	h1_type = hash_get_type(data->h1[0]);
-	h2_type = hash_get_type(data->h2[0]);
+	if (data->h1)
+	{
+		h1_type = hash_get_type(data->h1[0]);
+		h2_type = hash_get_type(data->h2[0]);
+	}
 
 	size = (cmph_uint32)(2*sizeof(CMPH_ALGO) + 3*sizeof(CMPH_HASH) + hash_state_packed_size(h0_type) + sizeof(cmph_uint32) +
-			sizeof(double) + sizeof(cmph_uint8)*data->k + sizeof(cmph_uint32)*data->k);
-	// pointers to g_is
-	#if defined (__ia64) || defined (__x86_64__)
-		size +=  (cmph_uint32) sizeof(cmph_uint64)*data->k;
-	#else
-		size +=  (cmph_uint32) sizeof(cmph_uint32)*data->k;
-	#endif
-
-	size += hash_state_packed_size(h1_type) * data->k;
-	size += hash_state_packed_size(h2_type) * data->k;
-
-	cmph_uint32 n = 0;
+			sizeof(cmph_uint32)*brz_packed_record_size(data->algo)*data->k);
 	for(i = 0; i < data->k; i++)
 	{
-   		switch(data->algo)
-   		{
-   			case CMPH_FCH:
-   				n = fch_calc_b(data->c, data->size[i]);
-   				break;
-   			case CMPH_BMZ8:
-   				n = (cmph_uint32)ceil(data->c * data->size[i]);
-   				break;
-   			default: assert(0);
-   		}
-		size += n;
+		size += BRZ_PACKED_ALIGN(brz_bucket_packed_size(data, i, h1_type, h2_type));
 	}
 	return size;
 }
 
-
-
-static cmph_uint32 brz_bmz8_search_packed(cmph_uint32 *packed_mphf, const char *key, cmph_uint32 keylen, cmph_uint32 * fingerprint)
+static inline cmph_uint32 brz_bmz8_search_packed(cmph_uint32 *record, cmph_uint8 *h1_ptr, CMPH_HASH h1_type, CMPH_HASH h2_type, const char *key, cmph_uint32 keylen)
 {
-	register CMPH_HASH h0_type = (CMPH_HASH)*packed_mphf++;
-	register cmph_uint32 *h0_ptr = packed_mphf;
-	packed_mphf = (cmph_uint32 *)(((cmph_uint8 *)packed_mphf) + hash_state_packed_size(h0_type));
-
-	register cmph_uint32 k = *packed_mphf++;
-
-	register double c = (double)(*((cmph_uint64*)packed_mphf));
-	packed_mphf += 2;
-
-	register CMPH_HASH h1_type = (CMPH_HASH)*packed_mphf++;
-
-	register CMPH_HASH h2_type = (CMPH_HASH)*packed_mphf++;
-
-	register cmph_uint8 * size = (cmph_uint8 *) packed_mphf;
-	packed_mphf = (cmph_uint32 *)(size + k);
-
-	register cmph_uint32 * offset = packed_mphf;
-	packed_mphf += k;
-
-	register cmph_uint32 h0;
-
-	hash_vector_packed(h0_ptr, h0_type, key, keylen, fingerprint);
-	h0 = fingerprint[2] % k;
-
-	register cmph_uint32 m = size[h0];
-	register cmph_uint32 n = (cmph_uint32)ceil(c * m);
-
-	#if defined (__ia64) || defined (__x86_64__)
-		register cmph_uint64 * g_is_ptr = (cmph_uint64 *)packed_mphf;
-	#else
-		register cmph_uint32 * g_is_ptr = packed_mphf;
-	#endif
-
-	register cmph_uint8 * h1_ptr = (cmph_uint8 *) g_is_ptr[h0];
-
+	register cmph_uint32 n = record[3];
 	register cmph_uint8 * h2_ptr = h1_ptr + hash_state_packed_size(h1_type);
-
 	register cmph_uint8 * g = h2_ptr + hash_state_packed_size(h2_type);
 
 	register cmph_uint32 h1 = hash_packed(h1_ptr, h1_type, key, keylen) % n;
@@ -936,62 +1838,33 @@ static cmph_uint32 brz_bmz8_search_packed(cmph_uint32 *packed_mphf, const char *
 
 	if (h1 == h2 && ++h2 >= n) h2 = 0;
 	mphf_bucket = (cmph_uint8)(g[h1] + g[h2]);
-	DEBUGP("key: %s h1: %u h2: %u h0: %u\n", key, h1, h2, h0);
-	DEBUGP("Address: %u\n", mphf_bucket + offset[h0]);
-	return (mphf_bucket + offset[h0]);
+	DEBUGP("key: %s h1: %u h2: %u\n", key, h1, h2);
+	DEBUGP("Address: %u\n", mphf_bucket + record[0]);
+	return (mphf_bucket + record[0]);
 }
 
-static cmph_uint32 brz_fch_search_packed(cmph_uint32 *packed_mphf, const char *key, cmph_uint32 keylen, cmph_uint32 * fingerprint)
+static inline cmph_uint32 brz_fch_search_packed(cmph_uint32 *record, cmph_uint8 *h1_ptr, CMPH_HASH h1_type, CMPH_HASH h2_type, const char *key, cmph_uint32 keylen)
 {
-	register CMPH_HASH h0_type = (CMPH_HASH)*packed_mphf++;
-
-	register cmph_uint32 *h0_ptr = packed_mphf;
-	packed_mphf = (cmph_uint32 *)(((cmph_uint8 *)packed_mphf) + hash_state_packed_size(h0_type));
-
-	register cmph_uint32 k = *packed_mphf++;
-
-	register double c = (double)(*((cmph_uint64*)packed_mphf));
-	packed_mphf += 2;
-
-	register CMPH_HASH h1_type = (CMPH_HASH)*packed_mphf++;
-
-	register CMPH_HASH h2_type = (CMPH_HASH)*packed_mphf++;
-
-	register cmph_uint8 * size = (cmph_uint8 *) packed_mphf;
-	packed_mphf = (cmph_uint32 *)(size + k);
-
-	register cmph_uint32 * offset = packed_mphf;
-	packed_mphf += k;
-
-	register cmph_uint32 h0;
-
-	hash_vector_packed(h0_ptr, h0_type, key, keylen, fingerprint);
-	h0 = fingerprint[2] % k;
-
-	register cmph_uint32 m = size[h0];
-	register cmph_uint32 b = fch_calc_b(c, m);
-	register double p1 = fch_calc_p1(m);
-	register double p2 = fch_calc_p2(b);
-
-	#if defined (__ia64) || defined (__x86_64__)
-		register cmph_uint64 * g_is_ptr = (cmph_uint64 *)packed_mphf;
-	#else
-		register cmph_uint32 * g_is_ptr = packed_mphf;
-	#endif
-
-	register cmph_uint8 * h1_ptr = (cmph_uint8 *) g_is_ptr[h0];
-
+	register cmph_uint32 m = record[2];
+	register cmph_uint32 b = record[3];
+	register cmph_uint32 p1 = record[4];
+	register cmph_uint32 p2 = record[5];
 	register cmph_uint8 * h2_ptr = h1_ptr + hash_state_packed_size(h1_type);
-
 	register cmph_uint8 * g = h2_ptr + hash_state_packed_size(h2_type);
 
 	register cmph_uint32 h1 = hash_packed(h1_ptr, h1_type, key, keylen) % m;
 	register cmph_uint32 h2 = hash_packed(h2_ptr, h2_type, key, keylen) % m;
 
 	register cmph_uint8 mphf_bucket = 0;
-	h1 = mixh10h11h12(b, p1, p2, h1);
+	// same as mixh10h11h12(), p1 and p2 being integers
+	if (h1 < p1) h1 %= p2;
+	else
+	{
+		h1 %= b;
+		if (h1 < p2) h1 += p2;
+	}
 	mphf_bucket = (cmph_uint8)((h2 + g[h1]) % m);
-	return (mphf_bucket + offset[h0]);
+	return (mphf_bucket + record[0]);
 }
 
 /** cmph_uint32 brz_search(void *packed_mphf, const char *key, cmph_uint32 keylen);
@@ -1005,13 +1878,32 @@ cmph_uint32 brz_search_packed(void *packed_mphf, const char *key, cmph_uint32 ke
 {
 	register cmph_uint32 *ptr = (cmph_uint32 *)packed_mphf;
 	register CMPH_ALGO algo = (CMPH_ALGO)*ptr++;
+	register CMPH_HASH h0_type = (CMPH_HASH)*ptr++;
+	register cmph_uint32 *h0_ptr = ptr;
+	ptr = (cmph_uint32 *)(((cmph_uint8 *)ptr) + hash_state_packed_size(h0_type));
+
+	register cmph_uint32 k = *ptr++;
+	register CMPH_HASH h1_type = (CMPH_HASH)*ptr++;
+	register CMPH_HASH h2_type = (CMPH_HASH)*ptr++;
+	register cmph_uint32 record_size = brz_packed_record_size(algo);
+	register cmph_uint32 *record;
+	register cmph_uint8 *bucket;
 	cmph_uint32 fingerprint[3];
+
+	hash_vector_packed(h0_ptr, h0_type, key, keylen, fingerprint);
+	record = ptr + record_size*(fingerprint[2] % k);
+	bucket = (cmph_uint8 *)(ptr + record_size*k) + record[1];
 	switch(algo)
 	{
 		case CMPH_FCH:
-			return brz_fch_search_packed(ptr, key, keylen, fingerprint);
+			return brz_fch_search_packed(record, bucket, h1_type, h2_type, key, keylen);
 		case CMPH_BMZ8:
-			return brz_bmz8_search_packed(ptr, key, keylen, fingerprint);
+			return brz_bmz8_search_packed(record, bucket, h1_type, h2_type, key, keylen);
+		case CMPH_BDZ:
+			return bdz_search_packed(bucket, key, keylen) + record[0];
+		case CMPH_CHD:
+			return chd_search_packed(bucket, key, keylen) + record[0];
 		default: assert(0);
 	}
+	return 0;
 }
@@ -24,7 +24,25 @@ typedef struct __brz_config_data_t brz_config_data_t;
 brz_config_data_t *brz_config_new(void);
 void brz_config_set_hashfuncs(cmph_config_t *mph, CMPH_HASH *hashfuncs);
 void brz_config_set_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir);
+/** \fn void brz_config_add_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir);
+ *  \brief Adds a temporary directory. The runs are striped across the temporary
+ *  directories, which should be on different disks. Each build writes them to a
+ *  directory of its own, named after its mphf_fd, so concurrent builds can share
+ *  the temporary directories. It is removed when the build ends.
+ */
+void brz_config_add_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir);
 void brz_config_set_mphf_fd(cmph_config_t *mph, FILE *mphf_fd);
+/** \fn void brz_config_set_compress_runs(cmph_config_t *mph, cmph_uint8 compress_runs);
+ *  \brief Sets whether the temporary runs are written in compressed blocks,
+ *  trading some CPU time for less temporary I/O. Default is 0.
+ */
+void brz_config_set_compress_runs(cmph_config_t *mph, cmph_uint8 compress_runs);
+/** \fn void brz_config_set_resume(cmph_config_t *mph, cmph_uint8 resume);
+ *  \brief Sets whether brz_new continues an interrupted build from the journal
+ *  it keeps in its directory. mphf_fd must then be the partially written file, opened
+ *  for update. The keys and parameters must be the same. Default is 0.
+ */
+void brz_config_set_resume(cmph_config_t *mph, cmph_uint8 resume);
 void brz_config_set_b(cmph_config_t *mph, cmph_uint32 b);
 void brz_config_set_algo(cmph_config_t *mph, CMPH_ALGO algo);
 void brz_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_availability);
@@ -5,34 +5,40 @@
 
 struct __brz_data_t
 {
-	CMPH_ALGO algo;      // CMPH algo for generating the MPHFs for the buckets (Just CMPH_FCH and CMPH_BMZ8)
+	CMPH_ALGO algo;      // CMPH algo for generating the MPHFs for the buckets (CMPH_FCH, CMPH_BMZ8, CMPH_BDZ or CMPH_CHD)
 	cmph_uint32 m;       // edges (words) count
 	double c;      // constant c
-	cmph_uint8  *size;   // size[i] stores the number of edges represented by g[i][...]. 
+	cmph_uint32 *size;   // size[i] stores the number of edges represented by g[i][...]. 
 	cmph_uint32 *offset; // offset[i] stores the sum: size[0] + size[1] + ... size[i-1].
-	cmph_uint8 **g;      // g function. 
+	cmph_uint8 **g;      // g function. For CMPH_BDZ and CMPH_CHD, g[i] is the length of the packed MPHF of the bucket followed by it.
 	cmph_uint32 k;       // number of components
-	hash_state_t **h1;
-	hash_state_t **h2;
+	hash_state_t **h1;   // NULL for CMPH_BDZ and CMPH_CHD
+	hash_state_t **h2;   // NULL for CMPH_BDZ and CMPH_CHD
 	hash_state_t * h0;
 };
 
 struct __brz_config_data_t
 {
 	CMPH_HASH hashfuncs[3];
-	CMPH_ALGO algo;      // CMPH algo for generating the MPHFs for the buckets (Just CMPH_FCH and CMPH_BMZ8)
+	CMPH_ALGO algo;      // CMPH algo for generating the MPHFs for the buckets (CMPH_COUNT means chosen by c)
 	double c;      // constant c
 	cmph_uint32 m;       // edges (words) count
-	cmph_uint8  *size;   // size[i] stores the number of edges represented by g[i][...]. 
+	cmph_uint32 *size;   // size[i] stores the number of edges represented by g[i][...]. 
 	cmph_uint32 *offset; // offset[i] stores the sum: size[0] + size[1] + ... size[i-1].
 	cmph_uint8 **g;      // g function. 
-	cmph_uint8  b;       // parameter b. 
+	cmph_uint32 b;       // parameter b: average number of keys per bucket (0 means the default of algo)
+	cmph_uint32 max_bucket_size; // largest bucket accepted
 	cmph_uint32 k;       // number of components
 	hash_state_t **h1;
 	hash_state_t **h2;
 	hash_state_t * h0;    
 	cmph_uint32 memory_availability; 
-	cmph_uint8 * tmp_dir; // temporary directory 
+	cmph_uint8 ** tmp_dirs; // temporary directories, the runs being striped across them
+	cmph_uint32 ntmp_dirs;
+	cmph_uint8 ** run_dirs; // directory of this build in each temporary directory
+	cmph_uint32 nruns;      // runs created, for the cleanup
+	cmph_uint8 compress_runs; // whether the temporary runs are compressed
+	cmph_uint8 resume; // whether an interrupted build journaled in run_dirs[0] is continued
 	FILE * mphf_fd; // mphf file
 };
 
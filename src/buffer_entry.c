@@ -1,8 +1,19 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
 #include "buffer_entry.h"
+#include "run_codec.h"
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#define BUFFER_ENTRY_IDLE 0      // spare buffer holds no data
+#define BUFFER_ENTRY_REQUESTED 1 // spare buffer is queued or being filled
+#define BUFFER_ENTRY_READY 2     // spare buffer holds the next block of the file
 
 struct __buffer_entry_t
 {
@@ -10,10 +21,216 @@ struct __buffer_entry_t
 	cmph_uint8 * buff;
 	cmph_uint32 capacity, // buffer entry capacity
 		    nbytes,   // buffer entry used bytes
-		    pos;      // current read position in buffer entry
+		    pos,      // current read position in buffer entry
+		    size;     // allocated bytes of buff
 	cmph_uint8  eof;      // flag to indicate end of file
+	// read-ahead: the spare buffer is filled while buff is consumed
+	cmph_uint8 * next_buff;
+	cmph_uint32 next_capacity, // bytes requested for the spare buffer
+		    next_nbytes,   // bytes read into the spare buffer
+		    next_size;     // allocated bytes of next_buff
+	cmph_uint8  next_eof;
+	cmph_uint8  next_state;
+	buffer_io_t * io;
+	buffer_entry_t * io_next; // next entry in the read queue
+	cmph_uint8 * key_buff;    // holds a record that straddles two blocks
+	cmph_uint32 key_size;     // allocated bytes of key_buff
+	// compressed files are read block by block (see run_codec.h)
+	cmph_uint8  compressed;
+	cmph_uint8  has_header;   // header holds the sizes of the next block
+	cmph_uint32 header[2];
+	cmph_uint8 * enc_buff;    // encoded block
+	cmph_uint32 enc_size;     // allocated bytes of enc_buff
 };
 
+#ifdef HAVE_PTHREAD_H
+struct __buffer_io_t
+{
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t requested;  // signaled when an entry is queued
+	pthread_cond_t loaded;     // signaled when a spare buffer becomes ready
+	buffer_entry_t * head, * tail;
+	cmph_uint8 shutdown;
+};
+#endif
+
+static cmph_uint8 buffer_entry_reserve(buffer_entry_t * buffer_entry, cmph_uint32 size)
+{
+	cmph_uint8 * next_buff = NULL;
+	if (buffer_entry->next_size >= size) return 1;
+	next_buff = (cmph_uint8 *)realloc(buffer_entry->next_buff, (size_t)size);
+	if (next_buff == NULL) return 0;
+	buffer_entry->next_buff = next_buff;
+	buffer_entry->next_size = size;
+	return 1;
+}
+
+/* Decodes into the spare buffer as many compressed blocks as fit in its
+ * capacity, and at least one.
+ */
+static void buffer_entry_fill_blocks(buffer_entry_t * buffer_entry)
+{
+	cmph_uint32 rawlen, enclen;
+	buffer_entry->next_nbytes = 0;
+	buffer_entry->next_eof = 0;
+	for(;;)
+	{
+		if (!buffer_entry->has_header)
+		{
+			if (fread(buffer_entry->header, sizeof(buffer_entry->header), (size_t)1, buffer_entry->fd) != 1) break;
+			buffer_entry->has_header = 1;
+		}
+		rawlen = buffer_entry->header[0];
+		enclen = buffer_entry->header[1];
+		if (buffer_entry->next_nbytes && (cmph_uint64)buffer_entry->next_nbytes + rawlen > buffer_entry->next_capacity) return;
+		if (!buffer_entry_reserve(buffer_entry, buffer_entry->next_nbytes + rawlen)) break;
+		if (buffer_entry->enc_size < enclen)
+		{
+			free(buffer_entry->enc_buff);
+			buffer_entry->enc_buff = (cmph_uint8 *)malloc((size_t)enclen);
+			buffer_entry->enc_size = buffer_entry->enc_buff ? enclen : 0;
+			if (buffer_entry->enc_buff == NULL) break;
+		}
+		if (fread(buffer_entry->enc_buff, (size_t)1, (size_t)enclen, buffer_entry->fd) != enclen) break;
+		if (run_codec_decode(buffer_entry->enc_buff, enclen, buffer_entry->next_buff + buffer_entry->next_nbytes, rawlen) != rawlen) break;
+		buffer_entry->next_nbytes += rawlen;
+		buffer_entry->has_header = 0;
+	}
+	buffer_entry->has_header = 0;
+	buffer_entry->next_eof = 1;
+}
+
+/* Fills the spare buffer with the next block of the file. It is the only place
+ * where the file is read, and it reuses the spare buffer unless the capacity
+ * has grown.
+ */
+static void buffer_entry_fill(buffer_entry_t * buffer_entry)
+{
+	if (buffer_entry->compressed)
+	{
+		buffer_entry_fill_blocks(buffer_entry);
+		return;
+	}
+	if (!buffer_entry_reserve(buffer_entry, buffer_entry->next_capacity))
+	{
+		buffer_entry->next_nbytes = 0;
+		buffer_entry->next_eof = 1;
+		return;
+	}
+	buffer_entry->next_nbytes = (cmph_uint32)fread(buffer_entry->next_buff, (size_t)1, (size_t)buffer_entry->next_capacity, buffer_entry->fd);
+	buffer_entry->next_eof = (cmph_uint8)(buffer_entry->next_nbytes != buffer_entry->next_capacity);
+}
+
+#ifdef HAVE_PTHREAD_H
+static void * buffer_io_run(void * arg)
+{
+	buffer_io_t * buffer_io = (buffer_io_t *)arg;
+	buffer_entry_t * buffer_entry = NULL;
+	pthread_mutex_lock(&buffer_io->mutex);
+	for(;;)
+	{
+		while (buffer_io->head == NULL && !buffer_io->shutdown) pthread_cond_wait(&buffer_io->requested, &buffer_io->mutex);
+		if (buffer_io->head == NULL) break;
+		buffer_entry = buffer_io->head;
+		buffer_io->head = buffer_entry->io_next;
+		if (buffer_io->head == NULL) buffer_io->tail = NULL;
+		buffer_entry->io_next = NULL;
+		pthread_mutex_unlock(&buffer_io->mutex);
+		buffer_entry_fill(buffer_entry);
+		pthread_mutex_lock(&buffer_io->mutex);
+		buffer_entry->next_state = BUFFER_ENTRY_READY;
+		pthread_cond_broadcast(&buffer_io->loaded);
+	}
+	pthread_mutex_unlock(&buffer_io->mutex);
+	return NULL;
+}
+#endif
+
+buffer_io_t * buffer_io_new(void)
+{
+#ifdef HAVE_PTHREAD_H
+	buffer_io_t * buffer_io = (buffer_io_t *)malloc(sizeof(buffer_io_t));
+	if (!buffer_io) return NULL;
+	buffer_io->head = NULL;
+	buffer_io->tail = NULL;
+	buffer_io->shutdown = 0;
+	pthread_mutex_init(&buffer_io->mutex, NULL);
+	pthread_cond_init(&buffer_io->requested, NULL);
+	pthread_cond_init(&buffer_io->loaded, NULL);
+	if (pthread_create(&buffer_io->thread, NULL, buffer_io_run, buffer_io) != 0)
+	{
+		pthread_cond_destroy(&buffer_io->loaded);
+		pthread_cond_destroy(&buffer_io->requested);
+		pthread_mutex_destroy(&buffer_io->mutex);
+		free(buffer_io);
+		return NULL;
+	}
+	return buffer_io;
+#else
+	return NULL;
+#endif
+}
+
+void buffer_io_destroy(buffer_io_t * buffer_io)
+{
+#ifdef HAVE_PTHREAD_H
+	if (buffer_io == NULL) return;
+	pthread_mutex_lock(&buffer_io->mutex);
+	buffer_io->shutdown = 1;
+	pthread_cond_signal(&buffer_io->requested);
+	pthread_mutex_unlock(&buffer_io->mutex);
+	pthread_join(buffer_io->thread, NULL);
+	pthread_cond_destroy(&buffer_io->loaded);
+	pthread_cond_destroy(&buffer_io->requested);
+	pthread_mutex_destroy(&buffer_io->mutex);
+	free(buffer_io);
+#endif
+}
+
+#ifdef HAVE_PTHREAD_H
+/* Queues the read of the next block into the spare buffer, with the mutex of
+ * the reader held.
+ */
+static void buffer_entry_enqueue(buffer_entry_t * buffer_entry)
+{
+	buffer_io_t * buffer_io = buffer_entry->io;
+	buffer_entry->next_capacity = buffer_entry->capacity;
+	buffer_entry->next_state = BUFFER_ENTRY_REQUESTED;
+	if (buffer_io->tail) buffer_io->tail->io_next = buffer_entry;
+	else buffer_io->head = buffer_entry;
+	buffer_io->tail = buffer_entry;
+	pthread_cond_signal(&buffer_io->requested);
+}
+#endif
+
+/* Queues the read of the next block into the spare buffer. */
+static void buffer_entry_request(buffer_entry_t * buffer_entry)
+{
+#ifdef HAVE_PTHREAD_H
+	buffer_io_t * buffer_io = buffer_entry->io;
+	pthread_mutex_lock(&buffer_io->mutex);
+	buffer_entry_enqueue(buffer_entry);
+	pthread_mutex_unlock(&buffer_io->mutex);
+#endif
+}
+
+/* Waits until no read is pending on the spare buffer, requesting the read
+ * first if request is set and none was. The state is only read with the
+ * mutex held, since the reader thread sets it.
+ */
+static void buffer_entry_wait(buffer_entry_t * buffer_entry, cmph_uint8 request)
+{
+#ifdef HAVE_PTHREAD_H
+	buffer_io_t * buffer_io = buffer_entry->io;
+	if (buffer_io == NULL) return;
+	pthread_mutex_lock(&buffer_io->mutex);
+	if (request && buffer_entry->next_state == BUFFER_ENTRY_IDLE) buffer_entry_enqueue(buffer_entry);
+	while (buffer_entry->next_state == BUFFER_ENTRY_REQUESTED) pthread_cond_wait(&buffer_io->loaded, &buffer_io->mutex);
+	pthread_mutex_unlock(&buffer_io->mutex);
+#endif
+}
+
 buffer_entry_t * buffer_entry_new(cmph_uint32 capacity)
 {
 	buffer_entry_t *buff_entry = (buffer_entry_t *)malloc(sizeof(buffer_entry_t));
@@ -23,13 +240,42 @@ buffer_entry_t * buffer_entry_new(cmph_uint32 capacity)
 	buff_entry->capacity = capacity;
 	buff_entry->nbytes = capacity;
 	buff_entry->pos = capacity;
+	buff_entry->size = 0;
         buff_entry->eof = 0;
+	buff_entry->next_buff = NULL;
+	buff_entry->next_capacity = capacity;
+	buff_entry->next_nbytes = 0;
+	buff_entry->next_size = 0;
+	buff_entry->next_eof = 0;
+	buff_entry->next_state = BUFFER_ENTRY_IDLE;
+	buff_entry->io = NULL;
+	buff_entry->io_next = NULL;
+	buff_entry->key_buff = NULL;
+	buff_entry->key_size = 0;
+	buff_entry->compressed = 0;
+	buff_entry->has_header = 0;
+	buff_entry->enc_buff = NULL;
+	buff_entry->enc_size = 0;
 	return buff_entry;
 }
 
+void buffer_entry_set_io(buffer_entry_t * buffer_entry, buffer_io_t * buffer_io)
+{
+	assert(buffer_entry->fd == NULL);
+	buffer_entry->io = buffer_io;
+}
+
+void buffer_entry_set_compressed(buffer_entry_t * buffer_entry, cmph_uint8 compressed)
+{
+	assert(buffer_entry->fd == NULL);
+	buffer_entry->compressed = compressed;
+}
+
 void buffer_entry_open(buffer_entry_t * buffer_entry, char * filename)
 {
 	buffer_entry->fd = fopen(filename, "rb");
+	// start reading the first block before it is asked for
+	if (buffer_entry->fd && buffer_entry->io) buffer_entry_request(buffer_entry);
 }
 
 void buffer_entry_set_capacity(buffer_entry_t * buffer_entry, cmph_uint32 capacity)
@@ -44,57 +290,125 @@ cmph_uint32 buffer_entry_get_capacity(buffer_entry_t * buffer_entry)
 }
 
 static void buffer_entry_load(buffer_entry_t * buffer_entry)
+{
+	cmph_uint8 * buff = buffer_entry->buff;
+	cmph_uint32 size = buffer_entry->size;
+	if (buffer_entry->io == NULL)
+	{
+		buffer_entry->next_capacity = buffer_entry->capacity;
+		buffer_entry_fill(buffer_entry);
+	}
+	else
+	{
+		buffer_entry_wait(buffer_entry, 1);
+	}
+	// swap buffers: the consumed one becomes the spare one
+	buffer_entry->buff = buffer_entry->next_buff;
+	buffer_entry->size = buffer_entry->next_size;
+	buffer_entry->nbytes = buffer_entry->next_nbytes;
+	buffer_entry->eof = buffer_entry->next_eof;
+	buffer_entry->pos = 0;
+	buffer_entry->next_buff = buff;
+	buffer_entry->next_size = size;
+	buffer_entry->next_state = BUFFER_ENTRY_IDLE;
+	if (buffer_entry->io && !buffer_entry->eof) buffer_entry_request(buffer_entry);
+}
+
+/* Gives the buffers back once the whole file has been read, so that the
+ * memory recovered by the buffer manager is really available.
+ */
+static void buffer_entry_release(buffer_entry_t * buffer_entry)
 {
 	free(buffer_entry->buff);
-	buffer_entry->buff = (cmph_uint8 *)calloc((size_t)buffer_entry->capacity, sizeof(cmph_uint8));
-	buffer_entry->nbytes = (cmph_uint32)fread(buffer_entry->buff, (size_t)1, (size_t)buffer_entry->capacity, buffer_entry->fd);
-	if (buffer_entry->nbytes != buffer_entry->capacity) buffer_entry->eof = 1;
+	buffer_entry->buff = NULL;
+	buffer_entry->size = 0;
+	buffer_entry->nbytes = 0;
 	buffer_entry->pos = 0;
+	free(buffer_entry->next_buff);
+	buffer_entry->next_buff = NULL;
+	buffer_entry->next_size = 0;
+	free(buffer_entry->key_buff);
+	buffer_entry->key_buff = NULL;
+	buffer_entry->key_size = 0;
+	free(buffer_entry->enc_buff);
+	buffer_entry->enc_buff = NULL;
+	buffer_entry->enc_size = 0;
+}
+
+// Copies the next n bytes of the file to dst, loading blocks as needed.
+static cmph_uint32 buffer_entry_copy(buffer_entry_t * buffer_entry, cmph_uint8 * dst, cmph_uint32 n)
+{
+	cmph_uint32 copied_bytes = 0, nbytes;
+	while(copied_bytes < n)
+	{
+		if(buffer_entry->pos == buffer_entry->nbytes)
+		{
+			if(buffer_entry->eof) break;
+			buffer_entry_load(buffer_entry);
+			continue;
+		}
+		nbytes = buffer_entry->nbytes - buffer_entry->pos;
+		if(nbytes > n - copied_bytes) nbytes = n - copied_bytes;
+		memcpy(dst + copied_bytes, buffer_entry->buff + buffer_entry->pos, (size_t)nbytes);
+		buffer_entry->pos += nbytes;
+		copied_bytes += nbytes;
+	}
+	return copied_bytes;
 }
 
-cmph_uint8 * buffer_entry_read_key(buffer_entry_t * buffer_entry, cmph_uint32 * keylen)
+cmph_uint8 * buffer_entry_read_key(buffer_entry_t * buffer_entry, cmph_uint32 * keylen, cmph_uint32 * h0)
 {
-	cmph_uint8 * buf = NULL;
-	cmph_uint32 lacked_bytes = sizeof(*keylen);
-	cmph_uint32 copied_bytes = 0;
+	cmph_uint32 header[2];
 	if(buffer_entry->eof && (buffer_entry->pos == buffer_entry->nbytes)) // end
 	{
-		free(buf);
+		buffer_entry_release(buffer_entry);
 		return NULL;
 	}
-	if((buffer_entry->pos + lacked_bytes) > buffer_entry->nbytes)
+	if((cmph_uint64)buffer_entry->pos + sizeof(header) <= buffer_entry->nbytes)
 	{
-		copied_bytes = buffer_entry->nbytes - buffer_entry->pos;
-		lacked_bytes = (buffer_entry->pos + lacked_bytes) - buffer_entry->nbytes;
-		if (copied_bytes != 0) memcpy(keylen, buffer_entry->buff + buffer_entry->pos, (size_t)copied_bytes);
-		buffer_entry_load(buffer_entry);
+		memcpy(header, buffer_entry->buff + buffer_entry->pos, sizeof(header));
+		if((cmph_uint64)buffer_entry->pos + sizeof(header) + header[1] <= buffer_entry->nbytes) // whole record in the buffer
+		{
+			cmph_uint8 * buf = buffer_entry->buff + buffer_entry->pos + sizeof(*h0);
+			buffer_entry->pos += (cmph_uint32)sizeof(header) + header[1];
+			*h0 = header[0];
+			*keylen = header[1];
+			return buf;
+		}
 	}
-	memcpy(keylen + copied_bytes, buffer_entry->buff + buffer_entry->pos, (size_t)lacked_bytes);
-	buffer_entry->pos += lacked_bytes;
-
-	lacked_bytes = *keylen;
-	copied_bytes = 0;
-	buf = (cmph_uint8 *)malloc(*keylen + sizeof(*keylen));
-        memcpy(buf, keylen, sizeof(*keylen));
-	if((buffer_entry->pos + lacked_bytes) > buffer_entry->nbytes) {
-		copied_bytes = buffer_entry->nbytes - buffer_entry->pos;
-		lacked_bytes = (buffer_entry->pos + lacked_bytes) - buffer_entry->nbytes;
-		if (copied_bytes != 0) {
-			memcpy(buf + sizeof(*keylen), buffer_entry->buff + buffer_entry->pos, (size_t)copied_bytes);
-                }
-		buffer_entry_load(buffer_entry);
+	// the record straddles two blocks, so it is assembled in key_buff
+	if(buffer_entry_copy(buffer_entry, (cmph_uint8 *)header, (cmph_uint32)sizeof(header)) < sizeof(header))
+	{
+		// the previous block ended exactly at the end of the file
+		buffer_entry_release(buffer_entry);
+		return NULL;
+	}
+	*h0 = header[0];
+	*keylen = header[1];
+	if(buffer_entry->key_size < *keylen + sizeof(*keylen))
+	{
+		buffer_entry->key_size = *keylen + (cmph_uint32)sizeof(*keylen);
+		buffer_entry->key_buff = (cmph_uint8 *)realloc(buffer_entry->key_buff, (size_t)buffer_entry->key_size);
+		assert(buffer_entry->key_buff);
 	}
-	memcpy(buf+sizeof(*keylen)+copied_bytes, buffer_entry->buff + buffer_entry->pos, (size_t)lacked_bytes);
-	buffer_entry->pos += lacked_bytes;
-	return buf;
+	memcpy(buffer_entry->key_buff, keylen, sizeof(*keylen));
+	buffer_entry_copy(buffer_entry, buffer_entry->key_buff + sizeof(*keylen), *keylen);
+	return buffer_entry->key_buff;
 }
 
 void buffer_entry_destroy(buffer_entry_t * buffer_entry)
 {
-  fclose(buffer_entry->fd);
+  buffer_entry_wait(buffer_entry, 0);
+  if (buffer_entry->fd) fclose(buffer_entry->fd);
   buffer_entry->fd = NULL;
   free(buffer_entry->buff);
   buffer_entry->buff = NULL;
+  free(buffer_entry->next_buff);
+  buffer_entry->next_buff = NULL;
+  free(buffer_entry->key_buff);
+  buffer_entry->key_buff = NULL;
+  free(buffer_entry->enc_buff);
+  buffer_entry->enc_buff = NULL;
   buffer_entry->capacity = 0;
   buffer_entry->nbytes = 0;
   buffer_entry->pos = 0;
@@ -5,10 +5,34 @@
 #include <stdio.h>
 typedef struct __buffer_entry_t buffer_entry_t;
 
+/* Background reader shared by a set of buffer entries. Each entry attached
+ * to it keeps a second buffer that is filled ahead of time, so the caller
+ * only waits for the disk when it consumes data faster than it is read.
+ */
+typedef struct __buffer_io_t buffer_io_t;
+
+/** \fn buffer_io_t * buffer_io_new(void);
+ *  \return a new background reader or NULL if threads are not available
+ */
+buffer_io_t * buffer_io_new(void);
+void buffer_io_destroy(buffer_io_t * buffer_io);
+
 buffer_entry_t * buffer_entry_new(cmph_uint32 capacity);
+void buffer_entry_set_io(buffer_entry_t * buffer_entry, buffer_io_t * buffer_io);
+/** \fn void buffer_entry_set_compressed(buffer_entry_t * buffer_entry, cmph_uint8 compressed);
+ *  \brief Sets whether the file is made of compressed blocks (see run_codec.h),
+ *  which are decoded when they are loaded. Must be called before buffer_entry_open.
+ */
+void buffer_entry_set_compressed(buffer_entry_t * buffer_entry, cmph_uint8 compressed);
 void buffer_entry_set_capacity(buffer_entry_t * buffer_entry, cmph_uint32 capacity);
 cmph_uint32 buffer_entry_get_capacity(buffer_entry_t * buffer_entry);
 void buffer_entry_open(buffer_entry_t * buffer_entry, char * filename);
-cmph_uint8 * buffer_entry_read_key(buffer_entry_t * buffer_entry, cmph_uint32 * keylen);
+/** \fn cmph_uint8 * buffer_entry_read_key(buffer_entry_t * buffer_entry, cmph_uint32 * keylen, cmph_uint32 * h0);
+ *  \brief Reads the next record (h0, key length and key) of the file.
+ *  \param h0 receives the bucket stored with the key
+ *  \return a pointer to the key length followed by the key, owned by the entry
+ *  and valid until the next call on the same entry, or NULL at the end of the file
+ */
+cmph_uint8 * buffer_entry_read_key(buffer_entry_t * buffer_entry, cmph_uint32 * keylen, cmph_uint32 * h0);
 void buffer_entry_destroy(buffer_entry_t * buffer_entry);
 #endif
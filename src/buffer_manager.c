@@ -10,9 +10,10 @@ struct __buffer_manager_t
 	cmph_uint32 nentries;             // number of entries to be managed
 	cmph_uint32 *memory_avail_list;   // memory available list
 	int pos_avail_list;               // current position in memory available list
+	buffer_io_t * buffer_io;          // background reader, NULL if reads are synchronous
 };
 
-buffer_manager_t * buffer_manager_new(cmph_uint32 memory_avail, cmph_uint32 nentries)
+buffer_manager_t * buffer_manager_new(cmph_uint32 memory_avail, cmph_uint32 nentries, cmph_uint8 compressed)
 {
 	cmph_uint32 memory_avail_entry, i;
 	buffer_manager_t *buff_manager = (buffer_manager_t *)malloc(sizeof(buffer_manager_t));
@@ -22,10 +23,15 @@ buffer_manager_t * buffer_manager_new(cmph_uint32 memory_avail, cmph_uint32 nent
 	buff_manager->memory_avail_list = (cmph_uint32 *)calloc((size_t)nentries, sizeof(cmph_uint32));
 	buff_manager->pos_avail_list = -1;
 	buff_manager->nentries = nentries;
-	memory_avail_entry = buff_manager->memory_avail/buff_manager->nentries + 1;
+	buff_manager->buffer_io = buffer_io_new();
+	// with read-ahead every entry holds two buffers
+	if (buff_manager->buffer_io) memory_avail_entry = buff_manager->memory_avail/(2*buff_manager->nentries) + 1;
+	else memory_avail_entry = buff_manager->memory_avail/buff_manager->nentries + 1;
 	for(i = 0; i < buff_manager->nentries; i++)
 	{
 		buff_manager->buffer_entries[i] = buffer_entry_new(memory_avail_entry);
+		buffer_entry_set_io(buff_manager->buffer_entries[i], buff_manager->buffer_io);
+		buffer_entry_set_compressed(buff_manager->buffer_entries[i], compressed);
 	}
 	return buff_manager;
 }
@@ -35,7 +41,7 @@ void buffer_manager_open(buffer_manager_t * buffer_manager, cmph_uint32 index, c
 	buffer_entry_open(buffer_manager->buffer_entries[index], filename);
 }
 
-cmph_uint8 * buffer_manager_read_key(buffer_manager_t * buffer_manager, cmph_uint32 index, cmph_uint32 * keylen)
+cmph_uint8 * buffer_manager_read_key(buffer_manager_t * buffer_manager, cmph_uint32 index, cmph_uint32 * keylen, cmph_uint32 * h0)
 {
 	cmph_uint8 * key = NULL;
 	if (buffer_manager->pos_avail_list >= 0 ) // recovering memory
@@ -43,7 +49,7 @@ cmph_uint8 * buffer_manager_read_key(buffer_manager_t * buffer_manager, cmph_uin
 		cmph_uint32 new_capacity = buffer_entry_get_capacity(buffer_manager->buffer_entries[index]) + buffer_manager->memory_avail_list[(buffer_manager->pos_avail_list)--];
 		buffer_entry_set_capacity(buffer_manager->buffer_entries[index], new_capacity);
 	}
-	key = buffer_entry_read_key(buffer_manager->buffer_entries[index], keylen);
+	key = buffer_entry_read_key(buffer_manager->buffer_entries[index], keylen, h0);
 	if (key == NULL) // storing memory to be recovered
 	{
 		buffer_manager->memory_avail_list[++(buffer_manager->pos_avail_list)] = buffer_entry_get_capacity(buffer_manager->buffer_entries[index]);
@@ -58,6 +64,7 @@ void buffer_manager_destroy(buffer_manager_t * buffer_manager)
 	{
 		buffer_entry_destroy(buffer_manager->buffer_entries[i]);
 	}
+	buffer_io_destroy(buffer_manager->buffer_io);
 	free(buffer_manager->memory_avail_list);
 	free(buffer_manager->buffer_entries);
 	free(buffer_manager);
@@ -5,8 +5,17 @@
 #include <stdio.h>
 typedef struct __buffer_manager_t buffer_manager_t;
 
-buffer_manager_t * buffer_manager_new(cmph_uint32 memory_avail, cmph_uint32 nentries);
+/** \fn buffer_manager_t * buffer_manager_new(cmph_uint32 memory_avail, cmph_uint32 nentries, cmph_uint8 compressed);
+ *  \param memory_avail memory shared by the buffers of all entries
+ *  \param nentries number of files to be read
+ *  \param compressed whether the files are made of compressed blocks (see run_codec.h)
+ */
+buffer_manager_t * buffer_manager_new(cmph_uint32 memory_avail, cmph_uint32 nentries, cmph_uint8 compressed);
 void buffer_manager_open(buffer_manager_t * buffer_manager, cmph_uint32 index, char * filename);
-cmph_uint8 * buffer_manager_read_key(buffer_manager_t * buffer_manager, cmph_uint32 index, cmph_uint32 * keylen);
+/** \fn cmph_uint8 * buffer_manager_read_key(buffer_manager_t * buffer_manager, cmph_uint32 index, cmph_uint32 * keylen, cmph_uint32 * h0);
+ *  \brief Reads the next record of the file index and its h0. The record is borrowed from
+ *  the buffer manager and stays valid until the next read on the same index.
+ */
+cmph_uint8 * buffer_manager_read_key(buffer_manager_t * buffer_manager, cmph_uint32 index, cmph_uint32 * keylen, cmph_uint32 * h0);
 void buffer_manager_destroy(buffer_manager_t * buffer_manager);
 #endif
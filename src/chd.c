@@ -61,6 +61,13 @@ void chd_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin)
 }
 
 
+void chd_config_set_use_primes(cmph_config_t *mph, cmph_uint32 use_primes)
+{
+	chd_config_data_t *data = (chd_config_data_t *) mph->data;
+	chd_ph_config_set_use_primes(data->chd_ph, use_primes);
+}
+
+
 cmph_t *chd_new(cmph_config_t *mph, double c)
 {
 	DEBUGP("Creating new chd");
@@ -80,6 +87,8 @@ cmph_t *chd_new(cmph_config_t *mph, double c)
 	register cmph_uint32 i, idx, nkeys, nvals, nbins;
 	cmph_uint32 * vals_table = NULL;
 	register cmph_uint32 * occup_table = NULL;
+	cmph_stats_mark_t mark;
+	cmph_stats_t chd_ph_stats;
 	#ifdef CMPH_TIMING
 	double construction_time_begin = 0.0;
 	double construction_time = 0.0;
@@ -94,7 +103,12 @@ cmph_t *chd_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "Generating a CHD_PH perfect hash function with a load factor equal to %.3f\n", c);
 	}
 
+	// the phases of CHD_PH are counted as phases of CHD, and its totals are
+	// part of the totals of CHD
+	cmph_config_set_stats(chd->chd_ph, mph->stats ? &chd_ph_stats : NULL);
 	chd_phf = cmph_new(chd->chd_ph);
+	cmph_config_set_stats(chd->chd_ph, NULL);
+	if(mph->stats) __cmph_stats_merge(mph->stats, &chd_ph_stats);
 
 	if(chd_phf == NULL)
 	{
@@ -118,6 +132,7 @@ cmph_t *chd_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "Compressing the range of the resulting CHD_PH perfect hash function\n");
 	}
 
+	cmph_stats_begin(mph->stats, &mark);
 	compressed_rank_init(&cr);
 	nbins = chd_ph->n;
 	nkeys = chd_ph->m;
@@ -141,6 +156,7 @@ cmph_t *chd_new(cmph_config_t *mph, double c)
 	packed_cr = (cmph_uint8 *) calloc(packed_cr_size, sizeof(cmph_uint8));
 	compressed_rank_pack(&cr, packed_cr);
 	compressed_rank_destroy(&cr);
+	cmph_stats_end(mph->stats, CMPH_PHASE_RANKING, &mark);
 
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
@@ -157,6 +173,7 @@ cmph_t *chd_new(cmph_config_t *mph, double c)
 
 	mphf->data = chdf;
 	mphf->size = nkeys;
+	cmph_stats_component(mph->stats, "rank", packed_cr_size*8.0);
 
 	DEBUGP("Successfully generated minimal perfect hash\n");
 	if (mph->verbosity)
@@ -11,6 +11,7 @@
 #include "chd_ph.h"
 #include"miller_rabin.h"
 #include"bitbool.h"
+#include"fastmod.h"
 
 
 //#define DEBUG
@@ -156,6 +157,7 @@ chd_ph_config_data_t *chd_ph_config_new(void)
 
 	chd_ph->m = 0;
 	chd_ph->use_h = 1;
+	chd_ph->use_primes = 1;
 	chd_ph->keys_per_bin = 1;
 	chd_ph->keys_per_bucket = 4;
 	chd_ph->occup_table = 0;
@@ -213,6 +215,13 @@ void chd_ph_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin
 	chd_ph->keys_per_bin = keys_per_bin;
 }
 
+void chd_ph_config_set_use_primes(cmph_config_t *mph, cmph_uint32 use_primes)
+{
+	assert(mph);
+	chd_ph_config_data_t *chd_ph = (chd_ph_config_data_t *)mph->data;
+	chd_ph->use_primes = (cmph_uint8)(use_primes != 0);
+}
+
 cmph_uint8 chd_ph_mapping(cmph_config_t *mph, chd_ph_bucket_t * buckets, chd_ph_item_t * items, cmph_uint32 *max_bucket_size)
 {
 	register cmph_uint32 i = 0, g = 0;
@@ -241,9 +250,9 @@ cmph_uint8 chd_ph_mapping(cmph_config_t *mph, chd_ph_bucket_t * buckets, chd_ph_
 
 			map_item = (map_items + i);
 
-			g = hl[0] % chd_ph->nbuckets;
-			map_item->f = hl[1] % chd_ph->n;
-			map_item->h = hl[2] % (chd_ph->n - 1) + 1;
+			g = fastmod_mod(hl[0], chd_ph->nbuckets_magic, chd_ph->nbuckets);
+			map_item->f = fastmod_mod(hl[1], chd_ph->n_magic, chd_ph->n);
+			map_item->h = fastmod_mod(hl[2], chd_ph->n1_magic, chd_ph->n - 1) + 1;
 			map_item->bucket_num=g;
 			mph->key_source->dispose(mph->key_source->data, key, keylen);
 // 			if(buckets[g].size == (chd_ph->keys_per_bucket << 2))
@@ -270,6 +279,7 @@ cmph_uint8 chd_ph_mapping(cmph_config_t *mph, chd_ph_bucket_t * buckets, chd_ph_
 			if(!chd_ph_bucket_insert(buckets, map_items, items, chd_ph->nbuckets, i))
 				break;
 		}
+		cmph_stats_iteration(mph->stats, i == chd_ph->m);
 		if(i == chd_ph->m)
 		{
 			free(map_items);
@@ -379,7 +389,7 @@ static inline cmph_uint8 place_bucket_probe(chd_ph_config_data_t *chd_ph, chd_ph
 	{
 		for(i = 0; i < size; i++) // placement
 		{
-			position = (cmph_uint32)((item->f + ((cmph_uint64)item->h)*probe0_num + probe1_num) % chd_ph->n);
+			position = fastmod_mod(item->f + ((cmph_uint64)item->h)*probe0_num + probe1_num, chd_ph->n_magic, chd_ph->n);
 			if(chd_ph->occup_table[position] >= chd_ph->keys_per_bin)
 			{
 				break;
@@ -391,7 +401,7 @@ static inline cmph_uint8 place_bucket_probe(chd_ph_config_data_t *chd_ph, chd_ph
 	{
 		for(i = 0; i < size; i++) // placement
 		{
-			position = (cmph_uint32)((item->f + ((cmph_uint64)item->h)*probe0_num + probe1_num) % chd_ph->n);
+			position = fastmod_mod(item->f + ((cmph_uint64)item->h)*probe0_num + probe1_num, chd_ph->n_magic, chd_ph->n);
 			if(GETBIT32(((cmph_uint32 *)chd_ph->occup_table), position))
 			{
 				break;
@@ -411,7 +421,7 @@ static inline cmph_uint8 place_bucket_probe(chd_ph_config_data_t *chd_ph, chd_ph
 				{
 					break;
 				}
-				position = (cmph_uint32)((item->f + ((cmph_uint64 )item->h) * probe0_num + probe1_num) % chd_ph->n);
+				position = fastmod_mod(item->f + ((cmph_uint64)item->h)*probe0_num + probe1_num, chd_ph->n_magic, chd_ph->n);
 				(chd_ph->occup_table[position])--;
 				item++;
 				i--;
@@ -424,7 +434,7 @@ static inline cmph_uint8 place_bucket_probe(chd_ph_config_data_t *chd_ph, chd_ph
 				{
 					break;
 				}
-				position = (cmph_uint32)((item->f + ((cmph_uint64 )item->h) * probe0_num + probe1_num) % chd_ph->n);
+				position = fastmod_mod(item->f + ((cmph_uint64)item->h)*probe0_num + probe1_num, chd_ph->n_magic, chd_ph->n);
 				UNSETBIT32(((cmph_uint32*)chd_ph->occup_table), position);
 
 // 				([position/32]^=(1<<(position%32));
@@ -589,12 +599,12 @@ static inline cmph_uint8 chd_ph_check_bin_hashing(chd_ph_config_data_t *chd_ph,
 		{
 			j = bucket_size;
 			item = items + buckets[i].items_list;
-			probe0_num = disp_table[buckets[i].bucket_id] % chd_ph->n;
-			probe1_num = disp_table[buckets[i].bucket_id] / chd_ph->n;
+			probe1_num = fastmod_div(disp_table[buckets[i].bucket_id], chd_ph->n_magic, chd_ph->n);
+			probe0_num = disp_table[buckets[i].bucket_id] - probe1_num * chd_ph->n;
 			for(; j > 0; j--)
 			{
 				m++;
-				position = (cmph_uint32)((item->f + ((cmph_uint64 )item->h) * probe0_num + probe1_num) % chd_ph->n);
+				position = fastmod_mod(item->f + ((cmph_uint64)item->h)*probe0_num + probe1_num, chd_ph->n_magic, chd_ph->n);
 				if(chd_ph->keys_per_bin > 1)
 				{
 					if(chd_ph->occup_table[position] >= chd_ph->keys_per_bin)
@@ -637,6 +647,7 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 	chd_ph_sorted_list_t * sorted_lists = NULL;
 	cmph_uint32 * disp_table = NULL;
 	register double space_lower_bound = 0;
+	cmph_stats_mark_t mark;
 	#ifdef CMPH_TIMING
 	double construction_time_begin = 0.0;
 	double construction_time = 0.0;
@@ -664,15 +675,27 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 
 	chd_ph->n = (cmph_uint32)(chd_ph->m/(chd_ph->keys_per_bin * load_factor)) + 1;
 
-	//Round the number of bins to the prime immediately above
-	if(chd_ph->n % 2 == 0) chd_ph->n++;
-	for(;;)
+	//Round the number of bins to the prime immediately above. The probe
+	//sequence works for any n > 1 since bins are reduced with fastmod, so the
+	//rounding can be turned off with chd_ph_config_set_use_primes().
+	if(chd_ph->use_primes)
 	{
-		if(check_primality(chd_ph->n) == 1)
-			break;
-		chd_ph->n += 2; // just odd numbers can be primes for n > 2
+		if(chd_ph->n % 2 == 0) chd_ph->n++;
+		for(;;)
+		{
+			if(check_primality(chd_ph->n) == 1)
+				break;
+			chd_ph->n += 2; // just odd numbers can be primes for n > 2
 
-	};
+		};
+	}
+	else if(chd_ph->n < 2)
+	{
+		chd_ph->n = 2;
+	}
+	chd_ph->nbuckets_magic = fastmod_magic(chd_ph->nbuckets);
+	chd_ph->n_magic = fastmod_magic(chd_ph->n);
+	chd_ph->n1_magic = fastmod_magic(chd_ph->n - 1);
 
 	DEBUGP("n = %u \n", chd_ph->n);
 	if(chd_ph->keys_per_bin == 1)
@@ -714,7 +737,10 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 			fprintf(stderr, "Starting mapping step for mph creation of %u keys with %u bins\n", chd_ph->m, chd_ph->n);
 		}
 
-		if(!chd_ph_mapping(mph, buckets, items, &max_bucket_size))
+		cmph_stats_begin(mph->stats, &mark);
+		searching_success = chd_ph_mapping(mph, buckets, items, &max_bucket_size);
+		cmph_stats_end(mph->stats, CMPH_PHASE_MAPPING, &mark);
+		if(!searching_success)
 		{
 			if (mph->verbosity)
 			{
@@ -733,15 +759,21 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 			free(sorted_lists);
 		}
 
+		cmph_stats_begin(mph->stats, &mark);
         	sorted_lists = chd_ph_ordering(&buckets, &items, chd_ph->nbuckets, chd_ph->m, max_bucket_size);
+		cmph_stats_end(mph->stats, CMPH_PHASE_ORDERING, &mark);
 
 		if (mph->verbosity)
 		{
 			fprintf(stderr, "Starting searching step\n");
 		}
 
+		cmph_stats_begin(mph->stats, &mark);
 		searching_success = chd_ph_searching(chd_ph, buckets, items, max_bucket_size, sorted_lists, max_probes, disp_table);
+		cmph_stats_end(mph->stats, CMPH_PHASE_SEARCHING, &mark);
 		if(searching_success) break;
+		// the mapping is counted as an iteration that failed
+		if(mph->stats) ++mph->stats->failures;
 
 		// reset occup_table
 		if(chd_ph->keys_per_bin > 1)
@@ -782,8 +814,10 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 		free(chd_ph->cs);
 	}
 	chd_ph->cs = (compressed_seq_t *) calloc(1, sizeof(compressed_seq_t));
+	cmph_stats_begin(mph->stats, &mark);
 	compressed_seq_init(chd_ph->cs);
 	compressed_seq_generate(chd_ph->cs, disp_table, chd_ph->nbuckets);
+	cmph_stats_end(mph->stats, CMPH_PHASE_RANKING, &mark);
 
 	#ifdef CMPH_TIMING
 	ELAPSED_TIME_IN_SECONDS(&construction_time);
@@ -816,9 +850,19 @@ cleanup:
 	chd_ph->hl = NULL; //transfer memory ownership
 	chd_phf->n = chd_ph->n;
 	chd_phf->nbuckets = chd_ph->nbuckets;
+	chd_phf->nbuckets_magic = chd_ph->nbuckets_magic;
+	chd_phf->n_magic = chd_ph->n_magic;
+	chd_phf->n1_magic = chd_ph->n1_magic;
 
 	mphf->data = chd_phf;
 	mphf->size = chd_ph->n;
+	cmph_stats_component(mph->stats, "displacements", compressed_seq_get_space_usage(chd_phf->cs));
+	cmph_stats_component(mph->stats, "hash", hash_state_packed_size(chd_ph->hashfunc)*8.0);
+	cmph_stats_parameter(mph->stats, "c", load_factor);
+	cmph_stats_parameter(mph->stats, "b", chd_ph->keys_per_bucket);
+	cmph_stats_parameter(mph->stats, "keys_per_bin", chd_ph->keys_per_bin);
+	cmph_stats_parameter(mph->stats, "n", chd_ph->n);
+	cmph_stats_parameter(mph->stats, "nbuckets", chd_ph->nbuckets);
 
 	DEBUGP("Successfully generated minimal perfect hash\n");
 	if (mph->verbosity)
@@ -866,6 +910,9 @@ void chd_ph_load(FILE *fd, cmph_t *mphf)
 	DEBUGP("Reading n and nbuckets\n");
 	nbytes = fread(&(chd_ph->n), sizeof(cmph_uint32), (size_t)1, fd);
 	nbytes = fread(&(chd_ph->nbuckets), sizeof(cmph_uint32), (size_t)1, fd);
+	chd_ph->nbuckets_magic = fastmod_magic(chd_ph->nbuckets);
+	chd_ph->n_magic = fastmod_magic(chd_ph->n);
+	chd_ph->n1_magic = fastmod_magic(chd_ph->n - 1);
 }
 
 int chd_ph_dump(cmph_t *mphf, FILE *fd)
@@ -914,14 +961,14 @@ cmph_uint32 chd_ph_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	register cmph_uint32 probe0_num,probe1_num;
 	register cmph_uint32 f,g,h;
 	hash_vector(chd_ph->hl, key, keylen, hl);
-	g = hl[0] % chd_ph->nbuckets;
-	f = hl[1] % chd_ph->n;
-	h = hl[2] % (chd_ph->n-1) + 1;
+	g = fastmod_mod(hl[0], chd_ph->nbuckets_magic, chd_ph->nbuckets);
+	f = fastmod_mod(hl[1], chd_ph->n_magic, chd_ph->n);
+	h = fastmod_mod(hl[2], chd_ph->n1_magic, chd_ph->n - 1) + 1;
 
 	disp = compressed_seq_query(chd_ph->cs, g);
-	probe0_num = disp % chd_ph->n;
-	probe1_num = disp/chd_ph->n;
-	position = (cmph_uint32)((f + ((cmph_uint64 )h)*probe0_num + probe1_num) % chd_ph->n);
+	probe1_num = fastmod_div(disp, chd_ph->n_magic, chd_ph->n);
+	probe0_num = disp - probe1_num * chd_ph->n;
+	position = fastmod_mod(f + ((cmph_uint64 )h)*probe0_num + probe1_num, chd_ph->n_magic, chd_ph->n);
 	return position;
 }
 
@@ -947,6 +994,15 @@ void chd_ph_pack(cmph_t *mphf, void *packed_mphf)
 	*((cmph_uint32 *) ptr) = data->nbuckets;
 	ptr += sizeof(data->nbuckets);
 
+	// packing the fastmod magic numbers for nbuckets, n and n - 1, which are
+	// only 4-byte aligned in the packed layout
+	memcpy(ptr, &data->nbuckets_magic, sizeof(data->nbuckets_magic));
+	ptr += sizeof(data->nbuckets_magic);
+	memcpy(ptr, &data->n_magic, sizeof(data->n_magic));
+	ptr += sizeof(data->n_magic);
+	memcpy(ptr, &data->n1_magic, sizeof(data->n1_magic));
+	ptr += sizeof(data->n1_magic);
+
 	// packing cs
 	compressed_seq_pack(data->cs, ptr);
 	//ptr += compressed_seq_packed_size(data->cs);
@@ -960,7 +1016,7 @@ cmph_uint32 chd_ph_packed_size(cmph_t *mphf)
 	register cmph_uint32 hash_state_pack_size =  hash_state_packed_size(hl_type);
 	register cmph_uint32 cs_pack_size = compressed_seq_packed_size(data->cs);
 
-	return (cmph_uint32)(sizeof(CMPH_ALGO) + hash_state_pack_size + cs_pack_size + 3*sizeof(cmph_uint32));
+	return (cmph_uint32)(sizeof(CMPH_ALGO) + hash_state_pack_size + cs_pack_size + 3*sizeof(cmph_uint32) + 3*sizeof(cmph_uint64));
 
 }
 
@@ -972,21 +1028,26 @@ cmph_uint32 chd_ph_search_packed(void *packed_mphf, const char *key, cmph_uint32
 	register cmph_uint32 * ptr = (cmph_uint32 *)(hl_ptr + hash_state_packed_size(hl_type));
 	register cmph_uint32 n = *ptr++;
 	register cmph_uint32 nbuckets = *ptr++;
+	cmph_uint64 nbuckets_magic, n_magic, n1_magic;
 	cmph_uint32 hl[3];
 
 	register cmph_uint32 disp,position;
 	register cmph_uint32 probe0_num,probe1_num;
 	register cmph_uint32 f,g,h;
 
+	memcpy(&nbuckets_magic, ptr, sizeof(nbuckets_magic));
+	memcpy(&n_magic, ptr + 2, sizeof(n_magic));
+	memcpy(&n1_magic, ptr + 4, sizeof(n1_magic));
 	hash_vector_packed(hl_ptr, hl_type, key, keylen, hl);
 
-	g = hl[0] % nbuckets;
-	f = hl[1] % n;
-	h = hl[2] % (n-1) + 1;
+	ptr += 6;
+	g = fastmod_mod(hl[0], nbuckets_magic, nbuckets);
+	f = fastmod_mod(hl[1], n_magic, n);
+	h = fastmod_mod(hl[2], n1_magic, n - 1) + 1;
 
 	disp = compressed_seq_query_packed(ptr, g);
-	probe0_num = disp % n;
-	probe1_num = disp/n;
-	position = (cmph_uint32)((f + ((cmph_uint64 )h)*probe0_num + probe1_num) % n);
+	probe1_num = fastmod_div(disp, n_magic, n);
+	probe0_num = disp - probe1_num * n;
+	position = fastmod_mod(f + ((cmph_uint64 )h)*probe0_num + probe1_num, n_magic, n);
 	return position;
 }
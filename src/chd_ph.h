@@ -23,6 +23,13 @@ void chd_ph_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin
  *  \param keys_per_bucket value for the number of keys per bucket 
  */
 void chd_ph_config_set_b(cmph_config_t *mph, cmph_uint32 keys_per_bucket);
+
+/** \fn void chd_ph_config_set_use_primes(cmph_config_t *mph, cmph_uint32 use_primes);
+ *  \brief Allows to turn off the rounding of the number of bins to a prime.
+ *  \param mph pointer to the configuration structure
+ *  \param use_primes zero to keep the number of bins as given by the load factor
+ */
+void chd_ph_config_set_use_primes(cmph_config_t *mph, cmph_uint32 use_primes);
 void chd_ph_config_destroy(cmph_config_t *mph);
 
 
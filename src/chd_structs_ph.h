@@ -10,6 +10,9 @@ struct __chd_ph_data_t
 	cmph_uint32 nbuckets;	// number of buckets
 	cmph_uint32 n;		// number of bins
 	hash_state_t *hl;	// linear hash function
+	cmph_uint64 nbuckets_magic;	// fastmod magic numbers for nbuckets, n and n - 1
+	cmph_uint64 n_magic;
+	cmph_uint64 n1_magic;
 };
 
 struct __chd_ph_config_data_t
@@ -22,6 +25,10 @@ struct __chd_ph_config_data_t
 	
 	cmph_uint32 m;		// number of keys
 	cmph_uint8 use_h;	// flag to indicate the of use of a heuristic (use_h = 1)
+	cmph_uint8 use_primes;	// flag to round the number of bins up to a prime (use_primes = 1)
+	cmph_uint64 nbuckets_magic;	// fastmod magic numbers for nbuckets, n and n - 1
+	cmph_uint64 n_magic;
+	cmph_uint64 n1_magic;
 	cmph_uint32 keys_per_bin;//maximum number of keys per bin 
 	cmph_uint32 keys_per_bucket; // average number of keys per bucket
 	cmph_uint8 *occup_table;     // table that indicates occupied positions	
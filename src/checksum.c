@@ -0,0 +1,177 @@
+#include "checksum.h"
+
+#include <string.h>
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+//#define DEBUG
+#include "debug.h"
+
+#define CRC32C_POLY 0x82f63b78U   // reflected Castagnoli polynomial
+
+/* Tables of the slicing-by-8 CRC: crc32c_table[k][b] is the CRC of the byte
+ * b followed by k zero bytes. They are built on the first call, once even
+ * when blobs are written by several threads.
+ */
+static cmph_uint32 crc32c_table[8][256];
+#ifdef HAVE_PTHREAD_H
+static pthread_once_t crc32c_table_once = PTHREAD_ONCE_INIT;
+#else
+static int crc32c_table_ready = 0;
+#endif
+
+static void crc32c_init(void)
+{
+	register cmph_uint32 i, j, crc;
+	for (i = 0; i < 256; ++i)
+	{
+		crc = i;
+		for (j = 0; j < 8; ++j) crc = (crc >> 1) ^ (CRC32C_POLY & (0U - (crc & 1U)));
+		crc32c_table[0][i] = crc;
+	}
+	for (i = 0; i < 256; ++i)
+	{
+		crc = crc32c_table[0][i];
+		for (j = 1; j < 8; ++j)
+		{
+			crc = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+			crc32c_table[j][i] = crc;
+		}
+	}
+#ifndef HAVE_PTHREAD_H
+	crc32c_table_ready = 1;
+#endif
+}
+
+cmph_uint32 crc32c(cmph_uint32 crc, const void *buf, size_t len)
+{
+	register const cmph_uint8 *p = (const cmph_uint8 *)buf;
+	crc = ~crc;
+#ifdef __SSE4_2__
+	while (len >= 8)
+	{
+		cmph_uint64 word;
+		memcpy(&word, p, sizeof(word));
+		crc = (cmph_uint32)_mm_crc32_u64(crc, word);
+		p += 8;
+		len -= 8;
+	}
+	while (len--) crc = _mm_crc32_u8(crc, *p++);
+#else
+#ifdef HAVE_PTHREAD_H
+	pthread_once(&crc32c_table_once, crc32c_init);
+#else
+	if (!crc32c_table_ready) crc32c_init();
+#endif
+	while (len >= 8)
+	{
+		register cmph_uint32 lo = crc ^ ((cmph_uint32)p[0] | ((cmph_uint32)p[1] << 8) | ((cmph_uint32)p[2] << 16) | ((cmph_uint32)p[3] << 24));
+		crc = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff] ^
+		      crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24] ^
+		      crc32c_table[3][p[4]] ^ crc32c_table[2][p[5]] ^
+		      crc32c_table[1][p[6]] ^ crc32c_table[0][p[7]];
+		p += 8;
+		len -= 8;
+	}
+	while (len--) crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+#endif
+	return ~crc;
+}
+
+#define XXH_PRIME64_1 11400714785074694791ULL
+#define XXH_PRIME64_2 14029467366897019727ULL
+#define XXH_PRIME64_3 1609587929392839161ULL
+#define XXH_PRIME64_4 9650029242287828579ULL
+#define XXH_PRIME64_5 2870177450012600261ULL
+
+static inline cmph_uint64 xxh_rotl(cmph_uint64 x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline cmph_uint64 xxh_read64(const cmph_uint8 *p)
+{
+	return (cmph_uint64)p[0] | ((cmph_uint64)p[1] << 8) | ((cmph_uint64)p[2] << 16) | ((cmph_uint64)p[3] << 24) |
+	       ((cmph_uint64)p[4] << 32) | ((cmph_uint64)p[5] << 40) | ((cmph_uint64)p[6] << 48) | ((cmph_uint64)p[7] << 56);
+}
+
+static inline cmph_uint64 xxh_read32(const cmph_uint8 *p)
+{
+	return (cmph_uint64)p[0] | ((cmph_uint64)p[1] << 8) | ((cmph_uint64)p[2] << 16) | ((cmph_uint64)p[3] << 24);
+}
+
+static inline cmph_uint64 xxh_round(cmph_uint64 acc, cmph_uint64 input)
+{
+	acc += input * XXH_PRIME64_2;
+	acc = xxh_rotl(acc, 31);
+	return acc * XXH_PRIME64_1;
+}
+
+static inline cmph_uint64 xxh_merge(cmph_uint64 acc, cmph_uint64 val)
+{
+	acc ^= xxh_round(0, val);
+	return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+cmph_uint64 xxh64(const void *buf, size_t len, cmph_uint64 seed)
+{
+	register const cmph_uint8 *p = (const cmph_uint8 *)buf;
+	const cmph_uint8 *end = p + len;
+	register cmph_uint64 h;
+
+	if (len >= 32)
+	{
+		const cmph_uint8 *limit = end - 32;
+		cmph_uint64 v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+		cmph_uint64 v2 = seed + XXH_PRIME64_2;
+		cmph_uint64 v3 = seed;
+		cmph_uint64 v4 = seed - XXH_PRIME64_1;
+		do
+		{
+			v1 = xxh_round(v1, xxh_read64(p));
+			v2 = xxh_round(v2, xxh_read64(p + 8));
+			v3 = xxh_round(v3, xxh_read64(p + 16));
+			v4 = xxh_round(v4, xxh_read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+		h = xxh_rotl(v1, 1) + xxh_rotl(v2, 7) + xxh_rotl(v3, 12) + xxh_rotl(v4, 18);
+		h = xxh_merge(h, v1);
+		h = xxh_merge(h, v2);
+		h = xxh_merge(h, v3);
+		h = xxh_merge(h, v4);
+	}
+	else h = seed + XXH_PRIME64_5;
+	h += (cmph_uint64)len;
+
+	while (p + 8 <= end)
+	{
+		h ^= xxh_round(0, xxh_read64(p));
+		h = xxh_rotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+		p += 8;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= xxh_read32(p) * XXH_PRIME64_1;
+		h = xxh_rotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		p += 4;
+	}
+	while (p < end)
+	{
+		h ^= (*p++) * XXH_PRIME64_5;
+		h = xxh_rotl(h, 11) * XXH_PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
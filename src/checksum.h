@@ -0,0 +1,24 @@
+#ifndef __CMPH_CHECKSUM_H__
+#define __CMPH_CHECKSUM_H__
+
+#include "cmph_types.h"
+#include <stddef.h>
+
+/* Checksums of the sections of the files written by cmph_blob_dump(). Both
+ * are the standard functions, so sections can be verified with other tools:
+ * CRC32C is the Castagnoli CRC of iSCSI and ext4 and XXH64 is xxHash64.
+ */
+
+/** \fn cmph_uint32 crc32c(cmph_uint32 crc, const void *buf, size_t len);
+ *  \brief Extends a CRC32C with len bytes of buf.
+ *  \param crc CRC32C of the previous bytes, 0 for the first call
+ *  \return the CRC32C of the previous bytes followed by buf
+ */
+cmph_uint32 crc32c(cmph_uint32 crc, const void *buf, size_t len);
+
+/** \fn cmph_uint64 xxh64(const void *buf, size_t len, cmph_uint64 seed);
+ *  \brief Computes the xxHash64 of len bytes of buf.
+ */
+cmph_uint64 xxh64(const void *buf, size_t len, cmph_uint64 seed);
+
+#endif
@@ -58,6 +58,7 @@ cmph_t *chm_new(cmph_config_t *mph, double c)
 	cmph_uint32 i;
 	cmph_uint32 iterations = 20;
 	cmph_uint8 *visited = NULL;
+	cmph_stats_mark_t mark;
 	chm_config_data_t *chm = (chm_config_data_t *)mph->data;
 	chm->m = mph->key_source->nkeys;
 	if (c == 0) c = 2.09;
@@ -79,6 +80,7 @@ cmph_t *chm_new(cmph_config_t *mph, double c)
 		chm->hashes[0] = hash_state_new(chm->hashfuncs[0], chm->n);
 		chm->hashes[1] = hash_state_new(chm->hashfuncs[1], chm->n);
 		ok = chm_gen_edges(mph);
+		cmph_stats_iteration(mph->stats, ok);
 		if (!ok)
 		{
 			--iterations;
@@ -107,6 +109,7 @@ cmph_t *chm_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "Starting assignment step\n");
 	}
 	DEBUGP("Assignment step\n");
+	cmph_stats_begin(mph->stats, &mark);
  	visited = (cmph_uint8 *)malloc((size_t)(chm->n/8 + 1));
 	memset(visited, 0, (size_t)(chm->n/8 + 1));
 	free(chm->g);
@@ -123,18 +126,25 @@ cmph_t *chm_new(cmph_config_t *mph, double c)
 	graph_destroy(chm->graph);
 	free(visited);
 	chm->graph = NULL;
+	cmph_stats_end(mph->stats, CMPH_PHASE_ASSIGNING, &mark);
 
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
 	chmf = (chm_data_t *)malloc(sizeof(chm_data_t));
-	chmf->g = chm->g;
-	chm->g = NULL; //transfer memory ownership
+	chmf->g_bits = packed_table_width(chm->m - 1);
+	chmf->g = packed_table_new(chm->g, chm->n, chmf->g_bits);
+	free(chm->g);
+	chm->g = NULL;
 	chmf->hashes = chm->hashes;
 	chm->hashes = NULL; //transfer memory ownership
 	chmf->n = chm->n;
 	chmf->m = chm->m;
 	mphf->data = chmf;
 	mphf->size = chm->m;
+	cmph_stats_component(mph->stats, "g", (double)chmf->n * chmf->g_bits);
+	cmph_stats_component(mph->stats, "hash", (hash_state_packed_size(chm->hashfuncs[0]) + hash_state_packed_size(chm->hashfuncs[1]))*8.0);
+	cmph_stats_parameter(mph->stats, "c", c);
+	cmph_stats_parameter(mph->stats, "n", chm->n);
 	DEBUGP("Successfully generated minimal perfect hash\n");
 	if (mph->verbosity)
 	{
@@ -146,19 +156,20 @@ cmph_t *chm_new(cmph_config_t *mph, double c)
 static void chm_traverse(chm_config_data_t *chm, cmph_uint8 *visited, cmph_uint32 v)
 {
 
-	graph_iterator_t it = graph_neighbors_it(chm->graph, v);
-	cmph_uint32 neighbor = 0;
+	const cmph_uint32 *neighbors, *edge_ids;
+	cmph_uint32 degree = graph_adjacency(chm->graph, v, &neighbors, &edge_ids);
+	cmph_uint32 i, neighbor = 0;
 	SETBIT(visited,v);
 
 	DEBUGP("Visiting vertex %u\n", v);
-	while((neighbor = graph_next_neighbor(chm->graph, &it)) != GRAPH_NO_NEIGHBOR)
+	for (i = 0; i < degree; i++)
 	{
+		neighbor = neighbors[i];
 		DEBUGP("Visiting neighbor %u\n", neighbor);
 		if(GETBIT(visited,neighbor)) continue;
-		DEBUGP("Visiting neighbor %u\n", neighbor);
-		DEBUGP("Visiting edge %u->%u with id %u\n", v, neighbor, graph_edge_id(chm->graph, v, neighbor));
-		chm->g[neighbor] = graph_edge_id(chm->graph, v, neighbor) - chm->g[v];
-		DEBUGP("g is %u (%u - %u mod %u)\n", chm->g[neighbor], graph_edge_id(chm->graph, v, neighbor), chm->g[v], chm->m);
+		DEBUGP("Visiting edge %u->%u with id %u\n", v, neighbor, edge_ids[i]);
+		chm->g[neighbor] = edge_ids[i] - chm->g[v];
+		DEBUGP("g is %u (%u - %u mod %u)\n", chm->g[neighbor], edge_ids[i], chm->g[v], chm->m);
 		chm_traverse(chm, visited, neighbor);
 	}
 }
@@ -168,8 +179,10 @@ static int chm_gen_edges(cmph_config_t *mph)
 	cmph_uint32 e;
 	chm_config_data_t *chm = (chm_config_data_t *)mph->data;
 	int cycles = 0;
+	cmph_stats_mark_t mark;
 
 	DEBUGP("Generating edges for %u vertices with hash functions %s and %s\n", chm->n, cmph_hash_names[chm->hashfuncs[0]], cmph_hash_names[chm->hashfuncs[1]]);
+	cmph_stats_begin(mph->stats, &mark);
 	graph_clear_edges(chm->graph);
 	mph->key_source->rewind(mph->key_source->data);
 	for (e = 0; e < mph->key_source->nkeys; ++e)
@@ -185,13 +198,17 @@ static int chm_gen_edges(cmph_config_t *mph)
 		{
 			if (mph->verbosity) fprintf(stderr, "Self loop for key %u\n", e);
 			mph->key_source->dispose(mph->key_source->data, key, keylen);
+			cmph_stats_end(mph->stats, CMPH_PHASE_MAPPING, &mark);
 			return 0;
 		}
 		DEBUGP("Adding edge: %u -> %u for key %s\n", h1, h2, key);
 		mph->key_source->dispose(mph->key_source->data, key, keylen);
 		graph_add_edge(chm->graph, h1, h2);
 	}
+	cmph_stats_end(mph->stats, CMPH_PHASE_MAPPING, &mark);
+	cmph_stats_begin(mph->stats, &mark);
 	cycles = graph_is_cyclic(chm->graph);
+	cmph_stats_end(mph->stats, CMPH_PHASE_SEARCHING, &mark);
 	if (mph->verbosity && cycles) fprintf(stderr, "Cyclic graph generated\n");
 	DEBUGP("Looking for cycles: %u\n", cycles);
 
@@ -224,10 +241,11 @@ int chm_dump(cmph_t *mphf, FILE *fd)
 	nbytes = fwrite(&(data->n), sizeof(cmph_uint32), (size_t)1, fd);
 	nbytes = fwrite(&(data->m), sizeof(cmph_uint32), (size_t)1, fd);
 
-	nbytes = fwrite(data->g, sizeof(cmph_uint32)*data->n, (size_t)1, fd);
+	nbytes = fwrite(&(data->g_bits), sizeof(cmph_uint32), (size_t)1, fd);
+	nbytes = fwrite(data->g, sizeof(cmph_uint32)*PACKED_TABLE_SIZE(data->n, data->g_bits), (size_t)1, fd);
 /*	#ifdef DEBUG
 	fprintf(stderr, "G: ");
-	for (i = 0; i < data->n; ++i) fprintf(stderr, "%u ", data->g[i]);
+	for (i = 0; i < data->n; ++i) fprintf(stderr, "%u ", get_packed_value(data->g, i, data->g_bits));
 	fprintf(stderr, "\n");
 	#endif*/
 	return 1;
@@ -263,11 +281,12 @@ void chm_load(FILE *f, cmph_t *mphf)
 	nbytes = fread(&(chm->n), sizeof(cmph_uint32), (size_t)1, f);
 	nbytes = fread(&(chm->m), sizeof(cmph_uint32), (size_t)1, f);
 
-	chm->g = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*chm->n);
-	nbytes = fread(chm->g, chm->n*sizeof(cmph_uint32), (size_t)1, f);
+	nbytes = fread(&(chm->g_bits), sizeof(cmph_uint32), (size_t)1, f);
+	chm->g = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*PACKED_TABLE_SIZE(chm->n, chm->g_bits));
+	nbytes = fread(chm->g, sizeof(cmph_uint32)*PACKED_TABLE_SIZE(chm->n, chm->g_bits), (size_t)1, f);
 	#ifdef DEBUG
 	fprintf(stderr, "G: ");
-	for (i = 0; i < chm->n; ++i) fprintf(stderr, "%u ", chm->g[i]);
+	for (i = 0; i < chm->n; ++i) fprintf(stderr, "%u ", get_packed_value(chm->g, i, chm->g_bits));
 	fprintf(stderr, "\n");
 	#endif
 	return;
@@ -279,10 +298,18 @@ cmph_uint32 chm_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	chm_data_t *chm = (chm_data_t *)mphf->data;
 	cmph_uint32 h1 = hash(chm->hashes[0], key, keylen) % chm->n;
 	cmph_uint32 h2 = hash(chm->hashes[1], key, keylen) % chm->n;
+	cmph_uint32 g1, g2;
 	DEBUGP("key: %s h1: %u h2: %u\n", key, h1, h2);
 	if (h1 == h2 && ++h2 >= chm->n) h2 = 0;
-	DEBUGP("key: %s g[h1]: %u g[h2]: %u edges: %u\n", key, chm->g[h1], chm->g[h2], chm->m);
-	return (chm->g[h1] + chm->g[h2]) % chm->m;
+	g1 = get_packed_value(chm->g, h1, chm->g_bits);
+	g2 = get_packed_value(chm->g, h2, chm->g_bits);
+	DEBUGP("key: %s g[h1]: %u g[h2]: %u edges: %u\n", key, g1, g2, chm->m);
+	// g[h1] + g[h2] wraps around to the id of the edge, which is below m, so
+	// the low g_bits bits of the values are enough to recover it. The masked
+	// sum of a key out of the set is below 2^g_bits <= 2(m - 1), and is
+	// reduced into [0, m) as well.
+	g1 = (g1 + g2) & (cmph_uint32)((((cmph_uint64)1) << chm->g_bits) - 1);
+	return g1 >= chm->m ? g1 - chm->m : g1;
 }
 void chm_destroy(cmph_t *mphf)
 {
@@ -331,8 +358,12 @@ void chm_pack(cmph_t *mphf, void *packed_mphf)
 	*((cmph_uint32 *) ptr) = data->m;
 	ptr += sizeof(data->m);
 
+	// packing g width
+	*((cmph_uint32 *) ptr) = data->g_bits;
+	ptr += sizeof(data->g_bits);
+
 	// packing g
-	memcpy(ptr, data->g, sizeof(cmph_uint32)*data->n);
+	memcpy(ptr, data->g, sizeof(cmph_uint32)*PACKED_TABLE_SIZE(data->n, data->g_bits));
 }
 
 /** \fn cmph_uint32 chm_packed_size(cmph_t *mphf);
@@ -347,7 +378,7 @@ cmph_uint32 chm_packed_size(cmph_t *mphf)
 	CMPH_HASH h2_type = hash_get_type(data->hashes[1]);
 
 	return (cmph_uint32)(sizeof(CMPH_ALGO) + hash_state_packed_size(h1_type) + hash_state_packed_size(h2_type) +
-			4*sizeof(cmph_uint32) + sizeof(cmph_uint32)*data->n);
+			5*sizeof(cmph_uint32) + sizeof(cmph_uint32)*PACKED_TABLE_SIZE(data->n, data->g_bits));
 }
 
 /** cmph_uint32 chm_search(void *packed_mphf, const char *key, cmph_uint32 keylen);
@@ -369,13 +400,19 @@ cmph_uint32 chm_search_packed(void *packed_mphf, const char *key, cmph_uint32 ke
 
 	register cmph_uint32 *g_ptr = (cmph_uint32 *)(h2_ptr + hash_state_packed_size(h2_type));
 
-	register cmph_uint32 n = *g_ptr++;
-	register cmph_uint32 m = *g_ptr++;
+	register cmph_uint32 n = g_ptr[0];
+	register cmph_uint32 m = g_ptr[1];
+	register cmph_uint32 g_bits = g_ptr[2];
+	g_ptr += 3;
 
 	register cmph_uint32 h1 = hash_packed(h1_ptr, h1_type, key, keylen) % n;
 	register cmph_uint32 h2 = hash_packed(h2_ptr, h2_type, key, keylen) % n;
+	register cmph_uint32 g1, g2;
 	DEBUGP("key: %s h1: %u h2: %u\n", key, h1, h2);
 	if (h1 == h2 && ++h2 >= n) h2 = 0;
-	DEBUGP("key: %s g[h1]: %u g[h2]: %u edges: %u\n", key, g_ptr[h1], g_ptr[h2], m);
-	return (g_ptr[h1] + g_ptr[h2]) % m;
+	g1 = get_packed_value(g_ptr, h1, g_bits);
+	g2 = get_packed_value(g_ptr, h2, g_bits);
+	DEBUGP("key: %s g[h1]: %u g[h2]: %u\n", key, g1, g2);
+	g1 = (g1 + g2) & (cmph_uint32)((((cmph_uint64)1) << g_bits) - 1);
+	return g1 >= m ? g1 - m : g1;
 }
@@ -384,6 +384,14 @@ void cmph_config_set_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir)
 	}
 }
 
+void cmph_config_add_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir)
+{
+	if (mph->algo == CMPH_BRZ)
+	{
+		brz_config_add_tmp_dir(mph, tmp_dir);
+	}
+}
+
 
 void cmph_config_set_mphf_fd(cmph_config_t *mph, FILE *mphf_fd)
 {
@@ -433,6 +441,30 @@ void cmph_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_
 	}
 }
 
+void cmph_config_set_tmp_compression(cmph_config_t *mph, cmph_uint32 compress)
+{
+	if (mph->algo == CMPH_BRZ)
+	{
+		brz_config_set_compress_runs(mph, compress != 0);
+	}
+}
+
+void cmph_config_set_resume(cmph_config_t *mph, cmph_uint32 resume)
+{
+	if (mph->algo == CMPH_BRZ)
+	{
+		brz_config_set_resume(mph, resume != 0);
+	}
+}
+
+void cmph_config_set_brz_algo(cmph_config_t *mph, CMPH_ALGO algo)
+{
+	if (mph->algo == CMPH_BRZ)
+	{
+		brz_config_set_algo(mph, algo);
+	}
+}
+
 void cmph_config_destroy(cmph_config_t *mph)
 {
 	if(mph)
@@ -479,6 +511,11 @@ void cmph_config_set_verbosity(cmph_config_t *mph, cmph_uint32 verbosity)
 	mph->verbosity = verbosity;
 }
 
+void cmph_config_set_nthreads(cmph_config_t *mph, cmph_uint32 nthreads)
+{
+	mph->nthreads = nthreads > 0 ? nthreads : 1;
+}
+
 void cmph_config_set_hashfuncs(cmph_config_t *mph, CMPH_HASH *hashfuncs)
 {
 	switch (mph->algo)
@@ -525,8 +562,16 @@ cmph_t *cmph_new(cmph_config_t *mph)
 {
 	cmph_t *mphf = NULL;
 	double c = mph->c;
+	cmph_stats_mark_t mark;
 
 	DEBUGP("Creating mph with algorithm %s\n", cmph_names[mph->algo]);
+	if (mph->stats)
+	{
+		cmph_stats_clear(mph->stats);
+		mph->stats->algo = mph->algo;
+		mph->stats->nkeys = mph->key_source->nkeys;
+	}
+	cmph_stats_begin(mph->stats, &mark);
 	switch (mph->algo)
 	{
 		case CMPH_CHM:
@@ -543,8 +588,6 @@ cmph_t *cmph_new(cmph_config_t *mph)
 			break;
 		case CMPH_BRZ: /* included -- Fabiano */
 			DEBUGP("Creating brz hash\n");
-			if (c >= 2.0) brz_config_set_algo(mph, CMPH_FCH);
-			else brz_config_set_algo(mph, CMPH_BMZ8);
 			mphf = brz_new(mph, c);
 			break;
 		case CMPH_FCH: /* included -- Fabiano */
@@ -570,6 +613,7 @@ cmph_t *cmph_new(cmph_config_t *mph)
 		default:
 			assert(0);
 	}
+	__cmph_stats_finish(mph->stats, &mark);
 	return mphf;
 }
 
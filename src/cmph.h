@@ -52,10 +52,50 @@ void cmph_config_set_verbosity(cmph_config_t *mph, cmph_uint32 verbosity);
 void cmph_config_set_graphsize(cmph_config_t *mph, double c);
 void cmph_config_set_algo(cmph_config_t *mph, CMPH_ALGO algo);
 void cmph_config_set_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir);
+/** \fn void cmph_config_add_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir);
+ *  \brief Adds a temporary directory to the one given to cmph_config_set_tmp_dir().
+ *  The temporary files of BRZ are striped across them. Other algorithms ignore it.
+ */
+void cmph_config_add_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir);
 void cmph_config_set_mphf_fd(cmph_config_t *mph, FILE *mphf_fd);
 void cmph_config_set_b(cmph_config_t *mph, cmph_uint32 b);
 void cmph_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin);
 void cmph_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_availability);
+
+/** \fn void cmph_config_set_tmp_compression(cmph_config_t *mph, cmph_uint32 compress);
+ *  \brief Sets whether the temporary files of the BRZ algorithm are compressed.
+ *  \param mph pointer to the configuration structure
+ *  \param compress 0 writes the keys verbatim (the default), other values
+ *  \param compress them. Other algorithms ignore it.
+ */
+void cmph_config_set_tmp_compression(cmph_config_t *mph, cmph_uint32 compress);
+
+/** \fn void cmph_config_set_resume(cmph_config_t *mph, cmph_uint32 resume);
+ *  \brief Sets whether an interrupted BRZ build is continued from the journal it
+ *  keeps in the temporary directory.
+ *  \param mph pointer to the configuration structure, already set to CMPH_BRZ
+ *  \param resume other than 0 to resume. The keys, the parameters and the
+ *  \param temporary directory must be the same as in the interrupted build and
+ *  \param the file given to cmph_config_set_mphf_fd() must be the partial
+ *  \param output, opened for update ("r+b"). Other algorithms ignore it.
+ */
+void cmph_config_set_resume(cmph_config_t *mph, cmph_uint32 resume);
+
+/** \fn void cmph_config_set_brz_algo(cmph_config_t *mph, CMPH_ALGO algo);
+ *  \brief Sets the algorithm used to build the function of each bucket of BRZ.
+ *  \param mph pointer to the configuration structure, already set to CMPH_BRZ
+ *  \param algo CMPH_BMZ8, CMPH_FCH, CMPH_BDZ or CMPH_CHD. By default FCH is
+ *  \param used when c >= 2.0 and BMZ8 otherwise. Other algorithms ignore it.
+ */
+void cmph_config_set_brz_algo(cmph_config_t *mph, CMPH_ALGO algo);
+
+/** \fn void cmph_config_set_nthreads(cmph_config_t *mph, cmph_uint32 nthreads);
+ *  \brief Sets the number of threads used to generate the function.
+ *  \param mph pointer to the configuration structure
+ *  \param nthreads number of threads. Algorithms without parallel construction
+ *  \param (currently all but BRZ) ignore it. Default is 1.
+ */
+void cmph_config_set_nthreads(cmph_config_t *mph, cmph_uint32 nthreads);
 void cmph_config_destroy(cmph_config_t *mph);
 
 /** Hash API **/
@@ -1,49 +1,60 @@
-// A simple benchmark tool around getrusage
+// A simple benchmark harness: each registered function is run a few times
+// to warm up, then timed over repeated runs, and the runs are summarized by
+// their median and 95th percentile in ns per iteration, with a confidence
+// interval of the median. Results can be written as JSON lines and compared
+// against a baseline written before, flagging the regressions.
 
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // for sched_setaffinity
+#endif
+#include <sched.h>
+#endif
 #include <assert.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/resource.h>
 
 #include "cmph_benchmark.h"
 
+#define BM_DEFAULT_WARMUP 1
+#define BM_DEFAULT_REPEATS 10
+#define BM_DEFAULT_THRESHOLD 5.0  // percent
+
 typedef struct {
   const char* name;
   void (*func)(int);
   int iters;
-  struct rusage begin;
-  struct rusage end;
+  double* samples;  // ns per iteration of each run
+  double* ticks;    // time stamp counter ticks per iteration of each run
+  double utime;     // CPU seconds of all runs
+  double stime;
 } benchmark_t;
 
-static benchmark_t* global_benchmarks = NULL;
-
-/* Subtract the `struct timeval' values X and Y,
-   storing the result in RESULT.
-   Return 1 if the difference is negative, otherwise 0.  */
-
-int timeval_subtract ( 
-    struct timeval *result, struct timeval *x, struct timeval* y) {
-  /* Perform the carry for the later subtraction by updating y. */
-  if (x->tv_usec < y->tv_usec) {
-    int nsec = (y->tv_usec - x->tv_usec) / 1000000 + 1;
-    y->tv_usec -= 1000000 * nsec;
-    y->tv_sec += nsec;
-  }
-  if (x->tv_usec - y->tv_usec > 1000000) {
-    int nsec = (x->tv_usec - y->tv_usec) / 1000000;
-    y->tv_usec += 1000000 * nsec;
-    y->tv_sec -= nsec;
-  }
+typedef struct {
+  int warmup;
+  int repeats;
+  int cpu;                 // -1 leaves the process unpinned
+  double threshold;        // percent of slowdown flagged as a regression
+  const char* json_file;
+  const char* baseline_file;
+  const char* filter;
+} bm_options_t;
 
-  /* Compute the time remaining to wait.
-     tv_usec is certainly positive. */
-  result->tv_sec = x->tv_sec - y->tv_sec;
-  result->tv_usec = x->tv_usec - y->tv_usec;
+typedef struct {
+  double median;
+  double p95;
+  double mean;
+  double stddev;
+  double ci_low;   // 95% confidence interval of the median
+  double ci_high;
+  double ticks;    // median, 0 without a time stamp counter
+} bm_summary_t;
 
-  /* Return 1 if result is negative. */
-  return x->tv_sec < y->tv_sec;
-}
+static benchmark_t* global_benchmarks = NULL;
 
 benchmark_t* find_benchmark(const char* name) {
   benchmark_t* benchmark = global_benchmarks;
@@ -66,6 +77,7 @@ int global_benchmarks_length() {
 void bm_register(const char* name, void (*func)(int), int iters) {
   benchmark_t benchmark;
   int length = global_benchmarks_length();
+  memset(&benchmark, 0, sizeof(benchmark_t));
   benchmark.name = name;
   benchmark.func = func;
   benchmark.iters = iters;
@@ -77,53 +89,280 @@ void bm_register(const char* name, void (*func)(int), int iters) {
   global_benchmarks[length + 1] = benchmark;
 }
 
-void bm_start(const char* name) {
-  benchmark_t* benchmark;
-  struct rusage rs;
+static double bm_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static double bm_ticks() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  return (double)__builtin_ia32_rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static double bm_seconds(const struct timeval* tv) {
+  return (double)tv->tv_sec + (double)tv->tv_usec / 1e6;
+}
+
+static int bm_double_cmp(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return x < y ? -1 : x > y;
+}
+
+// Value of 1-based rank of the sorted values, clamped to [1, n].
+static double bm_rank(const double* sorted, int n, double rank) {
+  int i = (int)rank;
+  if (i < 1) i = 1;
+  if (i > n) i = n;
+  return sorted[i - 1];
+}
+
+static void bm_summarize(const double* samples, const double* ticks, int n,
+                         bm_summary_t* summary) {
+  double* sorted = (double*)malloc(sizeof(double)*n);
+  double sum = 0, squares = 0;
+  int i;
+  memcpy(sorted, samples, sizeof(double)*n);
+  qsort(sorted, n, sizeof(double), bm_double_cmp);
+  for (i = 0; i < n; ++i) sum += sorted[i];
+  summary->mean = sum / n;
+  for (i = 0; i < n; ++i) {
+    squares += (sorted[i] - summary->mean) * (sorted[i] - summary->mean);
+  }
+  summary->stddev = n > 1 ? sqrt(squares / (n - 1)) : 0;
+  summary->median = n % 2 ? sorted[n / 2]
+                          : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+  summary->p95 = bm_rank(sorted, n, ceil(0.95 * n));
+  // Distribution free interval: the ranks n/2 -+ 1.96 sqrt(n)/2 of the runs
+  // bracket the median with 95% confidence. Fewer than 6 runs give the range.
+  if (n < 6) {
+    summary->ci_low = sorted[0];
+    summary->ci_high = sorted[n - 1];
+  } else {
+    summary->ci_low = bm_rank(sorted, n, floor(n / 2.0 - 0.98 * sqrt(n)));
+    summary->ci_high = bm_rank(sorted, n, ceil(1 + n / 2.0 + 0.98 * sqrt(n)));
+  }
+  memcpy(sorted, ticks, sizeof(double)*n);
+  qsort(sorted, n, sizeof(double), bm_double_cmp);
+  summary->ticks = sorted[n / 2];
+  free(sorted);
+}
 
-  benchmark = find_benchmark(name);
-  assert(benchmark);
-  int ret = getrusage(RUSAGE_SELF, &rs);  
-  if (ret != 0) {
-    perror("rusage failed");    
+static void bm_run(benchmark_t* benchmark, const bm_options_t* options) {
+  struct rusage begin, end;
+  int i;
+  for (i = 0; i < options->warmup; ++i) (*benchmark->func)(benchmark->iters);
+  free(benchmark->samples);
+  free(benchmark->ticks);
+  benchmark->samples = (double*)malloc(sizeof(double)*options->repeats);
+  benchmark->ticks = (double*)malloc(sizeof(double)*options->repeats);
+  if (getrusage(RUSAGE_SELF, &begin) != 0) {
+    perror("rusage failed");
+    exit(-1);
+  }
+  for (i = 0; i < options->repeats; ++i) {
+    double ns = bm_now_ns(), ticks = bm_ticks();
+    (*benchmark->func)(benchmark->iters);
+    ticks = bm_ticks() - ticks;
+    ns = bm_now_ns() - ns;
+    benchmark->samples[i] = ns / benchmark->iters;
+    benchmark->ticks[i] = ticks / benchmark->iters;
+  }
+  if (getrusage(RUSAGE_SELF, &end) != 0) {
+    perror("rusage failed");
     exit(-1);
   }
-  benchmark->begin = rs;
-  (*benchmark->func)(benchmark->iters);
+  benchmark->utime = bm_seconds(&end.ru_utime) - bm_seconds(&begin.ru_utime);
+  benchmark->stime = bm_seconds(&end.ru_stime) - bm_seconds(&begin.ru_stime);
 }
 
-void bm_end(const char* name) { 
-  benchmark_t* benchmark;
-  struct rusage rs;
+// Reads the median and the upper bound of its interval of name from a file
+// written with --json. Returns 0 if the benchmark is not there.
+static int bm_baseline(FILE* f, const char* name, double* median,
+                       double* ci_high) {
+  char line[4096];
+  char key[256];
+  int found = 0;
+  rewind(f);
+  snprintf(key, sizeof(key), "\"name\":\"%s\"", name);
+  while (!found && fgets(line, sizeof(line), f)) {
+    const char* p;
+    if (strstr(line, key) == NULL) continue;
+    p = strstr(line, "\"median_ns_per_op\":");
+    if (p == NULL) continue;
+    *median = strtod(p + strlen("\"median_ns_per_op\":"), NULL);
+    p = strstr(line, "\"ci_high_ns_per_op\":");
+    *ci_high = p ? strtod(p + strlen("\"ci_high_ns_per_op\":"), NULL) : *median;
+    found = 1;
+  }
+  return found;
+}
 
-  int ret = getrusage(RUSAGE_SELF, &rs);  
-  if (ret != 0) {
-    perror("rusage failed");    
-    exit(-1);
+static void bm_json(FILE* f, const benchmark_t* benchmark,
+                    const bm_options_t* options, const bm_summary_t* summary) {
+  int i;
+  fprintf(f, "{\"name\":\"%s\",\"iters\":%d,\"warmup\":%d,\"repeats\":%d,",
+          benchmark->name, benchmark->iters, options->warmup, options->repeats);
+  fprintf(f, "\"median_ns_per_op\":%.3f,\"p95_ns_per_op\":%.3f,"
+          "\"mean_ns_per_op\":%.3f,\"stddev_ns_per_op\":%.3f,"
+          "\"ci_low_ns_per_op\":%.3f,\"ci_high_ns_per_op\":%.3f,",
+          summary->median, summary->p95, summary->mean, summary->stddev,
+          summary->ci_low, summary->ci_high);
+  if (summary->ticks > 0) {
+    fprintf(f, "\"median_ticks_per_op\":%.3f,", summary->ticks);
+  }
+  fprintf(f, "\"user_seconds\":%.6f,\"system_seconds\":%.6f,\"samples_ns_per_op\":[",
+          benchmark->utime, benchmark->stime);
+  for (i = 0; i < options->repeats; ++i) {
+    fprintf(f, "%s%.3f", i ? "," : "", benchmark->samples[i]);
   }
+  fprintf(f, "]}\n");
+}
+
+static void bm_usage(const char* prg) {
+  fprintf(stderr, "usage: %s [--warmup=N] [--repeats=N] [--cpu=N] [--json=file]"
+          " [--baseline=file] [--threshold=percent] [--filter=substring]\n", prg);
+  fprintf(stderr, "  --warmup\t untimed runs of each benchmark (default %d)\n",
+          BM_DEFAULT_WARMUP);
+  fprintf(stderr, "  --repeats\t timed runs of each benchmark (default %d)\n",
+          BM_DEFAULT_REPEATS);
+  fprintf(stderr, "  --cpu\t\t pin the process to a CPU (Linux only)\n");
+  fprintf(stderr, "  --json\t write the results to the file as JSON lines\n");
+  fprintf(stderr, "  --baseline\t compare against the results written by --json"
+          " before\n");
+  fprintf(stderr, "  --threshold\t slowdown of the median flagged as a regression"
+          " when the confidence\n\t\t intervals do not overlap (default %.0f)\n",
+          BM_DEFAULT_THRESHOLD);
+  fprintf(stderr, "  --filter\t run the benchmarks whose name holds substring\n");
+}
 
-  benchmark = find_benchmark(name);
-  benchmark->end = rs;
+static int bm_parse_options(int argc, char** argv, bm_options_t* options) {
+  int i;
+  options->warmup = BM_DEFAULT_WARMUP;
+  options->repeats = BM_DEFAULT_REPEATS;
+  options->cpu = -1;
+  options->threshold = BM_DEFAULT_THRESHOLD;
+  options->json_file = NULL;
+  options->baseline_file = NULL;
+  options->filter = NULL;
+  for (i = 1; i < argc; ++i) {
+    const char* value = strchr(argv[i], '=');
+    char* end = NULL;
+    if (strncmp(argv[i], "--", 2) != 0 || value == NULL) return 0;
+    ++value;
+    if (strncmp(argv[i], "--warmup=", 9) == 0) {
+      options->warmup = (int)strtol(value, &end, 10);
+    } else if (strncmp(argv[i], "--repeats=", 10) == 0) {
+      options->repeats = (int)strtol(value, &end, 10);
+      if (options->repeats < 1) return 0;
+    } else if (strncmp(argv[i], "--cpu=", 6) == 0) {
+      options->cpu = (int)strtol(value, &end, 10);
+    } else if (strncmp(argv[i], "--threshold=", 12) == 0) {
+      options->threshold = strtod(value, &end);
+    } else if (strncmp(argv[i], "--json=", 7) == 0) {
+      options->json_file = value;
+    } else if (strncmp(argv[i], "--baseline=", 11) == 0) {
+      options->baseline_file = value;
+    } else if (strncmp(argv[i], "--filter=", 9) == 0) {
+      options->filter = value;
+    } else {
+      return 0;
+    }
+    if (end && (*end != 0 || end == value)) return 0;
+  }
+  return options->warmup >= 0;
+}
 
-  struct timeval utime;
-  timeval_subtract(&utime, &benchmark->end.ru_utime, &benchmark->begin.ru_utime);
-  struct timeval stime;
-  timeval_subtract(&stime, &benchmark->end.ru_stime, &benchmark->begin.ru_stime);
-  
-  printf("Benchmark: %s\n", benchmark->name);
-  printf("User time used  : %ld.%06ld\n",
-         utime.tv_sec, (long int)utime.tv_usec);
-  printf("System time used: %ld.%06ld\n",
-         stime.tv_sec, (long int)stime.tv_usec);
-  printf("\n");
+static void bm_pin(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    perror("Unable to pin the benchmarks");
+  }
+#else
+  fprintf(stderr, "Pinning to CPU %d is not supported, running unpinned\n", cpu);
+#endif
 }
- 
-void run_benchmarks(int argc, char** argv) {
+
+int run_benchmarks(int argc, char** argv) {
   benchmark_t* benchmark = global_benchmarks;
+  bm_options_t options;
+  FILE* json = NULL;
+  FILE* baseline = NULL;
+  int nregressions = 0;
+
+  if (!bm_parse_options(argc, argv, &options)) {
+    bm_usage(argv[0]);
+    return -1;
+  }
+  if (options.cpu >= 0) bm_pin(options.cpu);
+  if (options.baseline_file) {
+    // a missing baseline would let every benchmark pass
+    baseline = fopen(options.baseline_file, "r");
+    if (baseline == NULL) {
+      perror(options.baseline_file);
+      return -1;
+    }
+  }
+  if (options.json_file) {
+    json = fopen(options.json_file, "w");
+    if (json == NULL) {
+      perror(options.json_file);
+      if (baseline) fclose(baseline);
+      return -1;
+    }
+  }
+  printf("%-28s %10s %12s %12s %12s %25s %9s\n", "Benchmark", "iters",
+         "median ns/op", "p95 ns/op", "ticks/op", "95% CI of median", "vs base");
   while (benchmark && benchmark->name != NULL) {
-    bm_start(benchmark->name);
-    bm_end(benchmark->name);
+    bm_summary_t summary;
+    double base_median, base_ci_high;
+    int in_baseline = 0;
+    if (options.filter && !strstr(benchmark->name, options.filter)) {
+      ++benchmark;
+      continue;
+    }
+    bm_run(benchmark, &options);
+    bm_summarize(benchmark->samples, benchmark->ticks, options.repeats, &summary);
+    printf("%-28s %10d %12.2f %12.2f %12.2f     [%9.2f, %9.2f]", benchmark->name,
+           benchmark->iters, summary.median, summary.p95, summary.ticks,
+           summary.ci_low, summary.ci_high);
+    if (baseline) {
+      in_baseline = bm_baseline(baseline, benchmark->name, &base_median, &base_ci_high);
+      if (!in_baseline) printf(" %9s", "-");
+    }
+    if (in_baseline) {
+      double change = base_median > 0
+          ? (summary.median / base_median - 1) * 100 : 0;
+      printf(" %+8.1f%%", change);
+      // both the median and its interval have to move past the baseline
+      if (change > options.threshold && summary.ci_low > base_ci_high) {
+        printf(" REGRESSION");
+        ++nregressions;
+      }
+    }
+    printf("\n");
+    fflush(stdout);
+    if (baseline && !in_baseline) {
+      fprintf(stderr, "Warning: %s is not in the baseline %s\n", benchmark->name,
+              options.baseline_file);
+    }
+    if (json) bm_json(json, benchmark, &options, &summary);
     ++benchmark;
   }
+  if (baseline) fclose(baseline);
+  if (json && fclose(json) != 0) {
+    perror(options.json_file);
+    return -1;
+  }
+  if (nregressions) {
+    printf("%d benchmarks regressed by more than %.1f%%\n", nregressions,
+           options.threshold);
+  }
+  return nregressions;
 }
-
@@ -11,7 +11,13 @@ extern "C"
   
 #define BM_REGISTER(func, iters) bm_register(#func, func, iters)
 void bm_register(const char* name, void (*func)(int), int iters);
-void run_benchmarks(int argc, char** argv);
+// Runs the registered benchmarks with the options of argv, --warmup=N,
+// --repeats=N, --cpu=N, --json=file, --baseline=file, --threshold=percent
+// and --filter=substring. Returns the number of benchmarks that regressed
+// against the baseline, or -1 for invalid options and I/O failures, including
+// a baseline that can not be read. Benchmarks absent from the baseline are
+// reported on stderr.
+int run_benchmarks(int argc, char** argv);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,1199 @@
+#include "cmph_blob.h"
+#include "cmph_structs.h"
+#include "checksum.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <assert.h>
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_FCNTL_H) && defined(HAVE_UNISTD_H)
+#define CMPH_BLOB_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <dirent.h>
+#include <sys/syscall.h>
+#endif
+
+//#define DEBUG
+#include "debug.h"
+
+const char *cmph_checksum_names[] = { "crc32c", "xxh64", NULL };
+
+static const cmph_uint8 blob_magic[8] = { 0211, 'C', 'M', 'P', 'H', '\r', '\n', 032 };
+
+typedef struct
+{
+	cmph_uint8 magic[8];
+	cmph_uint32 version;
+	cmph_uint32 algo;
+	cmph_uint32 hashfunc;
+	cmph_uint32 flags;
+	cmph_uint32 size;
+	cmph_uint32 nsections;
+	cmph_uint64 file_size;
+	cmph_uint64 checksum;
+	cmph_uint32 capacity;               // sections each table of a container has room for
+	cmph_uint32 generation;             // of the table of a container
+	cmph_uint8 reserved[8];
+} cmph_blob_header_t;
+
+typedef struct
+{
+	cmph_uint32 type;
+	cmph_uint32 chunk_bits;
+	cmph_uint64 offset;
+	cmph_uint64 size;
+	cmph_uint64 checksum;
+} cmph_blob_section_t;
+
+struct __cmph_blob_t
+{
+	const cmph_uint8 *data;
+	size_t size;
+	void *mapping;                      // mmap()ed file, if any
+	size_t mapping_size;
+	void *buffer;                       // file read in memory, if it could not be mapped
+	cmph_uint8 *table;                  // copy of the header and of the section table
+	const cmph_blob_header_t *header;
+	const cmph_blob_section_t *sections;
+	cmph_uint8 *verified;               // whether the checksum of each section was verified
+	cmph_uint32 packed;                 // index of the packed section of a single function
+	cmph_uint32 directory;              // indexes of the directory and of its index in a container
+	cmph_uint32 index;
+	cmph_uint32 flags;
+	cmph_uint8 **replicas;              // copies of the blob, one for each NUMA node
+	cmph_uint32 nreplicas;
+	size_t replica_size;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_t mutex;              // guards the replicas made on demand
+#endif
+};
+
+/* The directory of a container is a cmph_blob_directory_t followed by an
+ * entry for each function and by the names. With an index, the entry of a
+ * function is at the position given by the index to its name.
+ */
+typedef struct
+{
+	cmph_uint32 nfunctions;
+	cmph_uint32 reserved;
+} cmph_blob_directory_t;
+
+typedef struct
+{
+	cmph_uint32 section;                // packed section of the function
+	cmph_uint32 size;                   // number of values of the function
+	cmph_uint32 name_offset;            // from the start of the directory
+	cmph_uint32 name_length;
+} cmph_blob_entry_t;
+
+/* A function added to a container. */
+typedef struct
+{
+	const char *name;
+	cmph_uint32 namelen;
+	cmph_uint32 size;
+	void *packed;
+	cmph_uint64 packed_size;
+	cmph_uint32 section;                // section of the function in the container it comes from
+} blob_function_t;
+
+#define BLOB_NO_SECTION UINT_MAX
+#define BLOB_CHUNK_BITS 20          // sections of more than 1 MB are checksummed by chunks of 1 MB
+#define BLOB_CONTAINER_CAPACITY(nsections) (2*(nsections) + 16)
+#define BLOB_HUGE_PAGE_SIZE (2U << 20)
+#define BLOB_ALIGN(x) (((x) + CMPH_BLOB_ALIGNMENT - 1) & ~(cmph_uint64)(CMPH_BLOB_ALIGNMENT - 1))
+#define BLOB_TABLE_SIZE(nsections) (sizeof(cmph_blob_header_t) + (cmph_uint64)(nsections) * sizeof(cmph_blob_section_t))
+#define BLOB_NTABLES(header) ((header)->version >= 3 && ((header)->flags & CMPH_BLOB_TABLES) ? 2 : 1)
+#define BLOB_TABLES_OFFSET(ntables) ((ntables) == 2 ? sizeof(cmph_blob_header_t) : 0)
+
+static cmph_uint64 blob_checksum(CMPH_CHECKSUM checksum, const void *buf, size_t len)
+{
+	switch (checksum)
+	{
+		case CMPH_CHECKSUM_CRC32C:
+			return crc32c(0, buf, len);
+		case CMPH_CHECKSUM_XXH64:
+			return xxh64(buf, len, 0);
+		default:
+			assert(0);
+	}
+	return 0;
+}
+
+/* Number of chunks of a section, 1 if it is checksummed whole. */
+static cmph_uint64 blob_nchunks(const cmph_blob_section_t *section)
+{
+	if (section->chunk_bits == 0) return 1;
+	return (section->size + ((cmph_uint64)1 << section->chunk_bits) - 1) >> section->chunk_bits;
+}
+
+/* Offset of the checksums of the chunks of a section, after its data. */
+#define BLOB_CHUNKS_OFFSET(section) BLOB_ALIGN((section)->offset + (section)->size)
+
+/* End of a section in the file, with its chunk checksums. */
+static cmph_uint64 blob_section_end(const cmph_blob_section_t *section)
+{
+	if (section->chunk_bits == 0) return section->offset + section->size;
+	return BLOB_CHUNKS_OFFSET(section) + blob_nchunks(section) * sizeof(cmph_uint64);
+}
+
+/* Checksums of the chunks of data, written to chunks. */
+static void blob_chunk_checksums(CMPH_CHECKSUM checksum, const cmph_uint8 *data, cmph_uint64 size, cmph_uint32 chunk_bits, cmph_uint64 *chunks)
+{
+	cmph_uint64 chunk_size = (cmph_uint64)1 << chunk_bits;
+	cmph_uint64 i, nchunks = (size + chunk_size - 1) >> chunk_bits;
+	for (i = 0; i < nchunks; ++i)
+	{
+		cmph_uint64 len = i + 1 < nchunks ? chunk_size : size - (i << chunk_bits);
+		chunks[i] = blob_checksum(checksum, data + (i << chunk_bits), (size_t)len);
+	}
+}
+
+/* Checksum of the header and of the section table, with the checksum field
+ * of the header zeroed.
+ */
+static cmph_uint64 blob_table_checksum(const cmph_uint8 *table, cmph_uint32 nsections)
+{
+	cmph_uint64 table_size = BLOB_TABLE_SIZE(nsections);
+	cmph_uint8 *copy = (cmph_uint8 *)malloc((size_t)table_size);
+	cmph_blob_header_t *header = (cmph_blob_header_t *)copy;
+	cmph_uint64 checksum;
+	memcpy(copy, table, (size_t)table_size);
+	header->checksum = 0;
+	checksum = blob_checksum((CMPH_CHECKSUM)(header->flags & 0xff), copy, (size_t)table_size);
+	free(copy);
+	return checksum;
+}
+
+/* Hash function of a packed function, for the header. */
+static CMPH_HASH blob_hashfunc(const cmph_uint8 *packed)
+{
+	const cmph_uint32 *ptr = (const cmph_uint32 *)packed;
+	cmph_uint32 packed_cr_size;
+	switch (ptr[0])
+	{
+		case CMPH_BRZ:
+			// the algorithm of the buckets comes first
+			return (CMPH_HASH)ptr[2];
+		case CMPH_CHD:
+			// the compressed rank comes first, then the CHD_PH function packed by cmph_pack()
+			memcpy(&packed_cr_size, packed + sizeof(cmph_uint32), sizeof(cmph_uint32));
+			ptr = (const cmph_uint32 *)(packed + 2*sizeof(cmph_uint32) + packed_cr_size + sizeof(cmph_uint32));
+			return (CMPH_HASH)ptr[1];
+		default:
+			return (CMPH_HASH)ptr[1];
+	}
+}
+
+/* Flushes f to the disk, so that the data written so far survives a crash
+ * of the system before what is written next.
+ */
+static int blob_sync(FILE *f)
+{
+	if (fflush(f) != 0) return 0;
+#ifdef HAVE_UNISTD_H
+	if (fsync(fileno(f)) != 0) return 0;
+#endif
+	return 1;
+}
+
+/* Writes the sections of a blob and its table, which has room for capacity
+ * sections. A section whose data is NULL is already in f, at the offset of its
+ * entry, and the other ones are written after end, the end of the data in f:
+ * 0 for a new blob, which is written sequentially. Otherwise the sections are
+ * written first and synced, and the table is written last. A container with
+ * CMPH_BLOB_TABLES has a header written with the new blob only, then two
+ * tables, and the table of generation g is the one at g % 2, so that the
+ * table in use is never overwritten. The fields of header that depend on
+ * the sections are filled.
+ */
+static int blob_write(FILE *f, cmph_blob_header_t *header, cmph_uint32 nsections, cmph_uint32 capacity, cmph_blob_section_t *entries, void **data, cmph_uint64 end)
+{
+	cmph_uint64 table_size = BLOB_ALIGN(BLOB_TABLE_SIZE(capacity));
+	cmph_uint8 *table = (cmph_uint8 *)calloc((size_t)table_size, (size_t)1);
+	static const cmph_uint8 padding[CMPH_BLOB_ALIGNMENT];
+	CMPH_CHECKSUM checksum = (CMPH_CHECKSUM)(header->flags & 0xff);
+	cmph_uint64 **chunks = (cmph_uint64 **)calloc((size_t)nsections + 1, sizeof(cmph_uint64 *));
+	cmph_uint32 ntables, slot;
+	cmph_uint64 tables_offset, offset;
+	register size_t nbytes = 1;
+	cmph_uint32 i;
+
+	assert(capacity >= nsections);
+	memcpy(header->magic, blob_magic, sizeof(blob_magic));
+	header->version = CMPH_BLOB_VERSION;
+	header->nsections = nsections;
+	header->capacity = capacity;
+	ntables = BLOB_NTABLES(header);
+	slot = header->generation % ntables;
+	tables_offset = BLOB_TABLES_OFFSET(ntables);
+	offset = tables_offset + ntables*table_size;
+	if (end > offset) offset = end;
+	header->file_size = offset;
+	for (i = 0; i < nsections; ++i)
+	{
+		if (data[i])
+		{
+			entries[i].offset = BLOB_ALIGN(offset);
+			entries[i].chunk_bits = 0;
+			if (entries[i].size > ((cmph_uint64)1 << BLOB_CHUNK_BITS))
+			{
+				// the checksum of the section is the one of the checksums of its chunks
+				entries[i].chunk_bits = BLOB_CHUNK_BITS;
+				chunks[i] = (cmph_uint64 *)malloc((size_t)blob_nchunks(entries + i) * sizeof(cmph_uint64));
+				blob_chunk_checksums(checksum, (const cmph_uint8 *)data[i], entries[i].size, BLOB_CHUNK_BITS, chunks[i]);
+				entries[i].checksum = blob_checksum(checksum, chunks[i], (size_t)blob_nchunks(entries + i) * sizeof(cmph_uint64));
+			}
+			else entries[i].checksum = blob_checksum(checksum, data[i], (size_t)entries[i].size);
+			offset = blob_section_end(entries + i);
+		}
+		if (blob_section_end(entries + i) > header->file_size) header->file_size = blob_section_end(entries + i);
+	}
+	header->checksum = 0;
+	memcpy(table, header, sizeof(cmph_blob_header_t));
+	memcpy(table + sizeof(cmph_blob_header_t), entries, sizeof(cmph_blob_section_t)*nsections);
+	header->checksum = blob_table_checksum(table, nsections);
+	memcpy(table, header, sizeof(cmph_blob_header_t));
+
+	if (end == 0)
+	{
+		if (tables_offset)
+		{
+			// the first header only locates the tables, and is not written again
+			cmph_blob_header_t first = *header;
+			first.size = 0;
+			first.nsections = 0;
+			first.file_size = 0;
+			first.generation = 0;
+			first.checksum = 0;
+			first.checksum = blob_table_checksum((const cmph_uint8 *)&first, 0);
+			nbytes &= fwrite(&first, sizeof(cmph_blob_header_t), (size_t)1, f);
+		}
+		for (i = 0; i < ntables; ++i)
+		{
+			if (i == slot) nbytes &= fwrite(table, (size_t)table_size, (size_t)1, f);
+			else
+			{
+				// an empty table is never valid, so the other one is used
+				cmph_uint8 *empty = (cmph_uint8 *)calloc((size_t)table_size, (size_t)1);
+				nbytes &= fwrite(empty, (size_t)table_size, (size_t)1, f);
+				free(empty);
+			}
+		}
+		offset = tables_offset + ntables*table_size;
+	}
+	for (i = 0; i < nsections; ++i)
+	{
+		if (data[i] == NULL) continue;
+		if (end == 0)
+		{
+			if (entries[i].offset > offset) nbytes &= fwrite(padding, (size_t)(entries[i].offset - offset), (size_t)1, f);
+		}
+		else if (fseek(f, (long)entries[i].offset, SEEK_SET) != 0) nbytes = 0;
+		if (entries[i].size) nbytes &= fwrite(data[i], (size_t)entries[i].size, (size_t)1, f);
+		offset = entries[i].offset + entries[i].size;
+		if (chunks[i] == NULL) continue;
+		if (BLOB_CHUNKS_OFFSET(entries + i) > offset) nbytes &= fwrite(padding, (size_t)(BLOB_CHUNKS_OFFSET(entries + i) - offset), (size_t)1, f);
+		nbytes &= fwrite(chunks[i], (size_t)blob_nchunks(entries + i) * sizeof(cmph_uint64), (size_t)1, f);
+		offset = blob_section_end(entries + i);
+	}
+	if (end != 0)
+	{
+		// the new sections are on disk before the table refers to them
+		if (!blob_sync(f) || fseek(f, (long)(tables_offset + slot*table_size), SEEK_SET) != 0) nbytes = 0;
+		nbytes &= fwrite(table, (size_t)table_size, (size_t)1, f);
+	}
+	for (i = 0; i < nsections; ++i) free(chunks[i]);
+	free(chunks);
+	free(table);
+	if (nbytes == 0 && ferror(f)) {
+		fprintf(stderr, "ERROR: %s\n", strerror(errno));
+		return 0;
+	}
+	return (int)nbytes;
+}
+
+int cmph_blob_dump(cmph_t *mphf, FILE *f, CMPH_CHECKSUM checksum)
+{
+	cmph_blob_header_t header;
+	cmph_blob_section_t entry;
+	cmph_uint32 packed_size = cmph_packed_size(mphf);
+	void *packed;
+	int ret;
+
+	if (packed_size == 0 || checksum >= CMPH_CHECKSUM_COUNT) return 0;
+	packed = calloc((size_t)packed_size, (size_t)1);
+	cmph_pack(mphf, packed);
+
+	memset(&header, 0, sizeof(header));
+	header.algo = mphf->algo;
+	header.hashfunc = blob_hashfunc((cmph_uint8 *)packed);
+	header.flags = checksum;
+	header.size = mphf->size;
+	memset(&entry, 0, sizeof(entry));
+	entry.type = CMPH_BLOB_SECTION_PACKED;
+	entry.size = packed_size;
+	ret = blob_write(f, &header, 1, 1, &entry, &packed, 0);
+	DEBUGP("Dumped %s blob of %u bytes\n", cmph_names[mphf->algo], packed_size);
+	free(packed);
+	return ret;
+}
+
+/* Verifies the checksums of the chunks of a section against the section
+ * table. The chunks themselves are verified by blob_verify_chunk().
+ */
+static int blob_verify_chunks(cmph_blob_t *blob, cmph_uint32 i)
+{
+	const cmph_blob_section_t *section = blob->sections + i;
+	CMPH_CHECKSUM checksum = (CMPH_CHECKSUM)(blob->header->flags & 0xff);
+	if (section->chunk_bits == 0) return 1;
+	return blob_checksum(checksum, blob->data + BLOB_CHUNKS_OFFSET(section), (size_t)blob_nchunks(section) * sizeof(cmph_uint64)) == section->checksum;
+}
+
+/* Verifies chunk j of section i, the whole section if it has no chunks. */
+static int blob_verify_chunk(cmph_blob_t *blob, cmph_uint32 i, cmph_uint64 j)
+{
+	const cmph_blob_section_t *section = blob->sections + i;
+	CMPH_CHECKSUM checksum = (CMPH_CHECKSUM)(blob->header->flags & 0xff);
+	cmph_uint64 expected, start, len;
+	if (section->chunk_bits == 0) return blob_checksum(checksum, blob->data + section->offset, (size_t)section->size) == section->checksum;
+	memcpy(&expected, blob->data + BLOB_CHUNKS_OFFSET(section) + j * sizeof(cmph_uint64), sizeof(cmph_uint64));
+	start = j << section->chunk_bits;
+	len = section->size - start < ((cmph_uint64)1 << section->chunk_bits) ? section->size - start : (cmph_uint64)1 << section->chunk_bits;
+	return blob_checksum(checksum, blob->data + section->offset + start, (size_t)len) == expected;
+}
+
+static int blob_verify_section(cmph_blob_t *blob, cmph_uint32 i)
+{
+	cmph_uint64 j, nchunks = blob_nchunks(blob->sections + i);
+	if (!blob_verify_chunks(blob, i)) return 0;
+	for (j = 0; j < nchunks; ++j)
+	{
+		if (!blob_verify_chunk(blob, i, j))
+		{
+			DEBUGP("Section %u of the blob is corrupted\n", i);
+			return 0;
+		}
+	}
+	blob->verified[i] = 1;
+	return 1;
+}
+
+/* A chunk to verify, or a whole section. */
+typedef struct
+{
+	cmph_uint32 section;
+	cmph_uint64 chunk;
+} blob_chunk_t;
+
+typedef struct
+{
+	cmph_blob_t *blob;
+	const blob_chunk_t *chunks;
+	cmph_uint8 *ok;          // result of each chunk
+	cmph_uint64 nchunks;
+	cmph_uint64 first;       // chunks first, first + step, ...
+	cmph_uint32 step;
+} blob_verifier_t;
+
+static void *blob_verifier_run(void *arg)
+{
+	blob_verifier_t *verifier = (blob_verifier_t *)arg;
+	cmph_uint64 i;
+	for (i = verifier->first; i < verifier->nchunks; i += verifier->step)
+	{
+		verifier->ok[i] = (cmph_uint8)blob_verify_chunk(verifier->blob, verifier->chunks[i].section, verifier->chunks[i].chunk);
+	}
+	return NULL;
+}
+
+/* The chunks of the sections not verified yet are spread over the threads,
+ * so that a single large function is verified in parallel as well.
+ */
+int cmph_blob_verify(cmph_blob_t *blob, cmph_uint32 nthreads)
+{
+	blob_verifier_t *verifiers;
+	blob_chunk_t *chunks;
+	cmph_uint8 *chunks_ok;
+	cmph_uint64 nchunks = 0, j, k;
+	cmph_uint32 i;
+	int ok = 1;
+	for (i = 0; i < blob->header->nsections; ++i)
+	{
+		if (blob->verified[i]) continue;
+		if (!blob_verify_chunks(blob, i))
+		{
+			DEBUGP("The chunks of section %u of the blob are corrupted\n", i);
+			ok = 0;
+			continue;
+		}
+		nchunks += blob_nchunks(blob->sections + i);
+	}
+	if (nchunks == 0) return ok;
+	chunks = (blob_chunk_t *)malloc((size_t)nchunks * sizeof(blob_chunk_t));
+	chunks_ok = (cmph_uint8 *)malloc((size_t)nchunks);
+	for (i = 0, k = 0; i < blob->header->nsections; ++i)
+	{
+		if (blob->verified[i] || !blob_verify_chunks(blob, i)) continue;
+		for (j = 0; j < blob_nchunks(blob->sections + i); ++j, ++k)
+		{
+			chunks[k].section = i;
+			chunks[k].chunk = j;
+		}
+	}
+	if (nthreads == 0) nthreads = 1;
+	if (nthreads > nchunks) nthreads = (cmph_uint32)nchunks;
+	verifiers = (blob_verifier_t *)malloc(sizeof(blob_verifier_t)*nthreads);
+	for (i = 0; i < nthreads; ++i)
+	{
+		verifiers[i].blob = blob;
+		verifiers[i].chunks = chunks;
+		verifiers[i].ok = chunks_ok;
+		verifiers[i].nchunks = nchunks;
+		verifiers[i].first = i;
+		verifiers[i].step = nthreads;
+	}
+#ifdef HAVE_PTHREAD_H
+	if (nthreads > 1)
+	{
+		pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t)*nthreads);
+		cmph_uint32 nstarted;
+		// the calling thread verifies the chunks of the first verifier
+		for (nstarted = 1; nstarted < nthreads; ++nstarted)
+		{
+			if (pthread_create(threads + nstarted, NULL, blob_verifier_run, verifiers + nstarted) != 0) break;
+		}
+		blob_verifier_run(verifiers);
+		for (i = 1; i < nstarted; ++i) pthread_join(threads[i], NULL);
+		// chunks of the verifiers that could not be started
+		for (i = nstarted; i < nthreads; ++i) blob_verifier_run(verifiers + i);
+		free(threads);
+	}
+	else blob_verifier_run(verifiers);
+#else
+	for (i = 0; i < nthreads; ++i) blob_verifier_run(verifiers + i);
+#endif
+	// a section is verified once all its chunks are
+	for (k = 0; k < nchunks; k = j)
+	{
+		cmph_uint8 section_ok = 1;
+		for (j = k; j < nchunks && chunks[j].section == chunks[k].section; ++j) section_ok &= chunks_ok[j];
+		if (section_ok) blob->verified[chunks[k].section] = 1;
+		else
+		{
+			DEBUGP("Section %u of the blob is corrupted\n", chunks[k].section);
+			ok = 0;
+		}
+	}
+	free(verifiers);
+	free(chunks);
+	free(chunks_ok);
+	return ok;
+}
+
+/* Number of NUMA nodes of the machine, 1 when it is unknown. */
+static cmph_uint32 blob_numa_nodes(void)
+{
+	cmph_uint32 nnodes = 1;
+#ifdef __linux__
+	DIR *dir = opendir("/sys/devices/system/node");
+	struct dirent *entry;
+	if (dir == NULL) return 1;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		unsigned int node;
+		if (sscanf(entry->d_name, "node%u", &node) == 1 && node + 1 > nnodes) nnodes = node + 1;
+	}
+	closedir(dir);
+#endif
+	return nnodes;
+}
+
+/* NUMA node of the CPU running the calling thread. */
+static cmph_uint32 blob_numa_node(void)
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+	unsigned int cpu, node;
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) return node;
+#endif
+	return 0;
+}
+
+/* Copies the blob into anonymous memory, on huge pages if requested. The
+ * pages are touched by the calling thread, so the default (first touch)
+ * policy of the kernel places them on its node.
+ */
+static cmph_uint8 *blob_replicate(cmph_blob_t *blob)
+{
+#ifdef CMPH_BLOB_MMAP
+	void *replica = MAP_FAILED;
+	if (blob->flags & CMPH_BLOB_HUGEPAGES)
+	{
+#ifdef MAP_HUGETLB
+		// explicit huge pages, when the administrator reserved them
+		replica = mmap(NULL, blob->replica_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+		if (replica == MAP_FAILED)
+		{
+			replica = mmap(NULL, blob->replica_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+			// transparent huge pages otherwise
+			if (replica != MAP_FAILED) madvise(replica, blob->replica_size, MADV_HUGEPAGE);
+#endif
+		}
+	}
+	else replica = mmap(NULL, blob->replica_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (replica == MAP_FAILED) return NULL;
+	memcpy(replica, blob->data, (size_t)blob->header->file_size);
+	mprotect(replica, blob->replica_size, PROT_READ);
+	DEBUGP("Replicated blob of %u bytes on node %u\n", (cmph_uint32)blob->header->file_size, blob_numa_node());
+	return (cmph_uint8 *)replica;
+#else
+	return NULL;
+#endif
+}
+
+/* Data of the blob for the calling thread. */
+static const cmph_uint8 *blob_local_data(cmph_blob_t *blob)
+{
+	cmph_uint32 node;
+	if (blob->nreplicas <= 1) return blob->data;
+	node = blob_numa_node() % blob->nreplicas;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&blob->mutex);
+#endif
+	if (blob->replicas[node] == NULL) blob->replicas[node] = blob_replicate(blob);
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&blob->mutex);
+#endif
+	// the shared copy serves the nodes whose replica could not be made
+	return blob->replicas[node] ? blob->replicas[node] : blob->data;
+}
+
+/* Copies the table of the blob at offset, which has room for capacity
+ * sections, to table and checks it. The copy is checked rather than the
+ * blob, whose tables may be rewritten meanwhile.
+ * \return 1 if the table is valid and its sections are within size bytes
+ */
+static int blob_read_table(const cmph_uint8 *data, size_t size, cmph_uint64 offset, cmph_uint32 capacity, cmph_uint8 *table)
+{
+	const cmph_blob_header_t *header = (const cmph_blob_header_t *)table;
+	const cmph_blob_section_t *sections = (const cmph_blob_section_t *)(header + 1);
+	cmph_uint32 i;
+
+	memcpy(table, data + offset, (size_t)BLOB_TABLE_SIZE(capacity));
+	if (memcmp(header->magic, blob_magic, sizeof(blob_magic)) != 0 ||
+	    header->version == 0 || header->version > CMPH_BLOB_VERSION || (header->flags & 0xff) >= CMPH_CHECKSUM_COUNT ||
+	    (header->algo >= CMPH_COUNT && !(header->flags & CMPH_BLOB_CONTAINER)) || header->file_size > size ||
+	    header->nsections > capacity)
+	{
+		DEBUGP("Unsupported or truncated table of version %u\n", header->version);
+		return 0;
+	}
+	if (blob_table_checksum(table, header->nsections) != header->checksum)
+	{
+		DEBUGP("The table at %llu is corrupted\n", (unsigned long long)offset);
+		return 0;
+	}
+	for (i = 0; i < header->nsections; ++i)
+	{
+		if (sections[i].offset % CMPH_BLOB_ALIGNMENT || sections[i].offset > header->file_size ||
+		    sections[i].size > header->file_size - sections[i].offset ||
+		    (sections[i].chunk_bits && (sections[i].chunk_bits < 12 || sections[i].chunk_bits > 40 ||
+		                                blob_section_end(sections + i) > header->file_size)))
+		{
+			DEBUGP("Section %u is out of the blob\n", i);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+cmph_blob_t *cmph_blob_map(const void *data, size_t size, cmph_uint32 flags)
+{
+	const cmph_blob_header_t *header = (const cmph_blob_header_t *)data;
+	const cmph_blob_section_t *sections;
+	cmph_uint8 *tables[2] = { NULL, NULL };
+	cmph_uint32 ntables, capacity;
+	cmph_uint64 tables_offset, table_size;
+	cmph_blob_t *blob;
+	cmph_uint32 i;
+
+	if (size < sizeof(cmph_blob_header_t) || memcmp(header->magic, blob_magic, sizeof(blob_magic)) != 0)
+	{
+		DEBUGP("Not a blob\n");
+		return NULL;
+	}
+	ntables = BLOB_NTABLES(header);
+	capacity = header->nsections;
+	if (ntables == 2)
+	{
+		// the first header of a container of two tables is never rewritten
+		if (header->version > CMPH_BLOB_VERSION || (header->flags & 0xff) >= CMPH_CHECKSUM_COUNT ||
+		    blob_table_checksum((const cmph_uint8 *)data, 0) != header->checksum)
+		{
+			DEBUGP("The header of the blob is corrupted\n");
+			return NULL;
+		}
+		capacity = header->capacity;
+	}
+	tables_offset = BLOB_TABLES_OFFSET(ntables);
+	table_size = BLOB_ALIGN(BLOB_TABLE_SIZE(capacity));
+	if (tables_offset + ntables*table_size > size)
+	{
+		DEBUGP("Truncated blob\n");
+		return NULL;
+	}
+	for (i = 0; i < ntables; ++i)
+	{
+		tables[i] = (cmph_uint8 *)malloc((size_t)BLOB_TABLE_SIZE(capacity));
+		if (!blob_read_table((const cmph_uint8 *)data, size, tables_offset + i*table_size, capacity, tables[i]))
+		{
+			free(tables[i]);
+			tables[i] = NULL;
+		}
+	}
+	// the newest valid table is used
+	if (tables[1] && (tables[0] == NULL ||
+	    (cmph_int32)(((cmph_blob_header_t *)tables[1])->generation - ((cmph_blob_header_t *)tables[0])->generation) > 0))
+	{
+		free(tables[0]);
+		tables[0] = tables[1];
+		tables[1] = NULL;
+	}
+	free(tables[1]);
+	if (tables[0] == NULL)
+	{
+		DEBUGP("The header of the blob is corrupted\n");
+		return NULL;
+	}
+	header = (const cmph_blob_header_t *)tables[0];
+	sections = (const cmph_blob_section_t *)(header + 1);
+
+	blob = (cmph_blob_t *)malloc(sizeof(cmph_blob_t));
+	if (blob == NULL)
+	{
+		free(tables[0]);
+		return NULL;
+	}
+	memset(blob, 0, sizeof(cmph_blob_t));
+	blob->data = (const cmph_uint8 *)data;
+	blob->size = size;
+	// the table is a copy, as appending to a container writes tables in the file
+	blob->table = tables[0];
+	blob->header = header;
+	blob->sections = sections;
+	blob->verified = (cmph_uint8 *)calloc((size_t)header->nsections + 1, sizeof(cmph_uint8));
+	blob->packed = blob->directory = blob->index = header->nsections;
+	for (i = header->nsections; i-- > 0; )
+	{
+		switch (sections[i].type)
+		{
+			case CMPH_BLOB_SECTION_PACKED:
+				if (!(header->flags & CMPH_BLOB_CONTAINER)) blob->packed = i;
+				break;
+			case CMPH_BLOB_SECTION_DIRECTORY:
+				blob->directory = i;
+				break;
+			case CMPH_BLOB_SECTION_INDEX:
+				blob->index = i;
+				break;
+		}
+	}
+	blob->flags = flags;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_init(&blob->mutex, NULL);
+#endif
+	if ((flags & CMPH_BLOB_VERIFY) && !cmph_blob_verify(blob, 1))
+	{
+		cmph_blob_close(blob);
+		return NULL;
+	}
+#ifdef CMPH_BLOB_MMAP
+	if (flags & (CMPH_BLOB_HUGEPAGES | CMPH_BLOB_NUMA))
+	{
+		blob->replica_size = (size_t)header->file_size;
+		if (flags & CMPH_BLOB_HUGEPAGES) blob->replica_size = (blob->replica_size + BLOB_HUGE_PAGE_SIZE - 1) & ~(size_t)(BLOB_HUGE_PAGE_SIZE - 1);
+		blob->nreplicas = (flags & CMPH_BLOB_NUMA) ? blob_numa_nodes() : 1;
+		// a single node needs no replica of its own
+		if (blob->nreplicas == 1 && !(flags & CMPH_BLOB_HUGEPAGES)) blob->nreplicas = 0;
+		blob->replicas = (cmph_uint8 **)calloc((size_t)blob->nreplicas + 1, sizeof(cmph_uint8 *));
+		if (blob->nreplicas == 1)
+		{
+			// a single copy is made at once and used instead of data
+			blob->replicas[0] = blob_replicate(blob);
+			if (blob->replicas[0]) blob->data = blob->replicas[0];
+		}
+	}
+#endif
+	DEBUGP("Blob of algorithm %s with %u sections\n", cmph_names[header->algo], header->nsections);
+	return blob;
+}
+
+cmph_blob_t *cmph_blob_open(const char *filename, cmph_uint32 flags)
+{
+	cmph_blob_t *blob;
+#ifdef CMPH_BLOB_MMAP
+	struct stat st;
+	void *mapping;
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return NULL;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) return NULL;
+	blob = cmph_blob_map(mapping, (size_t)st.st_size, flags);
+	if (blob == NULL)
+	{
+		munmap(mapping, (size_t)st.st_size);
+		return NULL;
+	}
+	blob->mapping = mapping;
+	blob->mapping_size = (size_t)st.st_size;
+	if (blob->nreplicas == 1 && blob->replicas[0])
+	{
+		// the file is not needed anymore
+		munmap(mapping, (size_t)st.st_size);
+		blob->mapping = NULL;
+	}
+#else
+	// read in a buffer aligned as the sections
+	void *buffer;
+	cmph_uint8 *data;
+	long size;
+	FILE *f = fopen(filename, "rb");
+	if (f == NULL) return NULL;
+	if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) <= 0)
+	{
+		fclose(f);
+		return NULL;
+	}
+	rewind(f);
+	buffer = malloc((size_t)size + CMPH_BLOB_ALIGNMENT);
+	data = (cmph_uint8 *)BLOB_ALIGN((size_t)buffer);
+	if (fread(data, (size_t)size, (size_t)1, f) != 1)
+	{
+		fclose(f);
+		free(buffer);
+		return NULL;
+	}
+	fclose(f);
+	blob = cmph_blob_map(data, (size_t)size, flags);
+	if (blob == NULL)
+	{
+		free(buffer);
+		return NULL;
+	}
+	blob->buffer = buffer;
+#endif
+	return blob;
+}
+
+/* Data of section i for the calling thread, verified on first use. */
+static const cmph_uint8 *blob_section(cmph_blob_t *blob, cmph_uint32 i)
+{
+	if (i >= blob->header->nsections) return NULL;
+	if (!blob->verified[i] && !blob_verify_section(blob, i)) return NULL;
+	return blob_local_data(blob) + blob->sections[i].offset;
+}
+
+void *cmph_blob_packed(cmph_blob_t *blob)
+{
+	return (void *)blob_section(blob, blob->packed);
+}
+
+CMPH_ALGO cmph_blob_algo(cmph_blob_t *blob)
+{
+	return (CMPH_ALGO)blob->header->algo;
+}
+
+CMPH_HASH cmph_blob_hashfunc(cmph_blob_t *blob)
+{
+	return (CMPH_HASH)blob->header->hashfunc;
+}
+
+cmph_uint32 cmph_blob_size(cmph_blob_t *blob)
+{
+	return blob->header->size;
+}
+
+void cmph_blob_close(cmph_blob_t *blob)
+{
+#ifdef CMPH_BLOB_MMAP
+	cmph_uint32 i;
+	for (i = 0; i < blob->nreplicas; ++i)
+	{
+		if (blob->replicas[i]) munmap(blob->replicas[i], blob->replica_size);
+	}
+	if (blob->mapping) munmap(blob->mapping, blob->mapping_size);
+#endif
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_destroy(&blob->mutex);
+#endif
+	free(blob->replicas);
+	free(blob->buffer);
+	free(blob->verified);
+	free(blob->table);
+	free(blob);
+}
+
+/* Directory of a container, or NULL if it is corrupted. */
+static const cmph_blob_directory_t *blob_directory(cmph_blob_t *blob)
+{
+	const cmph_blob_directory_t *directory;
+	if (!(blob->header->flags & CMPH_BLOB_CONTAINER)) return NULL;
+	directory = (const cmph_blob_directory_t *)blob_section(blob, blob->directory);
+	if (directory == NULL || blob->sections[blob->directory].size < sizeof(cmph_blob_directory_t)) return NULL;
+	if (directory->nfunctions > (blob->sections[blob->directory].size - sizeof(cmph_blob_directory_t)) / sizeof(cmph_blob_entry_t)) return NULL;
+	return directory;
+}
+
+static const cmph_blob_entry_t *blob_entry(cmph_blob_t *blob, const cmph_blob_directory_t *directory, cmph_uint32 i, const char **name)
+{
+	const cmph_blob_entry_t *entry = ((const cmph_blob_entry_t *)(directory + 1)) + i;
+	cmph_uint64 directory_size = blob->sections[blob->directory].size;
+	if (entry->name_offset > directory_size || entry->name_length > directory_size - entry->name_offset) return NULL;
+	*name = (const char *)directory + entry->name_offset;
+	return entry;
+}
+
+cmph_uint32 cmph_blob_nfunctions(cmph_blob_t *blob)
+{
+	const cmph_blob_directory_t *directory = blob_directory(blob);
+	return directory ? directory->nfunctions : 0;
+}
+
+const char *cmph_blob_function_name(cmph_blob_t *blob, cmph_uint32 i, cmph_uint32 *namelen)
+{
+	const cmph_blob_directory_t *directory = blob_directory(blob);
+	const cmph_blob_entry_t *entry;
+	const char *name;
+	if (directory == NULL || i >= directory->nfunctions) return NULL;
+	entry = blob_entry(blob, directory, i, &name);
+	if (entry == NULL) return NULL;
+	*namelen = entry->name_length;
+	return name;
+}
+
+void *cmph_blob_find(cmph_blob_t *blob, const char *name, cmph_uint32 namelen, cmph_uint32 *size, int *corrupted)
+{
+	const cmph_blob_directory_t *directory = blob_directory(blob);
+	const cmph_blob_entry_t *entry = NULL;
+	const char *entry_name;
+	cmph_uint32 i;
+	void *index, *packed;
+	int dummy;
+
+	if (corrupted == NULL) corrupted = &dummy;
+	*corrupted = 0;
+	if (directory == NULL)
+	{
+		// blob_directory() also fails on blobs of a single function
+		*corrupted = (blob->header->flags & CMPH_BLOB_CONTAINER) != 0;
+		return NULL;
+	}
+	if (directory->nfunctions == 0) return NULL;
+	if (blob->index < blob->header->nsections)
+	{
+		index = (void *)blob_section(blob, blob->index);
+		if (index == NULL)
+		{
+			*corrupted = 1;
+			return NULL;
+		}
+		i = cmph_search_packed(index, name, namelen);
+		if (i >= directory->nfunctions) return NULL;
+		entry = blob_entry(blob, directory, i, &entry_name);
+		if (entry == NULL) *corrupted = 1;
+		else if (entry->name_length != namelen || memcmp(entry_name, name, (size_t)namelen) != 0) entry = NULL;
+	}
+	else
+	{
+		// containers whose index could not be built are scanned
+		for (i = 0; i < directory->nfunctions; ++i)
+		{
+			entry = blob_entry(blob, directory, i, &entry_name);
+			if (entry && entry->name_length == namelen && memcmp(entry_name, name, (size_t)namelen) == 0) break;
+			if (entry == NULL) *corrupted = 1;
+			entry = NULL;
+		}
+	}
+	if (entry == NULL) return NULL;
+	if (entry->section >= blob->header->nsections || blob->sections[entry->section].type != CMPH_BLOB_SECTION_PACKED)
+	{
+		*corrupted = 1;
+		return NULL;
+	}
+	packed = (void *)blob_section(blob, entry->section);
+	if (packed == NULL)
+	{
+		*corrupted = 1;
+		return NULL;
+	}
+	if (size) *size = entry->size;
+	return packed;
+}
+
+/* Builds the index and the directory of functions, whose sections are set. */
+static void *blob_directory_new(blob_function_t *functions, cmph_uint32 nfunctions, void **index, cmph_uint32 *index_size, cmph_uint64 *directory_size)
+{
+	cmph_uint8 **names = (cmph_uint8 **)malloc(sizeof(cmph_uint8 *)*(nfunctions + 1));
+	cmph_uint32 *order = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*(nfunctions + 1));
+	cmph_io_adapter_t *source;
+	cmph_config_t *config;
+	cmph_t *mphf = NULL;
+	cmph_blob_directory_t *directory;
+	cmph_blob_entry_t *entries;
+	cmph_uint64 size = sizeof(cmph_blob_directory_t) + sizeof(cmph_blob_entry_t)*(cmph_uint64)nfunctions;
+	cmph_uint32 i;
+
+	for (i = 0; i < nfunctions; ++i)
+	{
+		names[i] = (cmph_uint8 *)malloc(sizeof(cmph_uint32) + functions[i].namelen);
+		memcpy(names[i], &(functions[i].namelen), sizeof(cmph_uint32));
+		memcpy(names[i] + sizeof(cmph_uint32), functions[i].name, (size_t)functions[i].namelen);
+		order[i] = i;
+	}
+	*index = NULL;
+	*index_size = 0;
+	if (nfunctions)
+	{
+		source = cmph_io_byte_vector_adapter(names, nfunctions);
+		config = cmph_config_new(source);
+		cmph_config_set_algo(config, CMPH_BDZ);
+		mphf = cmph_new(config);
+		cmph_config_destroy(config);
+		if (mphf)
+		{
+			*index_size = cmph_packed_size(mphf);
+			*index = calloc((size_t)*index_size, (size_t)1);
+			cmph_pack(mphf, *index);
+			for (i = 0; i < nfunctions; ++i) order[cmph_search(mphf, functions[i].name, functions[i].namelen)] = i;
+			cmph_destroy(mphf);
+		}
+		cmph_io_byte_vector_adapter_destroy(source);
+	}
+	for (i = 0; i < nfunctions; ++i)
+	{
+		free(names[i]);
+		size += functions[i].namelen;
+	}
+	free(names);
+
+	directory = (cmph_blob_directory_t *)calloc((size_t)size, (size_t)1);
+	directory->nfunctions = nfunctions;
+	entries = (cmph_blob_entry_t *)(directory + 1);
+	size = sizeof(cmph_blob_directory_t) + sizeof(cmph_blob_entry_t)*(cmph_uint64)nfunctions;
+	for (i = 0; i < nfunctions; ++i)
+	{
+		blob_function_t *function = functions + order[i];
+		entries[i].section = function->section;
+		entries[i].size = function->size;
+		entries[i].name_offset = (cmph_uint32)size;
+		entries[i].name_length = function->namelen;
+		memcpy((cmph_uint8 *)directory + size, function->name, (size_t)function->namelen);
+		size += function->namelen;
+	}
+	free(order);
+	*directory_size = size;
+	return directory;
+}
+
+/* Writes a container of nfunctions functions to filename. The functions
+ * of blob are either kept in place, when it has two tables with room for
+ * the new sections, or copied with the others to a new file, which replaces
+ * it. Either way, a reader or a crash finds the container as it was before
+ * or after the write, never in between.
+ */
+static int blob_container_write(const char *filename, cmph_blob_t *blob, blob_function_t *functions, cmph_uint32 nfunctions, CMPH_CHECKSUM checksum)
+{
+	cmph_uint32 nsections = nfunctions + 2;
+	cmph_blob_section_t *entries = (cmph_blob_section_t *)calloc((size_t)nsections, sizeof(cmph_blob_section_t));
+	void **data = (void **)calloc((size_t)nsections, sizeof(void *));
+	cmph_uint32 in_place = blob && BLOB_NTABLES(blob->header) == 2 && blob->header->capacity >= nsections;
+	cmph_blob_header_t header;
+	cmph_uint64 directory_size;
+	cmph_uint32 index_size, i;
+	void *directory, *index;
+	char *tmp_filename = NULL;
+	FILE *f = NULL;
+	int ret;
+
+	for (i = 0; i < nfunctions; ++i)
+	{
+		if (in_place && functions[i].section != BLOB_NO_SECTION) entries[i] = blob->sections[functions[i].section];
+		else
+		{
+			entries[i].type = CMPH_BLOB_SECTION_PACKED;
+			entries[i].size = functions[i].packed_size;
+			data[i] = functions[i].packed;
+		}
+		functions[i].section = i;
+	}
+	directory = blob_directory_new(functions, nfunctions, &index, &index_size, &directory_size);
+	entries[nfunctions].type = CMPH_BLOB_SECTION_DIRECTORY;
+	entries[nfunctions].size = directory_size;
+	data[nfunctions] = directory;
+	if (index)
+	{
+		entries[nfunctions + 1].type = CMPH_BLOB_SECTION_INDEX;
+		entries[nfunctions + 1].size = index_size;
+		data[nfunctions + 1] = index;
+	}
+	else --nsections;
+
+	memset(&header, 0, sizeof(header));
+	header.algo = CMPH_COUNT;
+	header.hashfunc = CMPH_HASH_COUNT;
+	header.flags = checksum | CMPH_BLOB_CONTAINER | CMPH_BLOB_TABLES;
+	header.size = nfunctions;
+	if (blob && !in_place && !cmph_blob_verify(blob, 1)) ret = 0;
+	else if (in_place)
+	{
+		// the new table goes where the one before the current table was
+		header.generation = blob->header->generation + 1;
+		f = fopen(filename, "r+b");
+		ret = f != NULL && blob_write(f, &header, nsections, blob->header->capacity, entries, data, blob->header->file_size);
+	}
+	else
+	{
+		// written aside, so that readers never see a partial container
+		tmp_filename = (char *)malloc(strlen(filename) + 5);
+		sprintf(tmp_filename, "%s.tmp", filename);
+		f = fopen(tmp_filename, "wb");
+		ret = f != NULL && blob_write(f, &header, nsections, BLOB_CONTAINER_CAPACITY(nsections), entries, data, 0);
+	}
+	// the new table, or the new file renamed next, is on disk before the write succeeds
+	if (f && ret && !blob_sync(f)) ret = 0;
+	if (f && fclose(f) != 0) ret = 0;
+	if (tmp_filename)
+	{
+		if (ret && rename(tmp_filename, filename) != 0) ret = 0;
+		if (!ret) remove(tmp_filename);
+		free(tmp_filename);
+	}
+	DEBUGP("Wrote container of %u functions %s\n", nfunctions, in_place ? "in place" : "to a new file");
+	free(directory);
+	free(index);
+	free(entries);
+	free(data);
+	return ret;
+}
+
+/* Functions of a container, but the one named name. */
+static blob_function_t *blob_functions(cmph_blob_t *blob, const char *name, cmph_uint32 namelen, cmph_uint32 *nfunctions)
+{
+	const cmph_blob_directory_t *directory = blob_directory(blob);
+	blob_function_t *functions;
+	cmph_uint32 i;
+	*nfunctions = 0;
+	if (directory == NULL) return NULL;
+	functions = (blob_function_t *)malloc(sizeof(blob_function_t)*(directory->nfunctions + 1));
+	for (i = 0; i < directory->nfunctions; ++i)
+	{
+		const char *entry_name;
+		const cmph_blob_entry_t *entry = blob_entry(blob, directory, i, &entry_name);
+		blob_function_t *function = functions + *nfunctions;
+		if (entry == NULL || entry->section >= blob->header->nsections)
+		{
+			free(functions);
+			return NULL;
+		}
+		if (name && entry->name_length == namelen && memcmp(entry_name, name, (size_t)namelen) == 0) continue;
+		function->name = entry_name;
+		function->namelen = entry->name_length;
+		function->size = entry->size;
+		function->packed = (void *)(blob->data + blob->sections[entry->section].offset);
+		function->packed_size = blob->sections[entry->section].size;
+		function->section = entry->section;
+		++(*nfunctions);
+	}
+	return functions;
+}
+
+int cmph_blob_append(const char *filename, const char *name, cmph_uint32 namelen, cmph_t *mphf, CMPH_CHECKSUM checksum)
+{
+	cmph_blob_t *blob = cmph_blob_open(filename, 0);
+	blob_function_t *functions = NULL;
+	cmph_uint32 nfunctions = 0;
+	cmph_uint32 packed_size = cmph_packed_size(mphf);
+	void *packed;
+	int ret;
+
+	if (blob == NULL)
+	{
+		// only a missing or empty file becomes a new container
+		FILE *f = fopen(filename, "rb");
+		if (f && fgetc(f) != EOF)
+		{
+			fclose(f);
+			return 0;
+		}
+		if (f) fclose(f);
+		functions = (blob_function_t *)malloc(sizeof(blob_function_t));
+	}
+	else
+	{
+		// the functions already in the container keep its checksum
+		checksum = (CMPH_CHECKSUM)(blob->header->flags & 0xff);
+		functions = blob_functions(blob, name, namelen, &nfunctions);
+	}
+	if (functions == NULL || packed_size == 0 || checksum >= CMPH_CHECKSUM_COUNT)
+	{
+		free(functions);
+		if (blob) cmph_blob_close(blob);
+		return 0;
+	}
+	packed = calloc((size_t)packed_size, (size_t)1);
+	cmph_pack(mphf, packed);
+	functions[nfunctions].name = name;
+	functions[nfunctions].namelen = namelen;
+	functions[nfunctions].size = mphf->size;
+	functions[nfunctions].packed = packed;
+	functions[nfunctions].packed_size = packed_size;
+	functions[nfunctions].section = BLOB_NO_SECTION;
+	ret = blob_container_write(filename, blob, functions, nfunctions + 1, checksum);
+	free(packed);
+	free(functions);
+	if (blob) cmph_blob_close(blob);
+	return ret;
+}
+
+int cmph_blob_compact(const char *filename)
+{
+	cmph_blob_t *blob = cmph_blob_open(filename, CMPH_BLOB_VERIFY);
+	blob_function_t *functions;
+	cmph_uint32 nfunctions, i;
+	int ret = 0;
+	if (blob == NULL) return 0;
+	functions = blob_functions(blob, NULL, 0, &nfunctions);
+	if (functions)
+	{
+		// every function is copied to the new file
+		for (i = 0; i < nfunctions; ++i) functions[i].section = BLOB_NO_SECTION;
+		ret = blob_container_write(filename, NULL, functions, nfunctions, (CMPH_CHECKSUM)(blob->header->flags & 0xff));
+		free(functions);
+	}
+	cmph_blob_close(blob);
+	return ret;
+}
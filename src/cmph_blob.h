@@ -0,0 +1,187 @@
+#ifndef __CMPH_BLOB_H__
+#define __CMPH_BLOB_H__
+
+#include "cmph.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* A blob is a file holding packed functions, meant to be mapped and searched
+ * in place. It starts with a header of 64 bytes:
+ *
+ *   magic        8 bytes, "\211CMPH\r\n\032"
+ *   version      cmph_uint32, CMPH_BLOB_VERSION
+ *   algo         cmph_uint32, CMPH_ALGO of the function
+ *   hashfunc     cmph_uint32, CMPH_HASH of its first hash function
+ *   flags        cmph_uint32, CMPH_CHECKSUM of the sections in the low byte
+ *                and CMPH_BLOB_CONTAINER
+ *   size         cmph_uint32, number of values of the function
+ *   nsections    cmph_uint32
+ *   file_size    cmph_uint64
+ *   checksum     cmph_uint64, of the header (with this field zeroed) and of
+ *                the section table
+ *   capacity     cmph_uint32, number of sections the table has room for
+ *   generation   cmph_uint32, of the table of a container
+ *   reserved     zeroes up to 64 bytes
+ *
+ * and the table of its sections follows, 32 bytes for each one:
+ *
+ *   type         cmph_uint32, CMPH_BLOB_SECTION_*
+ *   chunk_bits   cmph_uint32, log2 of the size of the chunks of the section,
+ *                0 if it is checksummed whole
+ *   offset       cmph_uint64, multiple of CMPH_BLOB_ALIGNMENT
+ *   size         cmph_uint64
+ *   checksum     cmph_uint64 (a CRC32C is zero extended)
+ *
+ * Sections start at offsets aligned to 64 bytes. Sections larger than 1 MB
+ * are split in chunks of 1 MB, the last one shorter, whose checksums follow
+ * the section at the next aligned offset, as an array of cmph_uint64. The
+ * checksum of such a section is the one of that array, so that the chunks
+ * of a large function are verified in parallel. Blobs of version 1 have no
+ * chunks and are read as well. A packed section holds the
+ * output of cmph_pack(), so cmph_search_packed() and the searchers of
+ * cmph_searcher.h use it where it is mapped. Integers are in the byte order
+ * of the host that wrote the blob, as in the files of cmph_dump().
+ *
+ * A container holds many functions, each one in a packed section, and a
+ * directory section that maps their names to their sections. The directory
+ * is indexed by a BDZ function of the names, packed in an index section. The
+ * algo, hashfunc and size fields of the header of a container are
+ * CMPH_COUNT, CMPH_HASH_COUNT and the number of functions. Sections left
+ * behind by cmph_blob_append() are only dropped by cmph_blob_compact().
+ * A container of version 3 with CMPH_BLOB_TABLES has a header of no
+ * section, written with the container only, followed by two tables of its
+ * capacity, each one with its own header. The valid table of the highest
+ * generation is used, and cmph_blob_append() writes the other one, so that
+ * the table in use is never overwritten.
+ *
+ * The header and the table are checked when a blob is opened. The checksum
+ * of a section is verified the first time it is used, unless the blob is
+ * opened with CMPH_BLOB_VERIFY or cmph_blob_verify() is called before.
+ */
+#define CMPH_BLOB_VERSION 3
+#define CMPH_BLOB_ALIGNMENT 64
+
+#define CMPH_BLOB_SECTION_PACKED 1   // a function as filled by cmph_pack()
+#define CMPH_BLOB_SECTION_DIRECTORY 2
+#define CMPH_BLOB_SECTION_INDEX 3
+
+#define CMPH_BLOB_CONTAINER 0x100    // header flag of containers
+#define CMPH_BLOB_TABLES 0x200       // header flag of containers with two tables
+
+/* Flags of cmph_blob_open() and cmph_blob_map(). The placement flags copy
+ * the blob to anonymous memory, so that the arrays searched by the lookups
+ * neither sit on 4 KB pages of the page cache nor on a remote NUMA node.
+ * They are ignored where mmap() is not available.
+ */
+#define CMPH_BLOB_VERIFY 1           // verify all sections at once
+#define CMPH_BLOB_HUGEPAGES 2        // copy the blob to explicit huge pages (MAP_HUGETLB) when some
+                                     // are reserved, or to transparent huge pages (MADV_HUGEPAGE)
+#define CMPH_BLOB_NUMA 4             // keep a replica of the blob on each NUMA node, made the first
+                                     // time a thread of the node calls cmph_blob_packed()
+
+typedef enum { CMPH_CHECKSUM_CRC32C, CMPH_CHECKSUM_XXH64, CMPH_CHECKSUM_COUNT } CMPH_CHECKSUM;
+extern const char *cmph_checksum_names[];
+
+typedef struct __cmph_blob_t cmph_blob_t;
+
+/** \fn int cmph_blob_dump(cmph_t *mphf, FILE *f, CMPH_CHECKSUM checksum);
+ *  \brief Writes mphf to f as a blob.
+ *  \param mphf a complete function. A function just built by BRZ has to be
+ *  \param dumped and loaded back with cmph_load() first.
+ *  \param checksum checksum of the sections
+ *  \return 1 for success and 0 for failures
+ */
+int cmph_blob_dump(cmph_t *mphf, FILE *f, CMPH_CHECKSUM checksum);
+
+/** \fn cmph_blob_t *cmph_blob_open(const char *filename, cmph_uint32 flags);
+ *  \brief Maps a blob file in memory.
+ *  \param flags CMPH_BLOB_VERIFY, CMPH_BLOB_HUGEPAGES and CMPH_BLOB_NUMA, or 0
+ *  \return the blob or NULL if the file is not a valid blob
+ */
+cmph_blob_t *cmph_blob_open(const char *filename, cmph_uint32 flags);
+
+/** \fn cmph_blob_t *cmph_blob_map(const void *data, size_t size, cmph_uint32 flags);
+ *  \brief Uses a blob already in memory, which must outlive it.
+ *  \param data start of the blob, aligned to CMPH_BLOB_ALIGNMENT bytes for
+ *  \param the alignment of the sections to hold
+ *  \param flags as in cmph_blob_open()
+ *  \return the blob or NULL if data is not a valid blob
+ */
+cmph_blob_t *cmph_blob_map(const void *data, size_t size, cmph_uint32 flags);
+
+/** \fn int cmph_blob_verify(cmph_blob_t *blob, cmph_uint32 nthreads);
+ *  \brief Verifies the checksums of the sections not verified yet.
+ *  \param nthreads number of threads verifying the chunks of the sections in parallel
+ *  \return 1 if all sections are intact and 0 otherwise
+ */
+int cmph_blob_verify(cmph_blob_t *blob, cmph_uint32 nthreads);
+
+/** \fn void *cmph_blob_packed(cmph_blob_t *blob);
+ *  \brief Returns the packed function of the blob, verifying it on first use.
+ *  Lazy verification is not thread safe: a blob shared by threads should be
+ *  opened with CMPH_BLOB_VERIFY, or verified, before. With CMPH_BLOB_NUMA
+ *  the function is the replica of the node of the calling thread, so each
+ *  thread should call it once and keep the result.
+ *  \return the function for cmph_search_packed() or NULL if it is corrupted
+ *  \return or if the blob is a container
+ */
+void *cmph_blob_packed(cmph_blob_t *blob);
+
+/** \fn int cmph_blob_append(const char *filename, const char *name, cmph_uint32 namelen, cmph_t *mphf, CMPH_CHECKSUM checksum);
+ *  \brief Adds mphf to the container filename under name, replacing the
+ *  function of the same name. A missing file becomes a new container.
+ *  The new sections are appended to the file and synced, and the table not
+ *  in use is written after them, when the tables have room for the sections.
+ *  Otherwise the container is rewritten to a new file that replaces it.
+ *  Blobs opened on the file before, during or after the append, and after a
+ *  crash in the middle of it, find either the old or the new functions.
+ *  \param mphf a complete function, as in cmph_blob_dump()
+ *  \param checksum checksum of a new container. The functions added to an
+ *  \param existing one get its checksum.
+ *  \return 1 for success and 0 for failures
+ */
+int cmph_blob_append(const char *filename, const char *name, cmph_uint32 namelen, cmph_t *mphf, CMPH_CHECKSUM checksum);
+
+/** \fn int cmph_blob_compact(const char *filename);
+ *  \brief Rewrites the container filename without the sections of the
+ *  functions replaced and of the directories superseded since it was written.
+ *  \return 1 for success and 0 for failures, including corrupted containers
+ */
+int cmph_blob_compact(const char *filename);
+
+/** \fn void *cmph_blob_find(cmph_blob_t *blob, const char *name, cmph_uint32 namelen, cmph_uint32 *size, int *corrupted);
+ *  \brief Looks up a function of a container by name. Sections are verified
+ *  on first use and placed as in cmph_blob_packed().
+ *  \param size if not NULL, receives the number of values of the function
+ *  \param corrupted if not NULL, set to 1 when NULL is returned because the
+ *  \param function, the directory or the index of the container is
+ *  \param corrupted, and to 0 otherwise
+ *  \return the function for cmph_search_packed() or NULL if there is no such
+ *  \return function or if it is corrupted
+ */
+void *cmph_blob_find(cmph_blob_t *blob, const char *name, cmph_uint32 namelen, cmph_uint32 *size, int *corrupted);
+
+/** \fn cmph_uint32 cmph_blob_nfunctions(cmph_blob_t *blob);
+ *  \return the number of functions of a container, 0 for other blobs
+ */
+cmph_uint32 cmph_blob_nfunctions(cmph_blob_t *blob);
+
+/** \fn const char *cmph_blob_function_name(cmph_blob_t *blob, cmph_uint32 i, cmph_uint32 *namelen);
+ *  \return the name of the i-th function of a container, in the order of
+ *  \return its directory, which is not NUL terminated
+ */
+const char *cmph_blob_function_name(cmph_blob_t *blob, cmph_uint32 i, cmph_uint32 *namelen);
+
+CMPH_ALGO cmph_blob_algo(cmph_blob_t *blob);
+CMPH_HASH cmph_blob_hashfunc(cmph_blob_t *blob);
+cmph_uint32 cmph_blob_size(cmph_blob_t *blob);
+void cmph_blob_close(cmph_blob_t *blob);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,337 @@
+#include "cmph_searcher.h"
+#include "cmph_structs.h"
+#include "hash.h"
+#include "fastmod.h"
+#include "chm.h"
+#include "bmz.h"
+#include "bmz8.h"
+#include "brz.h"
+#include "fch.h"
+#include "bdz.h"
+#include "bdz_structs.h"
+#include "bdz_ph.h"
+#include "chd_ph.h"
+#include "chd_structs_ph.h"
+#include "chd.h"
+#include "chd_structs.h"
+#include "compressed_seq.h"
+#include "compressed_rank.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+//#define DEBUG
+#include "debug.h"
+
+extern const cmph_uint8 bdz_lookup_table[];
+
+#define SEARCHER_BATCH 16   // keys of BDZ functions whose accesses are overlapped
+#ifdef __GNUC__
+#define SEARCHER_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define SEARCHER_PREFETCH(addr)
+#endif
+
+/* Search routines of each algorithm, bound to the function of the searcher. */
+#define SEARCHER_MPHF(algo) \
+static cmph_uint32 algo##_searcher(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen) \
+{ \
+	return algo##_search((cmph_t *)searcher->mphf, key, keylen); \
+}
+#define SEARCHER_PACKED(algo) \
+static cmph_uint32 algo##_searcher_packed(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen) \
+{ \
+	return algo##_search_packed(searcher->mphf, key, keylen); \
+}
+#define SEARCHER(algo) SEARCHER_MPHF(algo) SEARCHER_PACKED(algo)
+
+SEARCHER(chm)
+SEARCHER(bmz)
+SEARCHER(bmz8)
+SEARCHER(brz)
+SEARCHER(fch)
+SEARCHER_MPHF(bdz)
+SEARCHER(bdz_ph)
+
+static cmph_uint32 bdz_searcher_jenkins(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen)
+{
+	return cmph_searcher_search_bdz_jenkins(searcher, key, keylen);
+}
+
+static cmph_uint32 bdz_searcher_packed_hash(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen)
+{
+	cmph_uint32 hl[3];
+	hash_vector_packed((void *)searcher->hash_packed, searcher->hashfunc, key, keylen, hl);
+	return cmph_searcher_bdz(searcher, hl);
+}
+
+/* Bucket, first probe and step of a key in a CHD_PH function, as chd_ph_search(). */
+static inline cmph_uint32 searcher_chd_ph_hash(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen,
+                                               cmph_uint32 *f, cmph_uint32 *h)
+{
+	cmph_uint32 hl[3];
+	if (searcher->hashfunc == CMPH_HASH_JENKINS) cmph_searcher_jenkins(searcher->seed, (const unsigned char *)key, keylen, hl);
+	else hash_vector_packed((void *)searcher->hash_packed, searcher->hashfunc, key, keylen, hl);
+	*f = fastmod_mod(hl[1], searcher->n_magic, searcher->n);
+	*h = fastmod_mod(hl[2], searcher->n1_magic, searcher->n - 1) + 1;
+	return fastmod_mod(hl[0], searcher->nbuckets_magic, searcher->nbuckets);
+}
+
+// Bin of a key in a CHD_PH function, from the displacement of its bucket.
+static inline cmph_uint32 searcher_chd_ph_position(const cmph_searcher_t *searcher, cmph_uint32 f, cmph_uint32 h, cmph_uint32 disp)
+{
+	cmph_uint32 probe1_num = fastmod_div(disp, searcher->n_magic, searcher->n);
+	cmph_uint32 probe0_num = disp - probe1_num * searcher->n;
+	return fastmod_mod(f + ((cmph_uint64)h)*probe0_num + probe1_num, searcher->n_magic, searcher->n);
+}
+
+static cmph_uint32 chd_ph_searcher(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen)
+{
+	cmph_uint32 f, h;
+	cmph_uint32 g = searcher_chd_ph_hash(searcher, key, keylen, &f, &h);
+	return searcher_chd_ph_position(searcher, f, h, compressed_seq_query((compressed_seq_t *)searcher->cs, g));
+}
+
+static cmph_uint32 chd_ph_searcher_packed(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen)
+{
+	cmph_uint32 f, h;
+	cmph_uint32 g = searcher_chd_ph_hash(searcher, key, keylen, &f, &h);
+	return searcher_chd_ph_position(searcher, f, h, compressed_seq_query_packed((void *)searcher->cs, g));
+}
+
+// CHD functions are packed in memory as well, so one routine serves both searchers.
+static cmph_uint32 chd_searcher(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen)
+{
+	cmph_uint32 bin_idx = chd_ph_searcher_packed(searcher, key, keylen);
+	return bin_idx - compressed_rank_query_packed((void *)searcher->cr, bin_idx);
+}
+
+/* The searcher is allocated with hash_size more bytes, where the hash
+ * function of a CHD_PH cmph_t is packed.
+ */
+static cmph_searcher_t *searcher_new(CMPH_ALGO algo, void *mphf, cmph_uint32 hash_size)
+{
+	cmph_searcher_t *searcher = (cmph_searcher_t *)malloc(sizeof(cmph_searcher_t) + hash_size);
+	if (!searcher) return NULL;
+	memset(searcher, 0, sizeof(cmph_searcher_t));
+	searcher->algo = algo;
+	searcher->mphf = mphf;
+	searcher->lookup_table = bdz_lookup_table;
+	return searcher;
+}
+
+static void searcher_set_bdz(cmph_searcher_t *searcher, cmph_uint32 r, cmph_uint32 b, const cmph_uint32 *ranktable, const cmph_uint8 *g)
+{
+	searcher->r = r;
+	searcher->r_magic = fastmod_magic(r);
+	searcher->b = b;
+	searcher->ranktable = ranktable;
+	searcher->g = g;
+}
+
+// Decodes the header of a packed CHD_PH function, written by chd_ph_pack().
+static void searcher_set_chd_ph_packed(cmph_searcher_t *searcher, cmph_uint8 *packed)
+{
+	cmph_uint32 *ptr;
+	searcher->hashfunc = (CMPH_HASH)*(cmph_uint32 *)packed;
+	searcher->hash_packed = packed + sizeof(cmph_uint32);
+	ptr = (cmph_uint32 *)(packed + sizeof(cmph_uint32) + hash_state_packed_size(searcher->hashfunc));
+	searcher->n = *ptr++;
+	searcher->nbuckets = *ptr++;
+	memcpy(&(searcher->nbuckets_magic), ptr, sizeof(cmph_uint64));
+	memcpy(&(searcher->n_magic), ptr + 2, sizeof(cmph_uint64));
+	memcpy(&(searcher->n1_magic), ptr + 4, sizeof(cmph_uint64));
+	searcher->cs = ptr + 6;
+	if (searcher->hashfunc == CMPH_HASH_JENKINS) memcpy(&(searcher->seed), searcher->hash_packed, sizeof(cmph_uint32));
+}
+
+// Decodes a packed CHD function, written by chd_pack(), or the fields of a CHD cmph_t.
+static void searcher_set_chd(cmph_searcher_t *searcher, cmph_uint8 *packed_cr, cmph_uint8 *packed_chd_phf)
+{
+	searcher->cr = packed_cr;
+	// packed_chd_phf starts with its algorithm, as packed by cmph_pack()
+	searcher_set_chd_ph_packed(searcher, packed_chd_phf + sizeof(cmph_uint32));
+	searcher->search = chd_searcher;
+}
+
+static void searcher_set_jenkins(cmph_searcher_t *searcher, const void *hash_packed)
+{
+	memcpy(&(searcher->seed), hash_packed, sizeof(cmph_uint32));
+	searcher->search = bdz_searcher_jenkins;
+	searcher->bdz_jenkins = 1;
+}
+
+cmph_searcher_t *cmph_searcher_new(cmph_t *mphf)
+{
+	cmph_uint32 hash_size = 0;
+	cmph_searcher_t *searcher;
+	if (mphf->algo == CMPH_CHD_PH) hash_size = hash_state_packed_size(hash_get_type(((chd_ph_data_t *)mphf->data)->hl));
+	searcher = searcher_new(mphf->algo, mphf, hash_size);
+	if (!searcher) return NULL;
+	switch(mphf->algo)
+	{
+		case CMPH_CHM:
+			searcher->search = chm_searcher;
+			break;
+		case CMPH_BMZ:
+			searcher->search = bmz_searcher;
+			break;
+		case CMPH_BMZ8:
+			searcher->search = bmz8_searcher;
+			break;
+		case CMPH_BRZ:
+			searcher->search = brz_searcher;
+			break;
+		case CMPH_FCH:
+			searcher->search = fch_searcher;
+			break;
+		case CMPH_BDZ:
+			{
+				bdz_data_t *bdz = (bdz_data_t *)mphf->data;
+				searcher->search = bdz_searcher;
+				searcher->hashfunc = hash_get_type(bdz->hl);
+				searcher_set_bdz(searcher, bdz->r, bdz->b, bdz->ranktable, bdz->g);
+				if (searcher->hashfunc == CMPH_HASH_JENKINS)
+				{
+					// the seed is read back from the packed hash
+					cmph_uint8 hl_packed[sizeof(cmph_uint32)];
+					hash_state_pack(bdz->hl, hl_packed);
+					searcher_set_jenkins(searcher, hl_packed);
+				}
+			}
+			break;
+		case CMPH_BDZ_PH:
+			searcher->search = bdz_ph_searcher;
+			break;
+		case CMPH_CHD_PH:
+			{
+				chd_ph_data_t *chd_ph = (chd_ph_data_t *)mphf->data;
+				cmph_uint8 *hl_packed = (cmph_uint8 *)(searcher + 1);
+				hash_state_pack(chd_ph->hl, hl_packed);
+				searcher->hashfunc = hash_get_type(chd_ph->hl);
+				searcher->hash_packed = hl_packed;
+				if (searcher->hashfunc == CMPH_HASH_JENKINS) memcpy(&(searcher->seed), hl_packed, sizeof(cmph_uint32));
+				searcher->n = chd_ph->n;
+				searcher->nbuckets = chd_ph->nbuckets;
+				searcher->nbuckets_magic = chd_ph->nbuckets_magic;
+				searcher->n_magic = chd_ph->n_magic;
+				searcher->n1_magic = chd_ph->n1_magic;
+				searcher->cs = chd_ph->cs;
+				searcher->search = chd_ph_searcher;
+			}
+			break;
+		case CMPH_CHD:
+			{
+				chd_data_t *chd = (chd_data_t *)mphf->data;
+				searcher_set_chd(searcher, chd->packed_cr, chd->packed_chd_phf);
+			}
+			break;
+		default:
+			free(searcher);
+			return NULL;
+	}
+	return searcher;
+}
+
+cmph_searcher_t *cmph_searcher_new_packed(void *packed_mphf)
+{
+	cmph_uint32 *ptr = (cmph_uint32 *)packed_mphf;
+	cmph_searcher_t *searcher = searcher_new((CMPH_ALGO)*ptr, ptr + 1, 0);
+	if (!searcher) return NULL;
+	switch(*ptr)
+	{
+		case CMPH_CHM:
+			searcher->search = chm_searcher_packed;
+			break;
+		case CMPH_BMZ:
+			searcher->search = bmz_searcher_packed;
+			break;
+		case CMPH_BMZ8:
+			searcher->search = bmz8_searcher_packed;
+			break;
+		case CMPH_BRZ:
+			searcher->search = brz_searcher_packed;
+			break;
+		case CMPH_FCH:
+			searcher->search = fch_searcher_packed;
+			break;
+		case CMPH_BDZ:
+			{
+				// the layout written by bdz_pack()
+				cmph_uint8 *hl_ptr = (cmph_uint8 *)(ptr + 2);
+				cmph_uint32 *ranktable;
+				cmph_uint32 r, ranktablesize;
+				cmph_uint8 *g;
+				searcher->hashfunc = (CMPH_HASH)ptr[1];
+				searcher->hash_packed = hl_ptr;
+				ranktable = (cmph_uint32 *)(hl_ptr + hash_state_packed_size(searcher->hashfunc));
+				r = *ranktable++;
+				ranktablesize = *ranktable++;
+				g = (cmph_uint8 *)(ranktable + ranktablesize);
+				searcher->search = bdz_searcher_packed_hash;
+				searcher_set_bdz(searcher, r, *g, ranktable, g + 1);
+				if (searcher->hashfunc == CMPH_HASH_JENKINS) searcher_set_jenkins(searcher, hl_ptr);
+			}
+			break;
+		case CMPH_BDZ_PH:
+			searcher->search = bdz_ph_searcher_packed;
+			break;
+		case CMPH_CHD_PH:
+			searcher_set_chd_ph_packed(searcher, (cmph_uint8 *)(ptr + 1));
+			searcher->search = chd_ph_searcher_packed;
+			break;
+		case CMPH_CHD:
+			{
+				// the layout written by chd_pack()
+				cmph_uint32 packed_cr_size = ptr[1];
+				cmph_uint8 *packed_cr = (cmph_uint8 *)(ptr + 2);
+				searcher_set_chd(searcher, packed_cr, packed_cr + packed_cr_size + sizeof(cmph_uint32));
+			}
+			break;
+		default:
+			free(searcher);
+			return NULL;
+	}
+	DEBUGP("Searcher for algorithm %u, inline path %u\n", searcher->algo, searcher->bdz_jenkins);
+	return searcher;
+}
+
+void cmph_searcher_destroy(cmph_searcher_t *searcher)
+{
+	free(searcher);
+}
+
+void cmph_searcher_search_batch(const cmph_searcher_t *searcher, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values)
+{
+	cmph_uint32 hl[SEARCHER_BATCH][3];
+	cmph_uint32 i, j, n;
+	if (searcher->algo != CMPH_BDZ || (!searcher->bdz_jenkins && searcher->hash_packed == NULL))
+	{
+		for (i = 0; i < nkeys; ++i) values[i] = searcher->search(searcher, keys[i], keylens[i]);
+		return;
+	}
+	for (i = 0; i < nkeys; i += n)
+	{
+		n = nkeys - i < SEARCHER_BATCH ? nkeys - i : SEARCHER_BATCH;
+		// the bytes of g of the vertices of the keys
+		for (j = 0; j < n; ++j)
+		{
+			if (searcher->bdz_jenkins) cmph_searcher_jenkins(searcher->seed, (const unsigned char *)keys[i + j], keylens[i + j], hl[j]);
+			else hash_vector_packed((void *)searcher->hash_packed, searcher->hashfunc, keys[i + j], keylens[i + j], hl[j]);
+			cmph_searcher_bdz_vertices(searcher, hl[j]);
+			SEARCHER_PREFETCH(searcher->g + (hl[j][0] >> 2));
+			SEARCHER_PREFETCH(searcher->g + (hl[j][1] >> 2));
+			SEARCHER_PREFETCH(searcher->g + (hl[j][2] >> 2));
+		}
+		// the entries of the rank table of the vertices selected and the bytes of g counted from them
+		for (j = 0; j < n; ++j)
+		{
+			cmph_uint32 index;
+			hl[j][0] = cmph_searcher_bdz_vertex(searcher, hl[j]);
+			index = hl[j][0] >> searcher->b;
+			SEARCHER_PREFETCH(searcher->ranktable + index);
+			SEARCHER_PREFETCH(searcher->g + ((index << searcher->b) >> 2));
+		}
+		for (j = 0; j < n; ++j) values[i + j] = cmph_searcher_bdz_rank(searcher, hl[j][0]);
+	}
+}
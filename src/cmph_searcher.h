@@ -0,0 +1,199 @@
+#ifndef __CMPH_SEARCHER_H__
+#define __CMPH_SEARCHER_H__
+
+#include "cmph.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* A searcher is a function resolved once for repeated lookups. The search
+ * routine for its algorithm and hash function is bound to it, so a lookup
+ * does not switch on the algorithm. The headers of BDZ, CHD_PH and CHD
+ * functions are decoded when the searcher is created, so their lookups do
+ * not read them again. Other algorithms are searched by their own search
+ * routines, which still read the packed header on each lookup.
+ *
+ * BDZ functions with the Jenkins hash, the most common combination, are
+ * searched by cmph_searcher_search() inline from this header. The
+ * fields below are only meant for the search routines.
+ */
+typedef struct __cmph_searcher_t cmph_searcher_t;
+struct __cmph_searcher_t
+{
+	cmph_uint32 (*search)(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen);
+	void *mphf;                        // cmph_t or packed function, past its algorithm
+	CMPH_ALGO algo;
+	CMPH_HASH hashfunc;
+	const void *hash_packed;           // packed hash function
+	cmph_uint32 bdz_jenkins;           // whether the inline fast path applies
+	cmph_uint32 seed;                  // seed of the Jenkins hash
+	cmph_uint32 r;                     // BDZ: vertices in each part of the hypergraph
+	cmph_uint64 r_magic;               // floor((2^64 - 1)/r)
+	cmph_uint32 b;                     // BDZ: log2 of the keys ranked by an entry of ranktable
+	const cmph_uint32 *ranktable;
+	const cmph_uint8 *g;
+	const cmph_uint8 *lookup_table;    // number of assigned vertices in a byte of g
+	cmph_uint32 n;                     // CHD_PH, CHD: bins of the function
+	cmph_uint32 nbuckets;              // CHD_PH, CHD: buckets of the displacements
+	cmph_uint64 n_magic;               // fastmod magic numbers of n, n - 1 and nbuckets
+	cmph_uint64 n1_magic;
+	cmph_uint64 nbuckets_magic;
+	const void *cs;                    // CHD_PH, CHD: displacements, packed unless of a CHD_PH cmph_t
+	const void *cr;                    // CHD: packed rank of the empty bins
+};
+
+/** \fn cmph_searcher_t *cmph_searcher_new(cmph_t *mphf);
+ *  \brief Creates a searcher for a function in memory.
+ *  \param mphf function, which must outlive the searcher
+ *  \return the searcher or NULL for failures
+ */
+cmph_searcher_t *cmph_searcher_new(cmph_t *mphf);
+
+/** \fn cmph_searcher_t *cmph_searcher_new_packed(void *packed_mphf);
+ *  \brief Creates a searcher for a packed function, as filled by cmph_pack().
+ *  \param packed_mphf packed function, which must outlive the searcher
+ *  \return the searcher or NULL for failures
+ */
+cmph_searcher_t *cmph_searcher_new_packed(void *packed_mphf);
+
+void cmph_searcher_destroy(cmph_searcher_t *searcher);
+
+static inline cmph_uint32 cmph_searcher_reduce(cmph_uint32 h, cmph_uint64 magic, cmph_uint32 d)
+{
+#ifdef __SIZEOF_INT128__
+	// the quotient is off by at most one, see fastmod.h
+	cmph_uint32 q = (cmph_uint32)(((unsigned __int128)h * magic) >> 64);
+	cmph_uint32 rem = h - q * d;
+	return rem >= d ? rem - d : rem;
+#else
+	(void)magic;
+	return h % d;
+#endif
+}
+
+#define CMPH_SEARCHER_MIX(a,b,c) \
+{ \
+	a -= b; a -= c; a ^= (c>>13); \
+	b -= c; b -= a; b ^= (a<<8); \
+	c -= a; c -= b; c ^= (b>>13); \
+	a -= b; a -= c; a ^= (c>>12);  \
+	b -= c; b -= a; b ^= (a<<16); \
+	c -= a; c -= b; c ^= (b>>5); \
+	a -= b; a -= c; a ^= (c>>3);  \
+	b -= c; b -= a; b ^= (a<<10); \
+	c -= a; c -= b; c ^= (b>>15); \
+}
+
+/* The Jenkins hash vector of jenkins_hash.c. */
+static inline void cmph_searcher_jenkins(cmph_uint32 seed, const unsigned char *k, cmph_uint32 keylen, cmph_uint32 *hashes)
+{
+	cmph_uint32 a = 0x9e3779b9, b = 0x9e3779b9, c = seed;
+	cmph_uint32 len = keylen;
+	while (len >= 12)
+	{
+		a += ((cmph_uint32)k[0] +((cmph_uint32)k[1]<<8) +((cmph_uint32)k[2]<<16) +((cmph_uint32)k[3]<<24));
+		b += ((cmph_uint32)k[4] +((cmph_uint32)k[5]<<8) +((cmph_uint32)k[6]<<16) +((cmph_uint32)k[7]<<24));
+		c += ((cmph_uint32)k[8] +((cmph_uint32)k[9]<<8) +((cmph_uint32)k[10]<<16)+((cmph_uint32)k[11]<<24));
+		CMPH_SEARCHER_MIX(a, b, c);
+		k += 12; len -= 12;
+	}
+	c += keylen;
+	/* the cases of jenkins_hash.c falling through, without a switch that
+	 * -Wimplicit-fallthrough would warn about in the programs including this
+	 */
+	if (len > 10) c += ((cmph_uint32)k[10]<<24);
+	if (len > 9) c += ((cmph_uint32)k[9]<<16);
+	if (len > 8) c += ((cmph_uint32)k[8]<<8);
+	if (len > 7) b += ((cmph_uint32)k[7]<<24);
+	if (len > 6) b += ((cmph_uint32)k[6]<<16);
+	if (len > 5) b += ((cmph_uint32)k[5]<<8);
+	if (len > 4) b += (cmph_uint8)k[4];
+	if (len > 3) a += ((cmph_uint32)k[3]<<24);
+	if (len > 2) a += ((cmph_uint32)k[2]<<16);
+	if (len > 1) a += ((cmph_uint32)k[1]<<8);
+	if (len > 0) a += (cmph_uint8)k[0];
+	CMPH_SEARCHER_MIX(a, b, c);
+	hashes[0] = a;
+	hashes[1] = b;
+	hashes[2] = c;
+}
+
+#define CMPH_SEARCHER_GETVALUE(g, i) ((cmph_uint32)((g[(i) >> 2] >> (((i) & 3U) << 1)) & 3U))
+
+/* Maps the three hash values of a key to its vertices in the BDZ hypergraph. */
+static inline void cmph_searcher_bdz_vertices(const cmph_searcher_t *searcher, cmph_uint32 *hl)
+{
+	cmph_uint32 r = searcher->r;
+	hl[0] = cmph_searcher_reduce(hl[0], searcher->r_magic, r);
+	hl[1] = cmph_searcher_reduce(hl[1], searcher->r_magic, r) + r;
+	hl[2] = cmph_searcher_reduce(hl[2], searcher->r_magic, r) + (r << 1);
+}
+
+/* Selects the vertex of a key among its three vertices. */
+static inline cmph_uint32 cmph_searcher_bdz_vertex(const cmph_searcher_t *searcher, const cmph_uint32 *hl)
+{
+	const cmph_uint8 *g = searcher->g;
+	return hl[(CMPH_SEARCHER_GETVALUE(g, hl[0]) + CMPH_SEARCHER_GETVALUE(g, hl[1]) + CMPH_SEARCHER_GETVALUE(g, hl[2])) % 3];
+}
+
+/* Rank of vertex among the assigned vertices, the value of its key. */
+static inline cmph_uint32 cmph_searcher_bdz_rank(const cmph_searcher_t *searcher, cmph_uint32 vertex)
+{
+	const cmph_uint8 *g = searcher->g;
+	cmph_uint32 index, base_rank, beg_idx_b, end_idx_b, beg_idx_v;
+	index = vertex >> searcher->b;
+	base_rank = searcher->ranktable[index];
+	beg_idx_b = (index << searcher->b) >> 2;
+	end_idx_b = vertex >> 2;
+	while (beg_idx_b < end_idx_b) base_rank += searcher->lookup_table[g[beg_idx_b++]];
+	for (beg_idx_v = beg_idx_b << 2; beg_idx_v < vertex; beg_idx_v++)
+	{
+		if (CMPH_SEARCHER_GETVALUE(g, beg_idx_v) != 3U) base_rank++;
+	}
+	return base_rank;
+}
+
+/* Maps the three hash values of a key to its value in a BDZ function. */
+static inline cmph_uint32 cmph_searcher_bdz(const cmph_searcher_t *searcher, cmph_uint32 *hl)
+{
+	cmph_searcher_bdz_vertices(searcher, hl);
+	return cmph_searcher_bdz_rank(searcher, cmph_searcher_bdz_vertex(searcher, hl));
+}
+
+/* Searches a BDZ function with the Jenkins hash, as bdz_search(). */
+static inline cmph_uint32 cmph_searcher_search_bdz_jenkins(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen)
+{
+	cmph_uint32 hl[3];
+	cmph_searcher_jenkins(searcher->seed, (const unsigned char *)key, keylen, hl);
+	return cmph_searcher_bdz(searcher, hl);
+}
+
+/** \fn cmph_uint32 cmph_searcher_search(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen);
+ *  \brief Computes the mphf value, as cmph_search() or cmph_search_packed() would.
+ *  \param searcher the resolved function
+ *  \param key is the key to be hashed
+ *  \param keylen is the key legth in bytes
+ *  \return The mphf value
+ */
+static inline cmph_uint32 cmph_searcher_search(const cmph_searcher_t *searcher, const char *key, cmph_uint32 keylen)
+{
+	if (searcher->bdz_jenkins) return cmph_searcher_search_bdz_jenkins(searcher, key, keylen);
+	return searcher->search(searcher, key, keylen);
+}
+
+/** \fn void cmph_searcher_search_batch(const cmph_searcher_t *searcher, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+ *  \brief Computes the mphf values of nkeys keys. The keys of BDZ functions
+ *  are searched in groups whose memory accesses are prefetched together,
+ *  so that their cache misses overlap. Other functions are searched one key
+ *  at a time.
+ *  \param values receives the value of each key
+ */
+void cmph_searcher_search_batch(const cmph_searcher_t *searcher, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
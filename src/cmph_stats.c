@@ -0,0 +1,209 @@
+#include "cmph_stats.h"
+#include "cmph_structs.h"
+
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#ifdef __GNUC__
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+//#define DEBUG
+#include "debug.h"
+
+const char *cmph_phase_names[] = { "mapping", "ordering", "searching", "assigning", "ranking", "io", NULL };
+
+static double stats_wall(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#else
+	return (double)time(NULL);
+#endif
+}
+
+double cmph_stats_thread_cpu(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#elif defined(__GNUC__)
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	return (double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec / 1e6 +
+	       (double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec / 1e6;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+void cmph_config_set_stats(cmph_config_t *mph, cmph_stats_t *stats)
+{
+	mph->stats = stats;
+}
+
+void cmph_stats_clear(cmph_stats_t *stats)
+{
+	memset(stats, 0, sizeof(cmph_stats_t));
+	stats->algo = CMPH_COUNT;
+}
+
+void cmph_stats_begin(cmph_stats_t *stats, cmph_stats_mark_t *mark)
+{
+	if (stats == NULL) return;
+	mark->wall = stats_wall();
+	mark->cpu = cmph_stats_thread_cpu();
+}
+
+void cmph_stats_end(cmph_stats_t *stats, CMPH_PHASE phase, const cmph_stats_mark_t *mark)
+{
+	if (stats == NULL) return;
+	stats->wall[phase] += stats_wall() - mark->wall;
+	stats->cpu[phase] += cmph_stats_thread_cpu() - mark->cpu;
+}
+
+void cmph_stats_add_cpu(cmph_stats_t *stats, CMPH_PHASE phase, double cpu)
+{
+	if (stats == NULL) return;
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	stats->cpu[phase] += cpu;
+	stats->total_cpu += cpu;
+#else
+	(void)phase; (void)cpu; // already in the CPU time of the process
+#endif
+}
+
+void __cmph_stats_finish(cmph_stats_t *stats, const cmph_stats_mark_t *mark)
+{
+	if (stats == NULL) return;
+	stats->total_wall = stats_wall() - mark->wall;
+	stats->total_cpu += cmph_stats_thread_cpu() - mark->cpu; // after the helper threads
+	cmph_stats_memory(stats);
+}
+
+/* Adds the phases, attempts and items of a function built by the
+ * generation (CHD builds CHD_PH) to its statistics. The totals are left
+ * out, since the generation counts the nested one in its own.
+ */
+void __cmph_stats_merge(cmph_stats_t *stats, const cmph_stats_t *nested)
+{
+	cmph_uint32 i;
+	if (stats == NULL) return;
+	for (i = 0; i < CMPH_PHASE_COUNT; ++i)
+	{
+		stats->wall[i] += nested->wall[i];
+		stats->cpu[i] += nested->cpu[i];
+	}
+	stats->iterations += nested->iterations;
+	stats->failures += nested->failures;
+	if (nested->peak_memory > stats->peak_memory) stats->peak_memory = nested->peak_memory;
+	for (i = 0; i < nested->ncomponents; ++i) cmph_stats_component(stats, nested->components[i].name, nested->components[i].value);
+	for (i = 0; i < nested->nparameters; ++i) cmph_stats_parameter(stats, nested->parameters[i].name, nested->parameters[i].value);
+}
+
+static cmph_stats_item_t *stats_item(cmph_stats_item_t *items, cmph_uint32 *nitems, const char *name)
+{
+	cmph_uint32 i;
+	for (i = 0; i < *nitems; ++i)
+	{
+		if (strcmp(items[i].name, name) == 0) return items + i;
+	}
+	if (*nitems == CMPH_STATS_MAX_ITEMS) return NULL;
+	items[i].name = name;
+	items[i].value = 0;
+	++*nitems;
+	return items + i;
+}
+
+void cmph_stats_iteration(cmph_stats_t *stats, int ok)
+{
+	if (stats == NULL) return;
+	++stats->iterations;
+	if (!ok) ++stats->failures;
+}
+
+void cmph_stats_component(cmph_stats_t *stats, const char *name, double bits)
+{
+	cmph_stats_item_t *item;
+	if (stats == NULL) return;
+	item = stats_item(stats->components, &stats->ncomponents, name);
+	if (item) item->value += bits;
+}
+
+void cmph_stats_parameter(cmph_stats_t *stats, const char *name, double value)
+{
+	cmph_stats_item_t *item;
+	if (stats == NULL) return;
+	item = stats_item(stats->parameters, &stats->nparameters, name);
+	if (item) item->value = value;
+}
+
+void cmph_stats_memory(cmph_stats_t *stats)
+{
+#ifdef __GNUC__
+	struct rusage usage;
+	cmph_uint64 peak;
+	if (stats == NULL || getrusage(RUSAGE_SELF, &usage) != 0) return;
+#ifdef __APPLE__
+	peak = (cmph_uint64)usage.ru_maxrss;           // bytes
+#else
+	peak = (cmph_uint64)usage.ru_maxrss * 1024;    // kilobytes
+#endif
+	if (peak > stats->peak_memory) stats->peak_memory = peak;
+#else
+	(void)stats;
+#endif
+}
+
+static void stats_json_string(const char *s, FILE *f)
+{
+	fputc('"', f);
+	for (; *s; ++s)
+	{
+		unsigned char ch = (unsigned char)*s;
+		if (ch == '"' || ch == '\\') fprintf(f, "\\%c", ch);
+		else if (ch < 0x20) fprintf(f, "\\u%04x", ch);
+		else fputc(ch, f);
+	}
+	fputc('"', f);
+}
+
+int cmph_stats_json(const cmph_stats_t *stats, const char *name, FILE *f)
+{
+	double bits = 0;
+	cmph_uint32 i;
+	fputc('{', f);
+	if (name)
+	{
+		fprintf(f, "\"name\":");
+		stats_json_string(name, f);
+		fputc(',', f);
+	}
+	fprintf(f, "\"algo\":\"%s\",\"nkeys\":%u,\"wall_seconds\":%.6f,\"cpu_seconds\":%.6f,\"phases\":{",
+	        stats->algo < CMPH_COUNT ? cmph_names[stats->algo] : "", stats->nkeys, stats->total_wall, stats->total_cpu);
+	for (i = 0; i < CMPH_PHASE_COUNT; ++i)
+	{
+		fprintf(f, "%s\"%s\":{\"wall_seconds\":%.6f,\"cpu_seconds\":%.6f}", i ? "," : "", cmph_phase_names[i], stats->wall[i], stats->cpu[i]);
+	}
+	fprintf(f, "},\"iterations\":%u,\"failures\":%u,\"%s\":%llu,\"bits_per_key\":{",
+	        stats->iterations, stats->failures, stats->shared_process ? "process_peak_memory_bytes" : "peak_memory_bytes",
+	        (unsigned long long)stats->peak_memory);
+	for (i = 0; i < stats->ncomponents; ++i)
+	{
+		bits += stats->components[i].value;
+		fprintf(f, "\"%s\":%.4f,", stats->components[i].name, stats->nkeys ? stats->components[i].value / stats->nkeys : 0.0);
+	}
+	fprintf(f, "\"total\":%.4f},\"parameters\":{", stats->nkeys ? bits / stats->nkeys : 0.0);
+	for (i = 0; i < stats->nparameters; ++i)
+	{
+		fprintf(f, "%s\"%s\":%.10g", i ? "," : "", stats->parameters[i].name, stats->parameters[i].value);
+	}
+	fprintf(f, "}}\n");
+	return !ferror(f);
+}
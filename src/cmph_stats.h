@@ -0,0 +1,141 @@
+#ifndef __CMPH_STATS_H__
+#define __CMPH_STATS_H__
+
+#include "cmph.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Statistics of the generation of a function, filled by cmph_new() when
+ * they are given to the configuration by cmph_config_set_stats().
+ *
+ * The time of each phase is counted in wall and in CPU seconds, the CPU
+ * time being of the thread calling cmph_new() and of the workers of BRZ,
+ * where the platform has thread clocks, and of the whole process otherwise.
+ * Phases run by an algorithm:
+ *
+ *   mapping    hashing the keys to a graph, to buckets or to bins, with the
+ *              reading of the keys by the adapter
+ *   ordering   sorting the buckets (FCH, CHD) or the critical vertices (BMZ)
+ *   searching  peeling or checking the graph, searching the displacements,
+ *              building the functions of the buckets of BRZ
+ *   assigning  assigning the values of the vertices
+ *   ranking    building the rank structures and compressing the result
+ *   io         partitioning the keys into temporary files (BRZ), and writing
+ *              the function when it is recorded by the caller
+ *
+ * The mapping is retried until the graph has the needed property, so
+ * iterations counts the attempts and failures the ones that were given up.
+ */
+typedef enum
+{
+	CMPH_PHASE_MAPPING,
+	CMPH_PHASE_ORDERING,
+	CMPH_PHASE_SEARCHING,
+	CMPH_PHASE_ASSIGNING,
+	CMPH_PHASE_RANKING,
+	CMPH_PHASE_IO,
+	CMPH_PHASE_COUNT
+} CMPH_PHASE;
+extern const char *cmph_phase_names[];
+
+#define CMPH_STATS_MAX_ITEMS 16
+
+typedef struct
+{
+	const char *name;   // a static string
+	double value;
+} cmph_stats_item_t;
+
+typedef struct
+{
+	CMPH_ALGO algo;
+	cmph_uint32 nkeys;
+	double wall[CMPH_PHASE_COUNT];     // seconds
+	double cpu[CMPH_PHASE_COUNT];      // CPU seconds of the threads of the generation
+	double total_wall;                 // of cmph_new()
+	double total_cpu;
+	cmph_uint32 iterations;
+	cmph_uint32 failures;
+	cmph_uint64 peak_memory;           // peak resident memory of the process, in bytes
+	cmph_uint8 shared_process;         // set by the caller when other work ran in the process
+	cmph_uint32 ncomponents;
+	cmph_stats_item_t components[CMPH_STATS_MAX_ITEMS];  // bits of each part of the function
+	cmph_uint32 nparameters;
+	cmph_stats_item_t parameters[CMPH_STATS_MAX_ITEMS];  // parameters chosen by the algorithm
+} cmph_stats_t;
+
+/* Start of a phase. */
+typedef struct
+{
+	double wall;
+	double cpu;
+} cmph_stats_mark_t;
+
+/** \fn void cmph_config_set_stats(cmph_config_t *mph, cmph_stats_t *stats);
+ *  \brief Makes cmph_new() fill stats, which is cleared first.
+ *  \param stats statistics, which must outlive the generation, or NULL
+ */
+void cmph_config_set_stats(cmph_config_t *mph, cmph_stats_t *stats);
+
+void cmph_stats_clear(cmph_stats_t *stats);
+
+/** \fn void cmph_stats_begin(cmph_stats_t *stats, cmph_stats_mark_t *mark);
+ *  \brief Marks the start of a phase, which cmph_stats_end() closes. Both
+ *  do nothing when stats is NULL.
+ */
+void cmph_stats_begin(cmph_stats_t *stats, cmph_stats_mark_t *mark);
+void cmph_stats_end(cmph_stats_t *stats, CMPH_PHASE phase, const cmph_stats_mark_t *mark);
+
+/** \fn double cmph_stats_thread_cpu(void);
+ *  \return the CPU seconds used so far by the calling thread, or by the
+ *  process where the platform has no thread clock
+ */
+double cmph_stats_thread_cpu(void);
+
+/** \fn void cmph_stats_add_cpu(cmph_stats_t *stats, CMPH_PHASE phase, double cpu);
+ *  \brief Adds the CPU seconds of a helper thread of the generation, measured
+ *  with cmph_stats_thread_cpu(), to a phase and to the total. It is called by
+ *  the thread calling cmph_new() once the helper has finished.
+ */
+void cmph_stats_add_cpu(cmph_stats_t *stats, CMPH_PHASE phase, double cpu);
+
+/** \fn void cmph_stats_iteration(cmph_stats_t *stats, int ok);
+ *  \brief Counts an attempt of the mapping, and a failure unless ok.
+ */
+void cmph_stats_iteration(cmph_stats_t *stats, int ok);
+
+/** \fn void cmph_stats_component(cmph_stats_t *stats, const char *name, double bits);
+ *  \brief Records the size of a part of the function. Parts of the same
+ *  name are added up.
+ *  \param name a static string
+ */
+void cmph_stats_component(cmph_stats_t *stats, const char *name, double bits);
+
+/** \fn void cmph_stats_parameter(cmph_stats_t *stats, const char *name, double value);
+ *  \brief Records a parameter, replacing the value of the same name.
+ *  \param name a static string
+ */
+void cmph_stats_parameter(cmph_stats_t *stats, const char *name, double value);
+
+/** \fn void cmph_stats_memory(cmph_stats_t *stats);
+ *  \brief Updates the peak memory, where the platform reports it. It is of
+ *  the whole process, so cmph_stats_json() names it process_peak_memory_bytes
+ *  instead of peak_memory_bytes when shared_process is set.
+ */
+void cmph_stats_memory(cmph_stats_t *stats);
+
+/** \fn int cmph_stats_json(const cmph_stats_t *stats, const char *name, FILE *f);
+ *  \brief Writes stats to f as a JSON object on a single line.
+ *  \param name if not NULL, written as the "name" member, as a JSON string
+ *  \return 1 for success and 0 for failures
+ */
+int cmph_stats_json(const cmph_stats_t *stats, const char *name, FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -12,8 +12,10 @@ cmph_config_t *__config_new(cmph_io_adapter_t *key_source)
 	memset(mph, 0, sizeof(cmph_config_t));
 	mph->key_source = key_source;
 	mph->verbosity = 0;
+	mph->nthreads = 1;
 	mph->data = NULL;
 	mph->c = 0;
+	mph->stats = NULL;
 	return mph;
 }
 
@@ -2,6 +2,7 @@
 #define __CMPH_STRUCTS_H__
 
 #include "cmph.h"
+#include "cmph_stats.h"
 
 /** Hash generation algorithm data
   */
@@ -10,7 +11,9 @@ struct __config_t
         CMPH_ALGO algo;
         cmph_io_adapter_t *key_source;
         cmph_uint32 verbosity;
+        cmph_uint32 nthreads; // number of threads for algorithms with parallel construction
         double c;
+        cmph_stats_t *stats; // filled by cmph_new() when not NULL
         void *data; // algorithm dependent data
 };
 
@@ -28,6 +31,8 @@ cmph_config_t *__config_new(cmph_io_adapter_t *key_source);
 void __config_destroy(cmph_config_t*);
 void __cmph_dump(cmph_t *mphf, FILE *);
 cmph_t *__cmph_load(FILE *f);
+void __cmph_stats_finish(cmph_stats_t *stats, const cmph_stats_mark_t *mark);
+void __cmph_stats_merge(cmph_stats_t *stats, const cmph_stats_t *nested);
 
 
 #endif
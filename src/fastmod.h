@@ -0,0 +1,61 @@
+#ifndef __CMPH_FASTMOD_H__
+#define __CMPH_FASTMOD_H__
+
+#include "cmph_types.h"
+
+/* Division-free reduction by a 32-bit divisor d fixed at construction time.
+ * The magic number floor((2^64 - 1)/d) is computed once with fastmod_magic()
+ * and stored along with d. A reduction then costs one 64x64->128 bit
+ * multiplication (high half only) plus at most two corrections, and it is
+ * exact for every 64-bit dividend (Barrett reduction).
+ */
+
+/** \fn cmph_uint64 fastmod_magic(cmph_uint32 d);
+ *  \brief Computes the magic number used to reduce values by d.
+ *  \param d divisor, must be greater than zero
+ *  \return the magic number for d
+ */
+static inline cmph_uint64 fastmod_magic(cmph_uint32 d)
+{
+	return ((cmph_uint64)-1) / d;
+}
+
+static inline cmph_uint64 fastmod_mulhi(cmph_uint64 a, cmph_uint64 b)
+{
+#ifdef __SIZEOF_INT128__
+	return (cmph_uint64)(((unsigned __int128)a * b) >> 64);
+#else
+	register cmph_uint64 a_lo = a & 0xffffffffU, a_hi = a >> 32;
+	register cmph_uint64 b_lo = b & 0xffffffffU, b_hi = b >> 32;
+	register cmph_uint64 lo_lo = a_lo * b_lo;
+	register cmph_uint64 hi_lo = a_hi * b_lo;
+	register cmph_uint64 lo_hi = a_lo * b_hi;
+	register cmph_uint64 cross = (lo_lo >> 32) + (hi_lo & 0xffffffffU) + lo_hi;
+	return a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+/** \fn cmph_uint32 fastmod_div(cmph_uint64 a, cmph_uint64 magic, cmph_uint32 d);
+ *  \brief Computes a / d. The quotient must fit in 32 bits.
+ */
+static inline cmph_uint32 fastmod_div(cmph_uint64 a, cmph_uint64 magic, cmph_uint32 d)
+{
+	register cmph_uint64 q = fastmod_mulhi(a, magic);
+	register cmph_uint64 r = a - q * d;
+	if (r >= d) { r -= d; q++; }
+	if (r >= d) { q++; }
+	return (cmph_uint32)q;
+}
+
+/** \fn cmph_uint32 fastmod_mod(cmph_uint64 a, cmph_uint64 magic, cmph_uint32 d);
+ *  \brief Computes a % d.
+ */
+static inline cmph_uint32 fastmod_mod(cmph_uint64 a, cmph_uint64 magic, cmph_uint32 d)
+{
+	register cmph_uint64 r = a - fastmod_mulhi(a, magic) * d;
+	if (r >= d) r -= d;
+	if (r >= d) r -= d;
+	return (cmph_uint32)r;
+}
+
+#endif
@@ -93,7 +93,7 @@ static fch_buckets_t * mapping(cmph_config_t *mph)
 	fch->p1 = fch_calc_p1(fch->m);
 	fch->p2 = fch_calc_p2(fch->b);
 	//DEBUGP("b:%u   p1:%f   p2:%f\n", fch->b, fch->p1, fch->p2);
-	buckets = fch_buckets_new(fch->b);
+	buckets = fch_buckets_new(fch->b, fch->m);
 
 	mph->key_source->rewind(mph->key_source->data);
 	for(i = 0; i < fch->m; i++)
@@ -107,6 +107,7 @@ static fch_buckets_t * mapping(cmph_config_t *mph)
 		key = NULL; // transger memory ownership
 
 	}
+	fch_buckets_finalize(buckets);
 	return buckets;
 }
 
@@ -254,6 +255,7 @@ cmph_t *fch_new(cmph_config_t *mph, double c)
 	cmph_uint8 restart_mapping = 0;
 	fch_buckets_t * buckets = NULL;
 	cmph_uint32 * sorted_indexes = NULL;
+	cmph_stats_mark_t mark;
 	fch_config_data_t *fch = (fch_config_data_t *)mph->data;
 	fch->m = mph->key_source->nkeys;
 	//DEBUGP("m: %f\n", fch->m);
@@ -270,18 +272,25 @@ cmph_t *fch_new(cmph_config_t *mph, double c)
 			fprintf(stderr, "Entering mapping step for mph creation of %u keys\n", fch->m);
 		}
 		if (buckets) fch_buckets_destroy(buckets, mph);
+		cmph_stats_begin(mph->stats, &mark);
 		buckets = mapping(mph);
+		cmph_stats_end(mph->stats, CMPH_PHASE_MAPPING, &mark);
 		if (mph->verbosity)
 		{
 			fprintf(stderr, "Starting ordering step\n");
 		}
 		if (sorted_indexes) free (sorted_indexes);
+		cmph_stats_begin(mph->stats, &mark);
 		sorted_indexes = ordering(buckets);
+		cmph_stats_end(mph->stats, CMPH_PHASE_ORDERING, &mark);
 		if (mph->verbosity)
 		{
 			fprintf(stderr, "Starting searching step.\n");
 		}
+		cmph_stats_begin(mph->stats, &mark);
 		restart_mapping = searching(fch, buckets, sorted_indexes);
+		cmph_stats_end(mph->stats, CMPH_PHASE_SEARCHING, &mark);
+		cmph_stats_iteration(mph->stats, !restart_mapping);
 		iterations--;
 
         } while(restart_mapping && iterations > 0);
@@ -291,8 +300,10 @@ cmph_t *fch_new(cmph_config_t *mph, double c)
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
 	fchf = (fch_data_t *)malloc(sizeof(fch_data_t));
-	fchf->g = fch->g;
-	fch->g = NULL; //transfer memory ownership
+	fchf->g_bits = packed_table_width(fch->m - 1);
+	fchf->g = packed_table_new(fch->g, fch->b, fchf->g_bits);
+	free(fch->g);
+	fch->g = NULL;
 	fchf->h1 = fch->h1;
 	fch->h1 = NULL; //transfer memory ownership
 	fchf->h2 = fch->h2;
@@ -304,6 +315,12 @@ cmph_t *fch_new(cmph_config_t *mph, double c)
 	fchf->m = fch->m;
 	mphf->data = fchf;
 	mphf->size = fch->m;
+	cmph_stats_component(mph->stats, "g", (double)fchf->b * fchf->g_bits);
+	cmph_stats_component(mph->stats, "hash", (hash_state_packed_size(fch->hashfuncs[0]) + hash_state_packed_size(fch->hashfuncs[1]))*8.0);
+	cmph_stats_parameter(mph->stats, "c", c);
+	cmph_stats_parameter(mph->stats, "b", fchf->b);
+	cmph_stats_parameter(mph->stats, "p1", fchf->p1);
+	cmph_stats_parameter(mph->stats, "p2", fchf->p2);
 	//DEBUGP("Successfully generated minimal perfect hash\n");
 	if (mph->verbosity)
 	{
@@ -338,11 +355,12 @@ int fch_dump(cmph_t *mphf, FILE *fd)
 	nbytes = fwrite(&(data->b), sizeof(cmph_uint32), (size_t)1, fd);
 	nbytes = fwrite(&(data->p1), sizeof(double), (size_t)1, fd);
 	nbytes = fwrite(&(data->p2), sizeof(double), (size_t)1, fd);
-	nbytes = fwrite(data->g, sizeof(cmph_uint32)*(data->b), (size_t)1, fd);
+	nbytes = fwrite(&(data->g_bits), sizeof(cmph_uint32), (size_t)1, fd);
+	nbytes = fwrite(data->g, sizeof(cmph_uint32)*PACKED_TABLE_SIZE(data->b, data->g_bits), (size_t)1, fd);
 	#ifdef DEBUG
 	cmph_uint32 i;
 	fprintf(stderr, "G: ");
-	for (i = 0; i < data->b; ++i) fprintf(stderr, "%u ", data->g[i]);
+	for (i = 0; i < data->b; ++i) fprintf(stderr, "%u ", get_packed_value(data->g, i, data->g_bits));
 	fprintf(stderr, "\n");
 	#endif
 	return 1;
@@ -385,12 +403,13 @@ void fch_load(FILE *f, cmph_t *mphf)
 	nbytes = fread(&(fch->p1), sizeof(double), (size_t)1, f);
 	nbytes = fread(&(fch->p2), sizeof(double), (size_t)1, f);
 
-	fch->g = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*fch->b);
-	nbytes = fread(fch->g, fch->b*sizeof(cmph_uint32), (size_t)1, f);
+	nbytes = fread(&(fch->g_bits), sizeof(cmph_uint32), (size_t)1, f);
+	fch->g = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*PACKED_TABLE_SIZE(fch->b, fch->g_bits));
+	nbytes = fread(fch->g, sizeof(cmph_uint32)*PACKED_TABLE_SIZE(fch->b, fch->g_bits), (size_t)1, f);
 	#ifdef DEBUG
 	cmph_uint32 i;
 	fprintf(stderr, "G: ");
-	for (i = 0; i < fch->b; ++i) fprintf(stderr, "%u ", fch->g[i]);
+	for (i = 0; i < fch->b; ++i) fprintf(stderr, "%u ", get_packed_value(fch->g, i, fch->g_bits));
 	fprintf(stderr, "\n");
 	#endif
 	return;
@@ -402,8 +421,8 @@ cmph_uint32 fch_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	cmph_uint32 h1 = hash(fch->h1, key, keylen) % fch->m;
 	cmph_uint32 h2 = hash(fch->h2, key, keylen) % fch->m;
 	h1 = mixh10h11h12 (fch->b, fch->p1, fch->p2, h1);
-	//DEBUGP("key: %s h1: %u h2: %u  g[h1]: %u\n", key, h1, h2, fch->g[h1]);
-	return (h2 + fch->g[h1]) % fch->m;
+	//DEBUGP("key: %s h1: %u h2: %u  g[h1]: %u\n", key, h1, h2, get_packed_value(fch->g, h1, fch->g_bits));
+	return (h2 + get_packed_value(fch->g, h1, fch->g_bits)) % fch->m;
 }
 void fch_destroy(cmph_t *mphf)
 {
@@ -459,8 +478,12 @@ void fch_pack(cmph_t *mphf, void *packed_mphf)
 	*((cmph_uint64 *)ptr) = (cmph_uint64)data->p2;
 	ptr += sizeof(data->p2);
 
+	// packing g width
+	*((cmph_uint32 *) ptr) = data->g_bits;
+	ptr += sizeof(data->g_bits);
+
 	// packing g
-	memcpy(ptr, data->g, sizeof(cmph_uint32)*(data->b));
+	memcpy(ptr, data->g, sizeof(cmph_uint32)*PACKED_TABLE_SIZE(data->b, data->g_bits));
 }
 
 /** \fn cmph_uint32 fch_packed_size(cmph_t *mphf);
@@ -475,7 +498,7 @@ cmph_uint32 fch_packed_size(cmph_t *mphf)
 	CMPH_HASH h2_type = hash_get_type(data->h2);
 
 	return (cmph_uint32)(sizeof(CMPH_ALGO) + hash_state_packed_size(h1_type) + hash_state_packed_size(h2_type) +
-			4*sizeof(cmph_uint32) + 2*sizeof(double) + sizeof(cmph_uint32)*(data->b));
+			5*sizeof(cmph_uint32) + 2*sizeof(double) + sizeof(cmph_uint32)*PACKED_TABLE_SIZE(data->b, data->g_bits));
 }
 
 
@@ -508,9 +531,11 @@ cmph_uint32 fch_search_packed(void *packed_mphf, const char *key, cmph_uint32 ke
 	register double p2 = (double)(*((cmph_uint64 *)g_ptr));
 	g_ptr += 2;
 
+	register cmph_uint32 g_bits = *g_ptr++;
+
 	register cmph_uint32 h1 = hash_packed(h1_ptr, h1_type, key, keylen) % m;
 	register cmph_uint32 h2 = hash_packed(h2_ptr, h2_type, key, keylen) % m;
 
 	h1 = mixh10h11h12 (b, p1, p2, h1);
-	return (h2 + g_ptr[h1]) % m;
+	return (h2 + get_packed_value(g_ptr, h1, g_bits)) % m;
 }
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 //#define DEBUG
 #include "debug.h"
 
@@ -13,116 +14,35 @@ typedef struct __fch_bucket_entry_t
   cmph_uint32 length;
 } fch_bucket_entry_t;
 
-typedef struct __fch_bucket_t
-{
-  fch_bucket_entry_t * entries;
-  cmph_uint32 capacity, size;
-} fch_bucket_t;
-
-
-
-static void fch_bucket_new(fch_bucket_t *bucket)
-{
-	assert(bucket);
-	bucket->size = 0;
-	bucket->entries = NULL;
-	bucket->capacity = 0;
-}
-
-static void fch_bucket_destroy(fch_bucket_t *bucket, cmph_config_t *mph)
-{
-	cmph_uint32 i;
-	assert(bucket);
-	for (i = 0; i < bucket->size; i++)
-	{
-    fch_bucket_entry_t * entry = bucket->entries + i;
-		mph->key_source->dispose(mph->key_source->data, entry->value, entry->length);
-	}
-	free(bucket->entries);
-}
-
-
-static void fch_bucket_reserve(fch_bucket_t *bucket, cmph_uint32 size)
-{
-	assert(bucket);
-	if (bucket->capacity < size)
-	{
-		cmph_uint32 new_capacity = bucket->capacity + 1;
-		DEBUGP("Increasing current capacity %u to %u\n", bucket->capacity, size);
-		while (new_capacity < size)
-		{
-			new_capacity *= 2;
-		}
-		bucket->entries = (fch_bucket_entry_t *)realloc(bucket->entries, sizeof(fch_bucket_entry_t)*new_capacity);
-		assert(bucket->entries);
-		bucket->capacity = new_capacity;
-		DEBUGP("Increased\n");
-	}
-}
-
-static void fch_bucket_insert(fch_bucket_t *bucket, char *val, cmph_uint32 val_length)
-{
-	assert(bucket);
-	fch_bucket_reserve(bucket, bucket->size + 1);
-	(bucket->entries + bucket->size)->value = val;
-	(bucket->entries + bucket->size)->length = val_length;
-	++(bucket->size);
-}
-
-
-static cmph_uint8 fch_bucket_is_empty(fch_bucket_t *bucket)
-{
-	assert(bucket);
-	return (cmph_uint8)(bucket->size == 0);
-}
-
-static cmph_uint32 fch_bucket_size(fch_bucket_t *bucket)
-{
-	assert(bucket);
-	return bucket->size;
-}
-
-static char * fch_bucket_get_key(fch_bucket_t *bucket, cmph_uint32 index_key)
-{
-	assert(bucket); assert(index_key < bucket->size);
-	return (bucket->entries + index_key)->value;
-}
-
-static cmph_uint32 fch_bucket_get_length(fch_bucket_t *bucket, cmph_uint32 index_key)
-{
-	assert(bucket); assert(index_key < bucket->size);
-	return (bucket->entries + index_key)->length;
-}
-
-static void fch_bucket_print(fch_bucket_t * bucket, cmph_uint32 index)
-{
-	cmph_uint32 i;
-	assert(bucket);
-	fprintf(stderr, "Printing bucket %u ...\n", index);
-	for (i = 0; i < bucket->size; i++)
-	{
-		fprintf(stderr, "  key: %s\n", (bucket->entries + i)->value);
-	}
-}
-
-//////////////////////////////////////////////////////////////////////////////////////
-
+/* The keys are laid out with a counting sort: fch_buckets_insert() appends
+ * them in input order and counts the bucket sizes, fch_buckets_finalize()
+ * then scatters them into a single array grouped by bucket. The buckets
+ * are placed in decreasing order of size, the order in which the searching
+ * step visits them, so it walks the keys sequentially.
+ */
 struct __fch_buckets_t
 {
-  fch_bucket_t * values;
-  cmph_uint32 nbuckets, max_size;
-
+  fch_bucket_entry_t * entries;
+  cmph_uint32 * sizes;
+  cmph_uint32 * offsets;        // first entry of each bucket
+  cmph_uint32 * bucket_of;      // bucket of each inserted key, freed by fch_buckets_finalize
+  cmph_uint32 * sorted_indexes; // buckets sorted by decreasing size
+  cmph_uint32 nbuckets, nkeys, capacity, max_size;
 };
 
-fch_buckets_t * fch_buckets_new(cmph_uint32 nbuckets)
+fch_buckets_t * fch_buckets_new(cmph_uint32 nbuckets, cmph_uint32 nkeys)
 {
-	cmph_uint32 i;
 	fch_buckets_t *buckets = (fch_buckets_t *)malloc(sizeof(fch_buckets_t));
-        if (!buckets) return NULL;
-	buckets->values = (fch_bucket_t *)calloc((size_t)nbuckets, sizeof(fch_bucket_t));
-	for (i = 0; i < nbuckets; i++) fch_bucket_new(buckets->values + i);
-	assert(buckets->values);
+	if (!buckets) return NULL;
+	buckets->entries = (fch_bucket_entry_t *)malloc(sizeof(fch_bucket_entry_t)*(size_t)nkeys + 1);
+	buckets->sizes = (cmph_uint32 *)calloc((size_t)nbuckets, sizeof(cmph_uint32));
+	buckets->offsets = NULL;
+	buckets->bucket_of = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*(size_t)nkeys + 1);
+	buckets->sorted_indexes = NULL;
+	assert(buckets->entries && buckets->sizes && buckets->bucket_of);
 	buckets->nbuckets = nbuckets;
+	buckets->nkeys = 0;
+	buckets->capacity = nkeys;
 	buckets->max_size = 0;
 	return buckets;
 }
@@ -130,36 +50,83 @@ fch_buckets_t * fch_buckets_new(cmph_uint32 nbuckets)
 cmph_uint8 fch_buckets_is_empty(fch_buckets_t * buckets, cmph_uint32 index)
 {
 	assert(index < buckets->nbuckets);
-	return fch_bucket_is_empty(buckets->values + index);
+	return (cmph_uint8)(buckets->sizes[index] == 0);
 }
 
 void fch_buckets_insert(fch_buckets_t * buckets, cmph_uint32 index, char * key, cmph_uint32 length)
 {
 	assert(index < buckets->nbuckets);
-	fch_bucket_insert(buckets->values + index, key, length);
-	if (fch_bucket_size(buckets->values + index) > buckets->max_size)
+	assert(buckets->bucket_of && buckets->nkeys < buckets->capacity);
+	buckets->entries[buckets->nkeys].value = key;
+	buckets->entries[buckets->nkeys].length = length;
+	buckets->bucket_of[buckets->nkeys++] = index;
+	if (++buckets->sizes[index] > buckets->max_size) buckets->max_size = buckets->sizes[index];
+}
+
+void fch_buckets_finalize(fch_buckets_t * buckets)
+{
+	cmph_uint32 i, sum = 0, size;
+	cmph_uint32 *nbuckets_size = (cmph_uint32 *) calloc((size_t)buckets->max_size + 1, sizeof(cmph_uint32));
+	fch_bucket_entry_t *entries = (fch_bucket_entry_t *)malloc(sizeof(fch_bucket_entry_t)*(size_t)buckets->nkeys + 1);
+	assert(nbuckets_size && entries && buckets->bucket_of);
+	buckets->offsets = (cmph_uint32 *) malloc(sizeof(cmph_uint32)*(size_t)buckets->nbuckets + 1);
+	buckets->sorted_indexes = (cmph_uint32 *) malloc(sizeof(cmph_uint32)*(size_t)buckets->nbuckets + 1);
+	assert(buckets->offsets && buckets->sorted_indexes);
+
+	// collect how many buckets for each size and compute their ranks
+	// considering a decreasing order of buckets size.
+	for (i = 0; i < buckets->nbuckets; i++) nbuckets_size[buckets->sizes[i]]++;
+	for (size = buckets->max_size + 1; size-- > 0;)
+	{
+		cmph_uint32 count = nbuckets_size[size];
+		nbuckets_size[size] = sum;
+		sum += count;
+	}
+	for (i = 0; i < buckets->nbuckets; i++)
+	{
+		buckets->sorted_indexes[nbuckets_size[buckets->sizes[i]]++] = i;
+	}
+	free(nbuckets_size);
+
+	// the buckets are laid out in that order
+	sum = 0;
+	for (i = 0; i < buckets->nbuckets; i++)
+	{
+		buckets->offsets[buckets->sorted_indexes[i]] = sum;
+		sum += buckets->sizes[buckets->sorted_indexes[i]];
+	}
+	assert(sum == buckets->nkeys);
+
+	for (i = 0; i < buckets->nkeys; i++)
 	{
-		buckets->max_size = fch_bucket_size(buckets->values + index);
+		entries[buckets->offsets[buckets->bucket_of[i]]++] = buckets->entries[i];
 	}
+	for (i = 0; i < buckets->nbuckets; i++) buckets->offsets[i] -= buckets->sizes[i];
+
+	free(buckets->bucket_of);
+	buckets->bucket_of = NULL;
+	free(buckets->entries);
+	buckets->entries = entries;
 }
 
 cmph_uint32 fch_buckets_get_size(fch_buckets_t * buckets, cmph_uint32 index)
 {
 	assert(index < buckets->nbuckets);
-	return fch_bucket_size(buckets->values + index);
+	return buckets->sizes[index];
 }
 
-
 char * fch_buckets_get_key(fch_buckets_t * buckets, cmph_uint32 index, cmph_uint32 index_key)
 {
-	assert(index < buckets->nbuckets);
-	return fch_bucket_get_key(buckets->values + index, index_key);
+	assert(index < buckets->nbuckets); assert(index_key < buckets->sizes[index]);
+	assert(buckets->offsets);
+	return buckets->entries[buckets->offsets[index] + index_key].value;
 }
 
 cmph_uint32 fch_buckets_get_keylength(fch_buckets_t * buckets, cmph_uint32 index, cmph_uint32 index_key)
 {
-	assert(index < buckets->nbuckets);
-	return fch_bucket_get_length(buckets->values + index, index_key);
+	assert(index < buckets->nbuckets); assert(index_key < buckets->sizes[index]);
+	assert(buckets->offsets);
+	return buckets->entries[buckets->offsets[index] + index_key].length;
 }
 
 cmph_uint32 fch_buckets_get_max_size(fch_buckets_t * buckets)
@@ -174,43 +141,36 @@ cmph_uint32 fch_buckets_get_nbuckets(fch_buckets_t * buckets)
 
 cmph_uint32 * fch_buckets_get_indexes_sorted_by_size(fch_buckets_t * buckets)
 {
-	cmph_int32 i = 0;
-	cmph_uint32 sum = 0, value;
-	cmph_uint32 *nbuckets_size = (cmph_uint32 *) calloc((size_t)buckets->max_size + 1, sizeof(cmph_uint32));
-	cmph_uint32 * sorted_indexes = (cmph_uint32 *) calloc((size_t)buckets->nbuckets, sizeof(cmph_uint32));
-
-	// collect how many buckets for each size.
-	for(i = 0; i < (int)buckets->nbuckets; i++) nbuckets_size[fch_bucket_size(buckets->values + i)] ++;
-
-	// calculating offset considering a decreasing order of buckets size.
-	value = nbuckets_size[buckets->max_size];
-	nbuckets_size[buckets->max_size] = sum;
-	for(i = (int)buckets->max_size - 1; i >= 0; i--)
-	{
-		sum += value;
-		value = nbuckets_size[i];
-		nbuckets_size[i] = sum;
-
-	}
-	for(i = 0; i < (int)buckets->nbuckets; i++)
-	{
-		sorted_indexes[nbuckets_size[fch_bucket_size(buckets->values + i)]] = (cmph_uint32)i;
-		nbuckets_size[fch_bucket_size(buckets->values + i)] ++;
-	}
-	free(nbuckets_size);
+	cmph_uint32 * sorted_indexes = (cmph_uint32 *) malloc(sizeof(cmph_uint32)*(size_t)buckets->nbuckets + 1);
+	assert(buckets->sorted_indexes && sorted_indexes);
+	memcpy(sorted_indexes, buckets->sorted_indexes, sizeof(cmph_uint32)*(size_t)buckets->nbuckets);
 	return sorted_indexes;
 }
 
 void fch_buckets_print(fch_buckets_t * buckets)
 {
-	cmph_uint32 i;
-	for (i = 0; i < buckets->nbuckets; i++) fch_bucket_print(buckets->values + i, i);
+	cmph_uint32 i, j;
+	for (i = 0; i < buckets->nbuckets; i++)
+	{
+		fprintf(stderr, "Printing bucket %u ...\n", i);
+		for (j = 0; j < buckets->sizes[i]; j++)
+		{
+			fprintf(stderr, "  key: %s\n", fch_buckets_get_key(buckets, i, j));
+		}
+	}
 }
 
 void fch_buckets_destroy(fch_buckets_t * buckets, cmph_config_t *mph)
 {
 	cmph_uint32 i;
-	for (i = 0; i < buckets->nbuckets; i++) fch_bucket_destroy(buckets->values + i, mph);
-	free(buckets->values);
+	for (i = 0; i < buckets->nkeys; i++)
+	{
+		mph->key_source->dispose(mph->key_source->data, buckets->entries[i].value, buckets->entries[i].length);
+	}
+	free(buckets->entries);
+	free(buckets->sizes);
+	free(buckets->offsets);
+	free(buckets->bucket_of);
+	free(buckets->sorted_indexes);
 	free(buckets);
 }
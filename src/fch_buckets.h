@@ -5,12 +5,17 @@
 #include "cmph.h"
 typedef struct __fch_buckets_t fch_buckets_t;
 
-fch_buckets_t * fch_buckets_new(cmph_uint32 nbuckets);
+// room is reserved for nkeys keys.
+fch_buckets_t * fch_buckets_new(cmph_uint32 nbuckets, cmph_uint32 nkeys);
 
 cmph_uint8 fch_buckets_is_empty(fch_buckets_t * buckets, cmph_uint32 index);
 
 void fch_buckets_insert(fch_buckets_t * buckets, cmph_uint32 index, char * key, cmph_uint32 length);
 
+// groups the inserted keys by bucket. It must be called once after the last
+// insertion and before the keys are accessed.
+void fch_buckets_finalize(fch_buckets_t * buckets);
+
 cmph_uint32 fch_buckets_get_size(fch_buckets_t * buckets, cmph_uint32 index);
 
 char * fch_buckets_get_key(fch_buckets_t * buckets, cmph_uint32 index, cmph_uint32 index_key);
@@ -10,7 +10,8 @@ struct __fch_data_t
 	cmph_uint32  b;      // parameter b = ceil(c*m/(log(m)/log(2) + 1)). Don't need to be stored 
 	double p1;     // constant p1 = ceil(0.6*m). Don't need to be stored 
 	double p2;     // constant p2 = ceil(0.3*b). Don't need to be stored 
-	cmph_uint32 *g;      // g function. 
+	cmph_uint32 g_bits;  // width of the values of g, enough for m - 1
+	cmph_uint32 *g;      // g function, packed in g_bits bits per bucket (see bitbool.h).
 	hash_state_t *h1;    // h10 function. 
 	hash_state_t *h2;    // h20 function.
 };
@@ -18,6 +18,11 @@
 
 #define abs_edge(e, i) (e % g->nedges + i * g->nedges)
 
+/* While edges are added the adjacency lists are kept in first/next. Once the
+ * graph is finalized they are replaced by a compressed sparse row layout: the
+ * neighbors of v and the ids of the edges leading to them are stored from
+ * offsets[v] to offsets[v + 1] - 1 in neighbors and edge_ids.
+ */
 struct __graph_t
 {
 	cmph_uint32 nnodes;
@@ -25,10 +30,14 @@ struct __graph_t
 	cmph_uint32 *edges;
 	cmph_uint32 *first;
 	cmph_uint32 *next;
+	cmph_uint32 *offsets;
+	cmph_uint32 *neighbors;
+	cmph_uint32 *edge_ids;
         cmph_uint8  *critical_nodes;   /* included -- Fabiano*/
         cmph_uint32 ncritical_nodes;   /* included -- Fabiano*/
 	cmph_uint32 cedges;
 	int shrinking;
+	int finalized;
 };
 
 static cmph_uint32 EMPTY = UINT_MAX;
@@ -41,6 +50,10 @@ graph_t *graph_new(cmph_uint32 nnodes, cmph_uint32 nedges)
 	graph->edges = (cmph_uint32 *)malloc(sizeof(cmph_uint32) * 2 * nedges);
 	graph->next =  (cmph_uint32 *)malloc(sizeof(cmph_uint32) * 2 * nedges);
 	graph->first = (cmph_uint32 *)malloc(sizeof(cmph_uint32) * nnodes);
+	graph->offsets = NULL;
+	graph->neighbors = NULL;
+	graph->edge_ids = NULL;
+	graph->finalized = 0;
         graph->critical_nodes = NULL; /* included -- Fabiano*/
 	graph->ncritical_nodes = 0;   /* included -- Fabiano*/
 	graph->nnodes = nnodes;
@@ -57,6 +70,9 @@ void graph_destroy(graph_t *graph)
 	free(graph->edges);
 	free(graph->first);
 	free(graph->next);
+	free(graph->offsets);
+	free(graph->neighbors);
+	free(graph->edge_ids);
         free(graph->critical_nodes); /* included -- Fabiano*/
 	free(graph);
 	return;
@@ -68,6 +84,14 @@ void graph_print(graph_t *g)
 	for (i = 0; i < g->nnodes; ++i)
 	{
 		DEBUGP("Printing edges connected to %u\n", i);
+		if (g->finalized)
+		{
+			for (e = g->offsets[i]; e < g->offsets[i + 1]; ++e)
+			{
+				printf("%u -> %u\n", g->edges[g->edge_ids[e]], g->edges[g->edge_ids[e] + g->nedges]);
+			}
+			continue;
+		}
 		e = g->first[i];
 		if (e != EMPTY)
 		{
@@ -90,6 +114,7 @@ void graph_add_edge(graph_t *g, cmph_uint32 v1, cmph_uint32 v2)
 	assert(v2 < g->nnodes);
 	assert(e < g->nedges);
 	assert(!g->shrinking);
+	assert(!g->finalized);
 
 	g->next[e] = g->first[v1];
 	g->first[v1] = e;
@@ -113,6 +138,11 @@ static int check_edge(graph_t *g, cmph_uint32 e, cmph_uint32 v1, cmph_uint32 v2)
 cmph_uint32 graph_edge_id(graph_t *g, cmph_uint32 v1, cmph_uint32 v2)
 {
 	cmph_uint32 e;
+	if (g->finalized)
+	{
+		for (e = g->offsets[v1]; g->neighbors[e] != v2; ++e) assert(e + 1 < g->offsets[v1 + 1]);
+		return g->edge_ids[e];
+	}
 	e = g->first[v1];
 	assert(e != EMPTY);
 	if (check_edge(g, e, v1, v2)) return abs_edge(e, 0);
@@ -154,6 +184,7 @@ static void del_edge_point(graph_t *g, cmph_uint32 v1, cmph_uint32 v2)
 
 void graph_del_edge(graph_t *g, cmph_uint32 v1, cmph_uint32 v2)
 {
+	assert(!g->finalized);
 	g->shrinking = 1;
 	del_edge_point(g, v1, v2);
 	del_edge_point(g, v2, v1);
@@ -162,6 +193,16 @@ void graph_del_edge(graph_t *g, cmph_uint32 v1, cmph_uint32 v2)
 void graph_clear_edges(graph_t *g)
 {
 	cmph_uint32 i;
+	if (g->finalized)
+	{
+		free(g->offsets);
+		free(g->neighbors);
+		free(g->edge_ids);
+		g->offsets = g->neighbors = g->edge_ids = NULL;
+		g->first = (cmph_uint32 *)malloc(sizeof(cmph_uint32) * g->nnodes);
+		g->next = (cmph_uint32 *)malloc(sizeof(cmph_uint32) * 2 * g->nedges);
+		g->finalized = 0;
+	}
 	for (i = 0; i < g->nnodes; ++i) g->first[i] = EMPTY;
 	for (i = 0; i < g->nedges*2; ++i)
 	{
@@ -172,73 +213,85 @@ void graph_clear_edges(graph_t *g)
 	g->shrinking = 0;
 }
 
-static cmph_uint8 find_degree1_edge(graph_t *g, cmph_uint32 v, cmph_uint8 *deleted, cmph_uint32 *e)
+void graph_finalize(graph_t *g)
 {
-	cmph_uint32 edge = g->first[v];
-	cmph_uint8 found = 0;
-	DEBUGP("Checking degree of vertex %u connected to edge %u\n", v, edge);
-	if (edge == EMPTY) return 0;
-	else if (!(GETBIT(deleted, abs_edge(edge, 0))))
+	cmph_uint32 e, v;
+	if (g->finalized) return;
+	DEBUGP("Finalizing graph with %u vertices and %u edges\n", g->nnodes, g->cedges);
+	// the edges array alone describes the graph, the lists can go first
+	free(g->first);
+	free(g->next);
+	g->first = g->next = NULL;
+	g->offsets = (cmph_uint32 *)calloc((size_t)g->nnodes + 1, sizeof(cmph_uint32));
+	g->neighbors = (cmph_uint32 *)malloc(sizeof(cmph_uint32) * 2 * g->cedges + 1);
+	g->edge_ids = (cmph_uint32 *)malloc(sizeof(cmph_uint32) * 2 * g->cedges + 1);
+	assert(g->offsets && g->neighbors && g->edge_ids);
+
+	for (e = 0; e < g->cedges; ++e)
 	{
-		found = 1;
-		*e = edge;
+		++g->offsets[g->edges[e]];
+		++g->offsets[g->edges[e + g->nedges]];
 	}
-	while(1)
+	// offsets[v] ends up one past the last neighbor of v ...
+	for (v = 1; v <= g->nnodes; ++v) g->offsets[v] += g->offsets[v - 1];
+	// ... and is moved back as the neighbors are stored, the newest edge
+	// first, so that they come in the order of the lists they replace.
+	for (e = 0; e < g->cedges; ++e)
 	{
-		edge = g->next[edge];
-		if (edge == EMPTY) break;
-		if (GETBIT(deleted, abs_edge(edge, 0))) continue;
-		if (found) return 0;
-		DEBUGP("Found first edge\n");
-		*e = edge;
-		found = 1;
+		cmph_uint32 v1 = g->edges[e + g->nedges];
+		cmph_uint32 v2 = g->edges[e];
+		cmph_uint32 i = --g->offsets[v1];
+		g->neighbors[i] = v2;
+		g->edge_ids[i] = e;
+		i = --g->offsets[v2];
+		g->neighbors[i] = v1;
+		g->edge_ids[i] = e;
 	}
-	return found;
+	g->finalized = 1;
 }
 
-static void cyclic_del_edge(graph_t *g, cmph_uint32 v, cmph_uint8 *deleted)
+cmph_uint32 graph_adjacency(graph_t *g, cmph_uint32 v, const cmph_uint32 **neighbors, const cmph_uint32 **edge_ids)
 {
+	assert(g->finalized);
+	*neighbors = g->neighbors + g->offsets[v];
+	if (edge_ids) *edge_ids = g->edge_ids + g->offsets[v];
+	return g->offsets[v + 1] - g->offsets[v];
+}
 
-	cmph_uint32 e = 0;
-	cmph_uint8 degree1;
-	cmph_uint32 v1 = v;
-	cmph_uint32 v2 = 0;
-
-	degree1 = find_degree1_edge(g, v1, deleted, &e);
-	if (!degree1) return;
-	while(1)
+/* Deletes the edges outside the 2-core, peeling degree 1 vertices. */
+static void graph_peel(graph_t *g, cmph_uint8 *deleted)
+{
+	cmph_uint32 v, u, i;
+	cmph_uint32 *degree = (cmph_uint32 *)malloc(sizeof(cmph_uint32) * g->nnodes + 1);
+	assert(degree);
+	for (v = 0; v < g->nnodes; ++v) degree[v] = g->offsets[v + 1] - g->offsets[v];
+	for (v = 0; v < g->nnodes; ++v)
 	{
-		DEBUGP("Deleting edge %u (%u->%u)\n", e, g->edges[abs_edge(e, 0)], g->edges[abs_edge(e, 1)]);
-		SETBIT(deleted, abs_edge(e, 0));
-
-		v2 = g->edges[abs_edge(e, 0)];
-		if (v2 == v1) v2 = g->edges[abs_edge(e, 1)];
-
-		DEBUGP("Checking if second endpoint %u has degree 1\n", v2);
-		degree1 = find_degree1_edge(g, v2, deleted, &e);
-		if (degree1)
+		u = v;
+		while (degree[u] == 1)
 		{
-			DEBUGP("Inspecting vertex %u\n", v2);
-			v1 = v2;
+			for (i = g->offsets[u]; GETBIT(deleted, g->edge_ids[i]); ++i);
+			DEBUGP("Deleting edge %u (%u->%u)\n", g->edge_ids[i], u, g->neighbors[i]);
+			SETBIT(deleted, g->edge_ids[i]);
+			--degree[u];
+			u = g->neighbors[i];
+			--degree[u];
 		}
-		else break;
 	}
+	free(degree);
 }
 
 int graph_is_cyclic(graph_t *g)
 {
 	cmph_uint32 i;
-	cmph_uint32 v;
 	cmph_uint8 *deleted = (cmph_uint8 *)malloc((g->nedges*sizeof(cmph_uint8))/8 + 1);
 	size_t deleted_len = g->nedges/8 + 1;
 	memset(deleted, 0, deleted_len);
 
 	DEBUGP("Looking for cycles in graph with %u vertices and %u edges\n", g->nnodes, g->nedges);
-	for (v = 0; v < g->nnodes; ++v)
-	{
-		cyclic_del_edge(g, v, deleted);
-	}
-	for (i = 0; i < g->nedges; ++i)
+	graph_finalize(g);
+	graph_peel(g, deleted);
+	for (i = 0; i < g->cedges; ++i)
 	{
 		if (!(GETBIT(deleted, i)))
 		{
@@ -259,7 +312,6 @@ cmph_uint8 graph_node_is_critical(graph_t * g, cmph_uint32 v) /* included -- Fab
 void graph_obtain_critical_nodes(graph_t *g) /* included -- Fabiano*/
 {
         cmph_uint32 i;
-	cmph_uint32 v;
 	cmph_uint8 *deleted = (cmph_uint8 *)malloc((g->nedges*sizeof(cmph_uint8))/8+1);
 	size_t deleted_len = g->nedges/8 + 1;
 	memset(deleted, 0, deleted_len);
@@ -268,12 +320,10 @@ void graph_obtain_critical_nodes(graph_t *g) /* included -- Fabiano*/
 	g->ncritical_nodes = 0;
 	memset(g->critical_nodes, 0, (g->nnodes*sizeof(cmph_uint8))/8 + 1);
 	DEBUGP("Looking for the 2-core in graph with %u vertices and %u edges\n", g->nnodes, g->nedges);
-	for (v = 0; v < g->nnodes; ++v)
-	{
-		cyclic_del_edge(g, v, deleted);
-	}
+	graph_finalize(g);
+	graph_peel(g, deleted);
 
-	for (i = 0; i < g->nedges; ++i)
+	for (i = 0; i < g->cedges; ++i)
 	{
 		if (!(GETBIT(deleted,i)))
 		{
@@ -296,6 +346,11 @@ void graph_obtain_critical_nodes(graph_t *g) /* included -- Fabiano*/
 cmph_uint8 graph_contains_edge(graph_t *g, cmph_uint32 v1, cmph_uint32 v2) /* included -- Fabiano*/
 {
 	cmph_uint32 e;
+	if (g->finalized)
+	{
+		for (e = g->offsets[v1]; e < g->offsets[v1 + 1]; ++e) if (g->neighbors[e] == v2) return 1;
+		return 0;
+	}
 	e = g->first[v1];
 	if(e == EMPTY) return 0;
 	if (check_edge(g, e, v1, v2)) return 1;
@@ -322,12 +377,17 @@ graph_iterator_t graph_neighbors_it(graph_t *g, cmph_uint32 v)
 {
 	graph_iterator_t it;
 	it.vertex = v;
-	it.edge = g->first[v];
+	it.edge = g->finalized ? g->offsets[v] : g->first[v];
 	return it;
 }
 cmph_uint32 graph_next_neighbor(graph_t *g, graph_iterator_t* it)
 {
 	cmph_uint32 ret;
+	if (g->finalized)
+	{
+		if (it->edge == g->offsets[it->vertex + 1]) return GRAPH_NO_NEIGHBOR;
+		return g->neighbors[it->edge++];
+	}
 	if(it->edge == EMPTY) return GRAPH_NO_NEIGHBOR;
 	if (g->edges[it->edge] == it->vertex) ret = g->edges[it->edge + g->nedges];
 	else ret = g->edges[it->edge];
@@ -25,6 +25,16 @@ void graph_clear_edges(graph_t *g);
 cmph_uint32 graph_edge_id(graph_t *g, cmph_uint32 v1, cmph_uint32 v2);
 cmph_uint8 graph_contains_edge(graph_t *g, cmph_uint32 v1, cmph_uint32 v2);
 
+/* Replaces the adjacency lists by a compressed sparse row layout once all the
+ * edges are added. No edge may be added or deleted afterwards, until
+ * graph_clear_edges() is called. graph_is_cyclic() and
+ * graph_obtain_critical_nodes() finalize the graph themselves. */
+void graph_finalize(graph_t *g);
+/* Points neighbors (and edge_ids, if not NULL) to the neighbors of v in a
+ * finalized graph and to the ids of the edges leading to them. Returns the
+ * degree of v. */
+cmph_uint32 graph_adjacency(graph_t *g, cmph_uint32 v, const cmph_uint32 **neighbors, const cmph_uint32 **edge_ids);
+
 graph_iterator_t graph_neighbors_it(graph_t *g, cmph_uint32 v);
 cmph_uint32 graph_next_neighbor(graph_t *g, graph_iterator_t* it);
 
@@ -0,0 +1,456 @@
+#include "key_generator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+//#define DEBUG
+#include "debug.h"
+
+const char *key_type_names[] = { "url", "uuid", "dense", "sparse", "binary", "near_duplicate", "zipf", NULL };
+
+#define KEY_NEAR_DUPLICATE_LEN 64
+#define KEY_NEAR_DUPLICATE_NCLASSES 4
+#define KEY_NEAR_DUPLICATE_IDLEN 8     // base 32 digits of the index of the key in its class
+
+struct __key_generator_t
+{
+	KEY_TYPE type;
+	cmph_uint64 nkeys;
+	cmph_uint64 seed;
+	cmph_uint32 id_bits;               // bits of the indices of the keys
+	cmph_uint32 bits;                  // of the integers of KEY_SPARSE
+	cmph_uint32 min_len;               // of KEY_BINARY
+	cmph_uint32 max_len;
+	char near_template[KEY_NEAR_DUPLICATE_LEN];
+	// KEY_ZIPF: the queried set and the constants of the rejection-inversion sampling
+	key_generator_t *base;
+	double skew;
+	double h_integral_x1;
+	double h_integral_n;
+	double s;
+	cmph_uint64 position;              // of key_generator_next()
+	char key[KEY_GENERATOR_MAX_KEYLEN];
+};
+
+static const char *url_syllables[32] =
+{
+	"ka", "lo", "mi", "ne", "ra", "to", "vi", "zu", "ber", "cor", "dan", "fel", "gar", "han", "jor", "kel",
+	"lin", "mar", "nor", "pol", "quin", "ros", "sal", "tan", "ul", "ven", "wil", "xan", "yor", "zel", "bri", "ston"
+};
+static const char *url_tlds[8] = { ".com", ".org", ".net", ".de", ".co.uk", ".io", ".com.br", ".edu" };
+static const char *url_words[32] =
+{
+	"news", "blog", "products", "search", "user", "images", "docs", "about", "forum", "wiki", "category",
+	"tag", "archive", "2019", "2020", "2021", "en", "pt", "de", "static", "media", "api", "v1", "v2",
+	"help", "shop", "item", "post", "video", "music", "sports", "world"
+};
+static const char *url_extensions[4] = { ".html", "", "/", ".php" };
+static const char *digits = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+/* Finalizer of splitmix64, a bijection of 64 bits. */
+static cmph_uint64 key_generator_mix(cmph_uint64 x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static cmph_uint64 key_generator_random(cmph_uint64 *state)
+{
+	*state += 0x9e3779b97f4a7c15ULL;
+	return key_generator_mix(*state);
+}
+
+static double key_generator_uniform(cmph_uint64 *state)
+{
+	return (double)(key_generator_random(state) >> 11) / 9007199254740992.0;
+}
+
+/* Random state of the key of index i, for the purpose given by salt. */
+static cmph_uint64 key_generator_state(key_generator_t *gen, cmph_uint64 i, cmph_uint64 salt)
+{
+	return key_generator_mix(gen->seed ^ salt) ^ key_generator_mix(i);
+}
+
+/* Permutation of the integers of the given bits, chosen by the seed. Each
+ * step, a xor, a multiplication by an odd number and a xor with the value
+ * shifted right, is a bijection modulo 2^bits.
+ */
+static cmph_uint64 key_generator_permute(cmph_uint64 seed, cmph_uint64 x, cmph_uint32 bits)
+{
+	static const cmph_uint64 multipliers[3] = { 0x9e3779b97f4a7c15ULL, 0xbf58476d1ce4e5b9ULL, 0x94d049bb133111ebULL };
+	cmph_uint64 mask = bits >= 64 ? ~(cmph_uint64)0 : ((cmph_uint64)1 << bits) - 1;
+	cmph_uint32 shift = (bits + 1) / 2;
+	cmph_uint32 round;
+	for (round = 0; round < 3; ++round)
+	{
+		x = (x ^ key_generator_mix(seed + round)) & mask;
+		x = (x * multipliers[round]) & mask;
+		x ^= x >> shift;
+	}
+	return x;
+}
+
+/* Permutation of [0, n), walking the cycle of the permutation of the bits of
+ * n until it comes back into the range, in less than two steps on average.
+ */
+static cmph_uint64 key_generator_shuffle(cmph_uint64 seed, cmph_uint64 i, cmph_uint64 n, cmph_uint32 bits)
+{
+	do i = key_generator_permute(seed, i, bits); while (i >= n);
+	return i;
+}
+
+static cmph_uint32 key_generator_bits(cmph_uint64 n)
+{
+	cmph_uint32 bits = 1;
+	while (bits < 64 && ((cmph_uint64)1 << bits) < n) ++bits;
+	return bits;
+}
+
+static cmph_uint32 key_generator_base36(char *p, cmph_uint64 value)
+{
+	char buf[16];
+	cmph_uint32 len = 0, i;
+	do
+	{
+		buf[len++] = digits[value % 36];
+		value /= 36;
+	} while (value);
+	for (i = 0; i < len; ++i) p[i] = buf[len - 1 - i];
+	return len;
+}
+
+static char *key_generator_append(char *p, const char *s)
+{
+	size_t len = strlen(s);
+	memcpy(p, s, len);
+	return p + len;
+}
+
+/* Zipf sampling by rejection-inversion (Hoermann and Derflinger, 1996), in
+ * constant time and memory whatever the size of the set.
+ */
+static double key_generator_helper1(double x)
+{
+	if (fabs(x) > 1e-8) return log1p(x) / x;
+	return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+static double key_generator_helper2(double x)
+{
+	if (fabs(x) > 1e-8) return expm1(x) / x;
+	return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+}
+
+static double key_generator_h(double skew, double x)
+{
+	return exp(-skew * log(x));
+}
+
+static double key_generator_h_integral(double skew, double x)
+{
+	double log_x = log(x);
+	return key_generator_helper2((1.0 - skew) * log_x) * log_x;
+}
+
+static double key_generator_h_integral_inverse(double skew, double x)
+{
+	double t = x * (1.0 - skew);
+	if (t < -1.0) t = -1.0;
+	return exp(key_generator_helper1(t) * x);
+}
+
+/* Rank in [1, universe] of the query i, rank 1 being the most frequent. */
+static cmph_uint64 key_generator_zipf_rank(key_generator_t *gen, cmph_uint64 i)
+{
+	cmph_uint64 state = key_generator_state(gen, i, 0x7a697066ULL);
+	cmph_uint64 universe = key_generator_nkeys(gen->base);
+	while (1)
+	{
+		double u = gen->h_integral_n + key_generator_uniform(&state) * (gen->h_integral_x1 - gen->h_integral_n);
+		double x = key_generator_h_integral_inverse(gen->skew, u);
+		cmph_uint64 k = x < 1.5 ? 1 : (cmph_uint64)(x + 0.5);
+		if (k > universe) k = universe;
+		if ((double)k - x <= gen->s ||
+		    u >= key_generator_h_integral(gen->skew, (double)k + 0.5) - key_generator_h(gen->skew, (double)k))
+		{
+			return k;
+		}
+	}
+}
+
+key_generator_t *key_generator_new(KEY_TYPE type, cmph_uint64 nkeys, cmph_uint64 seed)
+{
+	key_generator_t *gen;
+	cmph_uint64 state = seed;
+	cmph_uint32 i;
+	if (nkeys == 0 || type >= KEY_COUNT) return NULL;
+	// ids of uuids have 62 bits, and near duplicates have 40 bits per class
+	if (type == KEY_UUID && nkeys > ((cmph_uint64)1 << 62)) return NULL;
+	if (type == KEY_NEAR_DUPLICATE && nkeys > ((cmph_uint64)KEY_NEAR_DUPLICATE_NCLASSES << (5 * KEY_NEAR_DUPLICATE_IDLEN))) return NULL;
+	gen = (key_generator_t *)calloc(1, sizeof(key_generator_t));
+	assert(gen);
+	gen->type = type;
+	gen->nkeys = nkeys;
+	gen->seed = seed;
+	gen->id_bits = key_generator_bits(nkeys);
+	gen->bits = 64;
+	gen->min_len = 4;
+	gen->max_len = 64;
+	for (i = 0; i < KEY_NEAR_DUPLICATE_LEN; ++i)
+	{
+		gen->near_template[i] = digits[key_generator_random(&state) % 36];
+	}
+	if (type == KEY_ZIPF) key_generator_set_zipf(gen, KEY_URL, nkeys, 1.0);
+	return gen;
+}
+
+int key_generator_set_bits(key_generator_t *gen, cmph_uint32 bits)
+{
+	if (gen->base) return key_generator_set_bits(gen->base, bits);
+	if (bits == 0 || bits > 64 || bits < gen->id_bits) return 0;
+	gen->bits = bits;
+	return 1;
+}
+
+int key_generator_set_lengths(key_generator_t *gen, cmph_uint32 min_len, cmph_uint32 max_len)
+{
+	if (gen->base) return key_generator_set_lengths(gen->base, min_len, max_len);
+	if (min_len == 0 || min_len > max_len || max_len > KEY_GENERATOR_MAX_KEYLEN) return 0;
+	gen->min_len = min_len;
+	gen->max_len = max_len;
+	return 1;
+}
+
+int key_generator_set_zipf(key_generator_t *gen, KEY_TYPE base, cmph_uint64 universe, double skew)
+{
+	key_generator_t *base_gen;
+	if (base == KEY_ZIPF || universe == 0 || !(skew > 0)) return 0;
+	base_gen = key_generator_new(base, universe, gen->seed);
+	if (base_gen == NULL) return 0;
+	if (gen->base) key_generator_destroy(gen->base);
+	gen->base = base_gen;
+	gen->skew = skew;
+	gen->h_integral_x1 = key_generator_h_integral(skew, 1.5) - 1.0;
+	gen->h_integral_n = key_generator_h_integral(skew, (double)universe + 0.5);
+	gen->s = 2.0 - key_generator_h_integral_inverse(skew, key_generator_h_integral(skew, 2.5) - key_generator_h(skew, 2.0));
+	return 1;
+}
+
+cmph_uint64 key_generator_nkeys(key_generator_t *gen)
+{
+	return gen->nkeys;
+}
+
+cmph_uint64 key_generator_value(key_generator_t *gen, cmph_uint64 i)
+{
+	switch (gen->type)
+	{
+		case KEY_DENSE:
+			return key_generator_shuffle(gen->seed, i, gen->nkeys, gen->id_bits);
+		case KEY_SPARSE:
+			return key_generator_permute(gen->seed, i, gen->bits);
+		case KEY_ZIPF:
+			// the popular keys are spread over the set
+			return key_generator_shuffle(gen->seed + 1, key_generator_zipf_rank(gen, i) - 1,
+			                             gen->base->nkeys, gen->base->id_bits);
+		default:
+			return i;
+	}
+}
+
+/* Scheme and host drawn with a power law from a pool of about one host per
+ * 32 keys, a path of one to three segments whose first ones are few per
+ * host, and a last segment made unique by the permuted index of the key, in
+ * base 36 after the last '-' of the URL.
+ */
+static cmph_uint32 key_generator_url(key_generator_t *gen, cmph_uint64 i, char *key)
+{
+	cmph_uint64 state = key_generator_state(gen, i, 0x75726cULL);
+	cmph_uint64 nhosts = gen->nkeys / 32 + 1;
+	double u = key_generator_uniform(&state);
+	cmph_uint64 host = (cmph_uint64)(u * u * u * (double)nhosts);
+	cmph_uint64 host_state = key_generator_state(gen, host, 0x686f7374ULL);
+	cmph_uint64 r = key_generator_random(&host_state);
+	cmph_uint32 nsyllables = 2 + (cmph_uint32)((r >> 3) % 3);
+	cmph_uint32 depth = 1 + (cmph_uint32)(key_generator_random(&state) % 3);
+	char *p = key;
+	cmph_uint32 j;
+
+	p = key_generator_append(p, (r & 7) ? "https://www." : "http://www.");
+	for (j = 0; j < nsyllables; ++j) p = key_generator_append(p, url_syllables[(r >> (5 + 5 * j)) & 31]);
+	p = key_generator_append(p, url_tlds[(r >> 25) & 7]);
+	for (j = 0; j < depth; ++j)
+	{
+		double v = key_generator_uniform(&state);
+		cmph_uint64 word = (r >> (28 + 8 * j)) + (cmph_uint64)(v * v * (double)(4 << (3 * j)));
+		*p++ = '/';
+		p = key_generator_append(p, url_words[word & 31]);
+	}
+	*p++ = '/';
+	p = key_generator_append(p, url_words[key_generator_random(&state) & 31]);
+	*p++ = '-';
+	p += key_generator_base36(p, key_generator_permute(gen->seed, i, gen->id_bits));
+	p = key_generator_append(p, url_extensions[key_generator_random(&state) & 3]);
+	return (cmph_uint32)(p - key);
+}
+
+static char *key_generator_hex(char *p, cmph_uint64 value, cmph_uint32 ndigits)
+{
+	cmph_uint32 i;
+	for (i = 0; i < ndigits; ++i) p[i] = digits[(value >> (4 * (ndigits - 1 - i))) & 15];
+	return p + ndigits;
+}
+
+/* Random bits, with the permuted index of the key in the last 62 bits. */
+static cmph_uint32 key_generator_uuid(key_generator_t *gen, cmph_uint64 i, char *key)
+{
+	cmph_uint64 state = key_generator_state(gen, i, 0x75756964ULL);
+	cmph_uint64 hi = key_generator_random(&state);
+	cmph_uint64 lo = key_generator_permute(gen->seed, i, 62);
+	char *p = key;
+	p = key_generator_hex(p, hi >> 32, 8);
+	*p++ = '-';
+	p = key_generator_hex(p, hi >> 16, 4);
+	*p++ = '-';
+	p = key_generator_hex(p, 0x4000 | (hi & 0x0fff), 4);
+	*p++ = '-';
+	p = key_generator_hex(p, 0x8000 | (lo >> 48), 4);
+	*p++ = '-';
+	p = key_generator_hex(p, lo, 12);
+	return (cmph_uint32)(p - key);
+}
+
+/* Random bytes followed by the permuted index of the key, 7 bits per byte
+ * with the high bit set, so keys of the same length differ there. NUL,
+ * carriage return and newline get the high bit set too, since the lines of
+ * a keys file are read as C strings and may end with "\r\n".
+ */
+static cmph_uint32 key_generator_binary(key_generator_t *gen, cmph_uint64 i, char *key)
+{
+	cmph_uint64 state = key_generator_state(gen, i, 0x62696eULL);
+	cmph_uint64 id = key_generator_permute(gen->seed, i, gen->id_bits);
+	cmph_uint32 idlen = (gen->id_bits + 6) / 7;
+	cmph_uint32 len = gen->min_len + (cmph_uint32)(key_generator_random(&state) % (gen->max_len - gen->min_len + 1));
+	cmph_uint64 r = 0;
+	cmph_uint32 j;
+	if (len < idlen) len = idlen;
+	for (j = 0; j < len - idlen; ++j)
+	{
+		cmph_uint8 byte;
+		if ((j & 7) == 0) r = key_generator_random(&state);
+		byte = (cmph_uint8)(r >> (8 * (j & 7)));
+		key[j] = (char)(byte == '\0' || byte == '\r' || byte == '\n' ? byte ^ 0x80 : byte);
+	}
+	for (j = 0; j < idlen; ++j) key[len - idlen + j] = (char)(0x80 | ((id >> (7 * j)) & 0x7f));
+	return len;
+}
+
+/* A template of the seed with a few bytes replaced by the index of the key
+ * in its class, in base 32 at the position of the class, and the last byte
+ * naming the class. Consecutive keys of a class differ in one byte.
+ */
+static cmph_uint32 key_generator_near_duplicate(key_generator_t *gen, cmph_uint64 i, char *key)
+{
+	static const cmph_uint32 positions[KEY_NEAR_DUPLICATE_NCLASSES] = { 0, 20, 40, 55 };
+	cmph_uint32 key_class = (cmph_uint32)(i % KEY_NEAR_DUPLICATE_NCLASSES);
+	cmph_uint64 id = i / KEY_NEAR_DUPLICATE_NCLASSES;
+	cmph_uint32 j;
+	memcpy(key, gen->near_template, KEY_NEAR_DUPLICATE_LEN);
+	for (j = 0; j < KEY_NEAR_DUPLICATE_IDLEN; ++j)
+	{
+		key[positions[key_class] + KEY_NEAR_DUPLICATE_IDLEN - 1 - j] = digits[(id >> (5 * j)) & 31];
+	}
+	key[KEY_NEAR_DUPLICATE_LEN - 1] = (char)('A' + key_class);
+	return KEY_NEAR_DUPLICATE_LEN;
+}
+
+const char *key_generator_key(key_generator_t *gen, cmph_uint64 i, cmph_uint32 *keylen)
+{
+	assert(i < gen->nkeys);
+	switch (gen->type)
+	{
+		case KEY_URL:
+			*keylen = key_generator_url(gen, i, gen->key);
+			break;
+		case KEY_UUID:
+			*keylen = key_generator_uuid(gen, i, gen->key);
+			break;
+		case KEY_DENSE:
+		case KEY_SPARSE:
+			*keylen = (cmph_uint32)sprintf(gen->key, "%llu", (unsigned long long)key_generator_value(gen, i));
+			break;
+		case KEY_BINARY:
+			*keylen = key_generator_binary(gen, i, gen->key);
+			break;
+		case KEY_NEAR_DUPLICATE:
+			*keylen = key_generator_near_duplicate(gen, i, gen->key);
+			break;
+		case KEY_ZIPF:
+			return key_generator_key(gen->base, key_generator_value(gen, i), keylen);
+		default:
+			assert(0);
+	}
+	return gen->key;
+}
+
+const char *key_generator_next(key_generator_t *gen, cmph_uint32 *keylen)
+{
+	if (gen->position >= gen->nkeys) return NULL;
+	return key_generator_key(gen, gen->position++, keylen);
+}
+
+void key_generator_rewind(key_generator_t *gen)
+{
+	gen->position = 0;
+}
+
+void key_generator_destroy(key_generator_t *gen)
+{
+	if (gen->base) key_generator_destroy(gen->base);
+	free(gen);
+}
+
+static int key_generator_read(void *data, char **key, cmph_uint32 *keylen)
+{
+	key_generator_t *gen = (key_generator_t *)data;
+	const char *next = key_generator_next(gen, keylen);
+	if (next == NULL) return -1;
+	*key = (char *)malloc(*keylen + 1);
+	memcpy(*key, next, *keylen);
+	(*key)[*keylen] = 0;
+	return (int)(*keylen);
+}
+
+static void key_generator_dispose(void *data, char *key, cmph_uint32 keylen)
+{
+	free(key);
+}
+
+static void key_generator_io_rewind(void *data)
+{
+	key_generator_rewind((key_generator_t *)data);
+}
+
+cmph_io_adapter_t *key_generator_io_adapter(key_generator_t *gen)
+{
+	cmph_io_adapter_t *key_source;
+	if (gen->nkeys > 0xffffffffULL) return NULL;
+	key_source = (cmph_io_adapter_t *)malloc(sizeof(cmph_io_adapter_t));
+	assert(key_source);
+	key_source->data = (void *)gen;
+	key_source->nkeys = (cmph_uint32)gen->nkeys;
+	key_source->read = key_generator_read;
+	key_source->dispose = key_generator_dispose;
+	key_source->rewind = key_generator_io_rewind;
+	key_generator_rewind(gen);
+	return key_source;
+}
+
+void key_generator_io_adapter_destroy(cmph_io_adapter_t *key_source)
+{
+	free(key_source);
+}
@@ -0,0 +1,106 @@
+#ifndef __CMPH_KEY_GENERATOR_H__
+#define __CMPH_KEY_GENERATOR_H__
+
+// Deterministic synthetic key sets for benchmarks and tests. Every key is a
+// function of the seed and of its index only, so the keys are streamed in
+// constant memory, from a thousand to billions of them, any key can be
+// recomputed on its own, and the same seed gives the same keys everywhere.
+// The keys of a set are distinct and never hold a NUL byte, a carriage
+// return or a newline, so they can be written as the lines of a keys file.
+// Not distributed with the cmph runtime headers.
+
+#include "cmph.h"
+
+typedef enum
+{
+	KEY_URL,            // URLs sharing schemes, hosts and path prefixes
+	KEY_UUID,           // version 4 UUIDs in canonical text form
+	KEY_DENSE,          // the decimal integers of [0, nkeys), shuffled
+	KEY_SPARSE,         // decimal integers spread over the bits given
+	KEY_BINARY,         // bytes of random length, of any value but NUL, CR and LF
+	KEY_NEAR_DUPLICATE, // long keys differing from each other in a few bytes
+	KEY_ZIPF,           // Zipf-skewed queries of the keys of another set
+	KEY_COUNT
+} KEY_TYPE;
+
+extern const char *key_type_names[];
+
+#define KEY_GENERATOR_MAX_KEYLEN 4096
+
+typedef struct __key_generator_t key_generator_t;
+
+/** \fn key_generator_t *key_generator_new(KEY_TYPE type, cmph_uint64 nkeys, cmph_uint64 seed);
+ *  \brief Creates a generator of nkeys keys of the given type.
+ *  \param type type of the keys
+ *  \param nkeys number of keys, or of queries for KEY_ZIPF
+ *  \param seed seed of the keys
+ *  \return the generator, or NULL if nkeys is 0 or more than the type can tell apart
+ */
+key_generator_t *key_generator_new(KEY_TYPE type, cmph_uint64 nkeys, cmph_uint64 seed);
+
+/** \fn int key_generator_set_bits(key_generator_t *gen, cmph_uint32 bits);
+ *  \brief Sets the width of the integers of KEY_SPARSE, 64 by default.
+ *  Like key_generator_set_lengths(), it applies to the queried set of KEY_ZIPF,
+ *  so it is called after key_generator_set_zipf().
+ *  \return 0 if the width is out of [1,64] or too small for the keys, 1 otherwise
+ */
+int key_generator_set_bits(key_generator_t *gen, cmph_uint32 bits);
+
+/** \fn int key_generator_set_lengths(key_generator_t *gen, cmph_uint32 min_len, cmph_uint32 max_len);
+ *  \brief Sets the range of the lengths of KEY_BINARY keys, [4,64] by default.
+ *  Keys are never shorter than the bytes needed to tell them apart.
+ *  \return 0 if the range is empty or longer than KEY_GENERATOR_MAX_KEYLEN, 1 otherwise
+ */
+int key_generator_set_lengths(key_generator_t *gen, cmph_uint32 min_len, cmph_uint32 max_len);
+
+/** \fn int key_generator_set_zipf(key_generator_t *gen, KEY_TYPE base, cmph_uint64 universe, double skew);
+ *  \brief Sets the key set queried by KEY_ZIPF, the universe keys of the given
+ *  type generated with the same seed, and the exponent of the distribution
+ *  of the queries. The most frequent keys are spread over the set. The
+ *  default is a set of url keys as large as the number of queries, and an
+ *  exponent of 1.
+ *  \return 0 if the base is KEY_ZIPF, the universe is 0 or the skew is not positive, 1 otherwise
+ */
+int key_generator_set_zipf(key_generator_t *gen, KEY_TYPE base, cmph_uint64 universe, double skew);
+
+/** \fn cmph_uint64 key_generator_nkeys(key_generator_t *gen);
+ *  \return the number of keys of the generator
+ */
+cmph_uint64 key_generator_nkeys(key_generator_t *gen);
+
+/** \fn const char *key_generator_key(key_generator_t *gen, cmph_uint64 i, cmph_uint32 *keylen);
+ *  \brief Computes the key of index i.
+ *  \param keylen the length of the key
+ *  \return the key, valid until the next key is computed by the generator
+ */
+const char *key_generator_key(key_generator_t *gen, cmph_uint64 i, cmph_uint32 *keylen);
+
+/** \fn cmph_uint64 key_generator_value(key_generator_t *gen, cmph_uint64 i);
+ *  \return the integer of the key of index i for KEY_DENSE and KEY_SPARSE,
+ *  the index in the queried set of the query i for KEY_ZIPF, and i otherwise
+ */
+cmph_uint64 key_generator_value(key_generator_t *gen, cmph_uint64 i);
+
+/** \fn const char *key_generator_next(key_generator_t *gen, cmph_uint32 *keylen);
+ *  \brief Streams the keys in the order of their indices.
+ *  \return the next key, or NULL after the last one
+ */
+const char *key_generator_next(key_generator_t *gen, cmph_uint32 *keylen);
+
+/** \fn void key_generator_rewind(key_generator_t *gen);
+ *  \brief Restarts the stream of key_generator_next() from the first key.
+ */
+void key_generator_rewind(key_generator_t *gen);
+
+void key_generator_destroy(key_generator_t *gen);
+
+/** \fn cmph_io_adapter_t *key_generator_io_adapter(key_generator_t *gen);
+ *  \brief Adapter reading the keys of the generator, to build a function
+ *  of them without writing them to a file.
+ *  \return the adapter, or NULL if the generator has more than 2^32 - 1 keys
+ */
+cmph_io_adapter_t *key_generator_io_adapter(key_generator_t *gen);
+
+void key_generator_io_adapter_destroy(cmph_io_adapter_t *key_source);
+
+#endif
@@ -0,0 +1,187 @@
+#ifdef WIN32
+#include "wingetopt.h"
+#else
+#include <getopt.h>
+#endif
+#include "keygen.h"
+#include "key_generator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+//#define DEBUG
+#include "debug.h"
+
+#define KEYGEN_BUFFER_SIZE (1 << 20)
+
+static char keygen_buffer[KEYGEN_BUFFER_SIZE];
+
+static void keygen_usage(const char *prg)
+{
+	cmph_uint32 i;
+	fprintf(stderr, "usage: %s keygen [-t type] -n nkeys [-s seed] [-b bits] [-l min_len:max_len] [-i base_type] [-u universe] [-z skew] [-o file]\n", prg);
+	fprintf(stderr, "  -t\t type of the keys (default url) - valid values are\n");
+	for (i = 0; i < KEY_COUNT; ++i) fprintf(stderr, "    \t  * %s\n", key_type_names[i]);
+	fprintf(stderr, "  -n\t number of keys, or of queries for zipf, optionally followed by k, M or G\n");
+	fprintf(stderr, "  -s\t seed of the keys (default 1)\n");
+	fprintf(stderr, "  -b\t bits of the integers of sparse keys (default 64)\n");
+	fprintf(stderr, "  -l\t range of the lengths of binary keys (default 4:64)\n");
+	fprintf(stderr, "  -i\t type of the keys queried by zipf (default url), generated with the same seed\n");
+	fprintf(stderr, "  -u\t number of keys queried by zipf (default nkeys)\n");
+	fprintf(stderr, "  -z\t exponent of the zipf distribution (default 1.0)\n");
+	fprintf(stderr, "  -o\t write the keys to the file instead of the standard output\n");
+}
+
+static int keygen_parse_type(const char *name, KEY_TYPE *type)
+{
+	cmph_uint32 i;
+	for (i = 0; i < KEY_COUNT; ++i)
+	{
+		if (strcmp(key_type_names[i], name) == 0)
+		{
+			*type = (KEY_TYPE)i;
+			return 1;
+		}
+	}
+	fprintf(stderr, "Invalid key type: %s\n", name);
+	return 0;
+}
+
+static int keygen_parse_count(const char *arg, cmph_uint64 *count)
+{
+	char *endptr;
+	unsigned long long value = strtoull(arg, &endptr, 10);
+	if (*endptr == 'k') { value *= 1000ULL; ++endptr; }
+	else if (*endptr == 'M') { value *= 1000000ULL; ++endptr; }
+	else if (*endptr == 'G') { value *= 1000000000ULL; ++endptr; }
+	if (endptr == arg || *endptr != 0 || value == 0) return 0;
+	*count = (cmph_uint64)value;
+	return 1;
+}
+
+int keygen_main(int argc, char **argv)
+{
+	KEY_TYPE type = KEY_URL;
+	KEY_TYPE base = KEY_URL;
+	cmph_uint64 nkeys = 0;
+	cmph_uint64 universe = 0;
+	cmph_uint64 seed = 1;
+	cmph_uint32 bits = 64;
+	cmph_uint32 min_len = 4, max_len = 64;
+	double skew = 1.0;
+	const char *output = NULL;
+	key_generator_t *gen;
+	FILE *out = stdout;
+	const char *key;
+	cmph_uint32 keylen;
+	int ret = 0;
+
+	while (1)
+	{
+		int ch = getopt(argc, argv, "ht:n:s:b:l:i:u:z:o:");
+		char *endptr;
+		if (ch == -1) break;
+		switch (ch)
+		{
+			case 't':
+				if (!keygen_parse_type(optarg, &type)) return 1;
+				break;
+			case 'i':
+				if (!keygen_parse_type(optarg, &base)) return 1;
+				break;
+			case 'n':
+			case 'u':
+				if (!keygen_parse_count(optarg, ch == 'n' ? &nkeys : &universe))
+				{
+					fprintf(stderr, "Invalid value %s of -%c\n", optarg, ch);
+					return 1;
+				}
+				break;
+			case 's':
+				seed = (cmph_uint64)strtoull(optarg, &endptr, 10);
+				if (*endptr != 0)
+				{
+					fprintf(stderr, "Invalid seed: %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 'b':
+				bits = (cmph_uint32)strtoul(optarg, &endptr, 10);
+				if (*endptr != 0) bits = 0;
+				break;
+			case 'l':
+				min_len = (cmph_uint32)strtoul(optarg, &endptr, 10);
+				max_len = min_len;
+				if (*endptr == ':') max_len = (cmph_uint32)strtoul(endptr + 1, &endptr, 10);
+				if (*endptr != 0) min_len = 0;
+				break;
+			case 'z':
+				skew = strtod(optarg, &endptr);
+				if (*endptr != 0) skew = 0;
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			case 'h':
+			default:
+				keygen_usage("cmph");
+				return ch == 'h' ? 0 : 1;
+		}
+	}
+	if (optind != argc || nkeys == 0)
+	{
+		keygen_usage("cmph");
+		return 1;
+	}
+	gen = key_generator_new(type, nkeys, seed);
+	if (gen == NULL)
+	{
+		fprintf(stderr, "Too many keys of type %s: %llu\n", key_type_names[type], (unsigned long long)nkeys);
+		return 1;
+	}
+	if (type == KEY_ZIPF && !key_generator_set_zipf(gen, base, universe ? universe : nkeys, skew))
+	{
+		fprintf(stderr, "Invalid zipf queries of %s keys with exponent %g\n", key_type_names[base], skew);
+		key_generator_destroy(gen);
+		return 1;
+	}
+	if (!key_generator_set_bits(gen, bits))
+	{
+		fprintf(stderr, "Invalid number of bits for %llu keys: %u\n", (unsigned long long)nkeys, bits);
+		key_generator_destroy(gen);
+		return 1;
+	}
+	if (!key_generator_set_lengths(gen, min_len, max_len))
+	{
+		fprintf(stderr, "Invalid range of lengths: %u:%u\n", min_len, max_len);
+		key_generator_destroy(gen);
+		return 1;
+	}
+	if (output)
+	{
+		out = fopen(output, "wb");
+		if (out == NULL)
+		{
+			fprintf(stderr, "Unable to open output file %s: %s\n", output, strerror(errno));
+			key_generator_destroy(gen);
+			return 1;
+		}
+	}
+	setvbuf(out, keygen_buffer, _IOFBF, KEYGEN_BUFFER_SIZE);
+	DEBUGP("Generating %llu keys of type %s with seed %llu\n", (unsigned long long)nkeys,
+	       key_type_names[type], (unsigned long long)seed);
+	while ((key = key_generator_next(gen, &keylen)) != NULL)
+	{
+		if (fwrite(key, 1, keylen, out) != keylen || putc('\n', out) == EOF) break;
+	}
+	if (key != NULL || fflush(out) != 0)
+	{
+		fprintf(stderr, "Unable to write the keys: %s\n", strerror(errno));
+		ret = 1;
+	}
+	if (out != stdout) fclose(out);
+	key_generator_destroy(gen);
+	return ret;
+}
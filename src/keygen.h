@@ -0,0 +1,13 @@
+#ifndef __CMPH_KEYGEN_H__
+#define __CMPH_KEYGEN_H__
+
+/** \fn int keygen_main(int argc, char **argv);
+ *  \brief The keygen subcommand of the cmph tool. Writes a synthetic key set
+ *  or query stream of key_generator.h to stdout, or to the file given by -o,
+ *  a key per line. The same options and seed always give the same keys.
+ *  \param argv the arguments after the program name, "keygen" first
+ *  \return the exit status of the tool
+ */
+int keygen_main(int argc, char **argv);
+
+#endif
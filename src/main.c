@@ -11,23 +11,32 @@
 #include <limits.h>
 #include <assert.h>
 #include "cmph.h"
+#include "cmph_blob.h"
+#include "cmph_searcher.h"
+#include "cmph_stats.h"
 #include "hash.h"
+#include "query.h"
+#include "bench.h"
+#include "keygen.h"
 
 #ifdef WIN32
 #define VERSION "0.8"
 #else
 #include "config.h"
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 
 void usage(const char *prg)
 {
-	fprintf(stderr, "usage: %s [-v] [-h] [-V] [-k nkeys] [-f hash_function] [-g [-c algorithm_dependent_value][-s seed] ] [-a algorithm] [-M memory_in_MB] [-b algorithm_dependent_value] [-t keys_per_bin] [-d tmp_dir] [-m file.mph]  keysfile\n", prg);
+	fprintf(stderr, "usage: %s [-v] [-h] [-V] [-k nkeys] [-f hash_function] [-g [-c algorithm_dependent_value][-s seed] ] [-a algorithm] [-i bucket_algorithm] [-M memory_in_MB] [-b algorithm_dependent_value] [-t keys_per_bin] [-d tmp_dir] [-z] [-r] [-F checksum] [-n name] [-j nthreads] [--stats=json] [-m file.mph] keysfile...\n       %s -q text|binary [-j nthreads] [-n name] -m file.mph [keysfile]\n       %s -C -m container.mph\n       %s bench [-a algorithm] [-k nkeys] [-l nlookups] [-r rounds] [-s seed] [-d tmp_dir] [-o file.json] keysfile\n       %s keygen [-t type] -n nkeys [-s seed] [-o file]\n", prg, prg, prg, prg, prg);
 }
 void usage_long(const char *prg)
 {
 	cmph_uint32 i;
-	fprintf(stderr, "usage: %s [-v] [-h] [-V] [-k nkeys] [-f hash_function] [-g [-c algorithm_dependent_value][-s seed] ] [-a algorithm] [-M memory_in_MB] [-b algorithm_dependent_value] [-t keys_per_bin] [-d tmp_dir] [-m file.mph] keysfile\n", prg);
+	fprintf(stderr, "usage: %s [-v] [-h] [-V] [-k nkeys] [-f hash_function] [-g [-c algorithm_dependent_value][-s seed] ] [-a algorithm] [-i bucket_algorithm] [-M memory_in_MB] [-b algorithm_dependent_value] [-t keys_per_bin] [-d tmp_dir] [-z] [-r] [-F checksum] [-n name] [-j nthreads] [--stats=json] [-m file.mph] keysfile...\n       %s -q text|binary [-j nthreads] [-n name] -m file.mph [keysfile]\n       %s -C -m container.mph\n       %s bench [-a algorithm] [-k nkeys] [-l nlookups] [-r rounds] [-s seed] [-d tmp_dir] [-o file.json] keysfile\n       %s keygen [-t type] -n nkeys [-s seed] [-o file]\n", prg, prg, prg, prg, prg);
 	fprintf(stderr, "Minimum perfect hashing tool\n\n");
 	fprintf(stderr, "  -h\t print this help message\n");
 	fprintf(stderr, "  -c\t c value determines:\n");
@@ -36,6 +45,8 @@ void usage_long(const char *prg)
 	fprintf(stderr, "    \t  * the load factor in the CHD_PH algorithm\n");
 	fprintf(stderr, "  -a\t algorithm - valid values are\n");
 	for (i = 0; i < CMPH_COUNT; ++i) fprintf(stderr, "    \t  * %s\n", cmph_names[i]);
+	fprintf(stderr, "  -i\t algorithm of the buckets of BRZ - valid values are bmz8, fch, bdz and chd.\n");
+	fprintf(stderr, "    \t Default is fch if c >= 2.0 and bmz8 otherwise\n");
 	fprintf(stderr, "  -f\t hash function (may be used multiple times) - valid values are\n");
 	for (i = 0; i < CMPH_HASH_COUNT; ++i) fprintf(stderr, "    \t  * %s\n", cmph_hash_names[i]);
 	fprintf(stderr, "  -V\t print version number and exit\n");
@@ -45,10 +56,41 @@ void usage_long(const char *prg)
 	fprintf(stderr, "  -s\t random seed\n");
 	fprintf(stderr, "  -m\t minimum perfect hash function file \n");
 	fprintf(stderr, "  -M\t main memory availability (in MB) used in BRZ algorithm \n");
-	fprintf(stderr, "  -d\t temporary directory used in BRZ algorithm \n");
+	fprintf(stderr, "  -d\t temporary directory used in BRZ algorithm (may be used multiple times\n");
+	fprintf(stderr, "    \t to stripe the temporary files across several disks)\n");
+	fprintf(stderr, "  -z\t compress the temporary files of the BRZ algorithm \n");
+	fprintf(stderr, "  -r\t (or --resume) continue an interrupted generation with the BRZ algorithm,\n");
+	fprintf(stderr, "    \t using the same keys, options and temporary directory\n");
+	fprintf(stderr, "  -F\t write the function as a blob, with 64-byte aligned sections that can be\n");
+	fprintf(stderr, "    \t mapped and searched in place, checked with a checksum - valid values are\n");
+	for (i = 0; i < CMPH_CHECKSUM_COUNT; ++i) fprintf(stderr, "    \t  * %s\n", cmph_checksum_names[i]);
+	fprintf(stderr, "    \t Blobs are recognized when the function is read\n");
+	fprintf(stderr, "  -n\t name of the function in the container given by -m, which holds many blobs:\n");
+	fprintf(stderr, "    \t with -g the function is added to the container, replacing the function of\n");
+	fprintf(stderr, "    \t the same name, otherwise the keys are checked against it\n");
+	fprintf(stderr, "  -C\t compact the container given by -m, dropping the space left by replaced functions\n");
+	fprintf(stderr, "  -j\t number of threads of the generation. The functions of several keys files\n");
+	fprintf(stderr, "    \t are built concurrently and BRZ builds a function on the threads left free\n");
+	fprintf(stderr, "  --stats=json\n");
+	fprintf(stderr, "    \t print the statistics of the generation of each function to the standard\n");
+	fprintf(stderr, "    \t output as a line of JSON: time and CPU time of each phase, iterations, peak\n");
+	fprintf(stderr, "    \t memory, bits per key of each part of the function and chosen parameters\n");
+	fprintf(stderr, "  -q\t bulk query mode: the keys are read from keysfile, or from the standard input\n");
+	fprintf(stderr, "    \t if it is missing or -, and their values are written to the standard output in\n");
+	fprintf(stderr, "    \t the given format, text (a decimal line per key) or binary (a 32-bit integer per\n");
+	fprintf(stderr, "    \t key, in the byte order of the host). With -j the keys are searched on several\n");
+	fprintf(stderr, "    \t threads. Throughput and latency statistics are printed to stderr at the end\n");
+	fprintf(stderr, "  bench\t build the keys with every algorithm and a few values of c and b, and compare\n");
+	fprintf(stderr, "    \t the time and memory of the builds, the bits per key and the time of the lookups\n");
+	fprintf(stderr, "    \t (see %s bench -h)\n", prg);
+	fprintf(stderr, "  keygen\t write a synthetic key set or query stream, the same for the same seed: urls,\n");
+	fprintf(stderr, "    \t uuids, dense or sparse integers, binary keys, near duplicates or zipf queries\n");
+	fprintf(stderr, "    \t (see %s keygen -h)\n", prg);
 	fprintf(stderr, "  -b\t the meaning of this parameter depends on the algorithm selected in the -a option:\n");
 	fprintf(stderr, "    \t  * For BRZ it is used to make the maximal number of keys in a bucket lower than 256.\n");
-	fprintf(stderr, "    \t    In this case its value should be an integer in the range [64,175]. Default is 128.\n\n");
+	fprintf(stderr, "    \t    In this case its value should be an integer in the range [64,175]. Default is 128.\n");
+	fprintf(stderr, "    \t    If the buckets use bdz or chd (-i option) it is the average number of keys in a\n");
+	fprintf(stderr, "    \t    bucket, an integer in the range [128,16384]. Default is 2048.\n\n");
 	fprintf(stderr, "    \t  * For BDZ it is used to determine the size of some precomputed rank\n");
 	fprintf(stderr, "    \t    information and its value should be an integer in the range [3,10]. Default\n");
 	fprintf(stderr, "    \t    is 7. The larger is this value, the more compact are the resulting functions\n");
@@ -61,7 +103,272 @@ void usage_long(const char *prg)
 	fprintf(stderr, "    \t hash function allows at most t collisions in a given bin. This parameter applies\n");
 	fprintf(stderr, "    \t only to the CHD and CHD_PH algorithms. Its value should be an integer in the\n");
 	fprintf(stderr, "    \t range [1,128]. Defaul is 1\n");
-	fprintf(stderr, "  keysfile\t line separated file with keys\n");
+	fprintf(stderr, "  keysfile\t line separated file with keys. With -g several keys files may be given,\n");
+	fprintf(stderr, "          \t each function being written to the keys file name followed by .mph\n");
+}
+
+/* Options of the generation, shared by the functions built from each keys file. */
+typedef struct
+{
+	CMPH_ALGO algo;
+	CMPH_ALGO bucket_algo;
+	CMPH_HASH *hashes;
+	cmph_uint32 nhashes;
+	double c;
+	cmph_uint32 verbosity;
+	cmph_uint32 nkeys;
+	char **tmp_dirs;
+	cmph_uint32 ntmp_dirs;
+	cmph_uint32 tmp_compression;
+	cmph_uint32 resume;
+	cmph_uint32 memory_availability;
+	cmph_uint32 b;
+	cmph_uint32 keys_per_bin;
+	CMPH_CHECKSUM blob_checksum;
+	const char *function_name;
+	cmph_uint32 stats_json;    // print the statistics of each function
+	cmph_uint32 concurrent;    // functions are built at the same time by the workers of -j
+} generation_t;
+
+/* Builds the function of the keys in keys_file with nthreads threads and
+ * writes it to mphf_file, or adds it to the container mphf_file.
+ */
+static int generate_function(generation_t *gen, const char *keys_file, const char *mphf_file, cmph_uint32 nthreads)
+{
+	FILE *keys_fd;
+	FILE *mphf_fd = NULL;
+	FILE *legacy_fd = NULL;
+	CMPH_CHECKSUM blob_checksum = gen->blob_checksum;
+	cmph_io_adapter_t *source;
+	cmph_config_t *config;
+	cmph_t *mphf;
+	cmph_stats_t stats;
+	cmph_stats_mark_t mark;
+	double c = gen->c;
+	cmph_uint32 i;
+	int ret = 0;
+
+	keys_fd = fopen(keys_file, "r");
+	if (keys_fd == NULL)
+	{
+		fprintf(stderr, "Unable to open file %s: %s\n", keys_file, strerror(errno));
+		return -1;
+	}
+	if (gen->nkeys == UINT_MAX) source = cmph_io_nlfile_adapter(keys_fd);
+	else source = cmph_io_nlnkfile_adapter(keys_fd, gen->nkeys);
+
+	// an interrupted generation continues in its partial output
+	if (gen->resume && gen->algo == CMPH_BRZ) mphf_fd = fopen(mphf_file, "r+b");
+	// a container is updated once the function is built
+	if (mphf_fd == NULL && !gen->function_name) mphf_fd = fopen(mphf_file, "wb");
+	if (mphf_fd == NULL && !gen->function_name)
+	{
+		fprintf(stderr, "Unable to open output file %s: %s\n", mphf_file, strerror(errno));
+		cmph_io_nlfile_adapter_destroy(source);
+		fclose(keys_fd);
+		return -1;
+	}
+	// BRZ writes the function while it builds it, so a blob is made from the loaded function
+	if ((blob_checksum != CMPH_CHECKSUM_COUNT || gen->function_name) && gen->algo == CMPH_BRZ) legacy_fd = tmpfile();
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, gen->algo);
+	if (gen->bucket_algo != CMPH_COUNT) cmph_config_set_brz_algo(config, gen->bucket_algo);
+	if (gen->nhashes) cmph_config_set_hashfuncs(config, gen->hashes);
+	cmph_config_set_verbosity(config, gen->verbosity);
+	if (gen->ntmp_dirs) cmph_config_set_tmp_dir(config, (cmph_uint8 *) gen->tmp_dirs[0]);
+	for (i = 1; i < gen->ntmp_dirs; ++i) cmph_config_add_tmp_dir(config, (cmph_uint8 *) gen->tmp_dirs[i]);
+	cmph_config_set_tmp_compression(config, gen->tmp_compression);
+	if (gen->resume) cmph_config_set_resume(config, gen->resume);
+	cmph_config_set_mphf_fd(config, legacy_fd ? legacy_fd : mphf_fd);
+	cmph_config_set_memory_availability(config, gen->memory_availability);
+	cmph_config_set_b(config, gen->b);
+	cmph_config_set_keys_per_bin(config, gen->keys_per_bin);
+	cmph_config_set_nthreads(config, nthreads);
+	if (gen->stats_json) cmph_config_set_stats(config, &stats);
+
+	//if((mph_algo == CMPH_BMZ || mph_algo == CMPH_BRZ) && c >= 2.0) c=1.15;
+	if(gen->algo == CMPH_BMZ  && c >= 2.0) c=1.15;
+	if (c != 0) cmph_config_set_graphsize(config, c);
+	mphf = cmph_new(config);
+
+	cmph_config_destroy(config);
+	cmph_io_nlfile_adapter_destroy(source);
+	fclose(keys_fd);
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "Unable to create minimum perfect hashing function of %s\n", keys_file);
+		if (legacy_fd) fclose(legacy_fd);
+		if (mphf_fd) fclose(mphf_fd);
+		return -1;
+	}
+
+	cmph_stats_begin(gen->stats_json ? &stats : NULL, &mark);
+	if (legacy_fd)
+	{
+		cmph_dump(mphf, legacy_fd);
+		cmph_destroy(mphf);
+		rewind(legacy_fd);
+		mphf = cmph_load(legacy_fd);
+		fclose(legacy_fd);
+	}
+	if (gen->function_name)
+	{
+		if (blob_checksum == CMPH_CHECKSUM_COUNT) blob_checksum = CMPH_CHECKSUM_XXH64;
+		if (mphf == NULL || !cmph_blob_append(mphf_file, gen->function_name, (cmph_uint32)strlen(gen->function_name), mphf, blob_checksum))
+		{
+			fprintf(stderr, "Unable to add function %s to the container %s\n", gen->function_name, mphf_file);
+			ret = -1;
+		}
+	}
+	else if (blob_checksum != CMPH_CHECKSUM_COUNT)
+	{
+		if (mphf == NULL || !cmph_blob_dump(mphf, mphf_fd, blob_checksum))
+		{
+			fprintf(stderr, "Unable to write the blob %s\n", mphf_file);
+			ret = -1;
+		}
+	}
+	else cmph_dump(mphf, mphf_fd);
+	if (mphf) cmph_destroy(mphf);
+	if (mphf_fd) fclose(mphf_fd);
+	if (gen->stats_json)
+	{
+		cmph_stats_end(&stats, CMPH_PHASE_IO, &mark);
+		cmph_stats_memory(&stats);
+		stats.shared_process = gen->concurrent ? 1 : 0;
+		// the workers of -j print whole lines
+#ifdef HAVE_PTHREAD_H
+		flockfile(stdout);
+#endif
+		cmph_stats_json(&stats, keys_file, stdout);
+		fflush(stdout);
+#ifdef HAVE_PTHREAD_H
+		funlockfile(stdout);
+#endif
+	}
+	return ret;
+}
+
+/* Keys files built by the workers of -j. Each worker builds one function
+ * at a time on a thread of the budget. The threads of the budget left free,
+ * because there are fewer keys files than threads or because the workers
+ * ran out of keys files, are handed to the next functions of algorithms
+ * with parallel construction.
+ */
+typedef struct
+{
+	generation_t *gen;
+	char **keys_files;
+	cmph_uint32 nfiles;
+	cmph_uint32 next;      // next keys file to build
+	cmph_uint32 nworkers;  // workers still running
+	cmph_uint32 nfree;     // threads of the budget used by no worker
+	int ret;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_t mutex;
+#endif
+} generation_pool_t;
+
+static void generation_pool_lock(generation_pool_t *pool)
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&pool->mutex);
+#endif
+}
+
+static void generation_pool_unlock(generation_pool_t *pool)
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&pool->mutex);
+#endif
+}
+
+static void *generation_worker(void *arg)
+{
+	generation_pool_t *pool = (generation_pool_t *)arg;
+	generation_pool_lock(pool);
+	while (pool->next < pool->nfiles)
+	{
+		char *keys_file = pool->keys_files[pool->next];
+		cmph_uint32 nthreads = 1;
+		char *mphf_file;
+		int ret;
+		// only BRZ builds a function on several threads
+		if (pool->gen->algo == CMPH_BRZ)
+		{
+			cmph_uint32 nwaiting = pool->nfiles - pool->next;
+			if (nwaiting > pool->nworkers) nwaiting = pool->nworkers;
+			nthreads += pool->nfree / nwaiting;
+			pool->nfree -= nthreads - 1;
+		}
+		++pool->next;
+		generation_pool_unlock(pool);
+
+		mphf_file = (char *)malloc(strlen(keys_file) + 5);
+		sprintf(mphf_file, "%s.mph", keys_file);
+		if (pool->gen->verbosity) fprintf(stderr, "Building %s on %u threads\n", mphf_file, nthreads);
+		ret = generate_function(pool->gen, keys_file, mphf_file, nthreads);
+		free(mphf_file);
+
+		generation_pool_lock(pool);
+		if (ret) pool->ret = ret;
+		pool->nfree += nthreads - 1;
+	}
+	++pool->nfree;
+	--pool->nworkers;
+	generation_pool_unlock(pool);
+	return NULL;
+}
+
+/* Builds the functions of nfiles keys files, writing each one next to its
+ * keys file, with a budget of nthreads threads.
+ */
+static int generate_functions(generation_t *gen, char **keys_files, cmph_uint32 nfiles, cmph_uint32 nthreads)
+{
+	generation_pool_t pool;
+	cmph_uint32 nworkers = nthreads < nfiles ? nthreads : nfiles;
+	pool.gen = gen;
+	pool.keys_files = keys_files;
+	pool.nfiles = nfiles;
+	pool.next = 0;
+	pool.nworkers = nworkers;
+	pool.nfree = nthreads - nworkers;
+	pool.ret = 0;
+#ifdef HAVE_PTHREAD_H
+	if (nworkers > 1)
+	{
+		gen->concurrent = 1;
+		pthread_t *workers = (pthread_t *)malloc(sizeof(pthread_t)*nworkers);
+		cmph_uint32 nstarted, i;
+		pthread_mutex_init(&pool.mutex, NULL);
+		for (nstarted = 1; nstarted < nworkers; ++nstarted)
+		{
+			if (pthread_create(workers + nstarted, NULL, generation_worker, &pool) != 0) break;
+		}
+		if (nstarted < nworkers)
+		{
+			// the threads of the workers not started go to the functions
+			pthread_mutex_lock(&pool.mutex);
+			pool.nworkers -= nworkers - nstarted;
+			pool.nfree += nworkers - nstarted;
+			pthread_mutex_unlock(&pool.mutex);
+		}
+		generation_worker(&pool);
+		for (i = 1; i < nstarted; ++i) pthread_join(workers[i], NULL);
+		pthread_mutex_destroy(&pool.mutex);
+		free(workers);
+		return pool.ret;
+	}
+	pthread_mutex_init(&pool.mutex, NULL);
+	generation_worker(&pool);
+	pthread_mutex_destroy(&pool.mutex);
+#else
+	// the whole budget goes to each function in turn
+	pool.nworkers = 1;
+	pool.nfree = nthreads - 1;
+	generation_worker(&pool);
+#endif
+	return pool.ret;
 }
 
 int main(int argc, char **argv)
@@ -78,17 +385,54 @@ int main(int argc, char **argv)
 	cmph_uint32 nhashes = 0;
 	cmph_uint32 i;
 	CMPH_ALGO mph_algo = CMPH_CHM;
+	CMPH_ALGO bucket_algo = CMPH_COUNT;
 	double c = 0;
-	cmph_config_t *config = NULL;
 	cmph_t *mphf = NULL;
-	char * tmp_dir = NULL;
+	char ** tmp_dirs = NULL;
+	cmph_uint32 ntmp_dirs = 0;
+	cmph_uint32 tmp_compression = 0;
+	cmph_uint32 resume = 0;
+	CMPH_CHECKSUM blob_checksum = CMPH_CHECKSUM_COUNT;
+	cmph_blob_t *blob = NULL;
+	void *packed_mphf = NULL;
+	char *function_name = NULL;
+	cmph_uint32 compact = 0;
+	static char resume_option[] = "-r";
 	cmph_io_adapter_t *source;
 	cmph_uint32 memory_availability = 0;
 	cmph_uint32 b = 0;
 	cmph_uint32 keys_per_bin = 1;
+	cmph_uint32 nthreads = 1;
+	int query = 0;
+	int query_binary = 0;
+	cmph_uint8 * hashtable = NULL;
+	cmph_uint32 siz;
+	cmph_uint32 stats_json = 0;
+
+	// subcommands
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) return bench_main(argc - 1, argv + 1);
+	if (argc > 1 && strcmp(argv[1], "keygen") == 0) return keygen_main(argc - 1, argv + 1);
+	// --resume is an alias of -r, and --stats has no short option
+	for (i = 1; i < (cmph_uint32)argc; ++i)
+	{
+		if (strcmp(argv[i], "--") == 0) break;
+		if (strcmp(argv[i], "--resume") == 0) argv[i] = resume_option;
+		else if (strncmp(argv[i], "--stats", 7) == 0)
+		{
+			if (strcmp(argv[i] + 7, "=json") != 0 && argv[i][7] != 0)
+			{
+				fprintf(stderr, "Invalid statistics format %s\n", argv[i] + 7 + (argv[i][7] == '='));
+				return 1;
+			}
+			stats_json = 1;
+			memmove(argv + i, argv + i + 1, sizeof(char *)*(size_t)(argc - i));
+			--argc;
+			--i;
+		}
+	}
 	while (1)
 	{
-		char ch = (char)getopt(argc, argv, "hVvgc:k:a:M:b:t:f:m:d:s:");
+		char ch = (char)getopt(argc, argv, "hVvgc:k:a:i:M:b:t:f:m:d:zrF:n:Cj:q:s:");
 		if (ch == -1) break;
 		switch (ch)
 		{
@@ -129,7 +473,58 @@ int main(int argc, char **argv)
 				mphf_file = strdup(optarg);
 				break;
 			case 'd':
-				tmp_dir = strdup(optarg);
+				tmp_dirs = (char **)realloc(tmp_dirs, sizeof(char *) * (ntmp_dirs + 1));
+				tmp_dirs[ntmp_dirs++] = strdup(optarg);
+				break;
+			case 'z':
+				tmp_compression = 1;
+				break;
+			case 'r':
+				resume = 1;
+				break;
+			case 'n':
+				function_name = strdup(optarg);
+				break;
+			case 'C':
+				compact = 1;
+				break;
+			case 'j':
+				{
+					char *cptr;
+					nthreads = (cmph_uint32)strtoul(optarg, &cptr, 10);
+					if(*cptr != 0 || nthreads == 0) {
+						fprintf(stderr, "Invalid number of threads %s\n", optarg);
+						exit(1);
+					}
+				}
+				break;
+			case 'q':
+				query = 1;
+				if (strcmp(optarg, "binary") == 0) query_binary = 1;
+				else if (strcmp(optarg, "text") != 0)
+				{
+					fprintf(stderr, "Invalid format of the values: %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 'F':
+				{
+				char valid = 0;
+				for (i = 0; i < CMPH_CHECKSUM_COUNT; ++i)
+				{
+					if (strcmp(cmph_checksum_names[i], optarg) == 0)
+					{
+						blob_checksum = (CMPH_CHECKSUM)i;
+						valid = 1;
+						break;
+					}
+				}
+				if (!valid)
+				{
+					fprintf(stderr, "Invalid checksum: %s\n", optarg);
+					return -1;
+				}
+				}
 				break;
 			case 'M':
 				{
@@ -189,6 +584,25 @@ int main(int argc, char **argv)
 				}
 				}
 				break;
+			case 'i':
+				{
+				char valid = 0;
+				for (i = 0; i < CMPH_COUNT; ++i)
+				{
+					if (strcmp(cmph_names[i], optarg) == 0 && (i == CMPH_BMZ8 || i == CMPH_FCH || i == CMPH_BDZ || i == CMPH_CHD))
+					{
+						bucket_algo = (CMPH_ALGO)i;
+						valid = 1;
+						break;
+					}
+				}
+				if (!valid)
+				{
+					fprintf(stderr, "Invalid algorithm for the buckets of BRZ: %s\n", optarg);
+					return -1;
+				}
+				}
+				break;
 			case 'f':
 				{
 				char valid = 0;
@@ -217,16 +631,92 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (optind != argc - 1)
+	if (compact)
+	{
+		if (mphf_file == NULL || optind != argc)
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		if (!cmph_blob_compact(mphf_file))
+		{
+			fprintf(stderr, "Unable to compact the container %s\n", mphf_file);
+			free(mphf_file);
+			return -1;
+		}
+		free(mphf_file);
+		return 0;
+	}
+
+	// bulk queries read the keys from the standard input by default
+	if (query && !generate && optind == argc) keys_file = "-";
+	else if (optind == argc || (optind != argc - 1 && !generate))
 	{
 		usage(argv[0]);
 		return 1;
 	}
-	keys_file = argv[optind];
+	else keys_file = argv[optind];
+	if (query && (generate || (mphf_file == NULL && strcmp(keys_file, "-") == 0)))
+	{
+		fprintf(stderr, "Bulk queries need the function given by -m and no -g\n");
+		return 1;
+	}
+	if (argc - optind > 1 && (mphf_file || function_name))
+	{
+		fprintf(stderr, "Functions of several keys files are written next to them, without -m and -n\n");
+		return 1;
+	}
+
+	if (resume && (blob_checksum != CMPH_CHECKSUM_COUNT || function_name))
+	{
+		fprintf(stderr, "Interrupted generations can not be resumed into blobs\n");
+		return 1;
+	}
+	if (stats_json && !generate)
+	{
+		fprintf(stderr, "Statistics are only printed by the generation mode\n");
+		return 1;
+	}
+	if (function_name && mphf_file == NULL)
+	{
+		fprintf(stderr, "The container of function %s must be given by -m\n", function_name);
+		return 1;
+	}
 
 	if (seed == UINT_MAX) seed = (cmph_uint32)time(NULL);
 	srand(seed);
 	int ret = 0;
+	if (generate)
+	{
+		generation_t gen;
+		gen.algo = mph_algo;
+		gen.bucket_algo = bucket_algo;
+		gen.hashes = hashes;
+		gen.nhashes = nhashes;
+		gen.c = c;
+		gen.verbosity = verbosity;
+		gen.nkeys = nkeys;
+		gen.tmp_dirs = tmp_dirs;
+		gen.ntmp_dirs = ntmp_dirs;
+		gen.tmp_compression = tmp_compression;
+		gen.resume = resume;
+		gen.memory_availability = memory_availability;
+		gen.b = b;
+		gen.keys_per_bin = keys_per_bin;
+		gen.blob_checksum = blob_checksum;
+		gen.function_name = function_name;
+		gen.stats_json = stats_json;
+		gen.concurrent = 0;
+		if (mphf_file) ret = generate_function(&gen, keys_file, mphf_file, nthreads);
+		else ret = generate_functions(&gen, argv + optind, (cmph_uint32)(argc - optind), nthreads);
+		free(mphf_file);
+		for (i = 0; i < ntmp_dirs; ++i) free(tmp_dirs[i]);
+		free(tmp_dirs);
+		free(hashes);
+		free(function_name);
+		return ret;
+	}
+
 	if (mphf_file == NULL)
 	{
 		mphf_file = (char *)malloc(strlen(keys_file) + 5);
@@ -234,108 +724,107 @@ int main(int argc, char **argv)
 		memcpy(mphf_file + strlen(keys_file), ".mph\0", (size_t)5);
 	}
 
-	keys_fd = fopen(keys_file, "r");
-
-	if (keys_fd == NULL)
+	mphf_fd = fopen(mphf_file, "rb");
+	if (mphf_fd == NULL)
 	{
-		fprintf(stderr, "Unable to open file %s: %s\n", keys_file, strerror(errno));
+		fprintf(stderr, "Unable to open input file %s: %s\n", mphf_file, strerror(errno));
+		free(mphf_file);
 		return -1;
 	}
-
-	if (seed == UINT_MAX) seed = (cmph_uint32)time(NULL);
-	if(nkeys == UINT_MAX) source = cmph_io_nlfile_adapter(keys_fd);
-	else source = cmph_io_nlnkfile_adapter(keys_fd, nkeys);
-	if (generate)
+	blob = cmph_blob_open(mphf_file, 0);
+	if (blob)
 	{
-		//Create mphf
-		mphf_fd = fopen(mphf_file, "wb");
-		config = cmph_config_new(source);
-		cmph_config_set_algo(config, mph_algo);
-		if (nhashes) cmph_config_set_hashfuncs(config, hashes);
-		cmph_config_set_verbosity(config, verbosity);
-		cmph_config_set_tmp_dir(config, (cmph_uint8 *) tmp_dir);
-		cmph_config_set_mphf_fd(config, mphf_fd);
-		cmph_config_set_memory_availability(config, memory_availability);
-		cmph_config_set_b(config, b);
-		cmph_config_set_keys_per_bin(config, keys_per_bin);
-
-		//if((mph_algo == CMPH_BMZ || mph_algo == CMPH_BRZ) && c >= 2.0) c=1.15;
-		if(mph_algo == CMPH_BMZ  && c >= 2.0) c=1.15;
-		if (c != 0) cmph_config_set_graphsize(config, c);
-		mphf = cmph_new(config);
-
-		cmph_config_destroy(config);
-		if (mphf == NULL)
+		int corrupted = 1;
+		if (function_name) packed_mphf = cmph_blob_find(blob, function_name, (cmph_uint32)strlen(function_name), &siz, &corrupted);
+		else packed_mphf = cmph_blob_packed(blob);
+		if (!packed_mphf)
 		{
-			fprintf(stderr, "Unable to create minimum perfect hashing function\n");
-			//cmph_config_destroy(config);
+			if (function_name && corrupted) fprintf(stderr, "The function %s of the container %s is corrupted\n", function_name, mphf_file);
+			else if (function_name) fprintf(stderr, "No function %s in the container %s\n", function_name, mphf_file);
+			else fprintf(stderr, "The blob %s is corrupted\n", mphf_file);
+			cmph_blob_close(blob);
+			fclose(mphf_fd);
 			free(mphf_file);
 			return -1;
 		}
+	}
+	else mphf = cmph_load(mphf_fd);
+	fclose(mphf_fd);
+	if (!mphf && !blob)
+	{
+		fprintf(stderr, "Unable to parser input file %s\n", mphf_file);
+		free(mphf_file);
+		return -1;
+	}
 
-		if (mphf_fd == NULL)
+	if (query)
+	{
+		cmph_searcher_t *searcher = blob ? cmph_searcher_new_packed(packed_mphf) : cmph_searcher_new(mphf);
+		keys_fd = strcmp(keys_file, "-") == 0 ? stdin : fopen(keys_file, "rb");
+		if (keys_fd == NULL) fprintf(stderr, "Unable to open file %s: %s\n", keys_file, strerror(errno));
+		if (searcher == NULL || keys_fd == NULL || !query_run(searcher, keys_fd, stdout, query_binary, nthreads))
 		{
-			fprintf(stderr, "Unable to open output file %s: %s\n", mphf_file, strerror(errno));
-			free(mphf_file);
-			return -1;
+			if (keys_fd) fprintf(stderr, "Unable to query the keys of %s\n", keys_file);
+			ret = -1;
 		}
-		cmph_dump(mphf, mphf_fd);
-		cmph_destroy(mphf);
-		fclose(mphf_fd);
+		if (keys_fd && keys_fd != stdin) fclose(keys_fd);
+		if (searcher) cmph_searcher_destroy(searcher);
+		if (blob) cmph_blob_close(blob);
+		else cmph_destroy(mphf);
+		free(mphf_file);
+		free(function_name);
+		return ret;
+	}
+
+	keys_fd = fopen(keys_file, "r");
+
+	if (keys_fd == NULL)
+	{
+		fprintf(stderr, "Unable to open file %s: %s\n", keys_file, strerror(errno));
+		return -1;
 	}
-	else
+
+	if(nkeys == UINT_MAX) source = cmph_io_nlfile_adapter(keys_fd);
+	else source = cmph_io_nlnkfile_adapter(keys_fd, nkeys);
+
+	if (!blob) siz = cmph_size(mphf);
+	else if (!function_name) siz = cmph_blob_size(blob);
+	hashtable = (cmph_uint8*)calloc(siz, sizeof(cmph_uint8));
+	memset(hashtable, 0,(size_t) siz);
+	//check all keys
+	for (i = 0; i < source->nkeys; ++i)
 	{
-		cmph_uint8 * hashtable = NULL;
-		mphf_fd = fopen(mphf_file, "rb");
-		if (mphf_fd == NULL)
+		cmph_uint32 h;
+		char *buf;
+		cmph_uint32 buflen = 0;
+		source->read(source->data, &buf, &buflen);
+		h = blob ? cmph_search_packed(packed_mphf, buf, buflen) : cmph_search(mphf, buf, buflen);
+		if (!(h < siz))
 		{
-			fprintf(stderr, "Unable to open input file %s: %s\n", mphf_file, strerror(errno));
-			free(mphf_file);
-			return -1;
-		}
-		mphf = cmph_load(mphf_fd);
-		fclose(mphf_fd);
-		if (!mphf)
+			fprintf(stderr, "Unknown key %*s in the input.\n", buflen, buf);
+			ret = 1;
+		} else if(hashtable[h] >= keys_per_bin)
 		{
-			fprintf(stderr, "Unable to parser input file %s\n", mphf_file);
-			free(mphf_file);
-			return -1;
-		}
-		cmph_uint32 siz = cmph_size(mphf);
-		hashtable = (cmph_uint8*)calloc(siz, sizeof(cmph_uint8));
-		memset(hashtable, 0,(size_t) siz);
-		//check all keys
-		for (i = 0; i < source->nkeys; ++i)
-		{
-			cmph_uint32 h;
-			char *buf;
-			cmph_uint32 buflen = 0;
-			source->read(source->data, &buf, &buflen);
-			h = cmph_search(mphf, buf, buflen);
-			if (!(h < siz))
-			{
-				fprintf(stderr, "Unknown key %*s in the input.\n", buflen, buf);
-				ret = 1;
-			} else if(hashtable[h] >= keys_per_bin)
-			{
-				fprintf(stderr, "More than %u keys were mapped to bin %u\n", keys_per_bin, h);
-				fprintf(stderr, "Duplicated or unknown key %*s in the input\n", buflen, buf);
-				ret = 1;
-			} else hashtable[h]++;
+			fprintf(stderr, "More than %u keys were mapped to bin %u\n", keys_per_bin, h);
+			fprintf(stderr, "Duplicated or unknown key %*s in the input\n", buflen, buf);
+			ret = 1;
+		} else hashtable[h]++;
 
-			if (verbosity)
-			{
-				printf("%s -> %u\n", buf, h);
-			}
-			source->dispose(source->data, buf, buflen);
+		if (verbosity)
+		{
+			printf("%s -> %u\n", buf, h);
 		}
-
-		cmph_destroy(mphf);
-		free(hashtable);
+		source->dispose(source->data, buf, buflen);
 	}
+
+	if (blob) cmph_blob_close(blob);
+	else cmph_destroy(mphf);
+	free(hashtable);
 	fclose(keys_fd);
 	free(mphf_file);
-	free(tmp_dir);
+	for (i = 0; i < ntmp_dirs; ++i) free(tmp_dirs[i]);
+	free(tmp_dirs);
+	free(function_name);
         cmph_io_nlfile_adapter_destroy(source);
 	return ret;
 
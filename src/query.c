@@ -0,0 +1,277 @@
+#include "query.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+//#define DEBUG
+#include "debug.h"
+
+#define QUERY_BUFFER_SIZE (8U << 20)        // bytes of keys read at once
+#define QUERY_BATCH 64                      // keys searched and timed together
+#define QUERY_MIN_KEYS_PER_THREAD 8192      // smaller blocks are searched on fewer threads
+#define QUERY_TEXT_SIZE 11                  // decimal digits of a cmph_uint32 and a newline
+
+/* Latencies of the batches are counted in buckets of a log-linear histogram:
+ * values below 8 ns have a bucket each, and each power of two above is split
+ * in 8 buckets, so that a bucket is at most 12.5% wide.
+ */
+#define QUERY_HISTOGRAM_SIZE 496
+
+/* Keys of a block searched and formatted by one thread. */
+typedef struct
+{
+	const cmph_searcher_t *searcher;
+	const char **keys;
+	const cmph_uint32 *keylens;
+	cmph_uint32 *values;
+	cmph_uint32 nkeys;
+	int binary;
+	char *text;                    // values formatted as decimal lines
+	cmph_uint32 text_capacity;     // in keys
+	size_t text_len;
+	cmph_uint64 search_ns;
+	cmph_uint64 nbatches;
+	cmph_uint64 histogram[QUERY_HISTOGRAM_SIZE];
+} query_slice_t;
+
+static inline cmph_uint64 query_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (cmph_uint64)ts.tv_sec * 1000000000ULL + (cmph_uint64)ts.tv_nsec;
+#else
+	return (cmph_uint64)clock() * (1000000000ULL / CLOCKS_PER_SEC);
+#endif
+}
+
+static cmph_uint32 query_bucket(cmph_uint64 ns)
+{
+	cmph_uint32 e = 0;
+	if (ns < 8) return (cmph_uint32)ns;
+	while ((ns >> e) > 1) ++e;
+	return (e - 2) * 8 + (cmph_uint32)((ns >> (e - 3)) & 7);
+}
+
+// smallest latency of a bucket
+static cmph_uint64 query_bucket_ns(cmph_uint32 bucket)
+{
+	if (bucket < 8) return bucket;
+	return (cmph_uint64)(8 + bucket % 8) << (bucket / 8 - 1);
+}
+
+static char *query_format(char *p, cmph_uint32 value)
+{
+	char digits[10];
+	cmph_uint32 n = 0;
+	do
+	{
+		digits[n++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value);
+	while (n) *p++ = digits[--n];
+	*p++ = '\n';
+	return p;
+}
+
+static void *query_slice_run(void *arg)
+{
+	query_slice_t *slice = (query_slice_t *)arg;
+	cmph_uint32 i, n;
+	for (i = 0; i < slice->nkeys; i += n)
+	{
+		cmph_uint64 begin, ns;
+		n = slice->nkeys - i < QUERY_BATCH ? slice->nkeys - i : QUERY_BATCH;
+		begin = query_now();
+		cmph_searcher_search_batch(slice->searcher, n, slice->keys + i, slice->keylens + i, slice->values + i);
+		ns = query_now() - begin;
+		slice->search_ns += ns;
+		++slice->nbatches;
+		++slice->histogram[query_bucket(ns)];
+	}
+	if (!slice->binary)
+	{
+		char *p;
+		if (slice->text_capacity < slice->nkeys)
+		{
+			free(slice->text);
+			slice->text_capacity = slice->nkeys;
+			slice->text = (char *)malloc((size_t)slice->text_capacity * QUERY_TEXT_SIZE);
+		}
+		p = slice->text;
+		for (i = 0; i < slice->nkeys; ++i) p = query_format(p, slice->values[i]);
+		slice->text_len = (size_t)(p - slice->text);
+	}
+	return NULL;
+}
+
+/* Searches the keys of a block on up to nslices threads and writes their
+ * values in order.
+ */
+static int query_block(query_slice_t *slices, cmph_uint32 nslices, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values, cmph_uint32 nkeys, FILE *out)
+{
+	cmph_uint32 i, begin = 0;
+	if (nslices > nkeys / QUERY_MIN_KEYS_PER_THREAD) nslices = nkeys / QUERY_MIN_KEYS_PER_THREAD;
+	if (nslices == 0) nslices = 1;
+	for (i = 0; i < nslices; ++i)
+	{
+		cmph_uint32 end = (cmph_uint32)(((cmph_uint64)nkeys * (i + 1)) / nslices);
+		slices[i].keys = keys + begin;
+		slices[i].keylens = keylens + begin;
+		slices[i].values = values + begin;
+		slices[i].nkeys = end - begin;
+		begin = end;
+	}
+#ifdef HAVE_PTHREAD_H
+	if (nslices > 1)
+	{
+		pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t)*nslices);
+		cmph_uint32 nstarted;
+		for (nstarted = 1; nstarted < nslices; ++nstarted)
+		{
+			if (pthread_create(threads + nstarted, NULL, query_slice_run, slices + nstarted) != 0) break;
+		}
+		query_slice_run(slices);
+		for (i = 1; i < nstarted; ++i) pthread_join(threads[i], NULL);
+		for (i = nstarted; i < nslices; ++i) query_slice_run(slices + i);
+		free(threads);
+	}
+	else query_slice_run(slices);
+#else
+	for (i = 0; i < nslices; ++i) query_slice_run(slices + i);
+#endif
+	if (slices[0].binary) return fwrite(values, sizeof(cmph_uint32), nkeys, out) == nkeys;
+	for (i = 0; i < nslices; ++i)
+	{
+		if (fwrite(slices[i].text, 1, slices[i].text_len, out) != slices[i].text_len) return 0;
+	}
+	return 1;
+}
+
+static void query_report(query_slice_t *slices, cmph_uint32 nslices, cmph_uint64 nkeys, cmph_uint64 nbytes, cmph_uint64 elapsed_ns)
+{
+	cmph_uint64 histogram[QUERY_HISTOGRAM_SIZE];
+	cmph_uint64 search_ns = 0, nbatches = 0, count = 0;
+	cmph_uint64 p50 = 0, p99 = 0, max = 0;
+	double seconds = (double)elapsed_ns / 1e9;
+	cmph_uint32 nthreads = 0;
+	cmph_uint32 i, j;
+	memset(histogram, 0, sizeof(histogram));
+	for (i = 0; i < nslices; ++i)
+	{
+		search_ns += slices[i].search_ns;
+		nbatches += slices[i].nbatches;
+		if (slices[i].nbatches) ++nthreads;
+		for (j = 0; j < QUERY_HISTOGRAM_SIZE; ++j) histogram[j] += slices[i].histogram[j];
+	}
+	for (j = 0; j < QUERY_HISTOGRAM_SIZE; ++j)
+	{
+		if (histogram[j] == 0) continue;
+		count += histogram[j];
+		if (p50 == 0 && count * 2 >= nbatches) p50 = query_bucket_ns(j);
+		if (p99 == 0 && count * 100 >= nbatches * 99) p99 = query_bucket_ns(j);
+		max = query_bucket_ns(j);
+	}
+	if (seconds <= 0) seconds = 1e-9;
+	fprintf(stderr, "Queried %llu keys (%.1f MB) in %.3f s: %.0f keys/s, %.1f MB/s\n",
+	        (unsigned long long)nkeys, (double)nbytes / 1e6, seconds, (double)nkeys / seconds, (double)nbytes / 1e6 / seconds);
+	if (nkeys == 0) return;
+	fprintf(stderr, "Searched in %.1f ns per key on %u threads, batches of %u keys in %.1f us (p50), %.1f us (p99), %.1f us (max)\n",
+	        (double)search_ns / (double)nkeys, nthreads, QUERY_BATCH, (double)p50 / 1e3, (double)p99 / 1e3, (double)max / 1e3);
+}
+
+int query_run(const cmph_searcher_t *searcher, FILE *in, FILE *out, int binary, cmph_uint32 nthreads)
+{
+	size_t capacity = QUERY_BUFFER_SIZE, len = 0;
+	char *buffer = (char *)malloc(capacity);
+	cmph_uint32 keys_capacity = 0;
+	const char **keys = NULL;
+	cmph_uint32 *keylens = NULL;
+	cmph_uint32 *values = NULL;
+	query_slice_t *slices;
+	cmph_uint64 nkeys = 0, nbytes = 0, begin = query_now();
+	cmph_uint32 i;
+	int eof = 0, ret = 1;
+
+	if (nthreads == 0) nthreads = 1;
+	slices = (query_slice_t *)calloc(nthreads, sizeof(query_slice_t));
+	for (i = 0; i < nthreads; ++i)
+	{
+		slices[i].searcher = searcher;
+		slices[i].binary = binary;
+	}
+	while (!eof)
+	{
+		size_t nread = fread(buffer + len, 1, capacity - len, in);
+		size_t end;
+		cmph_uint32 n = 0;
+		char *p;
+		len += nread;
+		nbytes += nread;
+		if (len < capacity)
+		{
+			if (ferror(in))
+			{
+				ret = 0;
+				break;
+			}
+			eof = feof(in);
+		}
+		// the block ends with the last complete key
+		end = len;
+		if (!eof)
+		{
+			while (end > 0 && buffer[end - 1] != '\n') --end;
+			if (end == 0)
+			{
+				// a key longer than the buffer
+				if (len == capacity)
+				{
+					capacity *= 2;
+					buffer = (char *)realloc(buffer, capacity);
+				}
+				continue;
+			}
+		}
+		for (p = buffer; p < buffer + end; ++n)
+		{
+			char *newline = (char *)memchr(p, '\n', (size_t)(buffer + end - p));
+			if (newline == NULL) newline = buffer + end;
+			if (n == keys_capacity)
+			{
+				keys_capacity = keys_capacity ? keys_capacity * 2 : 65536;
+				keys = (const char **)realloc((void *)keys, sizeof(char *)*keys_capacity);
+				keylens = (cmph_uint32 *)realloc(keylens, sizeof(cmph_uint32)*keys_capacity);
+				values = (cmph_uint32 *)realloc(values, sizeof(cmph_uint32)*keys_capacity);
+			}
+			keys[n] = p;
+			keylens[n] = (cmph_uint32)(newline - p);
+			p = newline + 1;
+		}
+		DEBUGP("Block of %u keys in %lu bytes\n", n, (unsigned long)end);
+		if (n && !query_block(slices, nthreads, keys, keylens, values, n, out))
+		{
+			ret = 0;
+			break;
+		}
+		nkeys += n;
+		memmove(buffer, buffer + end, len - end);
+		len -= end;
+	}
+	if (fflush(out) != 0) ret = 0;
+	query_report(slices, nthreads, nkeys, nbytes, query_now() - begin);
+	for (i = 0; i < nthreads; ++i) free(slices[i].text);
+	free(slices);
+	free((void *)keys);
+	free(keylens);
+	free(values);
+	free(buffer);
+	return ret;
+}
@@ -0,0 +1,18 @@
+#ifndef __CMPH_QUERY_H__
+#define __CMPH_QUERY_H__
+
+#include "cmph_searcher.h"
+#include <stdio.h>
+
+/** \fn int query_run(const cmph_searcher_t *searcher, FILE *in, FILE *out, int binary, cmph_uint32 nthreads);
+ *  \brief Bulk queries of the cmph tool. Reads line separated keys from in
+ *  and writes their values to out, in the order of the keys, as decimal
+ *  lines or as cmph_uint32 in the byte order of the host. The keys are read
+ *  in large blocks and searched in batches by cmph_searcher_search_batch(),
+ *  on nthreads threads for large blocks. Throughput and latency statistics
+ *  are printed to stderr at the end.
+ *  \return 1 for success and 0 for I/O failures
+ */
+int query_run(const cmph_searcher_t *searcher, FILE *in, FILE *out, int binary, cmph_uint32 nthreads);
+
+#endif
@@ -0,0 +1,300 @@
+#include "run_codec.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RUN_CODEC_LZ_MIN_MATCH 4
+#define RUN_CODEC_LZ_HASH_BITS 12
+#define RUN_CODEC_LZ_MAX_LENGTH (1U << 30) // of a run of literals or a match, beyond any valid block
+
+struct __run_writer_t
+{
+	FILE * fd;
+	cmph_uint8 compressed;
+	cmph_uint8 error;
+	cmph_uint8 * block;      // encoded records of the current block
+	cmph_uint32 block_size;  // allocated bytes of block
+	cmph_uint8 * packed;     // block after the LZ77 pass
+	cmph_uint32 packed_size; // allocated bytes of packed
+	cmph_uint32 enclen;      // encoded bytes of the current block
+	cmph_uint32 rawlen;      // decoded bytes of the current block
+	cmph_uint32 prev_h0;
+	cmph_uint8 * prev_key;   // previous key of the current block
+	cmph_uint32 prev_keylen;
+	cmph_uint32 prev_key_size;
+};
+
+static inline cmph_uint32 run_codec_put_varint(cmph_uint8 * out, cmph_uint32 value)
+{
+	register cmph_uint32 n = 0;
+	while (value >= 0x80)
+	{
+		out[n++] = (cmph_uint8)(value | 0x80);
+		value >>= 7;
+	}
+	out[n++] = (cmph_uint8)value;
+	return n;
+}
+
+static inline cmph_uint32 run_codec_get_varint(cmph_uint8 * in, cmph_uint32 inlen, cmph_uint32 * pos, cmph_uint32 * value)
+{
+	register cmph_uint32 shift = 0;
+	register cmph_uint32 v = 0;
+	while (*pos < inlen && shift < 35)
+	{
+		register cmph_uint8 byte = in[(*pos)++];
+		v |= (cmph_uint32)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+		{
+			*value = v;
+			return 1;
+		}
+		shift += 7;
+	}
+	return 0;
+}
+
+// the sequence of 4 bytes at in, read in any alignment
+static inline cmph_uint32 run_codec_lz_read32(const cmph_uint8 * in)
+{
+	cmph_uint32 v;
+	memcpy(&v, in, sizeof(v));
+	return v;
+}
+
+static inline cmph_uint32 run_codec_lz_put_length(cmph_uint8 * out, cmph_uint32 length)
+{
+	register cmph_uint32 n = 0;
+	while (length >= 255)
+	{
+		out[n++] = 255;
+		length -= 255;
+	}
+	out[n++] = (cmph_uint8)length;
+	return n;
+}
+
+static inline cmph_uint32 run_codec_lz_get_length(const cmph_uint8 * in, cmph_uint32 inlen, cmph_uint32 * pos, cmph_uint32 * length)
+{
+	register cmph_uint8 byte;
+	do
+	{
+		if (*pos >= inlen || *length > RUN_CODEC_LZ_MAX_LENGTH) return 0;
+		byte = in[(*pos)++];
+		*length += byte;
+	} while (byte == 255);
+	return 1;
+}
+
+// Appends a sequence of literals followed by a match, if match_len is not 0.
+static cmph_uint32 run_codec_lz_put_sequence(cmph_uint8 * out, const cmph_uint8 * literals, cmph_uint32 nliterals,
+                                             cmph_uint32 offset, cmph_uint32 match_len)
+{
+	cmph_uint32 n = 1;
+	cmph_uint32 extra = match_len ? match_len - RUN_CODEC_LZ_MIN_MATCH : 0;
+	out[0] = (cmph_uint8)(((nliterals < 15 ? nliterals : 15) << 4) | (extra < 15 ? extra : 15));
+	if (nliterals >= 15) n += run_codec_lz_put_length(out + n, nliterals - 15);
+	memcpy(out + n, literals, (size_t)nliterals);
+	n += nliterals;
+	if (!match_len) return n;
+	out[n++] = (cmph_uint8)offset;
+	out[n++] = (cmph_uint8)(offset >> 8);
+	if (extra >= 15) n += run_codec_lz_put_length(out + n, extra - 15);
+	return n;
+}
+
+/* LZ77 pass over an encoded block, in the sequences of LZ4: a token with the
+ * number of literals and the match length in its nibbles, the literals, the
+ * 16-bit offset of the match and the lengths not fitting the nibbles. The
+ * last sequence has no match. Front coding only shares the prefix with the
+ * previous key, and this pass finds the repeated hosts and paths further
+ * back. out has room for inlen + inlen / 255 + 16 bytes.
+ */
+static cmph_uint32 run_codec_lz_compress(const cmph_uint8 * in, cmph_uint32 inlen, cmph_uint8 * out)
+{
+	cmph_uint32 table[1 << RUN_CODEC_LZ_HASH_BITS]; // last position + 1 of each hashed sequence
+	cmph_uint32 pos = 0, anchor = 0, n = 0;
+	memset(table, 0, sizeof(table));
+	while (pos + RUN_CODEC_LZ_MIN_MATCH <= inlen)
+	{
+		cmph_uint32 seq = run_codec_lz_read32(in + pos);
+		cmph_uint32 h = (seq * 2654435761U) >> (32 - RUN_CODEC_LZ_HASH_BITS);
+		cmph_uint32 candidate = table[h];
+		table[h] = pos + 1;
+		if (candidate && pos + 1 - candidate <= 0xffff && run_codec_lz_read32(in + candidate - 1) == seq)
+		{
+			cmph_uint32 match = candidate - 1;
+			cmph_uint32 match_len = RUN_CODEC_LZ_MIN_MATCH;
+			while (pos + match_len < inlen && in[match + match_len] == in[pos + match_len]) match_len++;
+			n += run_codec_lz_put_sequence(out + n, in + anchor, pos - anchor, pos - match, match_len);
+			pos += match_len;
+			anchor = pos;
+		}
+		else pos++;
+	}
+	n += run_codec_lz_put_sequence(out + n, in + anchor, inlen - anchor, 0, 0);
+	return n;
+}
+
+// Undoes run_codec_lz_compress(), returning the size of the block or 0 if it is invalid.
+static cmph_uint32 run_codec_lz_decompress(const cmph_uint8 * in, cmph_uint32 inlen, cmph_uint8 * out, cmph_uint32 outlen)
+{
+	cmph_uint32 pos = 0, n = 0;
+	while (pos < inlen)
+	{
+		cmph_uint8 token = in[pos++];
+		cmph_uint32 nliterals = token >> 4;
+		cmph_uint32 match_len = token & 15;
+		cmph_uint32 offset;
+		if (nliterals == 15 && !run_codec_lz_get_length(in, inlen, &pos, &nliterals)) return 0;
+		if (nliterals > inlen - pos || nliterals > outlen - n) return 0;
+		memcpy(out + n, in + pos, (size_t)nliterals);
+		pos += nliterals;
+		n += nliterals;
+		if (pos == inlen) break; // the last sequence
+		if (inlen - pos < 2) return 0;
+		offset = (cmph_uint32)in[pos] | ((cmph_uint32)in[pos + 1] << 8);
+		pos += 2;
+		if (match_len == 15 && !run_codec_lz_get_length(in, inlen, &pos, &match_len)) return 0;
+		match_len += RUN_CODEC_LZ_MIN_MATCH;
+		if (offset == 0 || offset > n || match_len > outlen - n) return 0;
+		while (match_len--) // the match may overlap its copy
+		{
+			out[n] = out[n - offset];
+			n++;
+		}
+	}
+	return n;
+}
+
+run_writer_t * run_writer_new(FILE * fd, cmph_uint8 compressed)
+{
+	run_writer_t * run_writer = (run_writer_t *)malloc(sizeof(run_writer_t));
+	if (!run_writer) return NULL;
+	run_writer->fd = fd;
+	run_writer->compressed = compressed;
+	run_writer->error = 0;
+	run_writer->block = NULL;
+	run_writer->block_size = 0;
+	run_writer->packed = NULL;
+	run_writer->packed_size = 0;
+	run_writer->enclen = 0;
+	run_writer->rawlen = 0;
+	run_writer->prev_h0 = 0;
+	run_writer->prev_key = NULL;
+	run_writer->prev_keylen = 0;
+	run_writer->prev_key_size = 0;
+	return run_writer;
+}
+
+static void run_writer_flush(run_writer_t * run_writer)
+{
+	cmph_uint32 header[2];
+	if (run_writer->rawlen == 0) return;
+	if (run_writer->enclen + run_writer->enclen/255 + 16 > run_writer->packed_size)
+	{
+		run_writer->packed_size = run_writer->enclen + run_writer->enclen/255 + 16;
+		run_writer->packed = (cmph_uint8 *)realloc(run_writer->packed, (size_t)run_writer->packed_size);
+		assert(run_writer->packed);
+	}
+	header[0] = run_writer->rawlen;
+	header[1] = run_codec_lz_compress(run_writer->block, run_writer->enclen, run_writer->packed);
+	if (fwrite(header, sizeof(header), (size_t)1, run_writer->fd) != 1) run_writer->error = 1;
+	if (fwrite(run_writer->packed, (size_t)header[1], (size_t)1, run_writer->fd) != 1) run_writer->error = 1;
+	run_writer->enclen = 0;
+	run_writer->rawlen = 0;
+	run_writer->prev_h0 = 0;
+	run_writer->prev_keylen = 0;
+}
+
+void run_writer_write(run_writer_t * run_writer, cmph_uint32 h0, cmph_uint8 * record)
+{
+	cmph_uint32 keylen, reclen, shared = 0;
+	cmph_uint8 * key = record + sizeof(keylen);
+	memcpy(&keylen, record, sizeof(keylen));
+	reclen = keylen + 2U*(cmph_uint32)sizeof(cmph_uint32);
+	if (!run_writer->compressed)
+	{
+		if (fwrite(&h0, sizeof(h0), (size_t)1, run_writer->fd) != 1) run_writer->error = 1;
+		if (fwrite(record, (size_t)keylen + sizeof(keylen), (size_t)1, run_writer->fd) != 1) run_writer->error = 1;
+		return;
+	}
+	if (run_writer->rawlen && run_writer->rawlen + reclen > RUN_CODEC_BLOCK_SIZE) run_writer_flush(run_writer);
+	// room for three varints and the suffix
+	if (run_writer->enclen + keylen + 15 > run_writer->block_size)
+	{
+		run_writer->block_size = run_writer->enclen + keylen + 15 > 2*run_writer->block_size ? run_writer->enclen + keylen + 15 : 2*run_writer->block_size;
+		run_writer->block = (cmph_uint8 *)realloc(run_writer->block, (size_t)run_writer->block_size);
+		assert(run_writer->block);
+	}
+	while (shared < keylen && shared < run_writer->prev_keylen && key[shared] == run_writer->prev_key[shared]) shared++;
+	run_writer->enclen += run_codec_put_varint(run_writer->block + run_writer->enclen, h0 - run_writer->prev_h0);
+	run_writer->enclen += run_codec_put_varint(run_writer->block + run_writer->enclen, shared);
+	run_writer->enclen += run_codec_put_varint(run_writer->block + run_writer->enclen, keylen - shared);
+	memcpy(run_writer->block + run_writer->enclen, key + shared, (size_t)(keylen - shared));
+	run_writer->enclen += keylen - shared;
+	run_writer->rawlen += reclen;
+	run_writer->prev_h0 = h0;
+	if (keylen > run_writer->prev_key_size)
+	{
+		run_writer->prev_key_size = keylen;
+		run_writer->prev_key = (cmph_uint8 *)realloc(run_writer->prev_key, (size_t)keylen);
+		assert(run_writer->prev_key);
+	}
+	memcpy(run_writer->prev_key + shared, key + shared, (size_t)(keylen - shared));
+	run_writer->prev_keylen = keylen;
+}
+
+int run_writer_destroy(run_writer_t * run_writer)
+{
+	int error;
+	if (run_writer->compressed) run_writer_flush(run_writer);
+	error = run_writer->error;
+	free(run_writer->block);
+	free(run_writer->packed);
+	free(run_writer->prev_key);
+	free(run_writer);
+	return !error;
+}
+
+static cmph_uint32 run_codec_decode_records(cmph_uint8 * in, cmph_uint32 inlen, cmph_uint8 * out, cmph_uint32 outlen)
+{
+	cmph_uint32 pos = 0, nbytes = 0;
+	cmph_uint32 h0 = 0, delta, shared, suffix, keylen;
+	cmph_uint8 * prev_key = NULL;
+	cmph_uint32 prev_keylen = 0;
+	while (pos < inlen)
+	{
+		if (!run_codec_get_varint(in, inlen, &pos, &delta)) return 0;
+		if (!run_codec_get_varint(in, inlen, &pos, &shared)) return 0;
+		if (!run_codec_get_varint(in, inlen, &pos, &suffix)) return 0;
+		if (shared > prev_keylen || suffix > inlen - pos) return 0;
+		keylen = shared + suffix;
+		if ((cmph_uint64)nbytes + keylen + 2*sizeof(cmph_uint32) > outlen) return 0;
+		h0 += delta;
+		memcpy(out + nbytes, &h0, sizeof(h0));
+		memcpy(out + nbytes + sizeof(h0), &keylen, sizeof(keylen));
+		nbytes += 2U*(cmph_uint32)sizeof(cmph_uint32);
+		if (shared) memmove(out + nbytes, prev_key, (size_t)shared);
+		memcpy(out + nbytes + shared, in + pos, (size_t)suffix);
+		prev_key = out + nbytes;
+		prev_keylen = keylen;
+		nbytes += keylen;
+		pos += suffix;
+	}
+	return nbytes;
+}
+
+cmph_uint32 run_codec_decode(cmph_uint8 * in, cmph_uint32 inlen, cmph_uint8 * out, cmph_uint32 outlen)
+{
+	// the varints of a record take at most 7 bytes more than its h0 and length
+	cmph_uint32 enclen_max = 2*outlen;
+	cmph_uint8 * encoded = (cmph_uint8 *)malloc((size_t)enclen_max);
+	cmph_uint32 enclen, nbytes = 0;
+	if (!encoded) return 0;
+	enclen = run_codec_lz_decompress(in, inlen, encoded, enclen_max);
+	if (enclen) nbytes = run_codec_decode_records(encoded, enclen, out, outlen);
+	free(encoded);
+	return nbytes;
+}
@@ -0,0 +1,45 @@
+#ifndef __CMPH_RUN_CODEC_H__
+#define __CMPH_RUN_CODEC_H__
+
+#include "cmph_types.h"
+#include <stdio.h>
+
+/* Records of the temporary runs of BRZ are h0 followed by the key length and
+ * the key. A run is either a plain sequence of records or, when compressed, a
+ * sequence of blocks, each one made of its decoded size, its encoded size and
+ * the encoded records. Inside a block every record is encoded as the varints
+ * of the h0 delta, of the length of the prefix shared with the previous key
+ * and of the suffix length, followed by the suffix, and the whole block then
+ * goes through an LZ77 pass in the sequence format of LZ4. The runs keep the
+ * keys of a bucket sorted, so neighbouring keys share long prefixes. Blocks
+ * decode independently to plain records, so the reader only has to frame them.
+ */
+#define RUN_CODEC_BLOCK_SIZE 16384   // maximum decoded size of a block, unless a single record is larger
+
+typedef struct __run_writer_t run_writer_t;
+
+/** \fn run_writer_t * run_writer_new(FILE * fd, cmph_uint8 compressed);
+ *  \brief Creates a writer of records to fd.
+ *  \param compressed whether the records are written in compressed blocks
+ */
+run_writer_t * run_writer_new(FILE * fd, cmph_uint8 compressed);
+
+/** \fn void run_writer_write(run_writer_t * run_writer, cmph_uint32 h0, cmph_uint8 * record);
+ *  \brief Appends a record to the run.
+ *  \param record key length followed by the key
+ */
+void run_writer_write(run_writer_t * run_writer, cmph_uint32 h0, cmph_uint8 * record);
+
+/** \fn int run_writer_destroy(run_writer_t * run_writer);
+ *  \brief Writes the pending block and destroys the writer. The file is not closed.
+ *  \return 0 if some write failed
+ */
+int run_writer_destroy(run_writer_t * run_writer);
+
+/** \fn cmph_uint32 run_codec_decode(cmph_uint8 * in, cmph_uint32 inlen, cmph_uint8 * out, cmph_uint32 outlen);
+ *  \brief Decodes a block into plain records.
+ *  \return the number of bytes written to out, which must be outlen for a valid block
+ */
+cmph_uint32 run_codec_decode(cmph_uint8 * in, cmph_uint32 inlen, cmph_uint8 * out, cmph_uint32 outlen);
+
+#endif
@@ -0,0 +1,336 @@
+#include "../src/cmph_blob.h"
+#include "../src/checksum.h"
+
+#define DEBUG
+#include "../src/debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NKEYS 1000
+
+// Builds a function of NKEYS keys with algo, writes it as a blob and searches the blob.
+static int check_blob(const char *filename, CMPH_ALGO algo, CMPH_CHECKSUM checksum)
+{
+	char **keys = (char **)malloc(sizeof(char *)*NKEYS);
+	cmph_uint8 *seen = (cmph_uint8 *)calloc(NKEYS, sizeof(cmph_uint8));
+	cmph_io_adapter_t *source;
+	cmph_config_t *config;
+	cmph_blob_t *blob;
+	cmph_t *mphf;
+	void *packed;
+	FILE *fd;
+	cmph_uint32 i;
+	int ret = 1;
+
+	for (i = 0; i < NKEYS; ++i)
+	{
+		keys[i] = (char *)malloc(32);
+		sprintf(keys[i], "key%u", i);
+	}
+	source = cmph_io_vector_adapter(keys, NKEYS);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, algo);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	fd = fopen(filename, "wb");
+	if (!cmph_blob_dump(mphf, fd, checksum)) return 0;
+	fclose(fd);
+
+	blob = cmph_blob_open(filename, CMPH_BLOB_VERIFY);
+	if (blob == NULL || cmph_blob_algo(blob) != algo || cmph_blob_size(blob) != NKEYS) return 0;
+	packed = cmph_blob_packed(blob);
+	if (packed == NULL || ((size_t)packed) % CMPH_BLOB_ALIGNMENT) return 0;
+	for (i = 0; i < NKEYS; ++i)
+	{
+		cmph_uint32 h = cmph_search_packed(packed, keys[i], (cmph_uint32)strlen(keys[i]));
+		if (h != cmph_search(mphf, keys[i], (cmph_uint32)strlen(keys[i])) || h >= NKEYS || seen[h]++)
+		{
+			fprintf(stderr, "key %s is not found in the blob\n", keys[i]);
+			ret = 0;
+		}
+	}
+	cmph_blob_close(blob);
+
+	// the copies on huge pages and on the node of the thread are searched as the file
+	blob = cmph_blob_open(filename, CMPH_BLOB_HUGEPAGES | CMPH_BLOB_NUMA);
+	packed = blob ? cmph_blob_packed(blob) : NULL;
+	if (packed == NULL || ((size_t)packed) % CMPH_BLOB_ALIGNMENT) return 0;
+	for (i = 0; i < NKEYS; ++i)
+	{
+		if (cmph_search_packed(packed, keys[i], (cmph_uint32)strlen(keys[i])) != cmph_search(mphf, keys[i], (cmph_uint32)strlen(keys[i]))) ret = 0;
+	}
+	cmph_blob_close(blob);
+
+	// a flipped bit of the function is found when the function is used
+	fd = fopen(filename, "r+b");
+	fseek(fd, -1, SEEK_END);
+	i = (cmph_uint32)fgetc(fd);
+	fseek(fd, -1, SEEK_END);
+	fputc((int)(i ^ 1), fd);
+	fclose(fd);
+	blob = cmph_blob_open(filename, 0);
+	if (blob == NULL || cmph_blob_packed(blob) != NULL || cmph_blob_verify(blob, 2)) ret = 0;
+	if (blob) cmph_blob_close(blob);
+	if (cmph_blob_open(filename, CMPH_BLOB_VERIFY) != NULL) ret = 0;
+
+	cmph_destroy(mphf);
+	cmph_io_vector_adapter_destroy(source);
+	for (i = 0; i < NKEYS; ++i) free(keys[i]);
+	free(keys);
+	free(seen);
+	remove(filename);
+	return ret;
+}
+
+// A CHM function of NCHUNKED_KEYS keys is several MB, so it is checksummed by chunks
+#define NCHUNKED_KEYS 500000
+static int check_chunks(const char *filename)
+{
+	char **keys = (char **)malloc(sizeof(char *)*NCHUNKED_KEYS);
+	cmph_io_adapter_t *source;
+	cmph_config_t *config;
+	cmph_blob_t *blob;
+	cmph_t *mphf;
+	void *packed;
+	FILE *fd;
+	long length;
+	cmph_uint32 i;
+	int ret = 1;
+
+	for (i = 0; i < NCHUNKED_KEYS; ++i)
+	{
+		keys[i] = (char *)malloc(32);
+		sprintf(keys[i], "chunked%u", i);
+	}
+	source = cmph_io_vector_adapter(keys, NCHUNKED_KEYS);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, CMPH_CHM);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	fd = fopen(filename, "wb");
+	if (mphf == NULL || !cmph_blob_dump(mphf, fd, CMPH_CHECKSUM_CRC32C)) return 0;
+	length = ftell(fd);
+	fclose(fd);
+	if (length < (2L << 20)) return 0;
+
+	blob = cmph_blob_open(filename, 0);
+	if (blob == NULL || !cmph_blob_verify(blob, 4)) return 0;
+	packed = cmph_blob_packed(blob);
+	for (i = 0; packed && i < NCHUNKED_KEYS; i += 97)
+	{
+		if (cmph_search_packed(packed, keys[i], (cmph_uint32)strlen(keys[i])) != cmph_search(mphf, keys[i], (cmph_uint32)strlen(keys[i]))) ret = 0;
+	}
+	if (packed == NULL) ret = 0;
+	cmph_blob_close(blob);
+
+	// a flipped bit in a chunk of the middle of the function
+	fd = fopen(filename, "r+b");
+	fseek(fd, length / 2, SEEK_SET);
+	i = (cmph_uint32)fgetc(fd);
+	fseek(fd, length / 2, SEEK_SET);
+	fputc((int)(i ^ 1), fd);
+	fclose(fd);
+	blob = cmph_blob_open(filename, 0);
+	if (blob == NULL || cmph_blob_verify(blob, 4) || cmph_blob_packed(blob) != NULL) ret = 0;
+	if (blob) cmph_blob_close(blob);
+	blob = cmph_blob_open(filename, 0);
+	if (blob == NULL || cmph_blob_packed(blob) != NULL) ret = 0;
+	if (blob) cmph_blob_close(blob);
+
+	cmph_destroy(mphf);
+	cmph_io_vector_adapter_destroy(source);
+	for (i = 0; i < NCHUNKED_KEYS; ++i) free(keys[i]);
+	free(keys);
+	remove(filename);
+	return ret;
+}
+
+// Function of NKEYS keys prefixed by prefix.
+static cmph_t *tenant_function(const char *prefix, char **keys)
+{
+	cmph_io_adapter_t *source;
+	cmph_config_t *config;
+	cmph_t *mphf;
+	cmph_uint32 i;
+	for (i = 0; i < NKEYS; ++i) sprintf(keys[i], "%s/%u", prefix, i);
+	source = cmph_io_vector_adapter(keys, NKEYS);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, CMPH_BDZ);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	cmph_io_vector_adapter_destroy(source);
+	return mphf;
+}
+
+// Adds NTENANTS functions to a container, more than its first table holds, and replaces some of them.
+#define NTENANTS 30
+static int check_container(const char *filename)
+{
+	char **keys = (char **)malloc(sizeof(char *)*NKEYS);
+	char name[32];
+	cmph_t *mphfs[NTENANTS];
+	cmph_blob_t *blob;
+	cmph_uint32 i, j, size;
+	long length, appended = 0;
+	FILE *fd;
+	cmph_uint8 *buffer, *data, *packed;
+	int corrupted;
+	int ret = 1;
+
+	remove(filename);
+	for (i = 0; i < NKEYS; ++i) keys[i] = (char *)malloc(64);
+	for (i = 0; i < NTENANTS + 5; ++i)
+	{
+		// the first five tenants are added twice
+		cmph_uint32 tenant = i < NTENANTS ? i : i - NTENANTS;
+		sprintf(name, "tenant%u", tenant);
+		if (i >= NTENANTS) cmph_destroy(mphfs[tenant]);
+		mphfs[tenant] = tenant_function(name, keys);
+		if (!cmph_blob_append(filename, name, (cmph_uint32)strlen(name), mphfs[tenant], CMPH_CHECKSUM_CRC32C)) return 0;
+	}
+	for (j = 0; j < 2; ++j)
+	{
+		blob = cmph_blob_open(filename, CMPH_BLOB_VERIFY);
+		if (blob == NULL || cmph_blob_nfunctions(blob) != NTENANTS || cmph_blob_packed(blob) != NULL) return 0;
+		if (cmph_blob_find(blob, "tenant", 6, NULL, &corrupted) != NULL || corrupted) ret = 0;
+		for (i = 0; i < NTENANTS; ++i)
+		{
+			void *packed;
+			cmph_uint32 k;
+			sprintf(name, "tenant%u", i);
+			packed = cmph_blob_find(blob, name, (cmph_uint32)strlen(name), &size, NULL);
+			if (packed == NULL || size != NKEYS || ((size_t)packed) % CMPH_BLOB_ALIGNMENT) return 0;
+			for (k = 0; k < NKEYS; k += 7)
+			{
+				sprintf(keys[k], "%s/%u", name, k);
+				if (cmph_search_packed(packed, keys[k], (cmph_uint32)strlen(keys[k])) != cmph_search(mphfs[i], keys[k], (cmph_uint32)strlen(keys[k]))) ret = 0;
+			}
+		}
+		cmph_blob_close(blob);
+		fd = fopen(filename, "rb");
+		fseek(fd, 0, SEEK_END);
+		length = ftell(fd);
+		fclose(fd);
+		DEBUGP("Container of %ld bytes\n", length);
+		// the replaced functions are dropped
+		if (j == 0)
+		{
+			appended = length;
+			if (!cmph_blob_compact(filename)) return 0;
+		}
+		else if (length >= appended) ret = 0;
+	}
+
+	// a corrupted function is told apart from a missing one
+	buffer = (cmph_uint8 *)malloc((size_t)length + CMPH_BLOB_ALIGNMENT);
+	data = buffer + CMPH_BLOB_ALIGNMENT - ((size_t)buffer) % CMPH_BLOB_ALIGNMENT;
+	fd = fopen(filename, "rb");
+	if (fread(data, (size_t)length, (size_t)1, fd) != 1) return 0;
+	fclose(fd);
+	blob = cmph_blob_map(data, (size_t)length, 0);
+	packed = blob ? (cmph_uint8 *)cmph_blob_find(blob, "tenant3", 7, NULL, NULL) : NULL;
+	if (packed == NULL) return 0;
+	cmph_blob_close(blob);
+	packed[8] ^= 1;
+	blob = cmph_blob_map(data, (size_t)length, 0);
+	if (blob == NULL) return 0;
+	if (cmph_blob_find(blob, "tenant3", 7, NULL, &corrupted) != NULL || !corrupted) ret = 0;
+	if (cmph_blob_find(blob, "tenant4", 7, NULL, &corrupted) == NULL || corrupted) ret = 0;
+	if (cmph_blob_find(blob, "tenant", 6, NULL, &corrupted) != NULL || corrupted) ret = 0;
+	cmph_blob_close(blob);
+	free(buffer);
+
+	for (i = 0; i < NTENANTS; ++i) cmph_destroy(mphfs[i]);
+	for (i = 0; i < NKEYS; ++i) free(keys[i]);
+	free(keys);
+	remove(filename);
+	return ret;
+}
+
+// Overwrites a table of a container of two tables with garbage, as a crash or
+// an append in the middle of writing it would leave it. The tables follow the
+// first header, whose capacity gives their size.
+static int garble_table(const char *filename, cmph_uint32 slot)
+{
+	FILE *fd = fopen(filename, "r+b");
+	cmph_uint8 header[64];
+	cmph_uint32 capacity;
+	cmph_uint64 table_size;
+	char *garbage;
+	int ok;
+	if (fd == NULL) return 0;
+	ok = fread(header, sizeof(header), 1, fd) == 1;
+	memcpy(&capacity, header + 48, sizeof(capacity));
+	table_size = (64 + (cmph_uint64)capacity * 32 + CMPH_BLOB_ALIGNMENT - 1) & ~(cmph_uint64)(CMPH_BLOB_ALIGNMENT - 1);
+	garbage = (char *)malloc((size_t)table_size);
+	memset(garbage, 0x5a, (size_t)table_size);
+	ok = ok && fseek(fd, (long)(64 + slot * table_size), SEEK_SET) == 0 && fwrite(garbage, (size_t)table_size, 1, fd) == 1;
+	free(garbage);
+	return fclose(fd) == 0 && ok;
+}
+
+// Appends a function in place to a container of another, and checks that a
+// garbled table leaves the container as it was before or after the append.
+static int check_tables(const char *filename)
+{
+	char **keys = (char **)malloc(sizeof(char *)*NKEYS);
+	cmph_t *first, *second;
+	cmph_blob_t *blob;
+	cmph_uint32 i, j;
+	int corrupted;
+	int ret = 1;
+
+	for (i = 0; i < NKEYS; ++i) keys[i] = (char *)malloc(64);
+	first = tenant_function("first", keys);
+	second = tenant_function("second", keys);
+	for (j = 0; j < 2; ++j)
+	{
+		remove(filename);
+		if (!cmph_blob_append(filename, "first", 5, first, CMPH_CHECKSUM_CRC32C)) return 0;
+		if (!cmph_blob_append(filename, "second", 6, second, CMPH_CHECKSUM_CRC32C)) return 0;
+		// the second append wrote the table of generation 1, after the one of generation 0
+		if (!garble_table(filename, j == 0 ? 0 : 1)) return 0;
+		blob = cmph_blob_open(filename, CMPH_BLOB_VERIFY);
+		if (blob == NULL) return 0;
+		if (cmph_blob_find(blob, "first", 5, NULL, &corrupted) == NULL || corrupted) ret = 0;
+		if ((cmph_blob_find(blob, "second", 6, NULL, &corrupted) != NULL) != (j == 0) || corrupted) ret = 0;
+		if (!ret) fprintf(stderr, "Wrong functions with the table of generation %u garbled\n", j);
+		cmph_blob_close(blob);
+	}
+	// the next append goes to the garbled table
+	if (!cmph_blob_append(filename, "second", 6, second, CMPH_CHECKSUM_CRC32C)) return 0;
+	blob = cmph_blob_open(filename, CMPH_BLOB_VERIFY);
+	if (blob == NULL || cmph_blob_nfunctions(blob) != 2) return 0;
+	cmph_blob_close(blob);
+
+	cmph_destroy(first);
+	cmph_destroy(second);
+	for (i = 0; i < NKEYS; ++i) free(keys[i]);
+	free(keys);
+	remove(filename);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	const char *filename = "blob_tests.tmp";
+	cmph_uint8 buf[100];
+	cmph_uint32 i;
+
+	// check values of the reference implementations
+	if (crc32c(0, "123456789", 9) != 0xe3069283U) return 1;
+	if (crc32c(crc32c(0, "1234", 4), "56789", 5) != 0xe3069283U) return 1;
+	if (xxh64("", 0, 0) != 0xef46db3751d8e999ULL) return 1;
+	if (xxh64("abc", 3, 0) != 0x44bc2cf5ad770999ULL) return 1;
+	for (i = 0; i < sizeof(buf); ++i) buf[i] = (cmph_uint8)i;
+	if (crc32c(0, buf, sizeof(buf)) != crc32c(crc32c(0, buf, 37), buf + 37, sizeof(buf) - 37)) return 1;
+
+	if (!check_blob(filename, CMPH_BDZ, CMPH_CHECKSUM_CRC32C)) return 1;
+	if (!check_blob(filename, CMPH_CHD, CMPH_CHECKSUM_XXH64)) return 1;
+	if (!check_blob(filename, CMPH_BMZ, CMPH_CHECKSUM_XXH64)) return 1;
+	if (!check_chunks(filename)) return 1;
+	if (!check_container(filename)) return 1;
+	if (!check_tables(filename)) return 1;
+	fprintf(stderr, "Blobs are searched in place and corruption is detected\n");
+	return 0;
+}
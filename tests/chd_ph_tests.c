@@ -0,0 +1,77 @@
+#include "../src/cmph.h"
+#include "../src/chd_ph.h"
+#include "../src/chd.h"
+
+#define DEBUG
+#include "../src/debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NKEYS 20000
+
+// Builds CHD_PH or CHD with and without prime table sizes, and checks that
+// the function is perfect (minimal for CHD) and that its packed form agrees.
+static int check_function(char **keys, CMPH_ALGO algo, double c, cmph_uint32 use_primes)
+{
+	cmph_io_adapter_t *source = cmph_io_vector_adapter(keys, NKEYS);
+	cmph_config_t *config = cmph_config_new(source);
+	cmph_t *mphf;
+	cmph_uint32 i, size;
+	char *seen, *packed;
+	int ok = 1;
+	cmph_config_set_algo(config, algo);
+	cmph_config_set_graphsize(config, c);
+	if (algo == CMPH_CHD) chd_config_set_use_primes(config, use_primes);
+	else chd_ph_config_set_use_primes(config, use_primes);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	cmph_io_vector_adapter_destroy(source);
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "%s with c=%.2f and use_primes=%u failed\n", cmph_names[algo], c, use_primes);
+		return 0;
+	}
+	size = cmph_size(mphf);
+	if (algo == CMPH_CHD && size != NKEYS) ok = 0;
+	seen = (char *)calloc(size, 1);
+	packed = (char *)malloc(cmph_packed_size(mphf));
+	cmph_pack(mphf, packed);
+	for (i = 0; ok && i < NKEYS; ++i)
+	{
+		cmph_uint32 keylen = (cmph_uint32)strlen(keys[i]);
+		cmph_uint32 h = cmph_search(mphf, keys[i], keylen);
+		if (h >= size || seen[h]++ || cmph_search_packed(packed, keys[i], keylen) != h) ok = 0;
+	}
+	if (!ok) fprintf(stderr, "%s with c=%.2f and use_primes=%u is not perfect\n", cmph_names[algo], c, use_primes);
+	free(packed);
+	free(seen);
+	cmph_destroy(mphf);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	double load_factors[] = { 0.5, 0.81, 0.99 };
+	char **keys = (char **)malloc(NKEYS * sizeof(char *));
+	cmph_uint32 i, j, use_primes;
+	int ok = 1;
+	for (i = 0; i < NKEYS; ++i)
+	{
+		char key[64];
+		sprintf(key, "http://www.example%u.com/path/%u", i % 7, i);
+		keys[i] = strdup(key);
+	}
+	for (i = 0; i < sizeof(load_factors)/sizeof(load_factors[0]); ++i)
+	{
+		for (use_primes = 0; use_primes < 2; ++use_primes)
+		{
+			ok &= check_function(keys, CMPH_CHD_PH, load_factors[i], use_primes);
+			ok &= check_function(keys, CMPH_CHD, load_factors[i], use_primes);
+		}
+	}
+	for (j = 0; j < NKEYS; ++j) free(keys[j]);
+	free(keys);
+	if (!ok) return 1;
+	fprintf(stderr, "CHD_PH and CHD functions are perfect with and without prime sizes\n");
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include "../src/cmph.h"
+
+#define DEBUG
+#include "../src/debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NKEYS 200000
+#define NLOOKUPS 1000000
+
+// Builds a CHM function and checks that it is minimal perfect, and that keys
+// out of the set, which get arbitrary ids, still get ids below m, whether the
+// function is packed or not.
+int main(int argc, char **argv)
+{
+	char **keys = (char **)malloc(NKEYS * sizeof(char *));
+	cmph_io_adapter_t *source;
+	cmph_config_t *config;
+	cmph_t *mphf;
+	cmph_uint32 i, m, nout = 0;
+	char *seen, *packed;
+	int ok = 1;
+	for (i = 0; i < NKEYS; ++i)
+	{
+		char key[64];
+		sprintf(key, "http://www.example%u.com/path/%u", i % 7, i);
+		keys[i] = strdup(key);
+	}
+	source = cmph_io_vector_adapter(keys, NKEYS);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, CMPH_CHM);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	cmph_io_vector_adapter_destroy(source);
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "Unable to build a chm function\n");
+		return 1;
+	}
+	m = cmph_size(mphf);
+	seen = (char *)calloc(m, 1);
+	packed = (char *)malloc(cmph_packed_size(mphf));
+	cmph_pack(mphf, packed);
+	for (i = 0; ok && i < NKEYS; ++i)
+	{
+		cmph_uint32 keylen = (cmph_uint32)strlen(keys[i]);
+		cmph_uint32 h = cmph_search(mphf, keys[i], keylen);
+		if (h >= m || seen[h]++ || cmph_search_packed(packed, keys[i], keylen) != h) ok = 0;
+	}
+	if (!ok) fprintf(stderr, "The chm function is not minimal perfect\n");
+	for (i = 0; ok && i < NLOOKUPS; ++i)
+	{
+		char key[64];
+		cmph_uint32 keylen = (cmph_uint32)sprintf(key, "http://www.absent%u.org/%u", i % 13, i);
+		cmph_uint32 h = cmph_search(mphf, key, keylen);
+		if (h >= m || cmph_search_packed(packed, key, keylen) != h) ++nout;
+	}
+	if (nout)
+	{
+		fprintf(stderr, "%u of %u keys out of the set got ids out of [0, %u)\n", nout, NLOOKUPS, m);
+		ok = 0;
+	}
+	free(packed);
+	free(seen);
+	cmph_destroy(mphf);
+	for (i = 0; i < NKEYS; ++i) free(keys[i]);
+	free(keys);
+	if (!ok) return 1;
+	fprintf(stderr, "Chm ids are below m for keys in and out of the set\n");
+	return 0;
+}
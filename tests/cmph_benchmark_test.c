@@ -1,5 +1,7 @@
 #include <unistd.h>  // for sleep
 #include <limits.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "cmph_benchmark.h"
 
@@ -15,9 +17,39 @@ void bm_increment(int iters) {
 }
 
 int main(int argc, char** argv) {
+  const char* baseline_file = "cmph_benchmark_test.baseline";
+  const char* json_file = "cmph_benchmark_test.json";
+  char* options[] = { argv[0], "--warmup=0", "--repeats=2", "--threshold=10",
+                      "--baseline=cmph_benchmark_test.baseline",
+                      "--json=cmph_benchmark_test.json", NULL };
+  char* invalid[] = { argv[0], "repeats=2", NULL };
+  char* missing[] = { argv[0], "--warmup=0", "--repeats=2",
+                      "--baseline=cmph_benchmark_test.missing", NULL };
+  char line[1024];
+  int nlines = 0;
+  FILE* f;
+
   BM_REGISTER(bm_sleep, 1);
   BM_REGISTER(bm_increment, 1);
-  run_benchmarks(argc, argv);
-  return 0;
-}
 
+  // a sleep of a second regresses against a baseline of a microsecond
+  f = fopen(baseline_file, "w");
+  fprintf(f, "{\"name\":\"bm_sleep\",\"median_ns_per_op\":1000.0,\"ci_high_ns_per_op\":1000.0}\n");
+  fclose(f);
+  if (run_benchmarks(6, options) != 1) return 1;
+  if (run_benchmarks(2, invalid) != -1) return 1;
+  // a baseline that can not be read fails instead of passing every benchmark
+  remove("cmph_benchmark_test.missing");
+  if (run_benchmarks(4, missing) != -1) return 1;
+
+  f = fopen(json_file, "r");
+  if (f == NULL) return 1;
+  while (fgets(line, sizeof(line), f)) {
+    if (strstr(line, "\"median_ns_per_op\":") == NULL) return 1;
+    if (strstr(line, "\"name\":\"bm_sleep\"") || strstr(line, "\"name\":\"bm_increment\"")) ++nlines;
+  }
+  fclose(f);
+  remove(baseline_file);
+  remove(json_file);
+  return nlines == 2 ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#include "../src/fastmod.h"
+
+#define DEBUG
+#include "../src/debug.h"
+#include <stdlib.h>
+
+static int check_divisor(cmph_uint32 d, cmph_uint64 *values, cmph_uint32 nvalues)
+{
+	cmph_uint64 magic = fastmod_magic(d);
+	cmph_uint32 i;
+	for(i = 0; i < nvalues; i++)
+	{
+		cmph_uint64 a = values[i];
+		if(fastmod_mod(a, magic, d) != (cmph_uint32)(a % d))
+		{
+			fprintf(stderr, "%lu mod %u: got %u expected %u\n", (unsigned long)a, d, fastmod_mod(a, magic, d), (cmph_uint32)(a % d));
+			return 0;
+		}
+		// the quotient is only defined when it fits in 32 bits
+		if(a / d <= 0xffffffffU && fastmod_div(a, magic, d) != (cmph_uint32)(a / d))
+		{
+			fprintf(stderr, "%lu div %u: got %u expected %u\n", (unsigned long)a, d, fastmod_div(a, magic, d), (cmph_uint32)(a / d));
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	cmph_uint32 divisors[] = { 1, 2, 3, 7, 10, 255, 256, 1000003, 2147483647U, 2147483648U, 4294967291U, 4294967295U };
+	cmph_uint32 ndivisors = sizeof(divisors)/sizeof(divisors[0]);
+	cmph_uint64 values[1024];
+	cmph_uint32 nvalues = 0;
+	cmph_uint32 i;
+
+	values[nvalues++] = 0;
+	values[nvalues++] = 1;
+	values[nvalues++] = 0xffffffffU;
+	values[nvalues++] = 0x100000000ULL;
+	values[nvalues++] = (cmph_uint64)-1;
+	values[nvalues++] = (cmph_uint64)-2;
+	values[nvalues++] = (cmph_uint64)4294967294U * 4294967294U + 2 * 4294967294U;
+	srand(13);
+	while(nvalues + 2 <= 1024)
+	{
+		cmph_uint64 v = ((cmph_uint64)rand() << 33) ^ ((cmph_uint64)rand() << 11) ^ (cmph_uint64)rand();
+		values[nvalues++] = v;
+		values[nvalues++] = v & 0xffffffffU;
+	}
+
+	for(i = 0; i < ndivisors; i++)
+	{
+		if(!check_divisor(divisors[i], values, nvalues)) return 1;
+	}
+	for(i = 0; i < 10000; i++)
+	{
+		cmph_uint32 d = (cmph_uint32)rand() + 1;
+		if(!check_divisor(d, values, 64)) return 1;
+	}
+	fprintf(stderr, "fastmod reductions match the hardware division\n");
+	return 0;
+}
@@ -61,6 +61,20 @@ int main(int argc, char **argv)
 	DEBUGP("Neighbor is %u\n", neighbor);
 	if (neighbor != GRAPH_NO_NEIGHBOR) return 1;
 
+	fprintf(stderr, "Checking compressed adjacency\n");
+	{
+		const cmph_uint32 *neighbors, *edge_ids;
+		graph_finalize(g);
+		if (graph_adjacency(g, 2, &neighbors, &edge_ids) != 2) return 1;
+		// newest edge first, as in the adjacency lists
+		if (neighbors[0] != 3 || edge_ids[0] != 2) return 1;
+		if (neighbors[1] != 1 || edge_ids[1] != 1) return 1;
+		if (graph_edge_id(g, 4, 3) != 3 || !graph_contains_edge(g, 0, 1) || graph_contains_edge(g, 0, 2)) return 1;
+		if (graph_adjacency(g, 0, &neighbors, NULL) != 1 || neighbors[0] != 1) return 1;
+		graph_clear_edges(g);
+		graph_add_edge(g, 0, 4);
+		if (graph_is_cyclic(g) || graph_adjacency(g, 0, &neighbors, NULL) != 1) return 1;
+	}
 
 	graph_destroy(g);
 	return 0;
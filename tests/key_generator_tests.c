@@ -0,0 +1,155 @@
+#include "../src/key_generator.h"
+
+#define DEBUG
+#include "../src/debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NKEYS 20000
+
+typedef struct
+{
+	char *key;
+	cmph_uint32 keylen;
+} generated_key_t;
+
+static int key_cmp(const void *a, const void *b)
+{
+	const generated_key_t *ka = (const generated_key_t *)a;
+	const generated_key_t *kb = (const generated_key_t *)b;
+	cmph_uint32 len = ka->keylen < kb->keylen ? ka->keylen : kb->keylen;
+	int cmp = memcmp(ka->key, kb->key, len);
+	if (cmp) return cmp;
+	return (int)ka->keylen - (int)kb->keylen;
+}
+
+// Checks that the keys are the same for the same seed, whether streamed or
+// computed one by one, that another seed changes them, and that they are
+// distinct and without the bytes that would break the lines of a keys file.
+static int check_keys(KEY_TYPE type)
+{
+	key_generator_t *gen = key_generator_new(type, NKEYS, 7);
+	key_generator_t *same = key_generator_new(type, NKEYS, 7);
+	key_generator_t *other = key_generator_new(type, NKEYS, 8);
+	generated_key_t *keys = (generated_key_t *)calloc(NKEYS, sizeof(generated_key_t));
+	cmph_uint32 i, keylen, nchanged = 0;
+	const char *key;
+	int ok = 1;
+	for (i = 0; (key = key_generator_next(gen, &keylen)) != NULL; ++i)
+	{
+		cmph_uint32 len;
+		const char *expected = key_generator_key(same, i, &len);
+		if (len != keylen || memcmp(key, expected, len) != 0 ||
+		    memchr(key, '\n', keylen) || memchr(key, '\r', keylen) || memchr(key, '\0', keylen))
+		{
+			fprintf(stderr, "%s key %u is not deterministic or can not be a line\n", key_type_names[type], i);
+			ok = 0;
+			break;
+		}
+		keys[i].key = (char *)malloc(keylen);
+		memcpy(keys[i].key, key, keylen);
+		keys[i].keylen = keylen;
+		expected = key_generator_key(other, i, &len);
+		if (len != keylen || memcmp(key, expected, len) != 0) ++nchanged;
+	}
+	if (ok && (i != NKEYS || nchanged < NKEYS / 2))
+	{
+		fprintf(stderr, "%s: %u keys, %u changed by the seed\n", key_type_names[type], i, nchanged);
+		ok = 0;
+	}
+	if (ok && type != KEY_ZIPF)
+	{
+		qsort(keys, NKEYS, sizeof(generated_key_t), key_cmp);
+		for (i = 1; i < NKEYS; ++i)
+		{
+			if (key_cmp(keys + i - 1, keys + i) == 0)
+			{
+				fprintf(stderr, "%s keys repeat: %.*s\n", key_type_names[type], keys[i].keylen, keys[i].key);
+				ok = 0;
+				break;
+			}
+		}
+	}
+	for (i = 0; i < NKEYS && keys[i].key; ++i) free(keys[i].key);
+	free(keys);
+	key_generator_destroy(gen);
+	key_generator_destroy(same);
+	key_generator_destroy(other);
+	return ok;
+}
+
+// Dense keys are a permutation of [0, NKEYS), and the most frequent of the
+// zipf queries is asked about 1 / H(NKEYS) of the time.
+static int check_values(void)
+{
+	key_generator_t *gen = key_generator_new(KEY_DENSE, NKEYS, 3);
+	cmph_uint32 *count = (cmph_uint32 *)calloc(NKEYS, sizeof(cmph_uint32));
+	cmph_uint32 i, max = 0;
+	int ok = 1;
+	for (i = 0; i < NKEYS; ++i)
+	{
+		cmph_uint64 value = key_generator_value(gen, i);
+		if (value >= NKEYS || count[value]++) ok = 0;
+	}
+	key_generator_destroy(gen);
+	if (!ok) fprintf(stderr, "Dense keys are not a permutation\n");
+	memset(count, 0, NKEYS * sizeof(cmph_uint32));
+	gen = key_generator_new(KEY_ZIPF, 10 * NKEYS, 3);
+	if (!key_generator_set_zipf(gen, KEY_UUID, NKEYS, 1.0)) ok = 0;
+	for (i = 0; i < 10 * NKEYS; ++i)
+	{
+		cmph_uint64 value = key_generator_value(gen, i);
+		if (value >= NKEYS) ok = 0;
+		else if (++count[value] > max) max = count[value];
+	}
+	key_generator_destroy(gen);
+	free(count);
+	// 1 / H(20000) is 9.5%
+	if (max < NKEYS * 10 / 12 || max > NKEYS * 10 / 9)
+	{
+		fprintf(stderr, "The most frequent zipf query is asked %u times out of %u\n", max, 10 * NKEYS);
+		ok = 0;
+	}
+	return ok;
+}
+
+// Builds a function straight from the generator.
+static int check_adapter(void)
+{
+	key_generator_t *gen = key_generator_new(KEY_URL, NKEYS, 5);
+	cmph_io_adapter_t *source = key_generator_io_adapter(gen);
+	cmph_config_t *config = cmph_config_new(source);
+	char *seen = (char *)calloc(NKEYS, 1);
+	cmph_uint32 i, keylen;
+	cmph_t *mphf;
+	int ok = 1;
+	cmph_config_set_algo(config, CMPH_BDZ);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	if (mphf == NULL) ok = 0;
+	for (i = 0; ok && i < NKEYS; ++i)
+	{
+		const char *key = key_generator_key(gen, i, &keylen);
+		cmph_uint32 h = cmph_search(mphf, key, keylen);
+		if (h >= NKEYS || seen[h]++) ok = 0;
+	}
+	if (!ok) fprintf(stderr, "The function of the generated keys is not minimal perfect\n");
+	if (mphf) cmph_destroy(mphf);
+	free(seen);
+	key_generator_io_adapter_destroy(source);
+	key_generator_destroy(gen);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	cmph_uint32 type;
+	for (type = 0; type < KEY_COUNT; ++type)
+	{
+		if (!check_keys((KEY_TYPE)type)) return 1;
+	}
+	if (!check_values()) return 1;
+	if (!check_adapter()) return 1;
+	fprintf(stderr, "Generated keys are deterministic and distinct\n");
+	return 0;
+}
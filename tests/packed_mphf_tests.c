@@ -11,6 +11,7 @@
 #include <limits.h>
 #include <assert.h>
 #include <cmph.h>
+#include <cmph_searcher.h>
 //#include "hash.h"
 
 #ifdef WIN32
@@ -151,6 +152,13 @@ int main(int argc, char **argv)
 
 	/* Pack the mphf. */
 	cmph_pack(mphf, packed_mphf);
+	cmph_searcher_t *searcher = cmph_searcher_new_packed(packed_mphf);
+	cmph_searcher_t *mphf_searcher = cmph_searcher_new(mphf);
+	// keys and values kept for the batched searches
+	char **keys = (char **)malloc(sizeof(char *)*source->nkeys);
+	cmph_uint32 *keylens = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*source->nkeys);
+	cmph_uint32 *values = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*source->nkeys);
+	cmph_uint32 *batch_values = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*source->nkeys);
 
 	// testing the packed function
 	//check all keys
@@ -167,6 +175,15 @@ int main(int argc, char **argv)
 		cmph_uint32 buflen = 0;
 		source->read(source->data, &buf, &buflen);
 		h = cmph_search_packed(packed_mphf, buf, buflen);
+		if (cmph_searcher_search(searcher, buf, buflen) != h || cmph_searcher_search(mphf_searcher, buf, buflen) != h)
+		{
+			fprintf(stderr, "Searcher disagrees on key %.*s\n", buflen, buf);
+			ret = 1;
+		}
+		keys[i] = (char *)malloc(buflen);
+		memcpy(keys[i], buf, buflen);
+		keylens[i] = buflen;
+		values[i] = h;
 
 		if (!(h < siz))
 		{
@@ -191,6 +208,25 @@ int main(int argc, char **argv)
 	fprintf(stdout, "%u\t%.2f\n", source->nkeys, evaluation_time);
 	#endif
 
+	cmph_searcher_search_batch(searcher, source->nkeys, (const char **)keys, keylens, batch_values);
+	if (memcmp(values, batch_values, sizeof(cmph_uint32)*source->nkeys) != 0)
+	{
+		fprintf(stderr, "Batched searches disagree\n");
+		ret = 1;
+	}
+	cmph_searcher_search_batch(mphf_searcher, source->nkeys, (const char **)keys, keylens, batch_values);
+	if (memcmp(values, batch_values, sizeof(cmph_uint32)*source->nkeys) != 0)
+	{
+		fprintf(stderr, "Batched searches of the function disagree\n");
+		ret = 1;
+	}
+	for (i = 0; i < source->nkeys; ++i) free(keys[i]);
+	free(keys);
+	free(keylens);
+	free(values);
+	free(batch_values);
+	cmph_searcher_destroy(mphf_searcher);
+	cmph_searcher_destroy(searcher);
 	free(packed_mphf);
 	cmph_destroy(mphf);	
 	free(hashtable);
@@ -0,0 +1,128 @@
+#include "../src/run_codec.h"
+#include "../src/buffer_manager.h"
+#include "../src/key_generator.h"
+
+#define DEBUG
+#include "../src/debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NKEYS 20000
+#define NBUCKETS 1000
+#define MIN_RATIO 2.0
+
+typedef struct
+{
+	cmph_uint32 h0;
+	cmph_uint8 *record;
+} url_record_t;
+
+static int url_record_cmp(const void *a, const void *b)
+{
+	const url_record_t *ra = (const url_record_t *)a;
+	const url_record_t *rb = (const url_record_t *)b;
+	cmph_uint32 alen, blen;
+	int cmp;
+	if (ra->h0 != rb->h0) return ra->h0 < rb->h0 ? -1 : 1;
+	memcpy(&alen, ra->record, sizeof(alen));
+	memcpy(&blen, rb->record, sizeof(blen));
+	cmp = memcmp(ra->record + sizeof(alen), rb->record + sizeof(blen), alen < blen ? alen : blen);
+	if (cmp) return cmp;
+	return (int)alen - (int)blen;
+}
+
+// Writes NKEYS records with shared prefixes and reads them back.
+static int check_roundtrip(const char *filename, cmph_uint8 compressed, cmph_uint32 memory_avail)
+{
+	cmph_uint8 record[sizeof(cmph_uint32) + 64];
+	cmph_uint32 i, keylen, h0;
+	cmph_uint8 *key = NULL;
+	FILE *fd = fopen(filename, "wb");
+	run_writer_t *run_writer = run_writer_new(fd, compressed);
+	buffer_manager_t *buff_manager = NULL;
+	for (i = 0; i < NKEYS; ++i)
+	{
+		keylen = (cmph_uint32)sprintf((char *)record + sizeof(keylen), "http://www.example%u.com/path/%u", i % 7, i);
+		memcpy(record, &keylen, sizeof(keylen));
+		run_writer_write(run_writer, i / 3, record);
+	}
+	if (!run_writer_destroy(run_writer)) return 0;
+	fclose(fd);
+
+	buff_manager = buffer_manager_new(memory_avail, 1, compressed);
+	buffer_manager_open(buff_manager, 0, (char *)filename);
+	for (i = 0; i < NKEYS; ++i)
+	{
+		char expected[64];
+		key = buffer_manager_read_key(buff_manager, 0, &keylen, &h0);
+		if (key == NULL) break;
+		sprintf(expected, "http://www.example%u.com/path/%u", i % 7, i);
+		if (h0 != i / 3 || keylen != strlen(expected) || memcmp(key + sizeof(keylen), expected, keylen) != 0)
+		{
+			fprintf(stderr, "record %u does not match\n", i);
+			return 0;
+		}
+	}
+	if (i != NKEYS || buffer_manager_read_key(buff_manager, 0, &keylen, &h0) != NULL)
+	{
+		fprintf(stderr, "read %u records out of %u\n", i, NKEYS);
+		return 0;
+	}
+	buffer_manager_destroy(buff_manager);
+	remove(filename);
+	return 1;
+}
+
+// Writes generated URLs spread over NBUCKETS buckets, in the order of a run,
+// and checks that the compressed run is at least MIN_RATIO times smaller.
+static int check_ratio(const char *filename)
+{
+	key_generator_t *gen = key_generator_new(KEY_URL, NKEYS, 11);
+	url_record_t *records = (url_record_t *)calloc(NKEYS, sizeof(url_record_t));
+	cmph_uint64 rawlen = 0;
+	cmph_uint32 i, keylen;
+	run_writer_t *run_writer;
+	FILE *fd;
+	long enclen;
+	double ratio;
+	for (i = 0; i < NKEYS; ++i)
+	{
+		const char *key = key_generator_key(gen, i, &keylen);
+		records[i].h0 = (cmph_uint32)(((cmph_uint64)i * 2654435761U) % NBUCKETS);
+		records[i].record = (cmph_uint8 *)malloc(sizeof(keylen) + keylen);
+		memcpy(records[i].record, &keylen, sizeof(keylen));
+		memcpy(records[i].record + sizeof(keylen), key, keylen);
+		rawlen += 2*sizeof(cmph_uint32) + keylen;
+	}
+	key_generator_destroy(gen);
+	qsort(records, NKEYS, sizeof(url_record_t), url_record_cmp);
+	fd = fopen(filename, "wb");
+	run_writer = run_writer_new(fd, 1);
+	for (i = 0; i < NKEYS; ++i) run_writer_write(run_writer, records[i].h0, records[i].record);
+	if (!run_writer_destroy(run_writer)) return 0;
+	enclen = ftell(fd);
+	fclose(fd);
+	remove(filename);
+	for (i = 0; i < NKEYS; ++i) free(records[i].record);
+	free(records);
+	ratio = (double)rawlen / (double)enclen;
+	if (ratio < MIN_RATIO)
+	{
+		fprintf(stderr, "URL runs are compressed %.2f times, less than %.2f\n", ratio, MIN_RATIO);
+		return 0;
+	}
+	fprintf(stderr, "URL runs are compressed %.2f times\n", ratio);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	const char *filename = "run_codec_tests.tmp";
+	// small buffers make records straddle two loads
+	if (!check_roundtrip(filename, 0, 1000)) return 1;
+	if (!check_roundtrip(filename, 1, 1000)) return 1;
+	if (!check_roundtrip(filename, 1, 1 << 20)) return 1;
+	if (!check_ratio(filename)) return 1;
+	fprintf(stderr, "Temporary runs are read back as written\n");
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include "../src/cmph.h"
+#include "../src/cmph_searcher.h"
+
+#define DEBUG
+#include "../src/debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NKEYS 3001   // neither a multiple of the batches below nor of the 16 keys of the BDZ groups
+#define NKEYS_BMZ8 200
+#define BATCH 37
+
+// Builds the function of the first nkeys keys. BRZ writes it while building it, so it is loaded back.
+static cmph_t *build_function(char **keys, cmph_uint32 nkeys, CMPH_ALGO algo)
+{
+	cmph_io_adapter_t *source = cmph_io_vector_adapter(keys, nkeys);
+	cmph_config_t *config = cmph_config_new(source);
+	FILE *mphf_fd = NULL;
+	cmph_t *mphf;
+	cmph_config_set_algo(config, algo);
+	if (algo == CMPH_BRZ)
+	{
+		mphf_fd = tmpfile();
+		cmph_config_set_tmp_dir(config, (cmph_uint8 *)".");
+		cmph_config_set_mphf_fd(config, mphf_fd);
+	}
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	cmph_io_vector_adapter_destroy(source);
+	if (mphf && mphf_fd)
+	{
+		cmph_dump(mphf, mphf_fd);
+		cmph_destroy(mphf);
+		rewind(mphf_fd);
+		mphf = cmph_load(mphf_fd);
+	}
+	if (mphf_fd) fclose(mphf_fd);
+	return mphf;
+}
+
+// Checks one searcher against cmph_search_packed(), key by key and in batches.
+static int check_searcher(cmph_searcher_t *searcher, void *packed, char **keys, cmph_uint32 *keylens,
+                          cmph_uint32 nkeys, const char *name)
+{
+	cmph_uint32 *values = (cmph_uint32 *)malloc(nkeys * sizeof(cmph_uint32));
+	cmph_uint32 *batch_values = (cmph_uint32 *)malloc(nkeys * sizeof(cmph_uint32));
+	cmph_uint32 i;
+	int ok = 1;
+	if (searcher == NULL)
+	{
+		fprintf(stderr, "No %s searcher\n", name);
+		ok = 0;
+	}
+	for (i = 0; ok && i < nkeys; ++i)
+	{
+		values[i] = cmph_search_packed(packed, keys[i], keylens[i]);
+		if (cmph_searcher_search(searcher, keys[i], keylens[i]) != values[i])
+		{
+			fprintf(stderr, "The %s searcher disagrees on key %.*s\n", name, keylens[i], keys[i]);
+			ok = 0;
+		}
+	}
+	if (ok)
+	{
+		cmph_searcher_search_batch(searcher, nkeys, (const char **)keys, keylens, batch_values);
+		if (memcmp(values, batch_values, nkeys * sizeof(cmph_uint32)) != 0)
+		{
+			fprintf(stderr, "The %s searcher disagrees on a batch of %u keys\n", name, nkeys);
+			ok = 0;
+		}
+	}
+	if (ok)
+	{
+		memset(batch_values, 0xff, nkeys * sizeof(cmph_uint32));
+		for (i = 0; i < nkeys; i += BATCH)
+		{
+			cmph_uint32 n = nkeys - i < BATCH ? nkeys - i : BATCH;
+			cmph_searcher_search_batch(searcher, n, (const char **)keys + i, keylens + i, batch_values + i);
+		}
+		if (memcmp(values, batch_values, nkeys * sizeof(cmph_uint32)) != 0)
+		{
+			fprintf(stderr, "The %s searcher disagrees on batches of %u keys\n", name, BATCH);
+			ok = 0;
+		}
+	}
+	free(values);
+	free(batch_values);
+	return ok;
+}
+
+static int check_algo(char **keys, cmph_uint32 *keylens, CMPH_ALGO algo)
+{
+	cmph_uint32 nkeys = algo == CMPH_BMZ8 ? NKEYS_BMZ8 : NKEYS;
+	cmph_t *mphf = build_function(keys, nkeys, algo);
+	cmph_searcher_t *searcher, *packed_searcher;
+	void *packed;
+	int ok;
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "Unable to build a %s function\n", cmph_names[algo]);
+		return 0;
+	}
+	packed = malloc(cmph_packed_size(mphf));
+	cmph_pack(mphf, packed);
+	searcher = cmph_searcher_new(mphf);
+	packed_searcher = cmph_searcher_new_packed(packed);
+	ok = check_searcher(searcher, packed, keys, keylens, nkeys, cmph_names[algo]);
+	if (ok) ok = check_searcher(packed_searcher, packed, keys, keylens, nkeys, cmph_names[algo]);
+	if (searcher) cmph_searcher_destroy(searcher);
+	if (packed_searcher) cmph_searcher_destroy(packed_searcher);
+	free(packed);
+	cmph_destroy(mphf);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	char **keys = (char **)malloc(NKEYS * sizeof(char *));
+	cmph_uint32 *keylens = (cmph_uint32 *)malloc(NKEYS * sizeof(cmph_uint32));
+	cmph_uint32 i;
+	int ok = 1;
+	for (i = 0; i < NKEYS; ++i)
+	{
+		char key[64];
+		keylens[i] = (cmph_uint32)sprintf(key, "http://www.example%u.com/path/%u", i % 7, i);
+		keys[i] = strdup(key);
+	}
+	for (i = 0; i < CMPH_COUNT; ++i) ok &= check_algo(keys, keylens, (CMPH_ALGO)i);
+	for (i = 0; i < NKEYS; ++i) free(keys[i]);
+	free(keys);
+	free(keylens);
+	if (!ok) return 1;
+	fprintf(stderr, "Searchers agree with the packed functions of every algorithm\n");
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include "../src/cmph.h"
+#include "../src/cmph_stats.h"
+
+#define DEBUG
+#include "../src/debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NKEYS 200000
+#define NKEYS_BMZ8 200
+#define NKEYS_FCH 20000   // FCH is much slower to build
+
+// Builds a function of each algorithm with statistics, and checks that the
+// total CPU time is about the sum of the CPU times of the phases: the phases
+// cover the generation but for bookkeeping, and no time is counted twice.
+static int check_algo(char **keys, CMPH_ALGO algo)
+{
+	cmph_uint32 nkeys = algo == CMPH_BMZ8 ? NKEYS_BMZ8 : algo == CMPH_FCH ? NKEYS_FCH : NKEYS;
+	cmph_io_adapter_t *source = cmph_io_vector_adapter(keys, nkeys);
+	cmph_config_t *config = cmph_config_new(source);
+	FILE *mphf_fd = NULL;
+	cmph_stats_t stats;
+	cmph_t *mphf;
+	double sum = 0;
+	cmph_uint32 i;
+	int ok = 1;
+	cmph_config_set_algo(config, algo);
+	cmph_config_set_stats(config, &stats);
+	if (algo == CMPH_BRZ)
+	{
+		mphf_fd = tmpfile();
+		cmph_config_set_tmp_dir(config, (cmph_uint8 *)".");
+		cmph_config_set_mphf_fd(config, mphf_fd);
+	}
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	cmph_io_vector_adapter_destroy(source);
+	if (mphf_fd) fclose(mphf_fd);
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "Unable to build a %s function\n", cmph_names[algo]);
+		return 0;
+	}
+	cmph_destroy(mphf);
+	for (i = 0; i < CMPH_PHASE_COUNT; ++i) sum += stats.cpu[i];
+	if (stats.algo != algo || stats.nkeys != nkeys) ok = 0;
+	if (stats.total_cpu < sum - 0.001 || stats.total_cpu > sum * 1.2 + 0.005) ok = 0;
+	if (!ok)
+	{
+		fprintf(stderr, "%s: %u keys, %.4f CPU seconds in total and %.4f in the phases\n",
+		        cmph_names[algo], stats.nkeys, stats.total_cpu, sum);
+	}
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	char **keys = (char **)malloc(NKEYS * sizeof(char *));
+	cmph_uint32 i;
+	int ok = 1;
+	for (i = 0; i < NKEYS; ++i)
+	{
+		char key[64];
+		sprintf(key, "http://www.example%u.com/path/%u", i % 7, i);
+		keys[i] = strdup(key);
+	}
+	for (i = 0; i < CMPH_COUNT; ++i) ok &= check_algo(keys, (CMPH_ALGO)i);
+	for (i = 0; i < NKEYS; ++i) free(keys[i]);
+	free(keys);
+	if (!ok) return 1;
+	fprintf(stderr, "The total CPU time of every algorithm is the sum of its phases\n");
+	return 0;
+}